@@ -1,151 +1,451 @@
-
-
-
 #ifndef __BLE_ADVERTISING_PARSING_H__
 #define __BLE_ADVERTISING_PARSING_H__
 
-#if 0
-class AdvertisementPayloadIterator;
+#include <string.h>
 
+/*
+    Read-only view of an advertising or scan response payload. Iterating
+    yields one AD structure at a time without copying; the value pointer
+    refers into the original payload. Iteration stops at the first zero
+    length field or at a field that would extend past the payload.
+*/
 class AdvertisementPayload
 {
-    friend class AdvertisementPayloadIterator;
-
 public:
     typedef struct {
-        const uint8_t* data;
-        uint8_t length;
+        uint8_t type;
+        uint8_t length;             // length of value, excluding type
+        const uint8_t* value;
     } DataField_t;
 
-    typedef AdvertisementPayloadIterator iterator;
-    typedef ptrdiff_t difference_type;
-    typedef size_t size_type;
-    typedef DataField_t  value_type;
-    typedef DataField_t* pointer;
-    typedef DataField_t& reference;
+    class iterator
+    {
+    public:
+        iterator(const AdvertisementPayload& _payload, uint8_t _position)
+            :   payload(_payload),
+                position(_position)
+        {
+            load();
+        }
+
+        const DataField_t& operator*() const
+        {
+            return field;
+        }
+
+        const DataField_t* operator->() const
+        {
+            return &field;
+        }
+
+        iterator& operator++()
+        {
+            position += field.length + 2;
+            load();
+
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator previous = *this;
+            ++(*this);
+
+            return previous;
+        }
+
+        bool operator==(const iterator& other) const
+        {
+            return (position == other.position);
+        }
+
+        bool operator!=(const iterator& other) const
+        {
+            return (position != other.position);
+        }
 
-    AdvertisementPayload(const uint8_t* _payload, uint8_t _length)
-        :   payload(_payload),
+        uint8_t getPosition() const
+        {
+            return position;
+        }
+
+    private:
+        void load()
+        {
+            // need at least length and type
+            if ((uint16_t) position + 2 > payload.length)
+            {
+                position = payload.length;
+                return;
+            }
+
+            uint8_t fieldLength = payload.data[position];
+
+            // zero length marks end of significant data, and a field must
+            // not extend beyond the payload
+            if ((fieldLength == 0) ||
+                ((uint16_t) position + 1 + fieldLength > payload.length))
+            {
+                position = payload.length;
+                return;
+            }
+
+            field.type = payload.data[position + 1];
+            field.length = fieldLength - 1;
+            field.value = &payload.data[position + 2];
+        }
+
+        const AdvertisementPayload& payload;
+        uint8_t position;
+        DataField_t field;
+    };
+
+    AdvertisementPayload(const uint8_t* _data, uint8_t _length)
+        :   data(_data),
             length(_length)
     {}
 
-    iterator begin()
+    iterator begin() const
     {
         return iterator(*this, 0);
     }
 
-    iterator end()
+    iterator end() const
     {
         return iterator(*this, length);
     }
 
 private:
-    const uint8_t* payload;
+    const uint8_t* data;
     uint8_t length;
 };
 
-class AdvertisementPayloadIterator
+/*
+    Single pass index over an advertising payload. Records the position of
+    the first occurrence of every AD type so later lookups for name, UUID
+    lists, TX power, and manufacturer data do not rescan the payload.
+*/
+class AdvertisementIndex
 {
 public:
-    AdvertisementPayloadIterator(AdvertisementPayload& _payload, uint8_t _position)
-        :   payload(_payload),
-            position(_position)
-    {}
+    AdvertisementIndex(const uint8_t* _data, uint8_t _length)
+        :   data(_data),
+            length(_length)
+    {
+        build();
+    }
 
-private:
-    AdvertisementPayload& payload;
-    uint8_t position;
-};
+    AdvertisementIndex(const Gap::AdvertisementCallbackParams_t* params)
+        :   data(params->advertisingData),
+            length(params->advertisingDataLen)
+    {
+        build();
+    }
 
-    AdvertisementPayload payload(params->advertisingData, params->advertisingDataLen);
+    bool find(uint8_t type, AdvertisementPayload::DataField_t* field) const
+    {
+        uint8_t slot = getSlot(type);
 
-    AdvertisementPayload::iterator iter = payload.begin();
+        if ((slot == NotPresent) || (positions[slot] == NotPresent))
+        {
+            return false;
+        }
 
-    for (; iter != payload.end(); iter++)
+        uint8_t position = positions[slot];
+
+        // bounds were checked while building the index
+        field->type = type;
+        field->length = data[position] - 1;
+        field->value = &data[position + 2];
+
+        return true;
+    }
+
+    bool getName(const char** name, uint8_t* nameLength) const
     {
-        iter->length;
-        iter->type;
-        iter->value;
+        AdvertisementPayload::DataField_t field;
+
+        if (find(GapAdvertisingData::COMPLETE_LOCAL_NAME, &field) ||
+            find(GapAdvertisingData::SHORTENED_LOCAL_NAME, &field))
+        {
+            *name = (const char*) field.value;
+            *nameLength = field.length;
+
+            return true;
+        }
+
+        return false;
     }
-#endif
 
-bool advertisementContainsUUID(const Gap::AdvertisementCallbackParams_t* params, const UUID& uuid)
-{
-    // scan through advertisement data
-    for (uint8_t idx = 0; idx < params->advertisingDataLen; )
+    bool getTxPower(int8_t* txPower) const
     {
-        uint8_t fieldLength = params->advertisingData[idx];
-        uint8_t fieldType = params->advertisingData[idx + 1];
-        const uint8_t* fieldValue = &(params->advertisingData[idx + 2]);
+        AdvertisementPayload::DataField_t field;
 
-        // find 16-bit service IDs
-        if ((fieldType == GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS) ||
-            (fieldType == GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS))
+        if (find(GapAdvertisingData::TX_POWER_LEVEL, &field) && (field.length >= 1))
         {
-            uint8_t units = (fieldLength - 1) / 2;
+            *txPower = (int8_t) field.value[0];
 
-            for (uint8_t idx = 0; idx < units; idx++)
-            {
-                // compare short UUID
-                UUID beaconUUID((fieldValue[idx * 2 + 1] << 8) | fieldValue[idx * 2]);
+            return true;
+        }
 
-                if (beaconUUID == uuid)
-                {
-                    return true;
-                }
+        return false;
+    }
+
+    bool getManufacturerData(const uint8_t** value, uint8_t* valueLength) const
+    {
+        AdvertisementPayload::DataField_t field;
+
+        if (find(GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA, &field))
+        {
+            *value = field.value;
+            *valueLength = field.length;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    bool containsUUID(const UUID& uuid) const
+    {
+        AdvertisementPayload::DataField_t field;
+
+        if (uuid.shortOrLong() == UUID::UUID_TYPE_SHORT)
+        {
+            uint16_t shortUUID = uuid.getShortUUID();
+            const uint8_t shortBytes[2] = { (uint8_t) shortUUID, (uint8_t) (shortUUID >> 8) };
+
+            return (find(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, &field) &&
+                    listContains(field, shortBytes, 2)) ||
+                   (find(GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS, &field) &&
+                    listContains(field, shortBytes, 2));
+        }
+        else
+        {
+            const uint8_t* longUUID = uuid.getBaseUUID();
+
+            return (find(GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS, &field) &&
+                    listContains(field, longUUID, UUID::LENGTH_OF_LONG_UUID)) ||
+                   (find(GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS, &field) &&
+                    listContains(field, longUUID, UUID::LENGTH_OF_LONG_UUID));
+        }
+    }
+
+private:
+    void build()
+    {
+        memset(positions, NotPresent, sizeof(positions));
+
+        AdvertisementPayload payload(data, length);
+
+        for (AdvertisementPayload::iterator iter = payload.begin(); iter != payload.end(); ++iter)
+        {
+            uint8_t slot = getSlot(iter->type);
+
+            if ((slot != NotPresent) && (positions[slot] == NotPresent))
+            {
+                positions[slot] = iter.getPosition();
             }
         }
-        // find 128-bit service IDs
-        else if ((fieldType == GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS) ||
-                 (fieldType == GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS))
+    }
+
+    // AD types 0x00 to 0x3F map directly, manufacturer data uses the last slot
+    static const uint8_t Slots = 0x41;
+    static const uint8_t NotPresent = 0xFF;
+
+    static uint8_t getSlot(uint8_t type)
+    {
+        if (type < Slots - 1)
+        {
+            return type;
+        }
+        else if (type == GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA)
         {
-            uint8_t units = (fieldLength - 1) / 16;
+            return Slots - 1;
+        }
 
-            for (uint8_t idx = 0; idx < units; idx++)
+        return NotPresent;
+    }
+
+    // UUIDs in advertising data and in UUID objects are little endian
+    static bool listContains(const AdvertisementPayload::DataField_t& field,
+                             const uint8_t* uuid,
+                             uint8_t uuidLength)
+    {
+        for (uint8_t offset = 0; offset + uuidLength <= field.length; offset += uuidLength)
+        {
+            if (memcmp(&field.value[offset], uuid, uuidLength) == 0)
             {
-                // compare long UUID
-                UUID beaconUUID(&fieldValue[idx * 16]);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const uint8_t* data;
+    uint8_t length;
+    uint8_t positions[Slots];
+};
 
-                if (beaconUUID == uuid)
+/*
+    Set of service UUIDs matched against an advertising payload in a single
+    pass. UUIDs are stored as raw little endian bytes when added, so
+    matching compares bytes directly without constructing UUID objects.
+    Each UUID is assigned a bit in the returned match mask.
+*/
+template <uint8_t Capacity>
+class UUIDFilterSet
+{
+public:
+    typedef uint64_t mask_t;
+
+    UUIDFilterSet()
+        :   shortCount(0),
+            longCount(0)
+    {
+        // one bit per filter in the match mask
+        typedef char CapacityCheck[(Capacity > 0) && (Capacity <= 64) ? 1 : -1];
+        (void) sizeof(CapacityCheck);
+    }
+
+    /*
+        Add UUID to the set. Returns the bit assigned to it, or -1 if the
+        set is full.
+    */
+    int8_t add(const UUID& uuid)
+    {
+        uint8_t bit = shortCount + longCount;
+
+        if (bit >= Capacity)
+        {
+            return -1;
+        }
+
+        if (uuid.shortOrLong() == UUID::UUID_TYPE_SHORT)
+        {
+            shortFilters[shortCount].value = uuid.getShortUUID();
+            shortFilters[shortCount].bit = bit;
+            shortCount++;
+        }
+        else
+        {
+            memcpy(longFilters[longCount].value, uuid.getBaseUUID(), UUID::LENGTH_OF_LONG_UUID);
+            longFilters[longCount].bit = bit;
+            longCount++;
+        }
+
+        return bit;
+    }
+
+    void clear()
+    {
+        shortCount = 0;
+        longCount = 0;
+    }
+
+    uint8_t size() const
+    {
+        return shortCount + longCount;
+    }
+
+    mask_t match(const uint8_t* data, uint8_t length) const
+    {
+        mask_t result = 0;
+
+        AdvertisementPayload payload(data, length);
+
+        for (AdvertisementPayload::iterator iter = payload.begin(); iter != payload.end(); ++iter)
+        {
+            if (((iter->type == GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS) ||
+                 (iter->type == GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS)) &&
+                (shortCount > 0))
+            {
+                for (uint8_t offset = 0; offset + 2 <= iter->length; offset += 2)
                 {
-                    return true;
+                    uint16_t value = iter->value[offset] | (iter->value[offset + 1] << 8);
+
+                    for (uint8_t idx = 0; idx < shortCount; idx++)
+                    {
+                        if (shortFilters[idx].value == value)
+                        {
+                            result |= (mask_t) 1 << shortFilters[idx].bit;
+                        }
+                    }
+                }
+            }
+            else if (((iter->type == GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS) ||
+                      (iter->type == GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS)) &&
+                     (longCount > 0))
+            {
+                for (uint8_t offset = 0; offset + UUID::LENGTH_OF_LONG_UUID <= iter->length; offset += UUID::LENGTH_OF_LONG_UUID)
+                {
+                    const uint8_t* value = &iter->value[offset];
+
+                    for (uint8_t idx = 0; idx < longCount; idx++)
+                    {
+                        // vendor UUIDs mostly differ in the bytes compared first
+                        if ((longFilters[idx].value[12] == value[12]) &&
+                            (longFilters[idx].value[13] == value[13]) &&
+                            (memcmp(longFilters[idx].value, value, UUID::LENGTH_OF_LONG_UUID) == 0))
+                        {
+                            result |= (mask_t) 1 << longFilters[idx].bit;
+                        }
+                    }
                 }
             }
         }
 
-        // move to next field
-        idx += fieldLength + 1;
+        return result;
     }
 
-    return false;
-}
+    mask_t match(const Gap::AdvertisementCallbackParams_t* params) const
+    {
+        return match(params->advertisingData, params->advertisingDataLen);
+    }
+
+private:
+    typedef struct {
+        uint16_t value;
+        uint8_t bit;
+    } short_filter_t;
+
+    typedef struct {
+        uint8_t value[UUID::LENGTH_OF_LONG_UUID];
+        uint8_t bit;
+    } long_filter_t;
+
+    short_filter_t shortFilters[Capacity];
+    long_filter_t longFilters[Capacity];
+    uint8_t shortCount;
+    uint8_t longCount;
+};
 
+inline bool advertisementContainsUUID(const Gap::AdvertisementCallbackParams_t* params, const UUID& uuid)
+{
+    AdvertisementIndex index(params->advertisingData, params->advertisingDataLen);
+
+    return index.containsUUID(uuid);
+}
 
-bool advertisementGetName(const Gap::AdvertisementCallbackParams_t* params, const char** name, uint8_t* length)
+inline bool advertisementGetName(const Gap::AdvertisementCallbackParams_t* params, const char** name, uint8_t* length)
 {
-    // scan through advertisement data
-    for (uint8_t idx = 0; idx < params->advertisingDataLen; )
-    {
-        uint8_t fieldLength = params->advertisingData[idx];
-        uint8_t fieldType = params->advertisingData[idx + 1];
-        const uint8_t* fieldValue = &(params->advertisingData[idx + 2]);
+    AdvertisementPayload payload(params->advertisingData, params->advertisingDataLen);
 
-        // find name
-        if ((fieldType == GapAdvertisingData::SHORTENED_LOCAL_NAME) ||
-            (fieldType == GapAdvertisingData::COMPLETE_LOCAL_NAME))
+    // first name field, as the index prefers the complete name
+    for (AdvertisementPayload::iterator iter = payload.begin(); iter != payload.end(); ++iter)
+    {
+        if ((iter->type == GapAdvertisingData::SHORTENED_LOCAL_NAME) ||
+            (iter->type == GapAdvertisingData::COMPLETE_LOCAL_NAME))
         {
-            *name = (const char*) fieldValue;
-            *length = fieldLength - 1;
+            *name = (const char*) iter->value;
+            *length = iter->length;
 
             return true;
         }
-
-        // move to next field
-        idx += fieldLength + 1;
     }
 
     return false;
 }
 
-
-#endif // __BLE_ADVERTISING_PARSING_H__
\ No newline at end of file
+#endif // __BLE_ADVERTISING_PARSING_H__
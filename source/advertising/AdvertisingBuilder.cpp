@@ -0,0 +1,228 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+
+#include "ble-ancs-client/ANCSClient.h"
+
+#include "AdvertisingBuilder.h"
+#include "../AdvertisingParsing.h"
+
+/*
+    Company identifier for the manufacturer data, as assigned by the
+    Bluetooth SIG. There is no default since 0xFFFF is reserved for
+    testing; set advertising.company-id in the application's config.json
+    or define ADVERTISING_COMPANY_ID.
+*/
+#ifndef ADVERTISING_COMPANY_ID
+#if defined(YOTTA_CFG_ADVERTISING_COMPANY_ID)
+#define ADVERTISING_COMPANY_ID YOTTA_CFG_ADVERTISING_COMPANY_ID
+#else
+#error "set advertising.company-id in config.json to the assigned company identifier"
+#endif
+#endif
+
+#if (ADVERTISING_COMPANY_ID < 0) || (ADVERTISING_COMPANY_ID >= 0xFFFF)
+#error "ADVERTISING_COMPANY_ID must be an assigned 16-bit identifier, 0xFFFF is for testing only"
+#endif
+
+#define PAYLOAD_MAX_LENGTH GapAdvertisingData::GAP_ADVERTISING_DATA_MAX_PAYLOAD
+
+// field sizes including length and type
+#define FLAGS_FIELD_LENGTH          (2 + 1)
+#define SOLICITATION_FIELD_LENGTH   (2 + UUID::LENGTH_OF_LONG_UUID)
+#define MANUFACTURER_VALUE_LENGTH   (2 + 1 + 1)
+#define MANUFACTURER_FIELD_LENGTH   (2 + MANUFACTURER_VALUE_LENGTH)
+#define TX_POWER_FIELD_LENGTH       (2 + 1)
+
+// name gets what is left of the scan response
+#define NAME_MAX_LENGTH             (PAYLOAD_MAX_LENGTH - TX_POWER_FIELD_LENGTH - 2)
+
+// advertising layout must fit with every optional field present
+typedef char AdvertisingLayoutCheck[(FLAGS_FIELD_LENGTH
+                                     + SOLICITATION_FIELD_LENGTH
+                                     + MANUFACTURER_FIELD_LENGTH <= PAYLOAD_MAX_LENGTH) ? 1 : -1];
+
+typedef struct {
+    uint8_t data[PAYLOAD_MAX_LENGTH];
+    uint8_t length;
+} payload_t;
+
+// content
+static bool solicitation = false;
+static int8_t txPower = 0;
+static char name[NAME_MAX_LENGTH];
+static uint8_t nameLength = 0;
+static bool nameShortened = false;
+static uint8_t batteryLevel = 0;
+static uint8_t unreadCount = 0;
+
+// payloads the stack currently has
+static payload_t advertising = { { 0 }, 0 };
+static payload_t scanResponse = { { 0 }, 0 };
+static uint8_t manufacturerOffset = 0;
+
+static AdvertisingBuilder::statistics_t statistics;
+
+/*****************************************************************************/
+
+static uint8_t addField(payload_t& payload, uint8_t type, const uint8_t* value, uint8_t length)
+{
+    uint8_t offset = payload.length;
+
+    payload.data[offset] = length + 1;
+    payload.data[offset + 1] = type;
+    memcpy(&payload.data[offset + 2], value, length);
+
+    payload.length += length + 2;
+
+    return offset;
+}
+
+static uint8_t encodeAdvertising(payload_t& payload)
+{
+    payload.length = 0;
+
+    uint8_t flags = GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE;
+    addField(payload, GapAdvertisingData::FLAGS, &flags, 1);
+
+    if (solicitation)
+    {
+        addField(payload, GapAdvertisingData::LIST_128BIT_SOLICITATION_IDS, ANCS::UUID.getBaseUUID(), UUID::LENGTH_OF_LONG_UUID);
+    }
+
+    const uint8_t manufacturer[MANUFACTURER_VALUE_LENGTH] = {
+        (uint8_t) ADVERTISING_COMPANY_ID,
+        (uint8_t) (ADVERTISING_COMPANY_ID >> 8),
+        batteryLevel,
+        unreadCount
+    };
+
+    return addField(payload, GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA, manufacturer, sizeof(manufacturer));
+}
+
+static void encodeScanResponse(payload_t& payload)
+{
+    payload.length = 0;
+
+    addField(payload, GapAdvertisingData::TX_POWER_LEVEL, (const uint8_t*) &txPower, 1);
+
+    addField(payload,
+             nameShortened ? GapAdvertisingData::SHORTENED_LOCAL_NAME : GapAdvertisingData::COMPLETE_LOCAL_NAME,
+             (const uint8_t*) name,
+             nameLength);
+}
+
+/*****************************************************************************/
+/* Advertising Builder                                                       */
+/*****************************************************************************/
+
+void AdvertisingBuilder::setSolicitation(bool enabled)
+{
+    solicitation = enabled;
+}
+
+void AdvertisingBuilder::setTxPower(int8_t _txPower)
+{
+    txPower = _txPower;
+}
+
+void AdvertisingBuilder::setName(const char* _name, uint8_t length)
+{
+    nameShortened = (length > NAME_MAX_LENGTH);
+    nameLength = nameShortened ? NAME_MAX_LENGTH : length;
+
+    memcpy(name, _name, nameLength);
+}
+
+void AdvertisingBuilder::setBatteryLevel(uint8_t level)
+{
+    batteryLevel = level;
+}
+
+void AdvertisingBuilder::setUnreadCount(uint8_t count)
+{
+    unreadCount = count;
+}
+
+void AdvertisingBuilder::apply()
+{
+    Gap& gap = BLE::Instance().gap();
+
+    statistics.applied++;
+
+    payload_t candidate;
+    uint8_t offset = encodeAdvertising(candidate);
+
+    if ((candidate.length == advertising.length) &&
+        (memcmp(candidate.data, advertising.data, candidate.length) == 0))
+    {
+        statistics.unchanged++;
+    }
+    else if ((candidate.length == advertising.length) &&
+             (offset == manufacturerOffset) &&
+             (memcmp(candidate.data, advertising.data, offset) == 0))
+    {
+        // only the manufacturer block differs
+        gap.updateAdvertisingPayload(GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA,
+                                     &candidate.data[offset + 2],
+                                     MANUFACTURER_VALUE_LENGTH);
+
+        statistics.patched++;
+    }
+    else
+    {
+        GapAdvertisingData data;
+        AdvertisementPayload fields(candidate.data, candidate.length);
+
+        for (AdvertisementPayload::iterator iter = fields.begin(); iter != fields.end(); ++iter)
+        {
+            data.addData((GapAdvertisingData::DataType) iter->type, iter->value, iter->length);
+        }
+
+        gap.setAdvertisingPayload(data);
+
+        statistics.replaced++;
+    }
+
+    advertising = candidate;
+    manufacturerOffset = offset;
+
+    /*************************************************************************/
+
+    encodeScanResponse(candidate);
+
+    if ((candidate.length != scanResponse.length) ||
+        (memcmp(candidate.data, scanResponse.data, candidate.length) != 0))
+    {
+        gap.clearScanResponse();
+
+        AdvertisementPayload fields(candidate.data, candidate.length);
+
+        for (AdvertisementPayload::iterator iter = fields.begin(); iter != fields.end(); ++iter)
+        {
+            gap.accumulateScanResponse((GapAdvertisingData::DataType) iter->type, iter->value, iter->length);
+        }
+
+        scanResponse = candidate;
+    }
+}
+
+const AdvertisingBuilder::statistics_t& AdvertisingBuilder::getStatistics()
+{
+    return statistics;
+}
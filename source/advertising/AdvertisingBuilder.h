@@ -0,0 +1,62 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ADVERTISING_BUILDER_H__
+#define __BLE_ADVERTISING_BUILDER_H__
+
+#include <stdint.h>
+
+/*
+    Keeps the encoded advertising and scan response payloads. Setters only
+    change the desired content; apply() encodes it and compares against
+    what the stack already has. Nothing is pushed if the bytes are equal,
+    a change confined to the manufacturer data block is patched in place,
+    and only other changes replace the whole payload. Advertising is never
+    stopped.
+
+    Advertising data:   flags, ANCS solicitation, manufacturer data
+                        (company ID, battery level, unread alert count)
+    Scan response:      TX power, local name
+*/
+namespace AdvertisingBuilder
+{
+    void setSolicitation(bool enabled);
+    void setTxPower(int8_t txPower);
+
+    /*
+        Names longer than the scan response allows are sent as shortened.
+    */
+    void setName(const char* name, uint8_t length);
+
+    void setBatteryLevel(uint8_t level);
+    void setUnreadCount(uint8_t count);
+
+    /*
+        Push changed bytes to the stack.
+    */
+    void apply();
+
+    typedef struct {
+        uint32_t applied;
+        uint32_t unchanged;
+        uint32_t patched;
+        uint32_t replaced;
+    } statistics_t;
+
+    const statistics_t& getStatistics();
+}
+
+#endif // __BLE_ADVERTISING_BUILDER_H__
@@ -0,0 +1,234 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+
+#include "AdvertisingManager.h"
+#include "../timer/TimerService.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+// 30 s fast, 5 min medium, then slow; intervals from Apple's recommendations
+static AdvertisingManager::stage_t stages[ADVERTISING_MAX_STAGES] = {
+    { 319,   30 * 1000 },
+    { 760,   5 * 60 * 1000 },
+    { 1285,  0 }
+};
+
+static uint8_t stageCount = 3;
+
+static AdvertisingManager::state_t state = AdvertisingManager::StateOff;
+static uint8_t stage = 0;
+static TimerService::handle_t stageTimer = TimerService::NoHandle;
+
+static minar::tick_t stateSince = 0;
+static AdvertisingManager::statistics_t statistics;
+
+static void enterStage(uint8_t next);
+static void nextStage(void);
+
+/*****************************************************************************/
+
+/*
+    Add time spent in the current state to the counters.
+*/
+static void account()
+{
+    minar::tick_t now = minar::Scheduler::getTime();
+    uint32_t elapsedMs = ((uint64_t) (now - stateSince) * 1000) / minar::milliseconds(1000);
+
+    stateSince = now;
+
+    if (state == AdvertisingManager::StateAdvertising)
+    {
+        statistics.advertisingMs += elapsedMs;
+        statistics.advertisingEvents += elapsedMs / stages[stage].intervalMs;
+    }
+    else if (state == AdvertisingManager::StateConnected)
+    {
+        statistics.connectedMs += elapsedMs;
+    }
+    else
+    {
+        statistics.offMs += elapsedMs;
+    }
+}
+
+static void cancelStageTimer()
+{
+    if (stageTimer != TimerService::NoHandle)
+    {
+        TimerService::stop(stageTimer);
+        stageTimer = TimerService::NoHandle;
+    }
+}
+
+static void enterStage(uint8_t next)
+{
+    account();
+    cancelStageTimer();
+
+    state = AdvertisingManager::StateAdvertising;
+    stage = next;
+    statistics.starts++;
+
+    DEBUGOUT("advertising: stage %u: %u ms\r\n", stage, stages[stage].intervalMs);
+
+    Gap& gap = BLE::Instance().gap();
+
+    gap.stopAdvertising();
+    gap.setAdvertisingInterval(stages[stage].intervalMs);
+    gap.startAdvertising();
+
+    if ((stages[stage].durationMs > 0) && (stage + 1 < stageCount))
+    {
+        // stages may run an eighth over to share a wakeup
+        stageTimer = TimerService::start(nextStage, stages[stage].durationMs, stages[stage].durationMs / 8);
+    }
+}
+
+static void nextStage()
+{
+    stageTimer = TimerService::NoHandle;
+
+    if (state == AdvertisingManager::StateAdvertising)
+    {
+        enterStage(stage + 1);
+    }
+}
+
+/*****************************************************************************/
+/* Advertising Manager                                                       */
+/*****************************************************************************/
+
+void AdvertisingManager::init()
+{
+    memset(&statistics, 0, sizeof(statistics));
+    stateSince = minar::Scheduler::getTime();
+}
+
+void AdvertisingManager::start(uint8_t first)
+{
+    // advertising resumes on disconnection
+    if (state == StateConnected)
+    {
+        return;
+    }
+
+    enterStage((first < stageCount) ? first : stageCount - 1);
+}
+
+void AdvertisingManager::startSlow()
+{
+    start(stageCount - 1);
+}
+
+void AdvertisingManager::stop()
+{
+    // nothing to stop, and a later start() must still wait for disconnection
+    if (state == StateConnected)
+    {
+        return;
+    }
+
+    account();
+    cancelStageTimer();
+
+    if (state == StateAdvertising)
+    {
+        BLE::Instance().gap().stopAdvertising();
+    }
+
+    state = StateOff;
+}
+
+void AdvertisingManager::setConnected()
+{
+    account();
+    cancelStageTimer();
+
+    // stack stops connectable advertising on connection
+    state = StateConnected;
+}
+
+void AdvertisingManager::setDisconnected()
+{
+    if (state == StateConnected)
+    {
+        account();
+        state = StateOff;
+    }
+}
+
+void AdvertisingManager::restart()
+{
+    if (state == StateAdvertising)
+    {
+        // new payload goes out at the current stage interval
+        enterStage(stage);
+    }
+}
+
+bool AdvertisingManager::setStages(const stage_t* _stages, uint8_t count)
+{
+    if ((count == 0) || (count > ADVERTISING_MAX_STAGES))
+    {
+        return false;
+    }
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        // Bluetooth limits: 20 ms to 10.24 s
+        if ((_stages[idx].intervalMs < 20) || (_stages[idx].intervalMs > 10240))
+        {
+            return false;
+        }
+    }
+
+    memcpy(stages, _stages, count * sizeof(stage_t));
+    stageCount = count;
+
+    if (state == StateAdvertising)
+    {
+        enterStage(0);
+    }
+
+    return true;
+}
+
+AdvertisingManager::state_t AdvertisingManager::getState()
+{
+    return state;
+}
+
+uint8_t AdvertisingManager::getStage()
+{
+    return stage;
+}
+
+const AdvertisingManager::statistics_t& AdvertisingManager::getStatistics()
+{
+    account();
+
+    return statistics;
+}
@@ -0,0 +1,89 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ADVERTISING_MANAGER_H__
+#define __BLE_ADVERTISING_MANAGER_H__
+
+#include <stdint.h>
+
+// maximum number of stages in the backoff curve
+#define ADVERTISING_MAX_STAGES 4
+
+/*
+    Advertising state machine. While disconnected, advertising walks
+    through a backoff curve of stages, each with its own interval and
+    duration; the last stage lasts until something else happens. Only one
+    stage timer is ever pending and it is cancelled on every transition.
+*/
+namespace AdvertisingManager
+{
+    typedef enum {
+        StateOff,
+        StateAdvertising,
+        StateConnected
+    } state_t;
+
+    typedef struct {
+        uint16_t intervalMs;
+        uint32_t durationMs;                // 0 for the final stage
+    } stage_t;
+
+    typedef struct {
+        uint32_t advertisingMs;
+        uint32_t connectedMs;
+        uint32_t offMs;
+        uint32_t advertisingEvents;         // estimated from stage intervals
+        uint32_t starts;
+    } statistics_t;
+
+    void init();
+
+    /*
+        Start advertising at the given stage of the curve.
+    */
+    void start(uint8_t stage = 0);
+
+    /*
+        Start advertising at the final, slowest stage.
+    */
+    void startSlow();
+
+    /*
+        Stop advertising. A connection is not affected; advertising stays
+        off after it ends until start() is called again.
+    */
+    void stop();
+
+    void setConnected();
+    void setDisconnected();
+
+    /*
+        Restart the current stage, e.g., after the payload has changed.
+    */
+    void restart();
+
+    bool setStages(const stage_t* stages, uint8_t count);
+
+    state_t getState();
+    uint8_t getStage();
+
+    /*
+        Statistics including time spent in the current state.
+    */
+    const statistics_t& getStatistics();
+}
+
+#endif // __BLE_ADVERTISING_MANAGER_H__
@@ -0,0 +1,343 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ANCSAttributeAssembler.h"
+
+#include <string.h>
+
+#define COMMAND_ID_GET_NOTIFICATION_ATTRIBUTES 0
+#define COMMAND_ID_GET_APP_ATTRIBUTES 1
+
+#define APP_ATTRIBUTE_ID_DISPLAY_NAME 0
+
+#define ATTRIBUTE_ID_TITLE      1
+#define ATTRIBUTE_ID_SUBTITLE   2
+#define ATTRIBUTE_ID_MESSAGE    3
+
+ANCSAttributeAssembler::ANCSAttributeAssembler()
+    :   state(StateDone),
+        notificationUID(0),
+        receivedUID(0),
+        uidBytes(0),
+        commandID(COMMAND_ID_GET_NOTIFICATION_ATTRIBUTES),
+        appIdentifier(NULL),
+        appIdentifierLength(0),
+        appMatched(0),
+        attributesRemaining(0),
+        currentID(0),
+        currentLength(0),
+        currentOffset(0),
+        receivedMask(0),
+        streamSink(NULL),
+        streamID(0)
+{
+    memset(lengths, 0, sizeof(lengths));
+}
+
+uint8_t ANCSAttributeAssembler::begin(uint32_t _notificationUID,
+                                      const uint8_t* attributeIDs,
+                                      uint8_t count,
+                                      uint16_t maxLength,
+                                      uint8_t* buffer,
+                                      uint8_t bufferLength)
+{
+    if ((count == 0) || (count > MaxAttributeID + 1) || (bufferLength < 5))
+    {
+        return 0;
+    }
+
+    // Title, Subtitle, and Message must not exceed local storage
+    if (maxLength > ANCS_ATTRIBUTE_MAX_LENGTH)
+    {
+        maxLength = ANCS_ATTRIBUTE_MAX_LENGTH;
+    }
+
+    uint8_t index = 0;
+
+    buffer[index++] = COMMAND_ID_GET_NOTIFICATION_ATTRIBUTES;
+    buffer[index++] = _notificationUID;
+    buffer[index++] = _notificationUID >> 8;
+    buffer[index++] = _notificationUID >> 16;
+    buffer[index++] = _notificationUID >> 24;
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        uint8_t attributeID = attributeIDs[idx];
+
+        if (attributeID > MaxAttributeID)
+        {
+            return 0;
+        }
+
+        bool hasLength = (attributeID == ATTRIBUTE_ID_TITLE) ||
+                         (attributeID == ATTRIBUTE_ID_SUBTITLE) ||
+                         (attributeID == ATTRIBUTE_ID_MESSAGE);
+
+        if (index + (hasLength ? 3 : 1) > bufferLength)
+        {
+            return 0;
+        }
+
+        buffer[index++] = attributeID;
+
+        if (hasLength)
+        {
+            buffer[index++] = maxLength;
+            buffer[index++] = maxLength >> 8;
+        }
+    }
+
+    // reset parser
+    state = StateCommandID;
+    commandID = COMMAND_ID_GET_NOTIFICATION_ATTRIBUTES;
+    notificationUID = _notificationUID;
+    receivedUID = 0;
+    uidBytes = 0;
+    attributesRemaining = count;
+    receivedMask = 0;
+    streamSink = NULL;
+    memset(lengths, 0, sizeof(lengths));
+
+    return index;
+}
+
+uint8_t ANCSAttributeAssembler::beginStream(uint32_t _notificationUID,
+                                            uint8_t attributeID,
+                                            uint16_t maxLength,
+                                            stream_sink_t sink,
+                                            uint8_t* buffer,
+                                            uint8_t bufferLength)
+{
+    if ((attributeID != ATTRIBUTE_ID_TITLE) &&
+        (attributeID != ATTRIBUTE_ID_SUBTITLE) &&
+        (attributeID != ATTRIBUTE_ID_MESSAGE))
+    {
+        return 0;
+    }
+
+    if (bufferLength < 1 + 4 + 3)
+    {
+        return 0;
+    }
+
+    uint8_t index = 0;
+
+    buffer[index++] = COMMAND_ID_GET_NOTIFICATION_ATTRIBUTES;
+    buffer[index++] = _notificationUID;
+    buffer[index++] = _notificationUID >> 8;
+    buffer[index++] = _notificationUID >> 16;
+    buffer[index++] = _notificationUID >> 24;
+    buffer[index++] = attributeID;
+    buffer[index++] = maxLength;
+    buffer[index++] = maxLength >> 8;
+
+    // reset parser
+    state = StateCommandID;
+    commandID = COMMAND_ID_GET_NOTIFICATION_ATTRIBUTES;
+    notificationUID = _notificationUID;
+    receivedUID = 0;
+    uidBytes = 0;
+    attributesRemaining = 1;
+    receivedMask = 0;
+    streamSink = sink;
+    streamID = attributeID;
+    memset(lengths, 0, sizeof(lengths));
+
+    return index;
+}
+
+uint8_t ANCSAttributeAssembler::beginApp(const uint8_t* _appIdentifier,
+                                         uint16_t _appIdentifierLength,
+                                         uint8_t* buffer,
+                                         uint16_t bufferLength)
+{
+    // command ID, NUL terminated identifier, and attribute ID
+    if ((_appIdentifierLength == 0) || (1 + _appIdentifierLength + 2 > bufferLength))
+    {
+        return 0;
+    }
+
+    uint16_t index = 0;
+
+    buffer[index++] = COMMAND_ID_GET_APP_ATTRIBUTES;
+    memcpy(&buffer[index], _appIdentifier, _appIdentifierLength);
+    index += _appIdentifierLength;
+    buffer[index++] = 0;
+    buffer[index++] = APP_ATTRIBUTE_ID_DISPLAY_NAME;
+
+    // reset parser, keeping the notification attributes
+    state = StateCommandID;
+    commandID = COMMAND_ID_GET_APP_ATTRIBUTES;
+    appIdentifier = _appIdentifier;
+    appIdentifierLength = _appIdentifierLength;
+    appMatched = 0;
+    attributesRemaining = 1;
+    receivedMask &= ~(1 << APP_ATTRIBUTE_ID_DISPLAY_NAME);
+    streamSink = NULL;
+    lengths[APP_ATTRIBUTE_ID_DISPLAY_NAME] = 0;
+
+    return index;
+}
+
+ANCSAttributeAssembler::status_t ANCSAttributeAssembler::feed(const uint8_t* data, uint16_t length)
+{
+    for (uint16_t idx = 0; (idx < length) && (state < StateDone); idx++)
+    {
+        uint8_t byte = data[idx];
+
+        switch (state)
+        {
+            case StateCommandID:
+                if (byte != commandID)
+                {
+                    state = StateError;
+                }
+                else
+                {
+                    state = (commandID == COMMAND_ID_GET_APP_ATTRIBUTES) ? StateAppIdentifier
+                                                                         : StateNotificationUID;
+                }
+                break;
+
+            case StateAppIdentifier:
+                if (byte == 0)
+                {
+                    // response belongs to a different app
+                    state = (appMatched == appIdentifierLength) ? StateAttributeID
+                                                                : StateError;
+                }
+                else if ((appMatched < appIdentifierLength) && (byte == appIdentifier[appMatched]))
+                {
+                    appMatched++;
+                }
+                else
+                {
+                    state = StateError;
+                }
+                break;
+
+            case StateNotificationUID:
+                receivedUID |= (uint32_t) byte << (8 * uidBytes);
+                uidBytes++;
+
+                if (uidBytes == 4)
+                {
+                    // response belongs to a different request
+                    state = (receivedUID == notificationUID) ? StateAttributeID
+                                                             : StateError;
+                }
+                break;
+
+            case StateAttributeID:
+                if (byte > MaxAttributeID)
+                {
+                    state = StateError;
+                }
+                else
+                {
+                    currentID = byte;
+                    state = StateLengthLow;
+                }
+                break;
+
+            case StateLengthLow:
+                currentLength = byte;
+                state = StateLengthHigh;
+                break;
+
+            case StateLengthHigh:
+                currentLength |= (uint16_t) byte << 8;
+                currentOffset = 0;
+                lengths[currentID] = 0;
+                state = StateData;
+
+                // empty attributes have no data bytes
+                if (currentLength > 0)
+                {
+                    break;
+                }
+                // fall through
+
+            case StateData:
+                if (streamSink && (currentID == streamID))
+                {
+                    // pass the run within this notification on in one call
+                    uint16_t run = currentLength - currentOffset;
+
+                    if (run > length - idx)
+                    {
+                        run = length - idx;
+                    }
+
+                    streamSink(&data[idx], run, currentOffset, (currentOffset + run == currentLength));
+
+                    currentOffset += run;
+
+                    if (run > 0)
+                    {
+                        idx += run - 1;
+                    }
+                }
+                else if (currentOffset < currentLength)
+                {
+                    // truncate values larger than local storage
+                    if (currentOffset < ANCS_ATTRIBUTE_MAX_LENGTH)
+                    {
+                        values[currentID][currentOffset] = byte;
+                        lengths[currentID]++;
+                    }
+
+                    currentOffset++;
+                }
+
+                if (currentOffset == currentLength)
+                {
+                    receivedMask |= 1 << currentID;
+                    attributesRemaining--;
+
+                    state = (attributesRemaining == 0) ? StateDone : StateAttributeID;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (state == StateDone)
+    {
+        return StatusComplete;
+    }
+    else if (state == StateError)
+    {
+        return StatusError;
+    }
+
+    return StatusInProgress;
+}
+
+bool ANCSAttributeAssembler::getAttribute(uint8_t attributeID, const uint8_t** data, uint16_t* length) const
+{
+    if ((attributeID > MaxAttributeID) || !(receivedMask & (1 << attributeID)))
+    {
+        return false;
+    }
+
+    *data = values[attributeID];
+    *length = lengths[attributeID];
+
+    return true;
+}
@@ -0,0 +1,146 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ANCS_ATTRIBUTE_ASSEMBLER_H__
+#define __BLE_ANCS_ATTRIBUTE_ASSEMBLER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// maximum number of bytes kept for each attribute
+#ifndef ANCS_ATTRIBUTE_MAX_LENGTH
+#define ANCS_ATTRIBUTE_MAX_LENGTH 110
+#endif
+
+/*
+    Builds a single Get Notification Attributes command for several
+    attributes and reassembles the response from the Data Source
+    characteristic, which may be split across any number of GATT
+    notifications. Attribute values are stored in static buffers indexed
+    by attribute ID and remain valid until the next call to begin().
+
+    Get App Attributes is handled the same way with beginApp(). The
+    display name is stored as attribute 0, in place of the app
+    identifier, and the other notification attributes are kept.
+*/
+class ANCSAttributeAssembler
+{
+public:
+    typedef enum {
+        StatusInProgress,
+        StatusComplete,
+        StatusError
+    } status_t;
+
+    // attribute IDs 0 (AppIdentifier) to 5 (Date) can be requested
+    static const uint8_t MaxAttributeID = 5;
+
+    // command ID, notification UID, and attribute ID with max length
+    static const uint8_t MaxRequestLength = 1 + 4 + 3 * (MaxAttributeID + 1);
+
+    /*
+        Receives a streamed attribute as it arrives. offset is the position
+        of data within the attribute value; final is set on the last call.
+    */
+    typedef void (*stream_sink_t)(const uint8_t* data, uint16_t length, uint16_t offset, bool final);
+
+    ANCSAttributeAssembler();
+
+    /*
+        Prepare for a new response and write the matching command into
+        buffer. Returns the command length or 0 if buffer is too small.
+    */
+    uint8_t begin(uint32_t notificationUID,
+                  const uint8_t* attributeIDs,
+                  uint8_t count,
+                  uint16_t maxLength,
+                  uint8_t* buffer,
+                  uint8_t bufferLength);
+
+    /*
+        Prepare for a response with a single attribute that is passed to
+        sink as it arrives instead of being stored, so maxLength is not
+        limited by local storage. Returns the command length or 0.
+    */
+    uint8_t beginStream(uint32_t notificationUID,
+                        uint8_t attributeID,
+                        uint16_t maxLength,
+                        stream_sink_t sink,
+                        uint8_t* buffer,
+                        uint8_t bufferLength);
+
+    /*
+        Prepare for the display name of the app with the given identifier.
+        The identifier must remain valid until the response is complete.
+        Returns the command length or 0 if buffer is too small.
+    */
+    uint8_t beginApp(const uint8_t* appIdentifier,
+                     uint16_t appIdentifierLength,
+                     uint8_t* buffer,
+                     uint16_t bufferLength);
+
+    /*
+        Consume one Data Source notification.
+    */
+    status_t feed(const uint8_t* data, uint16_t length);
+
+    /*
+        Retrieve a received attribute. Returns false if the attribute
+        was not part of the response.
+    */
+    bool getAttribute(uint8_t attributeID, const uint8_t** data, uint16_t* length) const;
+
+    uint32_t getNotificationUID() const
+    {
+        return notificationUID;
+    }
+
+private:
+    typedef enum {
+        StateCommandID,
+        StateNotificationUID,
+        StateAppIdentifier,
+        StateAttributeID,
+        StateLengthLow,
+        StateLengthHigh,
+        StateData,
+        StateDone,
+        StateError
+    } state_t;
+
+    state_t state;
+    uint32_t notificationUID;
+    uint32_t receivedUID;
+    uint8_t uidBytes;
+
+    uint8_t commandID;
+    const uint8_t* appIdentifier;
+    uint16_t appIdentifierLength;
+    uint16_t appMatched;
+
+    uint8_t attributesRemaining;
+    uint8_t currentID;
+    uint16_t currentLength;
+    uint16_t currentOffset;
+
+    uint8_t receivedMask;
+    stream_sink_t streamSink;
+    uint8_t streamID;
+    uint16_t lengths[MaxAttributeID + 1];
+    uint8_t values[MaxAttributeID + 1][ANCS_ATTRIBUTE_MAX_LENGTH];
+};
+
+#endif // __BLE_ANCS_ATTRIBUTE_ASSEMBLER_H__
@@ -18,14 +18,23 @@
 #include "BLE/ble.h"
 
 #include "message-center/MessageCenter.h"
-#include "cborg/Cbore.h"
+#include "../message/MessageQueue.h"
+#include "../cbor/CborSchema.h"
+#include "../connection/ConnectionManager.h"
+#include "../log/EventLog.h"
+#include "../log/LatencyTrace.h"
+#include "../log/TraceCapture.h"
+#include "../memory/MemoryMonitor.h"
+#include "../timer/TimerService.h"
 
 #include "core-util/SharedPointer.h"
 
 #include "ANCSManager.h"
-
-#include <string>
-#include <queue>
+#include "ANCSAttributeAssembler.h"
+#include "AlertRateLimiter.h"
+#include "AppNameCache.h"
+#include "HandleCache.h"
+#include "NotificationScheduler.h"
 
 using namespace mbed::util;
 
@@ -38,24 +47,376 @@ using namespace mbed::util;
 #endif // DEBUGOUT
 
 #define ALERT_LEVEL 1
-#define MAX_RETRIEVE_LENGTH 110
+#define MAX_RETRIEVE_LENGTH ANCS_ATTRIBUTE_MAX_LENGTH
+
+// fetch all attributes with a single Get Notification Attributes command
+#ifndef ANCS_FETCH_PIPELINED
+#define ANCS_FETCH_PIPELINED 1
+#endif
+
+/*
+    Fall back to one request per attribute through ANCSClient until the
+    pipelined handles are known, or always without pipelining. ANCSClient
+    allocates a block per response in its own callback, where no
+    MemoryMonitor::Allowance can reach, so by default notifications wait
+    for the handles instead.
+*/
+#ifndef ANCS_FETCH_SEQUENTIAL
+#if ANCS_FETCH_PIPELINED
+#define ANCS_FETCH_SEQUENTIAL 0
+#else
+#define ANCS_FETCH_SEQUENTIAL 1
+#endif
+#endif
+
+#if !ANCS_FETCH_PIPELINED && !ANCS_FETCH_SEQUENTIAL
+#error "ANCS_FETCH_SEQUENTIAL is needed without ANCS_FETCH_PIPELINED"
+#endif
+
+#if ANCS_FETCH_SEQUENTIAL && MEMORY_HEAP_TRAP
+#error "ANCS_FETCH_SEQUENTIAL allocates after init, set MEMORY_HEAP_TRAP to 0"
+#endif
+
+// include optional attributes in pipelined fetch
+#ifndef ANCS_FETCH_APP_IDENTIFIER
+#define ANCS_FETCH_APP_IDENTIFIER 0
+#endif
+
+#ifndef ANCS_FETCH_DATE
+#define ANCS_FETCH_DATE 0
+#endif
+
+// resolve the app identifier to a display name, cached across notifications
+#ifndef ANCS_APP_NAMES
+#define ANCS_APP_NAMES 1
+#endif
+
+// merge bursts within a category into one alert that carries a count
+#ifndef ANCS_COALESCE_ALERTS
+#define ANCS_COALESCE_ALERTS 1
+#endif
+
+// how long a fetch is held back for more of the same category to arrive
+#ifndef ANCS_COALESCE_WINDOW_MS
+#define ANCS_COALESCE_WINDOW_MS 250
+#endif
+
+// categories that are merged: Social, News, and Entertainment
+#ifndef ANCS_COALESCE_CATEGORIES
+#define ANCS_COALESCE_CATEGORIES ((1 << ANCSClient::CategoryIDSocial) | \
+                                  (1 << ANCSClient::CategoryIDNews) | \
+                                  (1 << ANCSClient::CategoryIDEntertainment))
+#endif
+
+// allow the host to ask for alert text in TextCodec encoding
+#ifndef ANCS_TEXT_PACKING
+#define ANCS_TEXT_PACKING 1
+#endif
+
+// cap host wakeups per app with a token bucket
+#ifndef ANCS_RATE_LIMIT
+#define ANCS_RATE_LIMIT 1
+#endif
+
+// behaviour when the notification queue is full
+#ifndef ANCS_QUEUE_OVERFLOW_POLICY
+#define ANCS_QUEUE_OVERFLOW_POLICY NotificationScheduler::OverflowReplaceLowest
+#endif
+
+// number of alerts that can be fetched or in flight to the host at once
+#ifndef ANCS_SEND_SLOTS
+#define ANCS_SEND_SLOTS 2
+#endif
+
+#if (ANCS_SEND_SLOTS < 1) || (ANCS_SEND_SLOTS > 4)
+#error "ANCS_SEND_SLOTS must be between 1 and 4"
+#endif
+
+// forward the rest of long messages in fragments when the host asks for it
+#ifndef ANCS_STREAM_MESSAGES
+#define ANCS_STREAM_MESSAGES 1
+#endif
+
+// message bytes per fragment; bounds the RAM used for streaming
+#ifndef ANCS_FRAGMENT_LENGTH
+#define ANCS_FRAGMENT_LENGTH 64
+#endif
+
+// fragments that can be queued for the host at once
+#ifndef ANCS_FRAGMENT_SLOTS
+#define ANCS_FRAGMENT_SLOTS 2
+#endif
+
+// longest message requested from the phone when streaming
+#ifndef ANCS_STREAM_MAX_LENGTH
+#define ANCS_STREAM_MAX_LENGTH 1024
+#endif
+
+#if (ANCS_FRAGMENT_SLOTS < 1) || (ANCS_FRAGMENT_SLOTS > 4)
+#error "ANCS_FRAGMENT_SLOTS must be between 1 and 4"
+#endif
+
+/*
+    alert on AlertPort: [alert level, "title subtitle", "message"], followed by
+    uid and final when streaming, where final is 0 if the message was cut
+    short and the rest can be requested, by "app name" when enabled, and by
+    count and category count when coalescing. count is the number of
+    notifications the alert stands for; category count is the phone's.
+*/
+typedef CborSchema::Array<CborSchema::Unsigned<ALERT_LEVEL>,
+                          CborSchema::JoinedText<MAX_RETRIEVE_LENGTH, MAX_RETRIEVE_LENGTH>,
+                          CborSchema::Text<MAX_RETRIEVE_LENGTH>
+#if ANCS_STREAM_MESSAGES
+                          , CborSchema::Unsigned<>
+                          , CborSchema::Unsigned<1>
+#endif
+#if ANCS_APP_NAMES
+                          , CborSchema::Text<ANCS_APP_NAME_MAX_LENGTH>
+#endif
+#if ANCS_COALESCE_ALERTS
+                          , CborSchema::Unsigned<0xFF>
+                          , CborSchema::Unsigned<0xFF>
+#endif
+                          > AlertMessage;
+
+#if ANCS_STREAM_MESSAGES
+/*
+    fragment on AlertPort: [uid, offset, final, bytes]
+    bytes, not text, since a fragment boundary can split a UTF-8 sequence.
+*/
+typedef CborSchema::Array<CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<ANCS_STREAM_MAX_LENGTH>,
+                          CborSchema::Unsigned<1>,
+                          CborSchema::Bytes<ANCS_FRAGMENT_LENGTH> > FragmentMessage;
+#endif
+
+// abandon a pipelined fetch if the phone does not respond
+#define FETCH_TIMEOUT_MS 5000
+
+/*
+    The phone answers a Control Point write and then sends the response on
+    the Data Source. The write response does not carry the ATT status in
+    this BLE API, so a write that is acknowledged and followed by no data,
+    e.g., error 0xA2 for a UID that was just removed, is abandoned after
+    this many connection events instead of the full timeout. At the idle
+    profile an event can be 1800 ms apart, so a fixed wait would abandon
+    answers that are merely slow; ANCS_FETCH_REJECT_MS is the floor.
+*/
+#ifndef ANCS_FETCH_REJECT_EVENTS
+#define ANCS_FETCH_REJECT_EVENTS 2
+#endif
+
+#ifndef ANCS_FETCH_REJECT_MS
+#define ANCS_FETCH_REJECT_MS 1000
+#endif
+
+// retry characteristic discovery while the stack is busy
+#define DISCOVERY_RETRY_MS 1000
+
+// give up on reading a cached characteristic declaration
+#define VERIFY_TIMEOUT_MS 1000
 
 static ANCSClient ancs;
 
-static SharedPointer<BlockStatic> sendBlock;
+#if ANCS_FETCH_SEQUENTIAL
 static SharedPointer<BlockStatic> titleBlock;
 static SharedPointer<BlockStatic> subtitleBlock;
 
 static ANCSClient::notification_attribute_id_t attributeIndex;
+#endif
 static uint32_t notificationID = 0;
 
-static std::queue<uint32_t> notificationQueue;
+static NotificationScheduler scheduler(ANCS_QUEUE_OVERFLOW_POLICY);
+
+/*
+    Send slots. A slot is reserved when a fetch starts, filled by sendAlert,
+    and released by its own completion callback, so the next notification
+    can be fetched while the previous alert is still being sent.
+*/
+typedef enum {
+    SlotFree,
+    SlotReserved,
+    SlotSending
+} slot_state_t;
+
+static CborMessage<AlertMessage> slotMessages[ANCS_SEND_SLOTS];
+static slot_state_t slotStates[ANCS_SEND_SLOTS];
+static uint8_t slotNext = 0;
+static uint32_t slotArrival[ANCS_SEND_SLOTS];
+static uint32_t slotQueued[ANCS_SEND_SLOTS];
+static int8_t currentSlot = -1;
+static uint8_t slotHighWaterMark = 0;
+static uint32_t alertsDropped = 0;
+
+typedef enum {
+    FetchIdle,
+    FetchScheduled,
+    FetchBlocked,
+    FetchDiscovery,
+    FetchSequential,
+    FetchPipelined,
+    FetchProbe,
+    FetchApp,
+    FetchStreaming
+} fetch_state_t;
+
+static fetch_state_t fetchState = FetchIdle;
+
+// tracepoints for the notification being fetched
+static uint32_t fetchArrival = 0;
+static uint8_t fetchCategory = 0;
+static uint8_t fetchCategoryCount = 0;
+static uint8_t alertCount = 1;
+static uint32_t fetchMark = 0;
+static bool fetchResponded = false;
+static bool enabled = true;
+static bool packText = false;
+
+#if ANCS_FETCH_PIPELINED
+static const UUID controlPointUUID("69D1D8F3-45E1-49A8-9821-9BBDFDAAD9D9");
+static const UUID dataSourceUUID("22EAC6E9-24D6-4BB5-BE44-B36ACE7C7BFB");
+
+static const uint8_t pipelinedAttributes[] = {
+    ANCSClient::NotificationAttributeIDTitle,
+    ANCSClient::NotificationAttributeIDSubtitle,
+    ANCSClient::NotificationAttributeIDMessage,
+#if ANCS_FETCH_APP_IDENTIFIER || ANCS_APP_NAMES || ANCS_RATE_LIMIT
+    ANCSClient::NotificationAttributeIDAppIdentifier,
+#endif
+#if ANCS_FETCH_DATE
+    ANCSClient::NotificationAttributeIDDate,
+#endif
+};
+
+// Get App Attributes: command ID, NUL terminated identifier, attribute ID
+static const uint16_t appRequestLength = (ANCS_APP_NAMES) ? 1 + ANCS_APP_ID_MAX_LENGTH + 2 : 0;
+static const uint16_t requestLength = (appRequestLength > ANCSAttributeAssembler::MaxRequestLength)
+                                      ? appRequestLength : ANCSAttributeAssembler::MaxRequestLength;
+
+static ANCSAttributeAssembler assembler;
+static uint8_t requestBuffer[requestLength];
+
+static Gap::Handle_t connectionHandle;
+static GattAttribute::Handle_t controlPointHandle = 0;
+static GattAttribute::Handle_t dataSourceHandle = 0;
+
+/*
+    Handles from a previous connection are checked by reading the two
+    characteristic declarations before the first fetch, one round trip
+    each; if either does not match they are dropped and discovered.
+
+    The cache is keyed by peer address. Phones connect with a resolvable
+    private address that changes every time, and this BLE API exposes
+    neither the identity address nor the IRK of a bonded peer, so all
+    such peers share one record under an empty address. The check above
+    catches a different phone.
+*/
+static HandleCache handleCache;
+static Gap::AddressType_t peerAddressType;
+static Gap::Address_t peerAddress;
+static bool handlesUnverified = false;
+static uint8_t handlesChecked = 0;
+static minar::callback_handle_t verifyHandle = NULL;
+static minar::callback_handle_t discoveryHandle = NULL;
+static uint32_t connectionTime = 0;
+
+static minar::callback_handle_t fetchTimeoutHandle = NULL;
+
+// state of the current Control Point request
+static bool fetchAcknowledged = false;
+static bool fetchReceiving = false;
+
+static void onConnection(const Gap::ConnectionCallbackParams_t* params);
+static void onDisconnection(const Gap::DisconnectionCallbackParams_t* params);
+static void discoverCharacteristics(void);
+static void onCharacteristic(const DiscoveredCharacteristic* characteristic);
+static void verifyHandles(void);
+static void onDeclarationRead(const GattReadCallbackParams* params);
+static void onVerifyTimeout(void);
+static void onDataSource(const GattHVXCallbackParams* params);
+static void onControlPointWritten(const GattWriteCallbackParams* params);
+static void armFetchTimeout(void);
+static void onFetchTimeout(void);
+static void invalidateHandles(void);
+static bool resolveApp(void);
+static void sendAssembledAlert(const uint8_t* app, uint16_t appLength);
+#endif
+
+#if ANCS_COALESCE_ALERTS
+// delayed processQueue while a burst is gathering
+static minar::callback_handle_t coalesceHandle = NULL;
+
+#if ANCS_FETCH_PIPELINED
+// notification whose app identifier is being fetched to key the merge
+static const uint8_t probeAttributes[] = { ANCSClient::NotificationAttributeIDAppIdentifier };
+static uint32_t probeUID = 0;
+static uint8_t probeCategory = 0;
+
+static bool startProbe(void);
+static uint32_t appKey(const uint8_t* identifier, uint16_t identifierLength);
+#endif
+#endif
+
+#if !ANCS_FETCH_SEQUENTIAL
+// delayed processQueue after a request the stack did not take
+static minar::callback_handle_t retryHandle = NULL;
+#endif
+
+#if ANCS_RATE_LIMIT && ANCS_FETCH_PIPELINED
+static AlertRateLimiter rateLimiter;
+static minar::callback_handle_t replayHandle = NULL;
+
+static bool admitAlert(void);
+static void scheduleReplay(void);
+static void onReplay(void);
+#endif
+
+#if ANCS_APP_NAMES && ANCS_FETCH_PIPELINED
+// identifier of the app being resolved, referenced by the assembler
+static uint8_t appIdentifier[ANCS_APP_ID_MAX_LENGTH];
+static uint16_t appIdentifierLength = 0;
+
+static AppNameCache appNames;
+#endif
+
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+/*
+    Streaming. One request from the host is held until the fetch is idle,
+    then the message is fetched again at full length. The first
+    MAX_RETRIEVE_LENGTH bytes were already sent with the alert, the rest
+    is collected in fragmentData and sent whenever it fills up, so nothing
+    larger than a fragment is ever buffered.
+*/
+static bool streamRequested = false;
+static uint32_t streamRequestUID = 0;
+static bool streamAborted = false;
+static uint16_t streamOffset = 0;
+static uint32_t streamOverruns = 0;
+
+static uint8_t fragmentData[ANCS_FRAGMENT_LENGTH];
+static uint16_t fragmentFill = 0;
+
+static CborMessage<FragmentMessage> fragmentMessages[ANCS_FRAGMENT_SLOTS];
+static bool fragmentBusy[ANCS_FRAGMENT_SLOTS];
+
+static bool startStream(void);
+static void onMessageStream(const uint8_t* data, uint16_t length, uint16_t offset, bool final);
+static void sendFragment(bool final);
+#endif
 
 static void onServiceFound(void);
 static void onNotificationTask(ANCSClient::Notification_t event);
+#if ANCS_FETCH_SEQUENTIAL
 static void onNotificationAttributeTask(SharedPointer<BlockStatic> dataPayload);
-static void sendTaskDone(void);
+#endif
+static void sendAlert(const uint8_t* title, uint32_t titleLength,
+                      const uint8_t* subtitle, uint32_t subtitleLength,
+                      const uint8_t* message, uint32_t messageLength,
+                      const uint8_t* app, uint32_t appLength);
+static void releaseSlot(uint8_t slot);
+static void updateBusy(void);
 static void processQueue(void);
+static void traceResponse(void);
 
 // extern function
 void updateConnectionParameters(void);
@@ -64,131 +425,1402 @@ void updateConnectionParameters(void);
 /* ANCS                                                                      */
 /*****************************************************************************/
 
-void ANCSManager::init()
+const NotificationScheduler::statistics_t& ANCSManager::getQueueStatistics()
+{
+    return scheduler.getStatistics();
+}
+
+uint32_t ANCSManager::getDroppedAlerts()
+{
+    return alertsDropped;
+}
+
+uint8_t ANCSManager::getSlotHighWaterMark()
+{
+    return slotHighWaterMark;
+}
+
+bool ANCSManager::setTextEncoding(uint32_t encoding)
+{
+    if (encoding == TextPlain)
+    {
+        packText = false;
+        return true;
+    }
+
+#if ANCS_TEXT_PACKING
+    if (encoding == TextPacked)
+    {
+        packText = true;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+ANCSManager::text_encoding_t ANCSManager::getTextEncoding()
+{
+    return (packText) ? TextPacked : TextPlain;
+}
+
+const AlertRateLimiter::statistics_t& ANCSManager::getRateStatistics()
+{
+#if ANCS_RATE_LIMIT && ANCS_FETCH_PIPELINED
+    return rateLimiter.getStatistics();
+#else
+    static const AlertRateLimiter::statistics_t none = { 0, 0, 0 };
+    return none;
+#endif
+}
+
+bool ANCSManager::requestMessage(uint32_t notificationUID)
+{
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+    // streaming relies on the Data Source being reassembled locally
+    if ((controlPointHandle == 0) || (dataSourceHandle == 0) || handlesUnverified)
+    {
+        return false;
+    }
+
+    // a newer request replaces one that has not started yet
+    streamRequestUID = notificationUID;
+    streamRequested = true;
+
+    if (fetchState == FetchIdle)
+    {
+        fetchState = FetchScheduled;
+        minar::Scheduler::postCallback(processQueue);
+
+        updateBusy();
+    }
+
+    return true;
+#else
+    (void) notificationUID;
+    return false;
+#endif
+}
+
+const AppNameCache::statistics_t& ANCSManager::getAppCacheStatistics()
+{
+#if ANCS_APP_NAMES && ANCS_FETCH_PIPELINED
+    return appNames.getStatistics();
+#else
+    static const AppNameCache::statistics_t none = { 0, 0, 0 };
+    return none;
+#endif
+}
+
+const HandleCache::statistics_t& ANCSManager::getHandleCacheStatistics()
+{
+#if ANCS_FETCH_PIPELINED
+    return handleCache.getStatistics();
+#else
+    static const HandleCache::statistics_t none = { 0, 0, 0, 0 };
+    return none;
+#endif
+}
+
+uint32_t ANCSManager::getStreamOverruns()
+{
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+    return streamOverruns;
+#else
+    return 0;
+#endif
+}
+
+void ANCSManager::setEnabled(bool _enabled)
+{
+    enabled = _enabled;
+
+    if (!enabled)
+    {
+        scheduler.clear();
+    }
+}
+
+bool ANCSManager::isEnabled()
+{
+    return enabled;
+}
+
+void ANCSManager::init(PersistentStorage* handleStorage)
 {
     ancs.init();
 
+#if ANCS_FETCH_PIPELINED
+    handleCache.setStorage(handleStorage);
+#else
+    (void) handleStorage;
+#endif
+
+    MessageQueue::addPort(MessageCenter::AlertPort, MessageQueue::PriorityAlert);
+
     ancs.registerServiceFoundHandlerTask(onServiceFound);
     ancs.registerNotificationHandlerTask(onNotificationTask);
+#if ANCS_FETCH_SEQUENTIAL
     ancs.registerDataHandlerTask(onNotificationAttributeTask);
+#endif
+
+#if ANCS_FETCH_PIPELINED
+    BLE::Instance().gap().onConnection(onConnection);
+    BLE::Instance().gap().onDisconnection(onDisconnection);
+    BLE::Instance().gattClient().onHVX(onDataSource);
+    BLE::Instance().gattClient().onDataWritten(onControlPointWritten);
+    BLE::Instance().gattClient().onDataRead(onDeclarationRead);
+#endif
 }
 
 static void onServiceFound()
 {
     DEBUGOUT("ancs: ancs service found\r\n");
 
+    TraceCapture::record(TraceCapture::RecordServiceFound);
+
     updateConnectionParameters();
+
+#if ANCS_FETCH_PIPELINED
+    // locate Control Point and Data Source once the client is done
+    minar::Scheduler::cancelCallback(discoveryHandle);
+    discoveryHandle = minar::Scheduler::postCallback(discoverCharacteristics)
+                        .delay(minar::milliseconds(DISCOVERY_RETRY_MS))
+                        .getHandle();
+#endif
 }
 
-static void onNotificationTask(ANCSClient::Notification_t event)
+#if ANCS_FETCH_PIPELINED
+static void onConnection(const Gap::ConnectionCallbackParams_t* params)
 {
-    // only process newly added notifications that are not silent
-    if ((event.eventID == ANCSClient::EventIDNotificationAdded) &&
-        !(event.eventFlags & ANCSClient::EventFlagSilent))
+    if (params->role == Gap::PERIPHERAL)
     {
-        DEBUGOUT("ancs: %u %u %u %u %lu\r\n", event.eventID, event.eventFlags, event.categoryID, event.categoryCount, event.notificationUID);
+        connectionHandle = params->handle;
+        connectionTime = LatencyTrace::now();
 
-        notificationQueue.push(event.notificationUID);
+        peerAddressType = params->peerAddrType;
+        memcpy(peerAddress, params->peerAddr, sizeof(peerAddress));
 
-        if (notificationQueue.size() == 1)
+        // a private address says nothing about the phone behind it
+        if (peerAddressType == BLEProtocol::AddressType::RANDOM_PRIVATE_RESOLVABLE)
         {
-            minar::Scheduler::postCallback(processQueue);
+            memset(peerAddress, 0, sizeof(peerAddress));
+        }
+
+        HandleCache::handles_t handles;
+
+        // pipelined fetches can start before the client has finished discovery
+        if (handleCache.find(peerAddressType, peerAddress, &handles) &&
+            (handles.controlPoint > 1) &&
+            (handles.dataSource > 1))
+        {
+            controlPointHandle = handles.controlPoint;
+            dataSourceHandle = handles.dataSource;
+            handlesUnverified = true;
+            handlesChecked = 0;
+
+            EventLog::record(EventLog::EventHandlesCached, controlPointHandle, dataSourceHandle);
+
+            verifyHandles();
         }
     }
 }
 
-static void processQueue()
+static void onDisconnection(const Gap::DisconnectionCallbackParams_t* params)
 {
-    DEBUGOUT("process queue: %d\r\n", notificationQueue.size());
+    if (params->handle == connectionHandle)
+    {
+        // handles are only valid for the current connection
+        controlPointHandle = 0;
+        dataSourceHandle = 0;
+        handlesUnverified = false;
 
-    notificationID = notificationQueue.front();
+        if (verifyHandle)
+        {
+            minar::Scheduler::cancelCallback(verifyHandle);
+            verifyHandle = NULL;
+        }
 
-    attributeIndex = ANCSClient::NotificationAttributeIDTitle;
-    ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+        // a discovery launched now would be for a link that is gone
+        if (discoveryHandle)
+        {
+            minar::Scheduler::cancelCallback(discoveryHandle);
+            discoveryHandle = NULL;
+        }
+
+        if (fetchTimeoutHandle)
+        {
+            minar::Scheduler::cancelCallback(fetchTimeoutHandle);
+            fetchTimeoutHandle = NULL;
+        }
+
+#if !ANCS_FETCH_SEQUENTIAL
+        if (retryHandle)
+        {
+            minar::Scheduler::cancelCallback(retryHandle);
+            retryHandle = NULL;
+        }
+#endif
+
+#if ANCS_COALESCE_ALERTS
+        if (coalesceHandle)
+        {
+            minar::Scheduler::cancelCallback(coalesceHandle);
+            coalesceHandle = NULL;
+        }
+#endif
+
+        // pending notifications are replayed by the phone on reconnect
+        if ((currentSlot >= 0) && (slotStates[currentSlot] == SlotReserved))
+        {
+            releaseSlot(currentSlot);
+        }
+
+        currentSlot = -1;
+
+#if ANCS_STREAM_MESSAGES
+        // fragments already queued are released by their own callbacks
+        streamRequested = false;
+        fragmentFill = 0;
+#endif
+
+#if ANCS_RATE_LIMIT
+        // buckets are kept, suppressed UIDs are meaningless after this
+        rateLimiter.clearPending();
+
+        if (replayHandle)
+        {
+            minar::Scheduler::cancelCallback(replayHandle);
+            replayHandle = NULL;
+        }
+#endif
+
+        fetchState = FetchIdle;
+        scheduler.clear();
+    }
 }
 
-static void onNotificationAttributeTask(SharedPointer<BlockStatic> dataPayload)
+static void discoverCharacteristics()
 {
-    DEBUGOUT("data: ");
-    for (uint8_t idx = 0; idx < dataPayload->getLength(); idx++)
+    GattClient& client = BLE::Instance().gattClient();
+
+    discoveryHandle = NULL;
+
+    if ((controlPointHandle != 0) && (dataSourceHandle != 0))
     {
-        DEBUGOUT("%c", dataPayload->at(idx));
+        return;
     }
-    DEBUGOUT("\r\n");
 
-    if (attributeIndex == ANCSClient::NotificationAttributeIDTitle)
+    if (client.isServiceDiscoveryActive() ||
+        (client.launchServiceDiscovery(connectionHandle,
+                                       NULL,
+                                       onCharacteristic,
+                                       ANCS::UUID) != BLE_ERROR_NONE))
     {
-        // store title payload
-        titleBlock = dataPayload;
+        discoveryHandle = minar::Scheduler::postCallback(discoverCharacteristics)
+                            .delay(minar::milliseconds(DISCOVERY_RETRY_MS))
+                            .getHandle();
+    }
+}
 
-        // get subtitle
-        attributeIndex = ANCSClient::NotificationAttributeIDSubtitle;
-        ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+static void onCharacteristic(const DiscoveredCharacteristic* characteristic)
+{
+    if (characteristic->getUUID() == controlPointUUID)
+    {
+        controlPointHandle = characteristic->getValueHandle();
     }
-    else if (attributeIndex == ANCSClient::NotificationAttributeIDSubtitle)
+    else if (characteristic->getUUID() == dataSourceUUID)
     {
-        // store title payload
-        subtitleBlock = dataPayload;
+        dataSourceHandle = characteristic->getValueHandle();
+    }
+    else
+    {
+        return;
+    }
 
-        // get message
-        attributeIndex = ANCSClient::NotificationAttributeIDMessage;
-        ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+    DEBUGOUT("ancs: handles: %u %u\r\n", controlPointHandle, dataSourceHandle);
+
+    TraceCapture::record(TraceCapture::RecordCharacteristic,
+                         (characteristic->getUUID() == controlPointUUID) ? 1 : 2,
+                         characteristic->getValueHandle());
+
+    if ((controlPointHandle != 0) && (dataSourceHandle != 0))
+    {
+        HandleCache::handles_t handles = { controlPointHandle, dataSourceHandle };
+
+        LatencyTrace::record(LatencyTrace::StageDiscovery, connectionTime);
+        handleCache.store(peerAddressType, peerAddress, handles);
+
+        if (fetchState == FetchDiscovery)
+        {
+            fetchState = FetchScheduled;
+            minar::Scheduler::postCallback(processQueue);
+        }
     }
-    else if (attributeIndex == ANCSClient::NotificationAttributeIDMessage)
+}
+
+/*
+    Read the declaration of the cached Control Point, then of the cached
+    Data Source. A characteristic value always follows its declaration.
+*/
+static void verifyHandles()
+{
+    verifyHandle = NULL;
+
+    GattAttribute::Handle_t declaration = ((handlesChecked == 0) ? controlPointHandle : dataSourceHandle) - 1;
+
+    if (BLE::Instance().gattClient().read(connectionHandle, declaration, 0) == BLE_ERROR_NONE)
     {
-        // get length for the title and subtitle
-        uint32_t titleLength = titleBlock->getLength();
-        uint32_t subtitleLength = subtitleBlock->getLength();
+        verifyHandle = minar::Scheduler::postCallback(onVerifyTimeout)
+                        .delay(minar::milliseconds(VERIFY_TIMEOUT_MS))
+                        .getHandle();
+    }
+    else
+    {
+        // the stack is busy, e.g., with the client's own discovery
+        verifyHandle = minar::Scheduler::postCallback(verifyHandles)
+                        .delay(minar::milliseconds(DISCOVERY_RETRY_MS))
+                        .getHandle();
+    }
+}
+
+static void onDeclarationRead(const GattReadCallbackParams* params)
+{
+    uint32_t values[4] = { params->connHandle, params->handle, params->offset, params->len };
+    TraceCapture::record(TraceCapture::RecordRead, values, 4, params->data, params->len);
+
+    GattAttribute::Handle_t value = (handlesChecked == 0) ? controlPointHandle : dataSourceHandle;
+    const UUID& uuid = (handlesChecked == 0) ? controlPointUUID : dataSourceUUID;
+
+    if (!handlesUnverified ||
+        (params->connHandle != connectionHandle) ||
+        (params->handle != value - 1))
+    {
+        return;
+    }
+
+    minar::Scheduler::cancelCallback(verifyHandle);
+    verifyHandle = NULL;
+
+    // properties, value handle, and the 128-bit UUID
+    bool valid = (params->offset == 0) &&
+                 (params->len == 3 + UUID::LENGTH_OF_LONG_UUID) &&
+                 ((params->data[1] | (params->data[2] << 8)) == value) &&
+                 (memcmp(&params->data[3], uuid.getBaseUUID(), UUID::LENGTH_OF_LONG_UUID) == 0);
+
+    if (!valid)
+    {
+        invalidateHandles();
+        return;
+    }
+
+    if (++handlesChecked < 2)
+    {
+        verifyHandles();
+        return;
+    }
+
+    handlesUnverified = false;
+
+    LatencyTrace::record(LatencyTrace::StageDiscovery, connectionTime);
+
+    if (fetchState == FetchDiscovery)
+    {
+        fetchState = FetchScheduled;
+        minar::Scheduler::postCallback(processQueue);
+    }
+}
+
+static void onVerifyTimeout()
+{
+    verifyHandle = NULL;
+
+    invalidateHandles();
+}
+
+/*
+    Cached handles did not match; forget them and discover from scratch.
+*/
+static void invalidateHandles()
+{
+    EventLog::record(EventLog::EventHandlesInvalid, controlPointHandle, dataSourceHandle);
+
+    if (verifyHandle)
+    {
+        minar::Scheduler::cancelCallback(verifyHandle);
+        verifyHandle = NULL;
+    }
+
+    handleCache.remove(peerAddressType, peerAddress);
 
-        // allocate buffer for combined title
-        uint32_t messageLength = 1 + titleLength + subtitleLength;
-        char messageBuffer[messageLength];
+    controlPointHandle = 0;
+    dataSourceHandle = 0;
+    handlesUnverified = false;
+
+    minar::Scheduler::cancelCallback(discoveryHandle);
+    discoveryHandle = minar::Scheduler::postCallback(discoverCharacteristics)
+                        .getHandle();
+}
+#endif
 
-        // copy title and subtitle into message buffer
-        memcpy(&messageBuffer[0], titleBlock->getData(), titleLength);
-        messageBuffer[titleLength] = ' ';
-        memcpy(&messageBuffer[titleLength + 1], subtitleBlock->getData(), subtitleLength);
+static void onNotificationTask(ANCSClient::Notification_t event)
+{
+    EventLog::record(EventLog::EventNotification, event.eventID, event.eventFlags, event.categoryID, event.notificationUID);
 
-        // allocate buffer for message center
-        uint8_t cborLength = 1 + 1                          // array and alert level
-                           + 2 + messageLength              // title
-                           + 2 + dataPayload->getLength();  // message
+    uint32_t values[5] = { event.eventID, event.eventFlags, event.categoryID, event.categoryCount, event.notificationUID };
+    TraceCapture::record(TraceCapture::RecordNotification, values, 5);
 
-        sendBlock = SharedPointer<BlockStatic>(new BlockDynamic(cborLength));
+    if (event.eventID == ANCSClient::EventIDNotificationRemoved)
+    {
+        // no point in fetching a notification the user has dismissed
+        scheduler.cancel(event.notificationUID);
+        return;
+    }
 
-        // construct cbor
-        Cbore cbor(sendBlock->getData(), sendBlock->getLength());
+    // only process added or modified notifications that are not silent
+    if (!enabled || (event.eventFlags & ANCSClient::EventFlagSilent))
+    {
+        return;
+    }
 
-        cbor.array(3)
-            .item(ALERT_LEVEL)
-            .item((const char*) messageBuffer, messageLength)
-            .item((const char*) dataPayload->getData(), dataPayload->getLength());
+#if ANCS_COALESCE_ALERTS
+    // the app is learned from the Data Source, which needs pipelined fetching
+    bool coalesce = ANCS_FETCH_PIPELINED &&
+                    (event.eventID == ANCSClient::EventIDNotificationAdded) &&
+                    (event.categoryID < 32) &&
+                    ((uint32_t) ANCS_COALESCE_CATEGORIES & (1UL << event.categoryID));
 
-        // set length
-        sendBlock->setLength(cbor.getLength());
+    // merged with pending notifications of the same app once its app is known
+    uint32_t app = (coalesce) ? NotificationScheduler::AppUnresolved : NotificationScheduler::AppNone;
+#else
+    uint32_t app = NotificationScheduler::AppNone;
+#endif
 
-        // send message
-        MessageCenter::sendTask(MessageCenter::RemoteHost,
-                                MessageCenter::AlertPort,
-                                *(sendBlock.get()),
-                                sendTaskDone);
+    // modified notifications are coalesced with pending entries
+    scheduler.add(event.notificationUID, event.categoryID, LatencyTrace::now(), event.categoryCount, app);
 
-        // remove ID from queue
-        notificationQueue.pop();
+    if (fetchState == FetchIdle)
+    {
+        fetchState = FetchScheduled;
 
-        // process next ID if available
-        if (notificationQueue.size() > 0)
+#if ANCS_COALESCE_ALERTS
+        // give the rest of a burst a moment to arrive
+        if (coalesce && (ANCS_COALESCE_WINDOW_MS > 0))
+        {
+            coalesceHandle = minar::Scheduler::postCallback(processQueue)
+                                .delay(minar::milliseconds(ANCS_COALESCE_WINDOW_MS))
+                                .getHandle();
+        }
+        else
+#endif
         {
             minar::Scheduler::postCallback(processQueue);
         }
+
+        updateBusy();
+    }
+#if ANCS_COALESCE_ALERTS
+    else if (!coalesce && coalesceHandle)
+    {
+        // other categories are not held back by a gathering burst
+        minar::Scheduler::cancelCallback(coalesceHandle);
+        coalesceHandle = NULL;
+
+        minar::Scheduler::postCallback(processQueue);
     }
+#endif
 }
 
-static void sendTaskDone()
+static void processQueue()
 {
-    // flag buffers as done
-    titleBlock = SharedPointer<BlockStatic>();
-    sendBlock = SharedPointer<BlockStatic>();
-}
+    DEBUGOUT("process queue: %d\r\n", scheduler.size());
+
+#if !ANCS_FETCH_SEQUENTIAL
+    retryHandle = NULL;
+#endif
+
+#if ANCS_COALESCE_ALERTS
+    coalesceHandle = NULL;
+#endif
+
+    // every caller schedules first; a stale callback must not start a
+    // second fetch next to one that is already running
+    if (fetchState != FetchScheduled)
+    {
+        return;
+    }
+
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+    // the host is waiting for this one, serve it before new alerts
+    if (streamRequested)
+    {
+        streamRequested = false;
 
+        if (startStream())
+        {
+            return;
+        }
+    }
+#endif
 
+    if (scheduler.empty())
+    {
+        fetchState = FetchIdle;
+        updateBusy();
+        return;
+    }
+
+#if !ANCS_FETCH_SEQUENTIAL
+    // wait for discovery, or for cached handles to be checked, rather
+    // than fetch through the client
+    if ((controlPointHandle == 0) || (dataSourceHandle == 0) || handlesUnverified)
+    {
+        fetchState = FetchDiscovery;
+        return;
+    }
+#endif
+
+#if ANCS_COALESCE_ALERTS && ANCS_FETCH_PIPELINED
+    // learn the app of each notification in a burst before fetching any
+    if (startProbe())
+    {
+        return;
+    }
+#endif
+
+    // reserve send slot in ring order, wait for a completion if none is free
+    uint8_t slotsTaken = 1;
+
+    for (uint8_t idx = 0; idx < ANCS_SEND_SLOTS; idx++)
+    {
+        slotsTaken += (slotStates[idx] != SlotFree) ? 1 : 0;
+    }
+
+    for (uint8_t idx = 0; idx < ANCS_SEND_SLOTS; idx++)
+    {
+        uint8_t slot = (slotNext + idx) % ANCS_SEND_SLOTS;
+
+        if (slotStates[slot] == SlotFree)
+        {
+            slotStates[slot] = SlotReserved;
+            slotNext = (slot + 1) % ANCS_SEND_SLOTS;
+            currentSlot = slot;
+            break;
+        }
+    }
+
+    if ((currentSlot >= 0) && (slotsTaken > slotHighWaterMark))
+    {
+        slotHighWaterMark = slotsTaken;
+    }
+
+    if (currentSlot < 0)
+    {
+        fetchState = FetchBlocked;
+        return;
+    }
+
+    scheduler.take(&notificationID, &fetchCategory, &fetchArrival, &fetchCategoryCount, &alertCount);
+
+    fetchMark = LatencyTrace::record(LatencyTrace::StageQueue, fetchArrival);
+    fetchResponded = false;
+
+#if ANCS_FETCH_PIPELINED
+    if ((controlPointHandle != 0) && (dataSourceHandle != 0) && !handlesUnverified)
+    {
+        uint8_t length = assembler.begin(notificationID,
+                                         pipelinedAttributes,
+                                         sizeof(pipelinedAttributes),
+                                         MAX_RETRIEVE_LENGTH,
+                                         requestBuffer,
+                                         sizeof(requestBuffer));
+
+        ble_error_t result =
+            BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_REQ,
+                                               connectionHandle,
+                                               controlPointHandle,
+                                               length,
+                                               requestBuffer);
+
+        if (result == BLE_ERROR_NONE)
+        {
+            fetchState = FetchPipelined;
+            EventLog::record(EventLog::EventFetchStart, notificationID, 1);
+
+            armFetchTimeout();
+            return;
+        }
+    }
+#endif
+
+#if ANCS_FETCH_SEQUENTIAL
+    fetchState = FetchSequential;
+    EventLog::record(EventLog::EventFetchStart, notificationID, 0);
+
+    attributeIndex = ANCSClient::NotificationAttributeIDTitle;
+    ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+#else
+    // the stack is busy; put the notification back as it was and try again shortly
+    scheduler.requeue();
+
+    releaseSlot(currentSlot);
+    currentSlot = -1;
+
+    fetchState = FetchScheduled;
+    retryHandle = minar::Scheduler::postCallback(processQueue)
+                    .delay(minar::milliseconds(DISCOVERY_RETRY_MS))
+                    .getHandle();
+#endif
+}
+
+static void nextNotification()
+{
+    // release slot if the fetch did not produce an alert
+    if ((currentSlot >= 0) && (slotStates[currentSlot] == SlotReserved))
+    {
+        releaseSlot(currentSlot);
+    }
+
+    currentSlot = -1;
+    fetchState = FetchIdle;
+
+    bool pending = !scheduler.empty();
+
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+    pending = pending || streamRequested;
+#endif
+
+    // process next ID or stream request if available
+    if (pending)
+    {
+        fetchState = FetchScheduled;
+        minar::Scheduler::postCallback(processQueue);
+    }
+
+    updateBusy();
+}
+
+#if ANCS_FETCH_PIPELINED
+static void onDataSource(const GattHVXCallbackParams* params)
+{
+    // other notifications, e.g., Notification Source, are captured as such
+    if (params->handle == dataSourceHandle)
+    {
+        uint32_t values[3] = { params->connHandle, params->handle, params->len };
+        TraceCapture::record(TraceCapture::RecordDataSource, values, 3, params->data, params->len);
+    }
+
+    if (((fetchState != FetchPipelined) && (fetchState != FetchProbe) &&
+         (fetchState != FetchApp) && (fetchState != FetchStreaming)) ||
+        (params->connHandle != connectionHandle) ||
+        (params->handle != dataSourceHandle))
+    {
+        return;
+    }
+
+    if (fetchState == FetchPipelined)
+    {
+        traceResponse();
+    }
+
+    fetchReceiving = true;
+
+    // streamed message bytes are passed to onMessageStream from here
+    ANCSAttributeAssembler::status_t status = assembler.feed(params->data, params->len);
+
+    if (status == ANCSAttributeAssembler::StatusInProgress)
+    {
+        return;
+    }
+
+    minar::Scheduler::cancelCallback(fetchTimeoutHandle);
+    fetchTimeoutHandle = NULL;
+
+    if (fetchState == FetchStreaming)
+    {
+        if (status != ANCSAttributeAssembler::StatusComplete)
+        {
+            EventLog::record(EventLog::EventFetchMalformed, notificationID);
+        }
+    }
+#if ANCS_COALESCE_ALERTS
+    else if (fetchState == FetchProbe)
+    {
+        const uint8_t* identifier = NULL;
+        uint16_t identifierLength = 0;
+        uint32_t app = NotificationScheduler::AppNone;
+
+        if ((status == ANCSAttributeAssembler::StatusComplete) &&
+            assembler.getAttribute(ANCSClient::NotificationAttributeIDAppIdentifier, &identifier, &identifierLength) &&
+            (identifierLength > 0))
+        {
+            app = appKey(identifier, identifierLength);
+        }
+        else if (status != ANCSAttributeAssembler::StatusComplete)
+        {
+            EventLog::record(EventLog::EventFetchMalformed, probeUID);
+        }
+
+        if (scheduler.resolve(probeUID, app))
+        {
+            EventLog::record(EventLog::EventSuperseded, probeUID, probeCategory);
+        }
+    }
+#endif
+#if ANCS_APP_NAMES
+    else if (fetchState == FetchApp)
+    {
+        const uint8_t* name = NULL;
+        uint16_t nameLength = 0;
+
+        if (status == ANCSAttributeAssembler::StatusComplete)
+        {
+            assembler.getAttribute(0, &name, &nameLength);
+        }
+        else
+        {
+            EventLog::record(EventLog::EventFetchMalformed, notificationID);
+        }
+
+        // failures are cached as an empty name, so they are not retried
+        appNames.insert(appIdentifier, appIdentifierLength, name, nameLength);
+
+        sendAssembledAlert(name, nameLength);
+    }
+#endif
+    else if (status == ANCSAttributeAssembler::StatusComplete)
+    {
+        fetchMark = LatencyTrace::record(LatencyTrace::StageAttributes, fetchMark);
+
+#if ANCS_RATE_LIMIT
+        // alert is sent once the app name is known, unless the app is over its budget
+        if (admitAlert() && resolveApp())
+        {
+            return;
+        }
+#else
+        // alert is sent once the app name is known
+        if (resolveApp())
+        {
+            return;
+        }
+#endif
+    }
+    else
+    {
+        EventLog::record(EventLog::EventFetchMalformed, notificationID);
+    }
+
+    nextNotification();
+}
+
+#if ANCS_RATE_LIMIT
+// scaling the tick count would jump back when the counter wraps
+static uint32_t nowMs()
+{
+    return TimerService::getTimeMs();
+}
+
+/*
+    Charge the app of the assembled notification one token. Without one
+    the alert is not sent and the host is not woken up.
+*/
+static bool admitAlert()
+{
+    const uint8_t* identifier = NULL;
+    uint16_t identifierLength = 0;
+    uint8_t carried = 0;
+
+    if (!assembler.getAttribute(ANCSClient::NotificationAttributeIDAppIdentifier, &identifier, &identifierLength))
+    {
+        return true;
+    }
+
+    if (rateLimiter.admit(identifier, identifierLength,
+                          notificationID, fetchCategory, alertCount,
+                          nowMs(), &carried))
+    {
+        alertCount = (alertCount > 0xFF - carried) ? 0xFF : alertCount + carried;
+        return true;
+    }
+
+    EventLog::record(EventLog::EventSuppressed, notificationID, alertCount);
+
+    scheduleReplay();
+
+    return false;
+}
+
+/*
+    Wake up when the first app with a suppressed notification has a token.
+*/
+static void scheduleReplay()
+{
+    if (replayHandle)
+    {
+        return;
+    }
+
+    int32_t delay = rateLimiter.getReplayDelay(nowMs());
+
+    if (delay >= 0)
+    {
+        replayHandle = minar::Scheduler::postCallback(onReplay)
+                          .delay(minar::milliseconds(delay))
+                          .getHandle();
+    }
+}
+
+/*
+    Fetch the newest suppressed notification of each app again, so the
+    latest text reaches the host once the burst is over.
+*/
+static void onReplay()
+{
+    uint32_t uid;
+    uint8_t categoryID;
+
+    replayHandle = NULL;
+
+    while (rateLimiter.takeReplay(nowMs(), &uid, &categoryID))
+    {
+        scheduler.add(uid, categoryID, LatencyTrace::now());
+    }
+
+    if (!scheduler.empty() && (fetchState == FetchIdle))
+    {
+        fetchState = FetchScheduled;
+        minar::Scheduler::postCallback(processQueue);
+
+        updateBusy();
+    }
+
+    scheduleReplay();
+}
+#endif
+
+#if ANCS_COALESCE_ALERTS
+static uint32_t appKey(const uint8_t* identifier, uint16_t identifierLength)
+{
+    uint32_t key = AlertRateLimiter::hash(identifier, identifierLength);
+
+    // keep clear of the keys with a meaning of their own
+    return (key > NotificationScheduler::AppUnresolved) ? key : key + 2;
+}
+
+/*
+    Fetch only the app identifier of a notification that may be merged
+    with another one in its category. The request and response are a few
+    bytes, and every merge saves fetching a full set of attributes.
+    Returns true while the app identifier is being fetched.
+*/
+static bool startProbe()
+{
+    // the sequential fallback gets here before the handles are known
+    if ((controlPointHandle == 0) || (dataSourceHandle == 0) || handlesUnverified ||
+        !scheduler.findUnresolved(&probeUID, &probeCategory))
+    {
+        return false;
+    }
+
+    uint8_t length = assembler.begin(probeUID,
+                                     probeAttributes,
+                                     sizeof(probeAttributes),
+                                     0,
+                                     requestBuffer,
+                                     sizeof(requestBuffer));
+
+    // a busy stack is retried through the regular fetch
+    if ((length == 0) ||
+        (BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_REQ,
+                                            connectionHandle,
+                                            controlPointHandle,
+                                            length,
+                                            requestBuffer) != BLE_ERROR_NONE))
+    {
+        return false;
+    }
+
+    fetchState = FetchProbe;
+
+    armFetchTimeout();
+
+    updateBusy();
+
+    return true;
+}
+#endif
+
+/*
+    Look up the app of the assembled notification and send the alert, or
+    start Get App Attributes for an app not seen before. Returns true
+    while the app name is being fetched.
+*/
+static bool resolveApp()
+{
+    const uint8_t* name = NULL;
+    uint16_t nameLength = 0;
+
+#if ANCS_APP_NAMES
+    const uint8_t* identifier = NULL;
+    uint16_t identifierLength = 0;
+
+    if (assembler.getAttribute(ANCSClient::NotificationAttributeIDAppIdentifier, &identifier, &identifierLength) &&
+        !appNames.find(identifier, identifierLength, &name, &nameLength) &&
+        (identifierLength > 0) &&
+        (identifierLength <= ANCS_APP_ID_MAX_LENGTH))
+    {
+        // attribute 0 is overwritten by the response, keep a copy
+        memcpy(appIdentifier, identifier, identifierLength);
+        appIdentifierLength = identifierLength;
+
+        uint8_t length = assembler.beginApp(appIdentifier,
+                                            appIdentifierLength,
+                                            requestBuffer,
+                                            sizeof(requestBuffer));
+
+        if ((length > 0) &&
+            (BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_REQ,
+                                                connectionHandle,
+                                                controlPointHandle,
+                                                length,
+                                                requestBuffer) == BLE_ERROR_NONE))
+        {
+            fetchState = FetchApp;
+            EventLog::record(EventLog::EventAppFetch, notificationID, appIdentifierLength);
+
+            armFetchTimeout();
+            return true;
+        }
+    }
+#endif
+
+    sendAssembledAlert(name, nameLength);
+
+    return false;
+}
+
+static void sendAssembledAlert(const uint8_t* app, uint16_t appLength)
+{
+    const uint8_t* title = NULL;
+    const uint8_t* subtitle = NULL;
+    const uint8_t* message = NULL;
+    uint16_t titleLength = 0;
+    uint16_t subtitleLength = 0;
+    uint16_t messageLength = 0;
+
+    assembler.getAttribute(ANCSClient::NotificationAttributeIDTitle, &title, &titleLength);
+    assembler.getAttribute(ANCSClient::NotificationAttributeIDSubtitle, &subtitle, &subtitleLength);
+    assembler.getAttribute(ANCSClient::NotificationAttributeIDMessage, &message, &messageLength);
+
+    sendAlert(title, titleLength, subtitle, subtitleLength, message, messageLength, app, appLength);
+}
+
+/*
+    Wait for the response to the Control Point write that was just sent.
+*/
+static void armFetchTimeout()
+{
+    fetchAcknowledged = false;
+    fetchReceiving = false;
+
+    fetchTimeoutHandle = minar::Scheduler::postCallback(onFetchTimeout)
+                            .delay(minar::milliseconds(FETCH_TIMEOUT_MS))
+                            .getHandle();
+}
+
+static void onControlPointWritten(const GattWriteCallbackParams* params)
+{
+    // when the phone answers decides when a rejected fetch is abandoned
+    if (params->handle == controlPointHandle)
+    {
+        TraceCapture::record(TraceCapture::RecordWritten, params->connHandle, params->handle);
+    }
+
+    if ((params->connHandle != connectionHandle) ||
+        (params->handle != controlPointHandle) ||
+        (fetchTimeoutHandle == NULL) ||
+        fetchAcknowledged ||
+        fetchReceiving)
+    {
+        return;
+    }
+
+    // a rejected request is followed by nothing; do not wait it out
+    fetchAcknowledged = true;
+
+    uint32_t rejectMs = ConnectionManager::getEventPeriodMs() * ANCS_FETCH_REJECT_EVENTS;
+
+    if (rejectMs < ANCS_FETCH_REJECT_MS)
+    {
+        rejectMs = ANCS_FETCH_REJECT_MS;
+    }
+    else if (rejectMs > FETCH_TIMEOUT_MS)
+    {
+        rejectMs = FETCH_TIMEOUT_MS;
+    }
+
+    minar::Scheduler::cancelCallback(fetchTimeoutHandle);
+    fetchTimeoutHandle = minar::Scheduler::postCallback(onFetchTimeout)
+                            .delay(minar::milliseconds(rejectMs))
+                            .getHandle();
+}
+
+static void onFetchTimeout()
+{
+    if (fetchAcknowledged && !fetchReceiving)
+    {
+        EventLog::record(EventLog::EventFetchRejected, notificationID);
+    }
+    else
+    {
+        EventLog::record(EventLog::EventFetchTimeout, notificationID);
+    }
+
+    fetchTimeoutHandle = NULL;
+
+#if ANCS_APP_NAMES
+    // the notification itself is complete, send it without a name
+    if (fetchState == FetchApp)
+    {
+        appNames.insert(appIdentifier, appIdentifierLength, NULL, 0);
+        sendAssembledAlert(NULL, 0);
+    }
+#endif
+
+#if ANCS_COALESCE_ALERTS
+    // fetch it as it is rather than probe it again
+    if (fetchState == FetchProbe)
+    {
+        scheduler.resolve(probeUID, NotificationScheduler::AppNone);
+    }
+#endif
+
+    // notification was most likely removed before it could be fetched
+    if ((fetchState == FetchPipelined) || (fetchState == FetchProbe) ||
+        (fetchState == FetchApp) || (fetchState == FetchStreaming))
+    {
+        nextNotification();
+    }
+}
+#endif
+
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+static bool startStream()
+{
+    uint8_t length = assembler.beginStream(streamRequestUID,
+                                           ANCSClient::NotificationAttributeIDMessage,
+                                           ANCS_STREAM_MAX_LENGTH,
+                                           onMessageStream,
+                                           requestBuffer,
+                                           sizeof(requestBuffer));
+
+    if ((length == 0) ||
+        (BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_REQ,
+                                            connectionHandle,
+                                            controlPointHandle,
+                                            length,
+                                            requestBuffer) != BLE_ERROR_NONE))
+    {
+        return false;
+    }
+
+    fetchState = FetchStreaming;
+    notificationID = streamRequestUID;
+    streamAborted = false;
+    streamOffset = MAX_RETRIEVE_LENGTH;
+    fragmentFill = 0;
+
+    EventLog::record(EventLog::EventStreamStart, notificationID);
+
+    armFetchTimeout();
+
+    updateBusy();
+
+    return true;
+}
+
+/*
+    Message bytes as they arrive. offset is relative to the whole message.
+*/
+static void onMessageStream(const uint8_t* data, uint16_t length, uint16_t offset, bool final)
+{
+    if (streamAborted)
+    {
+        return;
+    }
+
+    // skip the part that was sent with the alert
+    if (offset < MAX_RETRIEVE_LENGTH)
+    {
+        uint16_t skip = MAX_RETRIEVE_LENGTH - offset;
+
+        skip = (skip > length) ? length : skip;
+        data += skip;
+        length -= skip;
+    }
+
+    while ((length > 0) && !streamAborted)
+    {
+        uint16_t size = ANCS_FRAGMENT_LENGTH - fragmentFill;
+
+        size = (size > length) ? length : size;
+        memcpy(&fragmentData[fragmentFill], data, size);
+
+        fragmentFill += size;
+        data += size;
+        length -= size;
+
+        // a full fragment at the very end is sent as the final one below
+        if ((fragmentFill == ANCS_FRAGMENT_LENGTH) && !(final && (length == 0)))
+        {
+            sendFragment(false);
+        }
+    }
+
+    // an empty final fragment tells the host there is nothing more
+    if (final && !streamAborted)
+    {
+        sendFragment(true);
+    }
+}
+
+template <uint8_t Slot>
+static void fragmentSendDone()
+{
+    fragmentBusy[Slot] = false;
+
+    updateBusy();
+}
+
+// completion callback for each fragment slot
+static void (* const fragmentSendDoneHandlers[4])(void) = {
+    fragmentSendDone<0>,
+    fragmentSendDone<1>,
+    fragmentSendDone<2>,
+    fragmentSendDone<3>
+};
+
+static void sendFragment(bool final)
+{
+    int8_t slot = -1;
+
+    for (uint8_t idx = 0; idx < ANCS_FRAGMENT_SLOTS; idx++)
+    {
+        if (!fragmentBusy[idx])
+        {
+            slot = idx;
+            break;
+        }
+    }
+
+    // host link is slower than the phone; give up and let the host ask again
+    if (slot >= 0)
+    {
+        BlockStatic& block = fragmentMessages[slot].encode(notificationID,
+                                                           streamOffset,
+                                                           final,
+                                                           CborSchema::bytes(fragmentData, fragmentFill));
+
+        fragmentBusy[slot] = MessageQueue::send(MessageCenter::AlertPort,
+                                                block,
+                                                fragmentSendDoneHandlers[slot]);
+    }
+
+    if ((slot < 0) || !fragmentBusy[slot])
+    {
+        EventLog::record(EventLog::EventStreamOverrun, notificationID, streamOffset);
+
+        streamAborted = true;
+        streamOverruns++;
+    }
+    else
+    {
+        EventLog::record(EventLog::EventStreamFragment, notificationID, streamOffset, fragmentFill, final);
+    }
+
+    streamOffset += fragmentFill;
+    fragmentFill = 0;
+
+    updateBusy();
+}
+#endif
+
+#if ANCS_FETCH_SEQUENTIAL
+static void onNotificationAttributeTask(SharedPointer<BlockStatic> dataPayload)
+{
+    uint32_t values[2] = { attributeIndex, dataPayload->getLength() };
+    TraceCapture::record(TraceCapture::RecordAttributeData, values, 2,
+                         dataPayload->getData(), dataPayload->getLength());
+
+    // responses to pipelined requests are reassembled in onDataSource
+    if (fetchState != FetchSequential)
+    {
+        return;
+    }
+
+    EventLog::record(EventLog::EventAttributeData, attributeIndex, dataPayload->getLength());
+
+    traceResponse();
+
+    if (attributeIndex == ANCSClient::NotificationAttributeIDTitle)
+    {
+        // store title payload
+        titleBlock = dataPayload;
+
+        // get subtitle
+        attributeIndex = ANCSClient::NotificationAttributeIDSubtitle;
+        ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+    }
+    else if (attributeIndex == ANCSClient::NotificationAttributeIDSubtitle)
+    {
+        // store title payload
+        subtitleBlock = dataPayload;
+
+        // get message
+        attributeIndex = ANCSClient::NotificationAttributeIDMessage;
+        ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+    }
+    else if (attributeIndex == ANCSClient::NotificationAttributeIDMessage)
+    {
+        fetchMark = LatencyTrace::record(LatencyTrace::StageAttributes, fetchMark);
+
+        sendAlert(titleBlock->getData(), titleBlock->getLength(),
+                  subtitleBlock->getData(), subtitleBlock->getLength(),
+                  dataPayload->getData(), dataPayload->getLength(),
+                  NULL, 0);
+
+        nextNotification();
+    }
+}
+#endif
+
+/*
+    Close the wait for the first attribute data of the current fetch.
+*/
+static void traceResponse()
+{
+    if (!fetchResponded)
+    {
+        fetchMark = LatencyTrace::record(LatencyTrace::StageFirstResponse, fetchMark);
+        fetchResponded = true;
+    }
+}
+
+template <uint8_t Slot>
+static void slotSendDone()
+{
+    LatencyTrace::record(LatencyTrace::StageSend, slotQueued[Slot]);
+    LatencyTrace::record(LatencyTrace::StageTotal, slotArrival[Slot]);
+
+    releaseSlot(Slot);
+}
+
+// completion callback for each send slot
+static void (* const slotSendDoneHandlers[4])(void) = {
+    slotSendDone<0>,
+    slotSendDone<1>,
+    slotSendDone<2>,
+    slotSendDone<3>
+};
+
+static void sendAlert(const uint8_t* title, uint32_t titleLength,
+                      const uint8_t* subtitle, uint32_t subtitleLength,
+                      const uint8_t* message, uint32_t messageLength,
+                      const uint8_t* app, uint32_t appLength)
+{
+    if (currentSlot < 0)
+    {
+        EventLog::record(EventLog::EventAlertDropped, notificationID);
+
+        alertsDropped++;
+        return;
+    }
+
+    uint8_t slot = currentSlot;
+    uint32_t encodeStart = LatencyTrace::now();
+
+    // schema truncates attributes the phone sent longer than requested,
+    // final is 0 when a message that filled the request may have been cut
+    BlockStatic& block = slotMessages[slot].encode(ALERT_LEVEL,
+                                                   CborSchema::joined((const char*) title, titleLength,
+                                                                      (const char*) subtitle, subtitleLength,
+                                                                      packText),
+                                                   CborSchema::text((const char*) message, messageLength, packText)
+#if ANCS_STREAM_MESSAGES
+                                                   , notificationID
+                                                   , (messageLength < MAX_RETRIEVE_LENGTH)
+#endif
+#if ANCS_APP_NAMES
+                                                   , CborSchema::text((const char*) app, appLength, packText)
+#endif
+#if ANCS_COALESCE_ALERTS
+                                                   , alertCount
+                                                   , fetchCategoryCount
+#endif
+                                                   );
+
+    slotStates[slot] = SlotSending;
+    slotArrival[slot] = fetchArrival;
+    slotQueued[slot] = LatencyTrace::record(LatencyTrace::StageEncode, encodeStart);
+    EventLog::record(EventLog::EventAlertSent, block.getLength(), slot);
+    TraceCapture::record(TraceCapture::RecordAlertQueued, notificationID, block.getLength());
+
+#if ANCS_FETCH_SEQUENTIAL
+    // attribute blocks are no longer needed
+    titleBlock = SharedPointer<BlockStatic>();
+    subtitleBlock = SharedPointer<BlockStatic>();
+#endif
+
+    // send message, alerts queue behind control and radio messages
+    if (!MessageQueue::send(MessageCenter::AlertPort,
+                            block,
+                            slotSendDoneHandlers[slot]))
+    {
+        alertsDropped++;
+        releaseSlot(slot);
+    }
+}
+
+static void releaseSlot(uint8_t slot)
+{
+    slotStates[slot] = SlotFree;
+
+    // resume fetching if it was waiting for a slot
+    if (fetchState == FetchBlocked)
+    {
+        fetchState = FetchScheduled;
+        minar::Scheduler::postCallback(processQueue);
+    }
+
+    updateBusy();
+}
+
+/*
+    Ask for a short connection interval while fetching or sending alerts.
+*/
+static void updateBusy()
+{
+    bool sending = false;
+
+    for (uint8_t idx = 0; idx < ANCS_SEND_SLOTS; idx++)
+    {
+        if (slotStates[idx] == SlotSending)
+        {
+            sending = true;
+        }
+    }
+
+#if ANCS_STREAM_MESSAGES && ANCS_FETCH_PIPELINED
+    for (uint8_t idx = 0; idx < ANCS_FRAGMENT_SLOTS; idx++)
+    {
+        if (fragmentBusy[idx])
+        {
+            sending = true;
+        }
+    }
+#endif
+
+    ConnectionManager::setBusy(ConnectionManager::SourceANCS, (fetchState != FetchIdle));
+    ConnectionManager::setBusy(ConnectionManager::SourceAlerts, sending);
+}
@@ -19,9 +19,68 @@
 
 #include "ble-ancs-client/ANCSClient.h"
 
+#include "AlertRateLimiter.h"
+#include "AppNameCache.h"
+#include "HandleCache.h"
+#include "NotificationScheduler.h"
+
+#include "../storage/PersistentStorage.h"
+
 namespace ANCSManager
 {
-    void init();
+    typedef enum {
+        TextPlain = 0,
+        TextPacked = 1                  // alert text as TextCodec byte strings
+    } text_encoding_t;
+
+    /*
+        Discovered handles are kept per peer in storage, which must hold
+        HandleCache::StorageLength bytes. NULL disables the cache.
+    */
+    void init(PersistentStorage* handleStorage = NULL);
+
+    /*
+        Ignore notifications while disabled. Pending notifications are
+        dropped; an alert already being fetched is still sent.
+    */
+    void setEnabled(bool enabled);
+    bool isEnabled();
+
+    /*
+        Encoding of alert text, chosen by the host. Returns false and
+        keeps the current one if the encoding is not supported.
+    */
+    bool setTextEncoding(uint32_t encoding);
+    text_encoding_t getTextEncoding();
+
+    // counters for added, coalesced, superseded, cancelled, and dropped notifications
+    const NotificationScheduler::statistics_t& getQueueStatistics();
+
+    // alerts discarded because no send buffer was available
+    uint32_t getDroppedAlerts();
+
+    // most send slots in use at once, of ANCS_SEND_SLOTS
+    uint8_t getSlotHighWaterMark();
+
+    // alerts admitted, suppressed, and replayed by the per-app rate limit
+    const AlertRateLimiter::statistics_t& getRateStatistics();
+
+    /*
+        Fetch the message of an alert sent with final = 0 again at full
+        length and forward everything after the part already sent as
+        [uid, offset, final, bytes] fragments on AlertPort. Returns false
+        if streaming is not available on this connection.
+    */
+    bool requestMessage(uint32_t notificationUID);
+
+    // hits and misses when resolving app names
+    const AppNameCache::statistics_t& getAppCacheStatistics();
+
+    // peers that reconnected with or without known handles
+    const HandleCache::statistics_t& getHandleCacheStatistics();
+
+    // streams abandoned because the host link could not keep up
+    uint32_t getStreamOverruns();
 }
 
 #endif // __BLE_ANCS_MANAGER_H__
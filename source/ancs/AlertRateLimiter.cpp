@@ -0,0 +1,174 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AlertRateLimiter.h"
+
+#include <string.h>
+
+#define FULL_CREDIT ((uint32_t) ANCS_RATE_BURST * ANCS_RATE_REFILL_MS)
+
+typedef char RateBurstCheck[(ANCS_RATE_BURST > 0) ? 1 : -1];
+
+AlertRateLimiter::AlertRateLimiter()
+    :   clock(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+bool AlertRateLimiter::admit(const uint8_t* identifier, uint16_t identifierLength,
+                             uint32_t notificationUID, uint8_t categoryID, uint8_t merged,
+                             uint32_t now, uint8_t* carried)
+{
+    bucket_t& bucket = lookup(hash(identifier, identifierLength), now);
+
+    refill(bucket, now);
+
+    if (bucket.credit >= ANCS_RATE_REFILL_MS)
+    {
+        bucket.credit -= ANCS_RATE_REFILL_MS;
+
+        *carried = bucket.suppressed;
+        bucket.suppressed = 0;
+        bucket.pending = false;
+
+        statistics.admitted++;
+        return true;
+    }
+
+    // only the newest notification is worth fetching again
+    bucket.pendingUID = notificationUID;
+    bucket.pendingCategory = categoryID;
+    bucket.pending = true;
+    bucket.suppressed = (bucket.suppressed > 0xFF - merged) ? 0xFF : bucket.suppressed + merged;
+
+    statistics.suppressed++;
+    return false;
+}
+
+bool AlertRateLimiter::takeReplay(uint32_t now, uint32_t* notificationUID, uint8_t* categoryID)
+{
+    for (uint8_t idx = 0; idx < ANCS_RATE_APPS; idx++)
+    {
+        bucket_t& bucket = buckets[idx];
+
+        if (bucket.pending)
+        {
+            refill(bucket, now);
+
+            if (bucket.credit >= ANCS_RATE_REFILL_MS)
+            {
+                *notificationUID = bucket.pendingUID;
+                *categoryID = bucket.pendingCategory;
+
+                // the replayed notification is counted again when admitted
+                bucket.pending = false;
+                bucket.suppressed--;
+
+                statistics.replayed++;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+int32_t AlertRateLimiter::getReplayDelay(uint32_t now)
+{
+    int32_t delay = -1;
+
+    for (uint8_t idx = 0; idx < ANCS_RATE_APPS; idx++)
+    {
+        bucket_t& bucket = buckets[idx];
+
+        if (bucket.pending)
+        {
+            refill(bucket, now);
+
+            int32_t remaining = (bucket.credit >= ANCS_RATE_REFILL_MS) ? 0 : ANCS_RATE_REFILL_MS - bucket.credit;
+
+            if ((delay < 0) || (remaining < delay))
+            {
+                delay = remaining;
+            }
+        }
+    }
+
+    return delay;
+}
+
+void AlertRateLimiter::clearPending()
+{
+    for (uint8_t idx = 0; idx < ANCS_RATE_APPS; idx++)
+    {
+        buckets[idx].pending = false;
+    }
+}
+
+AlertRateLimiter::bucket_t& AlertRateLimiter::lookup(uint32_t hash, uint32_t now)
+{
+    uint8_t victim = 0;
+
+    for (uint8_t idx = 0; idx < ANCS_RATE_APPS; idx++)
+    {
+        if ((buckets[idx].lastUse != 0) && (buckets[idx].hash == hash))
+        {
+            buckets[idx].lastUse = ++clock;
+            return buckets[idx];
+        }
+
+        if (buckets[idx].lastUse < buckets[victim].lastUse)
+        {
+            victim = idx;
+        }
+    }
+
+    // new apps start with a full bucket
+    bucket_t& bucket = buckets[victim];
+
+    memset(&bucket, 0, sizeof(bucket_t));
+    bucket.hash = hash;
+    bucket.lastUse = ++clock;
+    bucket.updated = now;
+    bucket.credit = FULL_CREDIT;
+
+    return bucket;
+}
+
+void AlertRateLimiter::refill(bucket_t& bucket, uint32_t now)
+{
+    uint32_t elapsed = now - bucket.updated;
+
+    bucket.credit = (elapsed >= FULL_CREDIT - bucket.credit) ? FULL_CREDIT : bucket.credit + elapsed;
+    bucket.updated = now;
+}
+
+/*
+    FNV-1a.
+*/
+uint32_t AlertRateLimiter::hash(const uint8_t* data, uint16_t length)
+{
+    uint32_t value = 2166136261UL;
+
+    for (uint16_t idx = 0; idx < length; idx++)
+    {
+        value ^= data[idx];
+        value *= 16777619UL;
+    }
+
+    return value;
+}
@@ -0,0 +1,115 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ANCS_ALERT_RATE_LIMITER_H__
+#define __BLE_ANCS_ALERT_RATE_LIMITER_H__
+
+#include <stdint.h>
+
+// number of apps with their own token bucket
+#ifndef ANCS_RATE_APPS
+#define ANCS_RATE_APPS 8
+#endif
+
+// alerts an app can send back to back
+#ifndef ANCS_RATE_BURST
+#define ANCS_RATE_BURST 3
+#endif
+
+// time to earn one alert back
+#ifndef ANCS_RATE_REFILL_MS
+#define ANCS_RATE_REFILL_MS 10000
+#endif
+
+/*
+    Token bucket per app, keyed by a hash of the app identifier. An app
+    that runs out of tokens has its alerts suppressed; the newest
+    suppressed notification is remembered so it can be fetched again once
+    a token is available, and the alert that finally goes out carries the
+    number of notifications it stands for. A full table replaces the
+    least recently used bucket; hash collisions only share a bucket.
+
+    Times are in milliseconds from any monotonic source.
+*/
+class AlertRateLimiter
+{
+public:
+    typedef struct {
+        uint32_t admitted;
+        uint32_t suppressed;
+        uint32_t replayed;
+    } statistics_t;
+
+    AlertRateLimiter();
+
+    /*
+        Take a token for the app. On success carried is set to the number
+        of notifications suppressed since the app's last alert. Otherwise
+        the notification replaces the app's pending one, weighted by
+        merged, and false is returned.
+    */
+    bool admit(const uint8_t* identifier, uint16_t identifierLength,
+               uint32_t notificationUID, uint8_t categoryID, uint8_t merged,
+               uint32_t now, uint8_t* carried);
+
+    /*
+        Take a pending notification from an app that has a token again.
+    */
+    bool takeReplay(uint32_t now, uint32_t* notificationUID, uint8_t* categoryID);
+
+    /*
+        Milliseconds until a pending notification can be replayed, or -1
+        if there is none.
+    */
+    int32_t getReplayDelay(uint32_t now);
+
+    /*
+        Forget pending notifications; UIDs are only valid for a connection.
+    */
+    void clearPending();
+
+    const statistics_t& getStatistics() const
+    {
+        return statistics;
+    }
+
+    /*
+        Key of an app identifier, also used to merge alerts of one app.
+    */
+    static uint32_t hash(const uint8_t* data, uint16_t length);
+
+private:
+    typedef struct {
+        uint32_t hash;
+        uint32_t lastUse;               // 0 for unused buckets
+        uint32_t updated;
+        uint32_t credit;                // ms of refill time banked
+        uint32_t pendingUID;
+        uint8_t pendingCategory;
+        uint8_t suppressed;
+        bool pending;
+    } bucket_t;
+
+    bucket_t& lookup(uint32_t hash, uint32_t now);
+    void refill(bucket_t& bucket, uint32_t now);
+
+    bucket_t buckets[ANCS_RATE_APPS];
+    uint32_t clock;
+
+    statistics_t statistics;
+};
+
+#endif // __BLE_ANCS_ALERT_RATE_LIMITER_H__
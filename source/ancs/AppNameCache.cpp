@@ -0,0 +1,120 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AppNameCache.h"
+
+#include <string.h>
+
+typedef char AppCacheSizeCheck[((ANCS_APP_CACHE_SIZE > 0) && (ANCS_APP_CACHE_SIZE <= 127)) ? 1 : -1];
+typedef char AppIdentifierLengthCheck[(ANCS_APP_ID_MAX_LENGTH <= 0xFF) ? 1 : -1];
+typedef char AppNameLengthCheck[(ANCS_APP_NAME_MAX_LENGTH <= 0xFF) ? 1 : -1];
+
+AppNameCache::AppNameCache()
+    :   clock(0)
+{
+    memset(entries, 0, sizeof(entries));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+bool AppNameCache::find(const uint8_t* identifier, uint16_t identifierLength,
+                        const uint8_t** name, uint16_t* nameLength)
+{
+    int8_t index = lookup(identifier, identifierLength);
+
+    if (index < 0)
+    {
+        statistics.misses++;
+        return false;
+    }
+
+    entry_t& entry = entries[index];
+
+    entry.lastUse = ++clock;
+
+    *name = entry.name;
+    *nameLength = entry.nameLength;
+
+    statistics.hits++;
+    return true;
+}
+
+bool AppNameCache::insert(const uint8_t* identifier, uint16_t identifierLength,
+                          const uint8_t* name, uint16_t nameLength)
+{
+    if ((identifierLength == 0) || (identifierLength > ANCS_APP_ID_MAX_LENGTH))
+    {
+        return false;
+    }
+
+    int8_t index = lookup(identifier, identifierLength);
+
+    if (index < 0)
+    {
+        // take an unused entry or the least recently used one
+        index = 0;
+
+        for (uint8_t idx = 1; idx < ANCS_APP_CACHE_SIZE; idx++)
+        {
+            if (entries[idx].lastUse < entries[index].lastUse)
+            {
+                index = idx;
+            }
+        }
+
+        if (entries[index].lastUse != 0)
+        {
+            statistics.evictions++;
+        }
+    }
+
+    if (nameLength > ANCS_APP_NAME_MAX_LENGTH)
+    {
+        nameLength = ANCS_APP_NAME_MAX_LENGTH;
+    }
+
+    entry_t& entry = entries[index];
+
+    entry.lastUse = ++clock;
+    entry.identifierLength = identifierLength;
+    entry.nameLength = nameLength;
+    memcpy(entry.identifier, identifier, identifierLength);
+    memcpy(entry.name, name, nameLength);
+
+    return true;
+}
+
+void AppNameCache::clear()
+{
+    memset(entries, 0, sizeof(entries));
+    clock = 0;
+}
+
+int8_t AppNameCache::lookup(const uint8_t* identifier, uint16_t identifierLength)
+{
+    for (uint8_t idx = 0; idx < ANCS_APP_CACHE_SIZE; idx++)
+    {
+        const entry_t& entry = entries[idx];
+
+        if ((entry.lastUse != 0) &&
+            (entry.identifierLength == identifierLength) &&
+            (memcmp(entry.identifier, identifier, identifierLength) == 0))
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,91 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ANCS_APP_NAME_CACHE_H__
+#define __BLE_ANCS_APP_NAME_CACHE_H__
+
+#include <stdint.h>
+
+// number of apps remembered
+#ifndef ANCS_APP_CACHE_SIZE
+#define ANCS_APP_CACHE_SIZE 8
+#endif
+
+// longer app identifiers are not cached
+#ifndef ANCS_APP_ID_MAX_LENGTH
+#define ANCS_APP_ID_MAX_LENGTH 48
+#endif
+
+// display names are truncated to this length
+#ifndef ANCS_APP_NAME_MAX_LENGTH
+#define ANCS_APP_NAME_MAX_LENGTH 24
+#endif
+
+/*
+    Fixed-capacity map from app identifier to display name in static
+    memory. A full cache replaces the least recently used entry. Entries
+    are independent of the connection, so they are kept across reconnects.
+*/
+class AppNameCache
+{
+public:
+    typedef struct {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t evictions;
+    } statistics_t;
+
+    AppNameCache();
+
+    /*
+        Look up the display name for identifier and mark the entry as
+        recently used. Returns false on a miss.
+    */
+    bool find(const uint8_t* identifier, uint16_t identifierLength,
+              const uint8_t** name, uint16_t* nameLength);
+
+    /*
+        Store or update the display name for identifier. Returns false if
+        the identifier is too long to be cached.
+    */
+    bool insert(const uint8_t* identifier, uint16_t identifierLength,
+                const uint8_t* name, uint16_t nameLength);
+
+    void clear();
+
+    const statistics_t& getStatistics() const
+    {
+        return statistics;
+    }
+
+private:
+    typedef struct {
+        uint32_t lastUse;               // 0 for unused entries
+        uint8_t identifierLength;
+        uint8_t nameLength;
+        uint8_t identifier[ANCS_APP_ID_MAX_LENGTH];
+        uint8_t name[ANCS_APP_NAME_MAX_LENGTH];
+    } entry_t;
+
+    int8_t lookup(const uint8_t* identifier, uint16_t identifierLength);
+
+    entry_t entries[ANCS_APP_CACHE_SIZE];
+    uint32_t clock;
+
+    statistics_t statistics;
+};
+
+#endif // __BLE_ANCS_APP_NAME_CACHE_H__
@@ -0,0 +1,185 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HandleCache.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// bump when record_t changes so old records are ignored
+#define RECORD_VERSION 1
+
+typedef char HandleCacheEntriesCheck[((ANCS_HANDLE_CACHE_ENTRIES > 0) && (ANCS_HANDLE_CACHE_ENTRIES <= 127)) ? 1 : -1];
+
+HandleCache::HandleCache()
+    :   storage(NULL),
+        sequence(0)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+void HandleCache::setStorage(PersistentStorage* _storage)
+{
+    storage = _storage;
+    sequence = 0;
+
+    if ((storage != NULL) && (storage->getSize() < StorageLength))
+    {
+        storage = NULL;
+    }
+
+    // continue after the newest record so replacement order survives resets
+    record_t record;
+
+    for (uint8_t idx = 0; storage && (idx < ANCS_HANDLE_CACHE_ENTRIES); idx++)
+    {
+        if (readRecord(idx, &record) && (record.sequence > sequence))
+        {
+            sequence = record.sequence;
+        }
+    }
+}
+
+bool HandleCache::find(uint8_t addressType, const uint8_t address[6], handles_t* handles)
+{
+    record_t record;
+
+    if (lookup(addressType, address, &record) < 0)
+    {
+        statistics.misses++;
+        return false;
+    }
+
+    handles->controlPoint = record.controlPoint;
+    handles->dataSource = record.dataSource;
+
+    statistics.hits++;
+    return true;
+}
+
+bool HandleCache::store(uint8_t addressType, const uint8_t address[6], const handles_t& handles)
+{
+    if (storage == NULL)
+    {
+        return false;
+    }
+
+    record_t record;
+    int8_t index = lookup(addressType, address, &record);
+
+    if (index >= 0)
+    {
+        if ((record.controlPoint == handles.controlPoint) &&
+            (record.dataSource == handles.dataSource))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        // take an empty record or the oldest one
+        uint32_t oldest = 0xFFFFFFFF;
+
+        index = 0;
+
+        for (uint8_t idx = 0; idx < ANCS_HANDLE_CACHE_ENTRIES; idx++)
+        {
+            uint32_t age = (readRecord(idx, &record)) ? record.sequence : 0;
+
+            if (age < oldest)
+            {
+                oldest = age;
+                index = idx;
+            }
+        }
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.addressType = addressType;
+    memcpy(record.address, address, sizeof(record.address));
+    record.controlPoint = handles.controlPoint;
+    record.dataSource = handles.dataSource;
+
+    statistics.stores++;
+    return writeRecord(index, &record);
+}
+
+void HandleCache::remove(uint8_t addressType, const uint8_t address[6])
+{
+    record_t record;
+    int8_t index = lookup(addressType, address, &record);
+
+    if (index >= 0)
+    {
+        // a record with a bad checksum reads as empty
+        memset(&record, 0xFF, sizeof(record));
+        storage->write(index * sizeof(record_t), (const uint8_t*) &record, sizeof(record_t));
+
+        statistics.invalidations++;
+    }
+}
+
+bool HandleCache::readRecord(uint8_t index, record_t* record)
+{
+    if (!storage->read(index * sizeof(record_t), (uint8_t*) record, sizeof(record_t)))
+    {
+        return false;
+    }
+
+    return (record->version == RECORD_VERSION) && (record->check == checksum(*record));
+}
+
+bool HandleCache::writeRecord(uint8_t index, record_t* record)
+{
+    record->version = RECORD_VERSION;
+    record->sequence = ++sequence;
+    record->check = checksum(*record);
+
+    return storage->write(index * sizeof(record_t), (const uint8_t*) record, sizeof(record_t));
+}
+
+int8_t HandleCache::lookup(uint8_t addressType, const uint8_t address[6], record_t* record)
+{
+    for (uint8_t idx = 0; storage && (idx < ANCS_HANDLE_CACHE_ENTRIES); idx++)
+    {
+        if (readRecord(idx, record) &&
+            (record->addressType == addressType) &&
+            (memcmp(record->address, address, sizeof(record->address)) == 0))
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+/*
+    Fletcher-16 over everything but the checksum itself.
+*/
+uint16_t HandleCache::checksum(const record_t& record)
+{
+    const uint8_t* data = (const uint8_t*) &record;
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+
+    for (uint32_t idx = 0; idx < offsetof(record_t, check); idx++)
+    {
+        sum1 = (sum1 + data[idx]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+
+    return (sum2 << 8) | sum1;
+}
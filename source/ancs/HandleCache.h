@@ -0,0 +1,108 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ANCS_HANDLE_CACHE_H__
+#define __BLE_ANCS_HANDLE_CACHE_H__
+
+#include <stdint.h>
+
+#include "../storage/PersistentStorage.h"
+
+// number of peers remembered
+#ifndef ANCS_HANDLE_CACHE_ENTRIES
+#define ANCS_HANDLE_CACHE_ENTRIES 4
+#endif
+
+/*
+    Discovered ANCS characteristic handles per peer, kept in a
+    PersistentStorage so they can be used as soon as the peer reconnects.
+    Each record carries a format version and a checksum; anything else
+    read from the store, such as erased flash, counts as empty. A full
+    cache replaces the least recently stored peer.
+
+    Handles can go stale if the phone's GATT database changes. The caller
+    is expected to remove() the entry when cached handles fail and fall
+    back to discovery.
+*/
+class HandleCache
+{
+public:
+    typedef struct {
+        uint16_t controlPoint;
+        uint16_t dataSource;
+    } handles_t;
+
+    typedef struct {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t stores;
+        uint32_t invalidations;
+    } statistics_t;
+
+    static const uint32_t RecordLength = 20;
+
+    // bytes of storage needed for all entries
+    static const uint32_t StorageLength = ANCS_HANDLE_CACHE_ENTRIES * RecordLength;
+
+    HandleCache();
+
+    /*
+        Use storage for the records; NULL disables the cache.
+    */
+    void setStorage(PersistentStorage* storage);
+
+    bool find(uint8_t addressType, const uint8_t address[6], handles_t* handles);
+
+    /*
+        Remember handles for the peer. Rewrites the record only if the
+        handles changed.
+    */
+    bool store(uint8_t addressType, const uint8_t address[6], const handles_t& handles);
+
+    void remove(uint8_t addressType, const uint8_t address[6]);
+
+    const statistics_t& getStatistics() const
+    {
+        return statistics;
+    }
+
+private:
+    typedef struct {
+        uint8_t version;
+        uint8_t addressType;
+        uint8_t address[6];
+        uint16_t controlPoint;
+        uint16_t dataSource;
+        uint32_t sequence;
+        uint16_t check;
+        uint16_t reserved;
+    } record_t;
+
+    typedef char RecordLengthCheck[(sizeof(record_t) == RecordLength) ? 1 : -1];
+
+    bool readRecord(uint8_t index, record_t* record);
+    bool writeRecord(uint8_t index, record_t* record);
+    int8_t lookup(uint8_t addressType, const uint8_t address[6], record_t* record);
+
+    static uint16_t checksum(const record_t& record);
+
+    PersistentStorage* storage;
+    uint32_t sequence;
+
+    statistics_t statistics;
+};
+
+#endif // __BLE_ANCS_HANDLE_CACHE_H__
@@ -0,0 +1,330 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NotificationScheduler.h"
+
+#include <string.h>
+
+// priority for each ANCS category ID, higher is more urgent
+static const uint8_t categoryPriority[] = {
+    1,  // Other
+    3,  // IncomingCall
+    2,  // MissedCall
+    2,  // Voicemail
+    0,  // Social
+    2,  // Schedule
+    1,  // Email
+    0,  // News
+    1,  // HealthAndFitness
+    1,  // BusinessAndFinance
+    1,  // Location
+    0   // Entertainment
+};
+
+NotificationScheduler::NotificationScheduler(overflow_policy_t _policy)
+    :   policy(_policy),
+        head(0),
+        count(0),
+        hasTaken(false)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+uint8_t NotificationScheduler::getPriority(uint8_t categoryID)
+{
+    if (categoryID < sizeof(categoryPriority))
+    {
+        return categoryPriority[categoryID];
+    }
+
+    return 0;
+}
+
+bool NotificationScheduler::add(uint32_t notificationUID, uint8_t categoryID, uint32_t arrival, uint8_t categoryCount,
+                                uint32_t app)
+{
+    uint8_t priority = getPriority(categoryID);
+
+    // coalesce with pending entry
+    int16_t existing = find(notificationUID);
+
+    if (existing >= 0)
+    {
+        at(existing).categoryID = categoryID;
+        at(existing).priority = priority;
+        at(existing).categoryCount = categoryCount;
+
+        statistics.coalesced++;
+        return true;
+    }
+
+    if (count == ANCS_QUEUE_DEPTH)
+    {
+        if (policy == OverflowDropNewest)
+        {
+            statistics.dropped++;
+            return false;
+        }
+
+        // find oldest entry with the lowest priority
+        uint8_t victim = 0;
+
+        for (uint8_t idx = 1; idx < count; idx++)
+        {
+            if (at(idx).priority < at(victim).priority)
+            {
+                victim = idx;
+            }
+        }
+
+        // never evict something more urgent than the newcomer
+        if (at(victim).priority > priority)
+        {
+            statistics.dropped++;
+            return false;
+        }
+
+        removeAt(victim);
+        statistics.dropped++;
+    }
+
+    entry_t& entry = at(count);
+    entry.notificationUID = notificationUID;
+    entry.arrival = arrival;
+    entry.app = app;
+    entry.categoryID = categoryID;
+    entry.priority = priority;
+    entry.categoryCount = categoryCount;
+    entry.merged = 1;
+
+    count++;
+    statistics.added++;
+
+    if (count > statistics.highWaterMark)
+    {
+        statistics.highWaterMark = count;
+    }
+
+    return true;
+}
+
+bool NotificationScheduler::findUnresolved(uint32_t* notificationUID, uint8_t* categoryID)
+{
+    uint8_t urgent = 0;
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if (at(idx).priority > urgent)
+        {
+            urgent = at(idx).priority;
+        }
+    }
+
+    for (int16_t idx = count - 1; idx >= 0; idx--)
+    {
+        entry_t& entry = at(idx);
+
+        if ((entry.app != AppUnresolved) || (entry.priority < urgent))
+        {
+            continue;
+        }
+
+        // a notification alone in its category is fetched as it is
+        for (uint8_t other = 0; other < count; other++)
+        {
+            if ((other != idx) &&
+                (at(other).categoryID == entry.categoryID) &&
+                (at(other).app != AppNone))
+            {
+                *notificationUID = entry.notificationUID;
+
+                if (categoryID)
+                {
+                    *categoryID = entry.categoryID;
+                }
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool NotificationScheduler::resolve(uint32_t notificationUID, uint32_t app)
+{
+    int16_t position = find(notificationUID);
+
+    if (position < 0)
+    {
+        return false;
+    }
+
+    at(position).app = app;
+
+    if ((app == AppNone) || (app == AppUnresolved))
+    {
+        return false;
+    }
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if ((idx == position) ||
+            (at(idx).app != app) ||
+            (at(idx).categoryID != at(position).categoryID))
+        {
+            continue;
+        }
+
+        // positions are in arrival order
+        uint8_t older = (idx < position) ? idx : position;
+        uint8_t newer = (idx < position) ? position : idx;
+
+        entry_t& entry = at(older);
+        uint16_t merged = entry.merged + at(newer).merged;
+
+        entry.notificationUID = at(newer).notificationUID;
+        entry.categoryCount = at(newer).categoryCount;
+        entry.merged = (merged > 0xFF) ? 0xFF : merged;
+
+        removeAt(newer);
+
+        statistics.superseded++;
+        return true;
+    }
+
+    return false;
+}
+
+bool NotificationScheduler::cancel(uint32_t notificationUID)
+{
+    int16_t position = find(notificationUID);
+
+    if (position < 0)
+    {
+        return false;
+    }
+
+    removeAt(position);
+    statistics.cancelled++;
+
+    return true;
+}
+
+bool NotificationScheduler::take(uint32_t* notificationUID, uint8_t* categoryID, uint32_t* arrival,
+                                 uint8_t* categoryCount, uint8_t* merged)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+
+    // first entry with the highest priority
+    uint8_t best = 0;
+
+    for (uint8_t idx = 1; idx < count; idx++)
+    {
+        if (at(idx).priority > at(best).priority)
+        {
+            best = idx;
+        }
+    }
+
+    *notificationUID = at(best).notificationUID;
+
+    if (categoryID)
+    {
+        *categoryID = at(best).categoryID;
+    }
+
+    if (arrival)
+    {
+        *arrival = at(best).arrival;
+    }
+
+    if (categoryCount)
+    {
+        *categoryCount = at(best).categoryCount;
+    }
+
+    if (merged)
+    {
+        *merged = at(best).merged;
+    }
+
+    taken = at(best);
+    hasTaken = true;
+
+    removeAt(best);
+
+    return true;
+}
+
+bool NotificationScheduler::requeue()
+{
+    if (!hasTaken || (count == ANCS_QUEUE_DEPTH))
+    {
+        return false;
+    }
+
+    // it was the first entry of its priority, so the front keeps the order
+    head = (head + ANCS_QUEUE_DEPTH - 1) % ANCS_QUEUE_DEPTH;
+    at(0) = taken;
+
+    count++;
+    hasTaken = false;
+
+    return true;
+}
+
+void NotificationScheduler::clear()
+{
+    head = 0;
+    count = 0;
+    hasTaken = false;
+}
+
+int16_t NotificationScheduler::find(uint32_t notificationUID)
+{
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if (at(idx).notificationUID == notificationUID)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+void NotificationScheduler::removeAt(uint8_t position)
+{
+    if (position == 0)
+    {
+        // removing the oldest entry only moves the head
+        head = (head + 1) % ANCS_QUEUE_DEPTH;
+    }
+    else
+    {
+        // close the gap by moving newer entries one step back
+        for (uint8_t idx = position; idx < count - 1; idx++)
+        {
+            at(idx) = at(idx + 1);
+        }
+    }
+
+    count--;
+}
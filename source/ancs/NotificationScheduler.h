@@ -0,0 +1,154 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_ANCS_NOTIFICATION_SCHEDULER_H__
+#define __BLE_ANCS_NOTIFICATION_SCHEDULER_H__
+
+#include <stdint.h>
+
+// number of notifications waiting to be fetched
+#ifndef ANCS_QUEUE_DEPTH
+#define ANCS_QUEUE_DEPTH 16
+#endif
+
+/*
+    Fixed-capacity queue of notification UIDs waiting to be fetched.
+    Entries are stored in arrival order in a static ring buffer and taken
+    out by priority, derived from the ANCS category, with FIFO order
+    within the same priority.
+*/
+class NotificationScheduler
+{
+public:
+    typedef enum {
+        OverflowDropNewest,             // reject the incoming notification
+        OverflowReplaceLowest           // evict the oldest entry with the lowest priority
+    } overflow_policy_t;
+
+    typedef struct {
+        uint32_t added;
+        uint32_t coalesced;
+        uint32_t cancelled;
+        uint32_t dropped;
+        uint32_t superseded;
+        uint8_t highWaterMark;
+    } statistics_t;
+
+    /*
+        App of an entry, as a key derived from the app identifier. Entries
+        are only merged when category and app match; AppNone entries are
+        never merged and AppUnresolved entries wait for resolve().
+    */
+    static const uint32_t AppNone = 0;
+    static const uint32_t AppUnresolved = 1;
+
+    NotificationScheduler(overflow_policy_t policy = OverflowReplaceLowest);
+
+    /*
+        Queue notification for fetching. A UID already in the queue is
+        coalesced into the existing entry, which keeps its arrival time
+        and app. Returns false if the notification was dropped.
+    */
+    bool add(uint32_t notificationUID, uint8_t categoryID, uint32_t arrival = 0, uint8_t categoryCount = 0,
+             uint32_t app = AppNone);
+
+    /*
+        Return a notification whose app must be known before it can be
+        merged: unresolved, in the same category as another entry that
+        can be merged, and as urgent as anything in the queue. The newest
+        such entry is returned first.
+    */
+    bool findUnresolved(uint32_t* notificationUID, uint8_t* categoryID = 0);
+
+    /*
+        Set the app of a notification, AppNone if it cannot be known. If
+        another entry has the same category and app, the two are merged
+        into the older entry, which keeps its position and arrival time,
+        takes the newer UID and category count, and counts the merge, so
+        only the latest notification of a burst is fetched. Returns true
+        if the entries were merged.
+    */
+    bool resolve(uint32_t notificationUID, uint32_t app);
+    /*
+        Remove notification from the queue, if present.
+    */
+    bool cancel(uint32_t notificationUID);
+
+    /*
+        Take the most urgent notification out of the queue. merged is the
+        number of notifications the entry stands for.
+    */
+    bool take(uint32_t* notificationUID, uint8_t* categoryID = 0, uint32_t* arrival = 0,
+              uint8_t* categoryCount = 0, uint8_t* merged = 0);
+
+    /*
+        Put the entry returned by the last take back in front of the
+        queue, unchanged, e.g., when its fetch could not be started.
+        Returns false if there is no such entry or the queue is full.
+    */
+    bool requeue();
+
+    void clear();
+
+    uint8_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return (count == 0);
+    }
+
+    const statistics_t& getStatistics() const
+    {
+        return statistics;
+    }
+
+    static uint8_t getPriority(uint8_t categoryID);
+
+private:
+    typedef struct {
+        uint32_t notificationUID;
+        uint32_t arrival;
+        uint32_t app;
+        uint8_t categoryID;
+        uint8_t priority;
+        uint8_t categoryCount;
+        uint8_t merged;
+    } entry_t;
+
+    entry_t& at(uint8_t position)
+    {
+        return entries[(head + position) % ANCS_QUEUE_DEPTH];
+    }
+
+    int16_t find(uint32_t notificationUID);
+    void removeAt(uint8_t position);
+
+    overflow_policy_t policy;
+
+    entry_t entries[ANCS_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+
+    entry_t taken;
+    bool hasTaken;
+
+    statistics_t statistics;
+};
+
+#endif // __BLE_ANCS_NOTIFICATION_SCHEDULER_H__
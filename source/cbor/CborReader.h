@@ -0,0 +1,209 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CBOR_READER_H__
+#define __CBOR_READER_H__
+
+#include <stdint.h>
+
+/*
+    Forward-only CBOR decoder. Each call consumes the next item from the
+    buffer, so a message is decoded in a single pass. Strings are returned
+    as pointers into the buffer. Only definite lengths up to 32 bits are
+    supported; anything else, or reading past the end, fails.
+*/
+class CborReader
+{
+public:
+    typedef enum {
+        TypeUnsigned    = 0,
+        TypeNegative    = 1,
+        TypeBytes       = 2,
+        TypeText        = 3,
+        TypeArray       = 4,
+        TypeMap         = 5
+    } major_type_t;
+
+    CborReader(const uint8_t* _buffer, uint32_t _length)
+        :   buffer(_buffer),
+            length(_length),
+            index(0)
+    {}
+
+    bool readHeader(uint8_t* type, uint32_t* value)
+    {
+        if (index >= length)
+        {
+            return false;
+        }
+
+        uint8_t initial = buffer[index++];
+        uint8_t additional = initial & 0x1F;
+
+        *type = initial >> 5;
+
+        if (additional < 24)
+        {
+            *value = additional;
+            return true;
+        }
+
+        uint8_t size = (additional == 24) ? 1 :
+                       (additional == 25) ? 2 :
+                       (additional == 26) ? 4 : 0;
+
+        if ((size == 0) || (size > length - index))
+        {
+            return false;
+        }
+
+        *value = 0;
+
+        for (uint8_t idx = 0; idx < size; idx++)
+        {
+            *value = (*value << 8) | buffer[index++];
+        }
+
+        return true;
+    }
+
+    bool readUnsigned(uint32_t* value)
+    {
+        uint8_t type;
+
+        return readHeader(&type, value) && (type == TypeUnsigned);
+    }
+
+    bool readInteger(int32_t* value)
+    {
+        uint8_t type;
+        uint32_t raw;
+
+        if (!readHeader(&type, &raw) || (raw > 0x7FFFFFFF))
+        {
+            return false;
+        }
+
+        if (type == TypeUnsigned)
+        {
+            *value = raw;
+            return true;
+        }
+        else if (type == TypeNegative)
+        {
+            *value = -1 - (int32_t) raw;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool readArray(uint32_t* items)
+    {
+        uint8_t type;
+
+        return readHeader(&type, items) && (type == TypeArray);
+    }
+
+    bool readBytes(const uint8_t** data, uint32_t* dataLength)
+    {
+        return readString(TypeBytes, data, dataLength);
+    }
+
+    bool readText(const char** text, uint32_t* textLength)
+    {
+        const uint8_t* data;
+
+        // written through its own type, a cast pointer would alias
+        if (!readString(TypeText, &data, textLength))
+        {
+            return false;
+        }
+
+        *text = (const char*) data;
+        return true;
+    }
+
+    /*
+        Skip one complete item, including nested items.
+    */
+    bool skip()
+    {
+        uint8_t type;
+        uint32_t value;
+
+        if (!readHeader(&type, &value))
+        {
+            return false;
+        }
+
+        if ((type == TypeBytes) || (type == TypeText))
+        {
+            if (value > length - index)
+            {
+                return false;
+            }
+
+            index += value;
+        }
+        else if ((type == TypeArray) || (type == TypeMap))
+        {
+            uint32_t items = (type == TypeMap) ? 2 * value : value;
+
+            for (uint32_t idx = 0; idx < items; idx++)
+            {
+                if (!skip())
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool atEnd() const
+    {
+        return (index >= length);
+    }
+
+    uint32_t getPosition() const
+    {
+        return index;
+    }
+
+private:
+    bool readString(uint8_t expected, const uint8_t** data, uint32_t* dataLength)
+    {
+        uint8_t type;
+
+        if (!readHeader(&type, dataLength) || (type != expected) || (*dataLength > length - index))
+        {
+            return false;
+        }
+
+        *data = &buffer[index];
+        index += *dataLength;
+
+        return true;
+    }
+
+    const uint8_t* buffer;
+    uint32_t length;
+    uint32_t index;
+};
+
+#endif // __CBOR_READER_H__
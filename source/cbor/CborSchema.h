@@ -0,0 +1,342 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CBOR_SCHEMA_H__
+#define __CBOR_SCHEMA_H__
+
+#include "ble-blocktransfer/BlockStatic.h"
+
+#include "CborWriter.h"
+#include "TextCodec.h"
+
+/*
+    Message layouts declared as types. Every element knows the longest
+    encoding it can produce, so a message buffer is sized at compile time:
+
+        typedef CborSchema::Array<CborSchema::Unsigned<255>,
+                                  CborSchema::Text<20> > Example;
+
+        CborMessage<Example> message;               // Example::MaxLength bytes
+        message.encode(1, CborSchema::text(name, nameLength));
+
+    Values outside an element's bound are clamped and strings truncated,
+    so the encoding always fits. Text marked as packed is sent as a byte
+    string in TextCodec encoding when that is shorter; the receiver tells
+    the two apart by the major type.
+*/
+namespace CborSchema
+{
+    template <uint32_t Value>
+    struct HeaderLength
+    {
+        static const uint32_t value = (Value < 24) ? 1 : (Value <= 0xFF) ? 2 : (Value <= 0xFFFF) ? 3 : 5;
+    };
+
+    typedef struct {
+        const char* data;
+        uint32_t length;
+        bool packed;
+    } text_t;
+
+    typedef struct {
+        const uint8_t* data;
+        uint32_t length;
+    } bytes_t;
+
+    template <typename T>
+    struct list_t {
+        const T* items;
+        uint32_t count;
+    };
+
+    // value of an Array nested in a List, which is written piecewise
+    typedef struct {} piecewise_t;
+
+    // two strings sent as one, separated by a space
+    typedef struct {
+        text_t first;
+        text_t second;
+        bool packed;
+    } joined_text_t;
+
+    inline text_t text(const char* data, uint32_t length, bool packed = false)
+    {
+        text_t value = { data, length, packed };
+        return value;
+    }
+
+    inline bytes_t bytes(const uint8_t* data, uint32_t length)
+    {
+        bytes_t value = { data, length };
+        return value;
+    }
+
+    template <typename T>
+    inline list_t<T> list(const T* items, uint32_t count)
+    {
+        list_t<T> value = { items, count };
+        return value;
+    }
+
+    inline joined_text_t joined(const char* first, uint32_t firstLength,
+                                const char* second, uint32_t secondLength,
+                                bool packed = false)
+    {
+        joined_text_t value = { { first, firstLength, false }, { second, secondLength, false }, packed };
+        return value;
+    }
+
+    /*
+        Write text given in pieces as a TextCodec byte string. Returns
+        false, writing nothing, if that is not shorter than length.
+    */
+    inline bool packed(CborWriter& cbor, const TextCodec::piece_t* pieces, uint8_t count, uint32_t length)
+    {
+        uint32_t packedLength = TextCodec::encode(pieces, count, NULL);
+
+        if (packedLength >= length)
+        {
+            return false;
+        }
+
+        cbor.header(CborWriter::TypeBytes, packedLength);
+        uint8_t* output = cbor.reserve(packedLength);
+
+        if (output)
+        {
+            TextCodec::encode(pieces, count, output);
+        }
+
+        return true;
+    }
+
+    /*************************************************************************/
+
+    template <uint32_t Max = 0xFFFFFFFF>
+    struct Unsigned
+    {
+        typedef uint32_t value_type;
+
+        static const uint32_t MaxLength = HeaderLength<Max>::value;
+
+        static void encode(CborWriter& cbor, uint32_t value)
+        {
+            cbor.item((value > Max) ? Max : value);
+        }
+    };
+
+    template <int32_t Min, int32_t Max>
+    struct Integer
+    {
+        typedef int32_t value_type;
+
+        static const uint32_t PositiveLength = HeaderLength<(Max > 0) ? (uint32_t) Max : 0>::value;
+        static const uint32_t NegativeLength = HeaderLength<(Min < 0) ? (uint32_t) (-1 - Min) : 0>::value;
+        static const uint32_t MaxLength = (PositiveLength > NegativeLength) ? PositiveLength : NegativeLength;
+
+        static void encode(CborWriter& cbor, int32_t value)
+        {
+            cbor.item((value < Min) ? Min : (value > Max) ? Max : value);
+        }
+    };
+
+    template <uint32_t MaxChars>
+    struct Text
+    {
+        typedef text_t value_type;
+
+        static const uint32_t MaxLength = HeaderLength<MaxChars>::value + MaxChars;
+
+        static void encode(CborWriter& cbor, const text_t& value)
+        {
+            uint32_t length = (value.length > MaxChars) ? MaxChars : value.length;
+            TextCodec::piece_t piece = { (const uint8_t*) value.data, length };
+
+            if (!value.packed || !packed(cbor, &piece, 1, length))
+            {
+                cbor.item(value.data, length);
+            }
+        }
+    };
+
+    template <uint32_t MaxBytes>
+    struct Bytes
+    {
+        typedef bytes_t value_type;
+
+        static const uint32_t MaxLength = HeaderLength<MaxBytes>::value + MaxBytes;
+
+        static void encode(CborWriter& cbor, const bytes_t& value)
+        {
+            cbor.bytes(value.data, (value.length > MaxBytes) ? MaxBytes : value.length);
+        }
+    };
+
+    template <uint32_t MaxFirst, uint32_t MaxSecond>
+    struct JoinedText
+    {
+        typedef joined_text_t value_type;
+
+        static const uint32_t MaxChars = MaxFirst + 1 + MaxSecond;
+        static const uint32_t MaxLength = HeaderLength<MaxChars>::value + MaxChars;
+
+        static void encode(CborWriter& cbor, const joined_text_t& value)
+        {
+            uint32_t firstLength = (value.first.length > MaxFirst) ? MaxFirst : value.first.length;
+            uint32_t secondLength = (value.second.length > MaxSecond) ? MaxSecond : value.second.length;
+            const uint8_t space = ' ';
+
+            TextCodec::piece_t pieces[3] = {
+                { (const uint8_t*) value.first.data, firstLength },
+                { &space, 1 },
+                { (const uint8_t*) value.second.data, secondLength }
+            };
+
+            if (value.packed && packed(cbor, pieces, 3, firstLength + 1 + secondLength))
+            {
+                return;
+            }
+
+            // pieces are written straight into the message
+            cbor.header(CborWriter::TypeText, firstLength + 1 + secondLength)
+                .raw((const uint8_t*) value.first.data, firstLength)
+                .raw(&space, 1)
+                .raw((const uint8_t*) value.second.data, secondLength);
+        }
+    };
+
+    /*************************************************************************/
+
+    template <typename... Items>
+    struct LengthSum;
+
+    template <>
+    struct LengthSum<>
+    {
+        static const uint32_t value = 0;
+    };
+
+    template <typename First, typename... Rest>
+    struct LengthSum<First, Rest...>
+    {
+        static const uint32_t value = First::MaxLength + LengthSum<Rest...>::value;
+    };
+
+    /*
+        Fixed array, one value per item in declaration order.
+    */
+    template <typename... Items>
+    struct Array
+    {
+        typedef piecewise_t value_type;
+
+        static const uint32_t Count = sizeof...(Items);
+        static const uint32_t MaxLength = HeaderLength<Count>::value + LengthSum<Items...>::value;
+
+        static void encode(CborWriter& cbor, const typename Items::value_type&... values)
+        {
+            cbor.array(Count);
+
+            // braced initializers are evaluated in order
+            int expand[] = { 0, (Items::encode(cbor, values), 0)... };
+            (void) expand;
+        }
+    };
+
+    /*
+        Variable array of up to MaxCount items of the same type. Lists of
+        plain values are encoded from a list_t; for lists of arrays the
+        caller writes the header with begin() and then encodes each Item.
+    */
+    template <typename Item, uint32_t MaxCount>
+    struct List
+    {
+        typedef list_t<typename Item::value_type> value_type;
+
+        static const uint32_t MaxLength = HeaderLength<MaxCount>::value + MaxCount * Item::MaxLength;
+
+        static void encode(CborWriter& cbor, const value_type& value)
+        {
+            uint32_t count = begin(cbor, value.count);
+
+            for (uint32_t idx = 0; idx < count; idx++)
+            {
+                Item::encode(cbor, value.items[idx]);
+            }
+        }
+
+        static uint32_t begin(CborWriter& cbor, uint32_t count)
+        {
+            count = (count > MaxCount) ? MaxCount : count;
+            cbor.array(count);
+
+            return count;
+        }
+    };
+}
+
+/*
+    Buffer sized for the worst case of Schema, encoded in place and sent
+    as a BlockStatic over the same memory.
+*/
+template <typename Schema>
+class CborMessage
+{
+public:
+    static const uint32_t MaxLength = Schema::MaxLength;
+
+    CborMessage()
+        :   block(buffer, 0)
+    {}
+
+    template <typename... Values>
+    BlockStatic& encode(const Values&... values)
+    {
+        CborWriter cbor(buffer, MaxLength);
+        Schema::encode(cbor, values...);
+
+        return finish(cbor);
+    }
+
+    /*
+        For schemas encoded piecewise, e.g., List.
+    */
+    CborWriter writer()
+    {
+        return CborWriter(buffer, MaxLength);
+    }
+
+    BlockStatic& finish(const CborWriter& cbor)
+    {
+        block = BlockStatic(buffer, cbor.getLength());
+        return block;
+    }
+
+    BlockStatic& getBlock()
+    {
+        return block;
+    }
+
+private:
+    // block refers to this object's own buffer
+    CborMessage(const CborMessage&);
+    CborMessage& operator=(const CborMessage&);
+
+    uint8_t buffer[MaxLength];
+    BlockStatic block;
+};
+
+#endif // __CBOR_SCHEMA_H__
@@ -0,0 +1,200 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CBOR_WRITER_H__
+#define __CBOR_WRITER_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Minimal CBOR encoder writing into a caller-provided buffer. Unlike
+    Cbore it supports byte strings and strings assembled from several
+    pieces. Writes that would overflow the buffer are discarded and
+    flagged, so callers check once after encoding.
+*/
+class CborWriter
+{
+public:
+    typedef enum {
+        TypeUnsigned    = 0,
+        TypeNegative    = 1,
+        TypeBytes       = 2,
+        TypeText        = 3,
+        TypeArray       = 4,
+        TypeMap         = 5
+    } major_type_t;
+
+    // largest header written, for lengths up to 0xFFFF
+    static const uint8_t MaxHeaderLength = 3;
+
+    CborWriter(uint8_t* _buffer, uint32_t _capacity)
+        :   buffer(_buffer),
+            capacity(_capacity),
+            index(0),
+            overflow(false)
+    {}
+
+    CborWriter& array(uint32_t items)
+    {
+        header(TypeArray, items);
+        return *this;
+    }
+
+    CborWriter& map(uint32_t pairs)
+    {
+        header(TypeMap, pairs);
+        return *this;
+    }
+
+    CborWriter& item(uint32_t value)
+    {
+        header(TypeUnsigned, value);
+        return *this;
+    }
+
+    CborWriter& item(int32_t value)
+    {
+        if (value < 0)
+        {
+            header(TypeNegative, (uint32_t) (-1 - value));
+        }
+        else
+        {
+            header(TypeUnsigned, value);
+        }
+
+        return *this;
+    }
+
+    CborWriter& item(const char* text, uint32_t length)
+    {
+        header(TypeText, length);
+        raw((const uint8_t*) text, length);
+        return *this;
+    }
+
+    CborWriter& bytes(const uint8_t* data, uint32_t length)
+    {
+        header(TypeBytes, length);
+        raw(data, length);
+        return *this;
+    }
+
+    /*
+        Write header only, payload follows through raw().
+    */
+    CborWriter& header(major_type_t type, uint32_t value)
+    {
+        uint8_t initial = type << 5;
+
+        if (value < 24)
+        {
+            put(initial | value);
+        }
+        else if (value <= 0xFF)
+        {
+            put(initial | 24);
+            put(value);
+        }
+        else if (value <= 0xFFFF)
+        {
+            put(initial | 25);
+            put(value >> 8);
+            put(value);
+        }
+        else
+        {
+            put(initial | 26);
+            put(value >> 24);
+            put(value >> 16);
+            put(value >> 8);
+            put(value);
+        }
+
+        return *this;
+    }
+
+    CborWriter& raw(const uint8_t* data, uint32_t length)
+    {
+        if (overflow || (length > capacity - index))
+        {
+            overflow = true;
+        }
+        else
+        {
+            memcpy(&buffer[index], data, length);
+            index += length;
+        }
+
+        return *this;
+    }
+
+    /*
+        Room for length bytes that the caller fills in, NULL on overflow.
+    */
+    uint8_t* reserve(uint32_t length)
+    {
+        if (overflow || (length > capacity - index))
+        {
+            overflow = true;
+            return NULL;
+        }
+
+        uint8_t* position = &buffer[index];
+        index += length;
+
+        return position;
+    }
+
+    uint32_t getLength() const
+    {
+        return index;
+    }
+
+    bool hasOverflowed() const
+    {
+        return overflow;
+    }
+
+    /*
+        Number of bytes needed to encode a header with this value.
+    */
+    static uint8_t headerLength(uint32_t value)
+    {
+        return (value < 24) ? 1 : (value <= 0xFF) ? 2 : (value <= 0xFFFF) ? 3 : 5;
+    }
+
+private:
+    void put(uint8_t byte)
+    {
+        if (overflow || (index == capacity))
+        {
+            overflow = true;
+        }
+        else
+        {
+            buffer[index++] = byte;
+        }
+    }
+
+    uint8_t* buffer;
+    uint32_t capacity;
+    uint32_t index;
+    bool overflow;
+};
+
+#endif // __CBOR_WRITER_H__
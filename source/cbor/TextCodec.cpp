@@ -0,0 +1,352 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextCodec.h"
+
+#include <string.h>
+
+#define CODE_VERBATIM       254
+#define CODE_VERBATIM_RUN   255
+#define MAX_RUN             256
+
+/*
+    Sorted by bytes, so entries starting with the same byte are adjacent
+    and can be found with a binary search. Changing the dictionary
+    changes the encoding; hosts must be updated with it.
+*/
+static const char* const dictionary[] = {
+    " ", " a ", " about", " am ", " an ", " and ", " are ", " at ",
+    " be ", " been ", " but ", " by ", " call", " can ", " day",
+    " for ", " from ", " get ", " going", " had ", " has ", " have ",
+    " here", " how ", " if ", " in ", " is ", " it ", " just ",
+    " last", " me ", " minutes", " more", " morning", " my ", " new ",
+    " next", " not ", " now", " of ", " on ", " one", " or ", " our ",
+    " out", " please", " pm", " post", " see ", " send", " sent",
+    " shared ", " so ", " thanks", " that ", " the ", " there", " this ",
+    " time", " to ", " today", " tomorrow", " tonight", " up", " us",
+    " was ", " we ", " week", " what ", " when ", " where ", " who ",
+    " will ", " with ", " you", " your ", "!", "#", "'", "'s ",
+    ",", "-", ".", ".com", "/", "0", "1", "2", "3", "4", "5",
+    "6", "7", "8", "9", ":", "?", "@", "A", "B", "C", "Calendar",
+    "D", "E", "F", "Fwd: ", "G", "H", "Hey ", "Hi ", "I", "I ",
+    "I'm ", "Incoming call", "Invitation", "L", "M", "Meeting", "Missed call",
+    "N", "New ", "O", "P", "R", "Re: ", "Reminder", "S", "T",
+    "Thanks", "Today", "Tomorrow", "Voicemail", "W", "Y", "Your ",
+    "a", "al", "an", "and", "ar", "as", "at", "b", "be", "c",
+    "ce", "ch", "co", "commented on your ", "d", "de", "delivered",
+    "e", "ea", "ed", "ed ", "ee", "en", "ent", "er", "er ", "ere",
+    "es", "est", "f", "g", "h", "ha", "he", "hi", "http", "https://",
+    "i", "ic", "ight", "in", "ing", "ing ", "io", "is", "it",
+    "k", "l", "le", "li", "liked your ", "ll", "ly", "ly ", "m",
+    "ma", "me", "ment", "mentioned you", "message", "n", "n't ",
+    "nd", "ne", "ng", "nt", "o", "of", "om", "on", "oo", "or",
+    "order", "ou", "ould", "ow", "p", "package", "photo", "r",
+    "ra", "re", "ri", "ro", "s", "se", "shipped", "si", "st",
+    "story", "t", "te", "ter", "th", "thank", "the ", "ti", "tion",
+    "to", "u", "ur", "v", "ve", "w", "www.", "y", "you ", "your ",
+    "\xE2\x9D\xA4\xEF\xB8\x8F", "\xF0\x9F\x8E\x82", "\xF0\x9F\x8E\x89",
+    "\xF0\x9F\x91\x8D", "\xF0\x9F\x94\xA5", "\xF0\x9F\x98\x82", "\xF0\x9F\x98\x8A",
+    "\xF0\x9F\x98\x8D", "\xF0\x9F\x98\xAD", "\xF0\x9F\x98\xAE", "\xF0\x9F\x99\x8F",
+};
+
+#define DICTIONARY_SIZE (sizeof(dictionary) / sizeof(const char*))
+
+typedef char DictionarySizeCheck[(DICTIONARY_SIZE <= CODE_VERBATIM) ? 1 : -1];
+
+/*****************************************************************************/
+
+/*
+    Read position in a string given in pieces.
+*/
+class Cursor
+{
+public:
+    Cursor(const TextCodec::piece_t* _pieces, uint8_t _count)
+        :   pieces(_pieces),
+            count(_count),
+            piece(0),
+            offset(0)
+    {
+        skipEmpty();
+    }
+
+    bool atEnd() const
+    {
+        return (piece >= count);
+    }
+
+    const uint8_t* current() const
+    {
+        return &pieces[piece].data[offset];
+    }
+
+    /*
+        Length of text matching the input at the cursor, 0 if it does not.
+    */
+    uint32_t match(const char* text) const
+    {
+        uint8_t matchPiece = piece;
+        uint32_t matchOffset = offset;
+        uint32_t length = 0;
+
+        while (text[length] != '\0')
+        {
+            if ((matchPiece >= count) || (pieces[matchPiece].data[matchOffset] != (uint8_t) text[length]))
+            {
+                return 0;
+            }
+
+            length++;
+            matchOffset++;
+
+            while ((matchPiece < count) && (matchOffset >= pieces[matchPiece].length))
+            {
+                matchPiece++;
+                matchOffset = 0;
+            }
+        }
+
+        return length;
+    }
+
+    void advance(uint32_t length)
+    {
+        offset += length;
+
+        while ((piece < count) && (offset >= pieces[piece].length))
+        {
+            offset -= pieces[piece].length;
+            piece++;
+        }
+    }
+
+private:
+    void skipEmpty()
+    {
+        while ((piece < count) && (pieces[piece].length == 0))
+        {
+            piece++;
+        }
+    }
+
+    const TextCodec::piece_t* pieces;
+    uint8_t count;
+    uint8_t piece;
+    uint32_t offset;
+};
+
+/*
+    First entry in [low, high) whose byte at depth is not below value.
+*/
+static uint16_t lowerBound(uint16_t low, uint16_t high, uint8_t depth, uint16_t value)
+{
+    while (low < high)
+    {
+        uint16_t middle = (low + high) / 2;
+
+        if ((uint8_t) dictionary[middle][depth] < value)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/*
+    Longest dictionary entry at the cursor, or -1. The range of entries
+    sharing a prefix with the input is narrowed one byte at a time; an
+    entry that ends sorts first in its range.
+*/
+static int16_t longestEntry(const Cursor& cursor, uint32_t* length)
+{
+    Cursor probe = cursor;
+
+    uint16_t low = 0;
+    uint16_t high = DICTIONARY_SIZE;
+    int16_t best = -1;
+
+    *length = 0;
+
+    for (uint8_t depth = 0; (low < high) && !probe.atEnd(); depth++)
+    {
+        // already taken as the best match one byte ago
+        if (dictionary[low][depth] == '\0')
+        {
+            low++;
+        }
+
+        uint16_t value = *probe.current();
+
+        low = lowerBound(low, high, depth, value);
+        high = lowerBound(low, high, depth, value + 1);
+
+        probe.advance(1);
+
+        if ((low < high) && (dictionary[low][depth + 1] == '\0'))
+        {
+            best = low;
+            *length = depth + 1;
+        }
+    }
+
+    return best;
+}
+
+static uint32_t flushVerbatim(const uint8_t* run, uint32_t runLength, uint8_t* output, uint32_t index)
+{
+    if (runLength == 1)
+    {
+        if (output)
+        {
+            output[index] = CODE_VERBATIM;
+            output[index + 1] = run[0];
+        }
+
+        return index + 2;
+    }
+
+    if (output)
+    {
+        output[index] = CODE_VERBATIM_RUN;
+        output[index + 1] = runLength - 1;
+        memcpy(&output[index + 2], run, runLength);
+    }
+
+    return index + 2 + runLength;
+}
+
+/*****************************************************************************/
+/* Text Codec                                                                */
+/*****************************************************************************/
+
+uint32_t TextCodec::encode(const piece_t* pieces, uint8_t count, uint8_t* output)
+{
+    Cursor cursor(pieces, count);
+    uint32_t index = 0;
+
+    // bytes without an entry are collected and written as one run
+    const uint8_t* run = NULL;
+    uint32_t runLength = 0;
+
+    while (!cursor.atEnd())
+    {
+        uint32_t length;
+        int16_t entry = longestEntry(cursor, &length);
+
+        if ((entry >= 0) && (runLength > 0))
+        {
+            index = flushVerbatim(run, runLength, output, index);
+            runLength = 0;
+        }
+
+        if (entry >= 0)
+        {
+            if (output)
+            {
+                output[index] = entry;
+            }
+
+            index++;
+            cursor.advance(length);
+            continue;
+        }
+
+        // a run is copied in one go, so it ends at a piece boundary
+        if ((runLength > 0) && ((cursor.current() != run + runLength) || (runLength == MAX_RUN)))
+        {
+            index = flushVerbatim(run, runLength, output, index);
+            runLength = 0;
+        }
+
+        if (runLength == 0)
+        {
+            run = cursor.current();
+        }
+
+        runLength++;
+        cursor.advance(1);
+    }
+
+    if (runLength > 0)
+    {
+        index = flushVerbatim(run, runLength, output, index);
+    }
+
+    return index;
+}
+
+uint32_t TextCodec::decode(const uint8_t* input, uint32_t length, uint8_t* output, uint32_t capacity)
+{
+    uint32_t index = 0;
+    uint32_t out = 0;
+
+    while (index < length)
+    {
+        uint8_t code = input[index++];
+        const uint8_t* data;
+        uint32_t dataLength;
+
+        if (code == CODE_VERBATIM)
+        {
+            data = &input[index];
+            dataLength = 1;
+        }
+        else if (code == CODE_VERBATIM_RUN)
+        {
+            if (index >= length)
+            {
+                return 0;
+            }
+
+            dataLength = input[index++] + 1;
+            data = &input[index];
+        }
+        else if (code < DICTIONARY_SIZE)
+        {
+            data = (const uint8_t*) dictionary[code];
+            dataLength = strlen(dictionary[code]);
+        }
+        else
+        {
+            return 0;
+        }
+
+        if (code >= CODE_VERBATIM)
+        {
+            if (dataLength > length - index)
+            {
+                return 0;
+            }
+
+            index += dataLength;
+        }
+
+        if (dataLength > capacity - out)
+        {
+            return 0;
+        }
+
+        memcpy(&output[out], data, dataLength);
+        out += dataLength;
+    }
+
+    return out;
+}
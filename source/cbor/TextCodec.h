@@ -0,0 +1,53 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TEXT_CODEC_H__
+#define __TEXT_CODEC_H__
+
+#include <stdint.h>
+
+/*
+    Compact encoding for short notification text using a static
+    dictionary of common words, fragments, and emoji. Each output byte
+    below 254 stands for one dictionary entry; 254 is followed by one
+    verbatim byte and 255 by a count - 1 and up to 256 verbatim bytes.
+    The dictionary lives in flash and nothing is kept in RAM. Hosts
+    decode with the same dictionary.
+
+    Input may be given in pieces, e.g., title and subtitle, that are
+    encoded as if they were one string.
+*/
+namespace TextCodec
+{
+    typedef struct {
+        const uint8_t* data;
+        uint32_t length;
+    } piece_t;
+
+    /*
+        Encode into output, which must have room for the result. With
+        output NULL only the encoded length is returned.
+    */
+    uint32_t encode(const piece_t* pieces, uint8_t count, uint8_t* output);
+
+    /*
+        Returns the decoded length, or 0 if input is malformed or the
+        result does not fit in capacity.
+    */
+    uint32_t decode(const uint8_t* input, uint32_t length, uint8_t* output, uint32_t capacity);
+}
+
+#endif // __TEXT_CODEC_H__
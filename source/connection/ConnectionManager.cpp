@@ -0,0 +1,362 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+
+#include "ConnectionManager.h"
+#include "../log/TraceCapture.h"
+#include "../timer/TimerService.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+// fall back to the idle profile after this long without traffic
+#ifndef CONNECTION_IDLE_TIMEOUT_MS
+#define CONNECTION_IDLE_TIMEOUT_MS 10000
+#endif
+
+// the idle profile may be requested this much later to share a wakeup
+#ifndef CONNECTION_IDLE_SLACK_MS
+#define CONNECTION_IDLE_SLACK_MS 2000
+#endif
+
+// minimum time between parameter update requests
+#ifndef CONNECTION_UPDATE_SPACING_MS
+#define CONNECTION_UPDATE_SPACING_MS 5000
+#endif
+
+static Gap::ConnectionParams_t profiles[] = {
+    // ProfileNone, unused
+    { 0, 0, 0, 0 },
+    // ProfileFast
+    {
+        .minConnectionInterval = 12,          // 15 ms
+        .maxConnectionInterval = 32,          // 40 ms
+        .slaveLatency = 0,                    // 0 events
+        .connectionSupervisionTimeout = 400,  // 4000 ms
+    },
+    // ProfileIdle
+    {
+        .minConnectionInterval = 396,         // 495 ms
+        .maxConnectionInterval = 480,         // 600 ms
+        .slaveLatency = 2,                    // 2 events
+        .connectionSupervisionTimeout = 600,  // 6000 ms
+    }
+};
+
+static Gap::Handle_t connectionHandle;
+static bool started = false;
+
+static ConnectionManager::connection_mode_t mode = ConnectionManager::ModeAdaptive;
+static uint32_t idleTimeout = CONNECTION_IDLE_TIMEOUT_MS;
+static uint8_t busyMask = 0;
+
+static ConnectionManager::profile_t requested = ConnectionManager::ProfileNone;
+static ConnectionManager::profile_t target = ConnectionManager::ProfileNone;
+static minar::tick_t lastRequest = 0;
+
+static TimerService::handle_t idleTimer = TimerService::NoHandle;
+static minar::callback_handle_t deferHandle = NULL;
+
+// slowest parameters the central may be using, see getEventPeriodMs
+static uint32_t currentPeriodUs = 0;
+static uint32_t previousPeriodUs = 0;
+
+static ConnectionManager::statistics_t statistics;
+
+static void onConnection(const Gap::ConnectionCallbackParams_t* params);
+static void onDisconnection(const Gap::DisconnectionCallbackParams_t* params);
+static void evaluate(void);
+static void onIdle(void);
+static void request(ConnectionManager::profile_t profile);
+static void applyTarget(void);
+
+/*****************************************************************************/
+/* Connection Manager                                                        */
+/*****************************************************************************/
+
+void ConnectionManager::init()
+{
+    memset(&statistics, 0, sizeof(statistics));
+
+    // built-in profiles are not checked by setProfile
+    for (uint8_t profile = ProfileFast; profile <= ProfileIdle; profile++)
+    {
+        if (!isValid(profiles[profile]))
+        {
+            error("connection: profile %u breaks the iOS guidelines\r\n", profile);
+        }
+    }
+
+    BLE::Instance().gap().onConnection(onConnection);
+    BLE::Instance().gap().onDisconnection(onDisconnection);
+}
+
+void ConnectionManager::start(Gap::Handle_t handle)
+{
+    DEBUGOUT("connection: start\r\n");
+
+    connectionHandle = handle;
+    started = true;
+
+    evaluate();
+}
+
+void ConnectionManager::setBusy(source_t source, bool busy)
+{
+    uint8_t previous = busyMask;
+
+    if (busy)
+    {
+        busyMask |= source;
+    }
+    else
+    {
+        busyMask &= ~source;
+    }
+
+    if ((previous == 0) != (busyMask == 0))
+    {
+        evaluate();
+    }
+}
+
+void ConnectionManager::setMode(connection_mode_t _mode)
+{
+    mode = _mode;
+
+    evaluate();
+}
+
+bool ConnectionManager::setIdleTimeout(uint32_t milliseconds)
+{
+    if (milliseconds > MaxIdleTimeout)
+    {
+        return false;
+    }
+
+    idleTimeout = milliseconds;
+
+    return true;
+}
+
+bool ConnectionManager::setProfile(profile_t profile, const Gap::ConnectionParams_t& params)
+{
+    if ((profile == ProfileNone) || !isValid(params))
+    {
+        return false;
+    }
+
+    profiles[profile] = params;
+
+    // apply new values to the active profile
+    if (requested == profile)
+    {
+        requested = ProfileNone;
+        evaluate();
+    }
+
+    return true;
+}
+
+ConnectionManager::profile_t ConnectionManager::getProfile()
+{
+    return requested;
+}
+
+const ConnectionManager::statistics_t& ConnectionManager::getStatistics()
+{
+    return statistics;
+}
+
+uint32_t ConnectionManager::getEventPeriodMs()
+{
+    uint32_t periodUs = (currentPeriodUs > previousPeriodUs) ? currentPeriodUs : previousPeriodUs;
+
+    return (periodUs + 999) / 1000;
+}
+
+/*
+    Apple Accessory Design Guidelines, connection parameters.
+*/
+bool ConnectionManager::isValid(const Gap::ConnectionParams_t& params)
+{
+    // intervals in 1.25 ms units, timeout in 10 ms units
+    uint32_t minIntervalUs = params.minConnectionInterval * 1250UL;
+    uint32_t maxIntervalUs = params.maxConnectionInterval * 1250UL;
+    uint32_t timeoutUs = params.connectionSupervisionTimeout * 10000UL;
+    uint32_t effectiveUs = maxIntervalUs * (params.slaveLatency + 1);
+
+    return (params.slaveLatency <= 30) &&
+           (timeoutUs >= 2000000UL) && (timeoutUs <= 6000000UL) &&
+           (minIntervalUs >= 15000UL) &&
+           (minIntervalUs % 15000UL == 0) &&
+           (minIntervalUs + 15000UL <= maxIntervalUs) &&
+           (effectiveUs <= 2000000UL) &&
+           (effectiveUs * 3 < timeoutUs);
+}
+
+/*****************************************************************************/
+
+// longest gap between connection events the peripheral listens to
+static uint32_t eventPeriodUs(const Gap::ConnectionParams_t& params)
+{
+    return params.maxConnectionInterval * 1250UL * (params.slaveLatency + 1);
+}
+
+static void onConnection(const Gap::ConnectionCallbackParams_t* params)
+{
+    if (params->role == Gap::PERIPHERAL)
+    {
+        currentPeriodUs = eventPeriodUs(*params->connectionParams);
+        previousPeriodUs = currentPeriodUs;
+    }
+}
+
+static void onDisconnection(const Gap::DisconnectionCallbackParams_t* params)
+{
+    if (started && (params->handle == connectionHandle))
+    {
+        started = false;
+        busyMask = 0;
+        requested = ConnectionManager::ProfileNone;
+        target = ConnectionManager::ProfileNone;
+
+        if (idleTimer != TimerService::NoHandle)
+        {
+            TimerService::stop(idleTimer);
+            idleTimer = TimerService::NoHandle;
+        }
+
+        if (deferHandle)
+        {
+            minar::Scheduler::cancelCallback(deferHandle);
+            deferHandle = NULL;
+        }
+    }
+}
+
+static void evaluate()
+{
+    if (!started)
+    {
+        return;
+    }
+
+    if (mode == ConnectionManager::ModeAlwaysFast)
+    {
+        request(ConnectionManager::ProfileFast);
+    }
+    else if (mode == ConnectionManager::ModeAlwaysIdle)
+    {
+        request(ConnectionManager::ProfileIdle);
+    }
+    else if (busyMask)
+    {
+        if (idleTimer != TimerService::NoHandle)
+        {
+            TimerService::stop(idleTimer);
+            idleTimer = TimerService::NoHandle;
+        }
+
+        request(ConnectionManager::ProfileFast);
+    }
+    else if (requested == ConnectionManager::ProfileFast)
+    {
+        // stay fast for a while in case more traffic follows
+        if (idleTimer == TimerService::NoHandle)
+        {
+            idleTimer = TimerService::start(onIdle, idleTimeout, CONNECTION_IDLE_SLACK_MS);
+        }
+    }
+    else
+    {
+        request(ConnectionManager::ProfileIdle);
+    }
+}
+
+static void onIdle()
+{
+    idleTimer = TimerService::NoHandle;
+
+    if ((busyMask == 0) && (mode == ConnectionManager::ModeAdaptive))
+    {
+        request(ConnectionManager::ProfileIdle);
+    }
+}
+
+static void request(ConnectionManager::profile_t profile)
+{
+    target = profile;
+
+    // a deferred request picks up the latest target
+    if ((target == requested) || deferHandle)
+    {
+        return;
+    }
+
+    minar::tick_t elapsed = minar::Scheduler::getTime() - lastRequest;
+    minar::tick_t spacing = minar::milliseconds(CONNECTION_UPDATE_SPACING_MS);
+
+    if ((statistics.requests > 0) && (elapsed < spacing))
+    {
+        statistics.deferred++;
+
+        deferHandle = minar::Scheduler::postCallback(applyTarget)
+                        .delay(spacing - elapsed)
+                        .getHandle();
+        return;
+    }
+
+    applyTarget();
+}
+
+static void applyTarget()
+{
+    deferHandle = NULL;
+
+    if (!started || (target == requested))
+    {
+        return;
+    }
+
+    DEBUGOUT("connection: request profile %d\r\n", target);
+
+    ble_error_t result = BLE::Instance().gap().updateConnectionParams(connectionHandle, &profiles[target]);
+
+    TraceCapture::record(TraceCapture::RecordParameterUpdate, target, result);
+
+    if (result == BLE_ERROR_NONE)
+    {
+        // the central switches when it chooses, until then the old values apply
+        previousPeriodUs = currentPeriodUs;
+        currentPeriodUs = eventPeriodUs(profiles[target]);
+
+        requested = target;
+        lastRequest = minar::Scheduler::getTime();
+        statistics.requests++;
+    }
+    else
+    {
+        statistics.rejected++;
+    }
+}
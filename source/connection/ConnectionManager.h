@@ -0,0 +1,100 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_CONNECTION_MANAGER_H__
+#define __BLE_CONNECTION_MANAGER_H__
+
+#include "ble/BLE.h"
+
+/*
+    Chooses connection parameters at runtime. While any traffic source is
+    busy a short interval is requested; once all sources have been idle for
+    the configured time the connection falls back to a long interval with
+    slave latency. Requests are validated against the iOS accessory
+    guidelines and spaced out so the central is not flooded with updates.
+*/
+namespace ConnectionManager
+{
+    // longest idle timeout accepted, in milliseconds
+    const uint32_t MaxIdleTimeout = 60UL * 60 * 1000;
+
+    typedef enum {
+        ModeAdaptive    = 0,
+        ModeAlwaysFast  = 1,
+        ModeAlwaysIdle  = 2
+    } connection_mode_t;
+
+    typedef enum {
+        SourceANCS      = 0x01,
+        SourceAlerts    = 0x02
+    } source_t;
+
+    typedef enum {
+        ProfileNone,
+        ProfileFast,
+        ProfileIdle
+    } profile_t;
+
+    typedef struct {
+        uint32_t requests;
+        uint32_t deferred;
+        uint32_t rejected;
+    } statistics_t;
+
+    void init();
+
+    /*
+        Start managing the connection, called once the central is ready
+        for parameter updates.
+    */
+    void start(Gap::Handle_t handle);
+
+    /*
+        Mark traffic source as busy or idle.
+    */
+    void setBusy(source_t source, bool busy);
+
+    void setMode(connection_mode_t mode);
+
+    /*
+        Returns false if the timeout is longer than MaxIdleTimeout.
+    */
+    bool setIdleTimeout(uint32_t milliseconds);
+
+    /*
+        Replace fast or idle profile. Returns false if the parameters do
+        not meet the iOS guidelines; the minimum interval must be a
+        multiple of 15 ms.
+    */
+    bool setProfile(profile_t profile, const Gap::ConnectionParams_t& params);
+
+    profile_t getProfile();
+
+    const statistics_t& getStatistics();
+
+    /*
+        Longest time between connection events the peripheral listens to,
+        interval x (slave latency + 1), for the slower of the parameters
+        last requested and those before them, as the central applies an
+        update only when it chooses. Starts from the parameters at
+        connection.
+    */
+    uint32_t getEventPeriodMs();
+
+    bool isValid(const Gap::ConnectionParams_t& params);
+}
+
+#endif // __BLE_CONNECTION_MANAGER_H__
@@ -0,0 +1,266 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+#include "core-util/CriticalSectionLock.h"
+
+#include "EventLog.h"
+
+#include <stdio.h>
+
+using namespace mbed::util;
+
+// drain to the UART, off by default on the watch like DEBUGOUT
+#ifndef EVENT_LOG_OUTPUT
+#if !defined(TARGET_LIKE_WATCH)
+#define EVENT_LOG_OUTPUT 1
+#else
+#define EVENT_LOG_OUTPUT 0
+#endif
+#endif
+
+// ring size in bytes, power of two
+#ifndef EVENT_LOG_LENGTH
+#define EVENT_LOG_LENGTH 512
+#endif
+
+// delay from the first entry to the drain, so a burst is written at once
+#ifndef EVENT_LOG_DRAIN_MS
+#define EVENT_LOG_DRAIN_MS 100
+#endif
+
+// entries written per run
+
+#ifndef EVENT_LOG_DRAIN_ENTRIES
+#define EVENT_LOG_DRAIN_ENTRIES 8
+#endif
+
+#if (EVENT_LOG_LENGTH & (EVENT_LOG_LENGTH - 1)) != 0
+#error "EVENT_LOG_LENGTH must be a power of two"
+#endif
+
+#define EVENT_LOG_MASK (EVENT_LOG_LENGTH - 1)
+
+// entry: [event] [argument count] [timestamp, 4 bytes] [arguments, 4 bytes each]
+#define ENTRY_HEADER_LENGTH 6
+#define ENTRY_MAX_LENGTH (ENTRY_HEADER_LENGTH + 4 * 4)
+
+static uint8_t ring[EVENT_LOG_LENGTH];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+
+static uint32_t droppedReported = 0;
+
+// drain is only scheduled while the ring holds entries
+static bool draining = false;
+static bool drainPosted = false;
+
+static EventLog::statistics_t statistics = { 0, 0, 0 };
+
+/*****************************************************************************/
+
+static void put32(uint8_t* buffer, uint32_t value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+    buffer[3] = value >> 24;
+}
+
+#if EVENT_LOG_OUTPUT
+static void drain(void);
+
+static void postDrain()
+{
+    minar::Scheduler::postCallback(drain)
+        .delay(minar::milliseconds(EVENT_LOG_DRAIN_MS));
+}
+#endif
+
+static void write(EventLog::event_t event, const uint32_t* args, uint8_t count)
+{
+    uint8_t entry[ENTRY_MAX_LENGTH];
+    uint8_t length = ENTRY_HEADER_LENGTH + 4 * count;
+
+    entry[0] = event;
+    entry[1] = count;
+    put32(&entry[2], us_ticker_read());
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        put32(&entry[ENTRY_HEADER_LENGTH + 4 * idx], args[idx]);
+    }
+
+    bool post = false;
+
+    {
+        CriticalSectionLock lock;
+
+        if (length > EVENT_LOG_LENGTH - (head - tail))
+        {
+            statistics.dropped++;
+            return;
+        }
+
+        for (uint8_t idx = 0; idx < length; idx++)
+        {
+            ring[(head + idx) & EVENT_LOG_MASK] = entry[idx];
+        }
+
+        head += length;
+        statistics.recorded++;
+
+        // first entry since the last drain finished
+        if (draining && !drainPosted)
+        {
+            drainPosted = true;
+            post = true;
+        }
+    }
+
+#if EVENT_LOG_OUTPUT
+    if (post)
+    {
+        postDrain();
+    }
+#else
+    (void) post;
+#endif
+}
+
+#if EVENT_LOG_OUTPUT
+/*
+    Entries are copied out under the lock and printed outside it. The
+    drain posts itself again until the ring is empty; after that the next
+    record() posts it.
+*/
+static void drain()
+{
+    for (uint8_t drained = 0; drained < EVENT_LOG_DRAIN_ENTRIES; drained++)
+    {
+        uint8_t entry[ENTRY_MAX_LENGTH];
+        uint8_t length;
+
+        {
+            CriticalSectionLock lock;
+
+            if (head == tail)
+            {
+                break;
+            }
+
+            length = ENTRY_HEADER_LENGTH + 4 * ring[(tail + 1) & EVENT_LOG_MASK];
+
+            for (uint8_t idx = 0; idx < length; idx++)
+            {
+                entry[idx] = ring[(tail + idx) & EVENT_LOG_MASK];
+            }
+
+            tail += length;
+            statistics.drained++;
+        }
+
+        printf("#L ");
+
+        for (uint8_t idx = 0; idx < length; idx++)
+        {
+            printf("%02X", entry[idx]);
+        }
+
+        printf("\r\n");
+    }
+
+    uint32_t dropped = statistics.dropped;
+
+    if (dropped != droppedReported)
+    {
+        printf("#D %lu\r\n", dropped - droppedReported);
+        droppedReported = dropped;
+    }
+
+    bool more;
+
+    {
+        CriticalSectionLock lock;
+
+        more = (head != tail);
+        drainPosted = more;
+    }
+
+    if (more)
+    {
+        postDrain();
+    }
+}
+#endif
+
+/*****************************************************************************/
+/* Event Log                                                                 */
+/*****************************************************************************/
+
+void EventLog::init()
+{
+#if EVENT_LOG_OUTPUT
+    bool post;
+
+    {
+        CriticalSectionLock lock;
+
+        draining = true;
+        drainPosted = (head != tail);
+        post = drainPosted;
+    }
+
+    // entries recorded before init
+    if (post)
+    {
+        postDrain();
+    }
+#endif
+}
+
+void EventLog::record(event_t event)
+{
+    write(event, NULL, 0);
+}
+
+void EventLog::record(event_t event, uint32_t arg0)
+{
+    write(event, &arg0, 1);
+}
+
+void EventLog::record(event_t event, uint32_t arg0, uint32_t arg1)
+{
+    const uint32_t args[] = { arg0, arg1 };
+    write(event, args, 2);
+}
+
+void EventLog::record(event_t event, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    const uint32_t args[] = { arg0, arg1, arg2 };
+    write(event, args, 3);
+}
+
+void EventLog::record(event_t event, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    const uint32_t args[] = { arg0, arg1, arg2, arg3 };
+    write(event, args, 4);
+}
+
+const EventLog::statistics_t& EventLog::getStatistics()
+{
+    return statistics;
+}
@@ -0,0 +1,64 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __EVENT_LOG_H__
+#define __EVENT_LOG_H__
+
+#include <stdint.h>
+
+#include "EventLogEvents.h"
+
+/*
+    Binary event log. record() copies an event id, a microsecond timestamp,
+    and up to four arguments into a RAM ring and returns; it is safe from
+    interrupt context and never blocks. Entries that do not fit are
+    counted and discarded.
+
+    A minar callback drains a few entries at a time to the UART as
+    "#L <hex>" lines, which tools/decode_event_log.py turns back into text
+    using EventLogEvents.h. The callback is posted by the first record()
+    into an empty ring and reposts itself until the ring is empty, so an
+    idle log causes no wakeups.
+*/
+namespace EventLog
+{
+#define EVENT_LOG_ENUM(id, name, format) Event##name = id,
+    typedef enum {
+        EVENT_LOG_EVENTS(EVENT_LOG_ENUM)
+    } event_t;
+#undef EVENT_LOG_ENUM
+
+    typedef struct {
+        uint32_t recorded;
+        uint32_t dropped;
+        uint32_t drained;
+    } statistics_t;
+
+    /*
+        Start draining to the UART.
+    */
+    void init();
+
+    void record(event_t event);
+    void record(event_t event, uint32_t arg0);
+    void record(event_t event, uint32_t arg0, uint32_t arg1);
+    void record(event_t event, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+    void record(event_t event, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+    const statistics_t& getStatistics();
+}
+
+#endif // __EVENT_LOG_H__
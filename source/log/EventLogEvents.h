@@ -0,0 +1,67 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __EVENT_LOG_EVENTS_H__
+#define __EVENT_LOG_EVENTS_H__
+
+/*
+    Event identifiers and their text. tools/decode_event_log.py reads this
+    file, so keep one EVENT() per line: id, name, format. Arguments are
+    32-bit and printed with Python % formatting; %d prints them signed.
+*/
+#define EVENT_LOG_EVENTS(EVENT)                                                         \
+    EVENT(0x01, Boot,                   "boot")                                         \
+    EVENT(0x02, Connected,              "connected: %u %u %u")                          \
+    EVENT(0x03, Disconnected,           "disconnected: reason %u")                      \
+    EVENT(0x04, HeapCall,               "heap call after init: %u bytes")               \
+    EVENT(0x05, WatchdogFed,            "watchdog fed")                                 \
+    EVENT(0x06, ConnectionManaged,      "connection: parameters handed to manager")     \
+    EVENT(0x10, Command,                "command: port %u type %u length %u")           \
+    EVENT(0x11, CommandRejected,        "command rejected: port %u length %u")          \
+    EVENT(0x12, DeviceName,             "control: name %u bytes")                       \
+    EVENT(0x13, ANCSEnabled,            "control: ancs %u")                             \
+    EVENT(0x14, MessageRequested,       "control: message %u")                          \
+    EVENT(0x15, TextEncoding,           "control: text encoding %u")                    \
+    EVENT(0x16, CaptureControl,         "control: capture %u")                          \
+    EVENT(0x20, Notification,           "ancs: event %u flags %u category %u uid %u")   \
+    EVENT(0x21, AttributeData,          "ancs: attribute %u length %u")                 \
+    EVENT(0x22, FetchStart,             "ancs: fetch %u pipelined %u")                  \
+    EVENT(0x23, FetchTimeout,           "ancs: fetch timeout %u")                       \
+    EVENT(0x24, FetchMalformed,         "ancs: malformed response %u")                  \
+    EVENT(0x25, AlertSent,              "ancs: alert %u bytes slot %u")                 \
+    EVENT(0x26, AlertDropped,           "ancs: alert dropped %u")                       \
+    EVENT(0x27, StreamStart,            "ancs: stream %u")                              \
+    EVENT(0x28, StreamFragment,         "ancs: fragment %u offset %u length %u final %u") \
+    EVENT(0x29, StreamOverrun,          "ancs: stream overrun %u offset %u")            \
+    EVENT(0x2A, AppFetch,               "ancs: app name for %u, identifier %u bytes")   \
+    EVENT(0x2B, HandlesCached,          "ancs: cached handles %u %u")                   \
+    EVENT(0x2C, HandlesInvalid,         "ancs: cached handles %u %u failed")            \
+    EVENT(0x2D, Superseded,             "ancs: %u supersedes category %u")              \
+    EVENT(0x2E, Suppressed,             "ancs: suppressed %u weight %u")                \
+    EVENT(0x2F, FetchRejected,          "ancs: fetch rejected %u")                      \
+    EVENT(0x30, RadioEnabled,           "radio: enable %u")                             \
+    EVENT(0x31, ScanEnabled,            "radio: scan %u")                               \
+    EVENT(0x32, IdleTimeout,            "radio: idle timeout %u s")                     \
+    EVENT(0x33, ConnectionMode,         "radio: connection mode %u")                    \
+    EVENT(0x34, TxPower,                "radio: tx power %d dBm")                       \
+    EVENT(0x35, AdvertisingPolicy,      "radio: advertising policy %u")                 \
+    EVENT(0x36, ScanUUIDFilter,         "radio: scan uuid filter %u bytes")             \
+    EVENT(0x37, ScanNameFilter,         "radio: scan name filter %u bytes")             \
+    EVENT(0x38, ScanFiltersCleared,     "radio: scan filters cleared")                  \
+    EVENT(0x39, Connect,                "radio: connect address type %u")               \
+    EVENT(0x3A, ConnectionProfile,      "radio: connection profile %u: %u %u latency %u")
+
+#endif // __EVENT_LOG_EVENTS_H__
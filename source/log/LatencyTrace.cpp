@@ -0,0 +1,136 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+
+#include "LatencyTrace.h"
+#include "../cbor/CborSchema.h"
+#include "../message/MessageQueue.h"
+
+// durations below 2^7 us go into the first bucket
+#define BUCKET_SHIFT 7
+
+// [count, minimum, maximum, mean, [buckets]]
+typedef CborSchema::Array<CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::List<CborSchema::Unsigned<>, LATENCY_TRACE_BUCKETS> > StageEntry;
+
+// [7, [stage entries]]
+typedef CborSchema::Array<CborSchema::Unsigned<7>,
+                          CborSchema::List<StageEntry, LatencyTrace::StageCount> > StatisticsMessage;
+
+static LatencyTrace::histogram_t histograms[LatencyTrace::StageCount];
+
+static CborMessage<StatisticsMessage> statisticsMessage;
+static bool statisticsSending = false;
+
+/*****************************************************************************/
+
+static uint8_t bucket(uint32_t duration)
+{
+    uint8_t index = 0;
+
+    duration >>= BUCKET_SHIFT;
+
+    while (duration && (index < LATENCY_TRACE_BUCKETS - 1))
+    {
+        duration >>= 1;
+        index++;
+    }
+
+    return index;
+}
+
+static void statisticsSendDone()
+{
+    statisticsSending = false;
+}
+
+/*****************************************************************************/
+/* Latency Trace                                                             */
+/*****************************************************************************/
+
+uint32_t LatencyTrace::now()
+{
+    return us_ticker_read();
+}
+
+uint32_t LatencyTrace::record(stage_t stage, uint32_t start)
+{
+    uint32_t end = us_ticker_read();
+    uint32_t duration = end - start;
+
+    histogram_t& histogram = histograms[stage];
+
+    if ((histogram.count == 0) || (duration < histogram.minimum))
+    {
+        histogram.minimum = duration;
+    }
+
+    if (duration > histogram.maximum)
+    {
+        histogram.maximum = duration;
+    }
+
+    histogram.count++;
+    histogram.total += duration;
+    histogram.buckets[bucket(duration)]++;
+
+    return end;
+}
+
+const LatencyTrace::histogram_t& LatencyTrace::getHistogram(stage_t stage)
+{
+    return histograms[stage];
+}
+
+void LatencyTrace::reset()
+{
+    memset(histograms, 0, sizeof(histograms));
+}
+
+void LatencyTrace::sendStatistics()
+{
+    // previous dump still owns the buffer
+    if (statisticsSending)
+    {
+        return;
+    }
+
+    CborWriter cbor = statisticsMessage.writer();
+
+    cbor.array(2);
+    CborSchema::Unsigned<7>::encode(cbor, 7);
+    CborSchema::List<StageEntry, StageCount>::begin(cbor, StageCount);
+
+    for (uint8_t stage = 0; stage < StageCount; stage++)
+    {
+        const histogram_t& histogram = histograms[stage];
+
+        StageEntry::encode(cbor,
+                           histogram.count,
+                           histogram.minimum,
+                           histogram.maximum,
+                           (histogram.count) ? histogram.total / histogram.count : 0,
+                           CborSchema::list(histogram.buckets, LATENCY_TRACE_BUCKETS));
+    }
+
+    statisticsSending = MessageQueue::send(MessageCenter::ControlPort,
+                                           statisticsMessage.finish(cbor),
+                                           statisticsSendDone);
+}
@@ -0,0 +1,82 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LATENCY_TRACE_H__
+#define __LATENCY_TRACE_H__
+
+#include <stdint.h>
+
+// log2 buckets per stage; bucket 0 holds everything below 128 us
+#ifndef LATENCY_TRACE_BUCKETS
+#define LATENCY_TRACE_BUCKETS 16
+#endif
+
+/*
+    Per-stage latency histograms in static memory. Tracepoints take a
+    timestamp from the us ticker with now() and pass it to record() when
+    the stage ends. Bucket n > 0 counts durations from 2^(n+6) us up to
+    twice that; the last bucket is open ended.
+
+    Alert pipeline:
+
+        arrival --Queue--> fetch --FirstResponse--> first attribute data
+                --Attributes--> complete --Encode--> queued for the host
+                --Send--> handed to the transport
+
+    Total spans arrival to transport, Command the handling of one
+    control or radio command, Discovery connection to known ANCS handles.
+*/
+namespace LatencyTrace
+{
+    typedef enum {
+        StageQueue,
+        StageFirstResponse,
+        StageAttributes,
+        StageEncode,
+        StageSend,
+        StageTotal,
+        StageCommand,
+        StageDiscovery,
+        StageCount
+    } stage_t;
+
+    typedef struct {
+        uint32_t count;
+        uint32_t minimum;               // microseconds
+        uint32_t maximum;
+        uint32_t total;
+        uint32_t buckets[LATENCY_TRACE_BUCKETS];
+    } histogram_t;
+
+    uint32_t now();
+
+    /*
+        Add the time elapsed since start to the stage. Returns now.
+    */
+    uint32_t record(stage_t stage, uint32_t start);
+
+    const histogram_t& getHistogram(stage_t stage);
+
+    void reset();
+
+    /*
+        Send [7, [[count, min, max, mean, [buckets]], ...]] on ControlPort,
+        one entry per stage.
+    */
+    void sendStatistics();
+}
+
+#endif // __LATENCY_TRACE_H__
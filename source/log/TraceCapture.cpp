@@ -0,0 +1,216 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+#include "core-util/CriticalSectionLock.h"
+
+#include "TraceCapture.h"
+#include "../cbor/CborSchema.h"
+#include "../message/MessageQueue.h"
+
+using namespace mbed::util;
+
+#if (TRACE_CAPTURE_LENGTH & (TRACE_CAPTURE_LENGTH - 1)) != 0
+#error "TRACE_CAPTURE_LENGTH must be a power of two"
+#endif
+
+#define TRACE_CAPTURE_MASK (TRACE_CAPTURE_LENGTH - 1)
+
+// record: [type] [value count] [data length] [timestamp, 4 bytes] [values] [data]
+#define RECORD_HEADER_LENGTH 7
+#define RECORD_MAX_VALUES 8
+
+typedef char RecordLengthCheck[(RECORD_HEADER_LENGTH + 4 * RECORD_MAX_VALUES + TRACE_CAPTURE_DATA_MAX
+                                <= TRACE_CAPTURE_LENGTH) ? 1 : -1];
+typedef char DataMaxCheck[(TRACE_CAPTURE_DATA_MAX <= 0xFF) ? 1 : -1];
+
+// [16, offset, total, bytes]
+typedef CborSchema::Array<CborSchema::Unsigned<16>,
+                          CborSchema::Unsigned<TRACE_CAPTURE_LENGTH>,
+                          CborSchema::Unsigned<TRACE_CAPTURE_LENGTH>,
+                          CborSchema::Bytes<TRACE_CAPTURE_CHUNK> > ChunkMessage;
+
+static TraceCapture::statistics_t statistics = { 0, 0, 0, false };
+
+#if TRACE_CAPTURE
+static uint8_t ring[TRACE_CAPTURE_LENGTH];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+
+static CborMessage<ChunkMessage> chunkMessage;
+static uint8_t chunk[TRACE_CAPTURE_CHUNK];
+static bool chunkSending = false;
+#endif
+
+/*****************************************************************************/
+
+#if TRACE_CAPTURE
+static void put(uint32_t offset, uint8_t value)
+{
+    ring[(head + offset) & TRACE_CAPTURE_MASK] = value;
+}
+
+static void put32(uint32_t offset, uint32_t value)
+{
+    put(offset, value);
+    put(offset + 1, value >> 8);
+    put(offset + 2, value >> 16);
+    put(offset + 3, value >> 24);
+}
+
+static uint32_t recordLength(uint32_t start)
+{
+    return RECORD_HEADER_LENGTH
+           + 4 * ring[(start + 1) & TRACE_CAPTURE_MASK]
+           + ring[(start + 2) & TRACE_CAPTURE_MASK];
+}
+
+static void chunkSendDone()
+{
+    chunkSending = false;
+}
+#endif
+
+/*****************************************************************************/
+/* Trace Capture                                                             */
+/*****************************************************************************/
+
+void TraceCapture::start()
+{
+#if TRACE_CAPTURE
+    CriticalSectionLock lock;
+
+    head = 0;
+    tail = 0;
+
+    statistics.recorded = 0;
+    statistics.overwritten = 0;
+    statistics.capturing = true;
+#endif
+}
+
+void TraceCapture::stop()
+{
+    statistics.capturing = false;
+}
+
+void TraceCapture::record(record_t type)
+{
+    record(type, (const uint32_t*) NULL, 0);
+}
+
+void TraceCapture::record(record_t type, uint32_t value0, uint32_t value1)
+{
+    uint32_t values[2] = { value0, value1 };
+
+    record(type, values, 2);
+}
+
+void TraceCapture::record(record_t type, const uint32_t* values, uint8_t count,
+                          const uint8_t* data, uint16_t length)
+{
+#if TRACE_CAPTURE
+    if (!statistics.capturing)
+    {
+        return;
+    }
+
+    count = (count > RECORD_MAX_VALUES) ? RECORD_MAX_VALUES : count;
+    length = (length > TRACE_CAPTURE_DATA_MAX) ? TRACE_CAPTURE_DATA_MAX : length;
+
+    uint32_t total = RECORD_HEADER_LENGTH + 4 * count + length;
+    uint32_t timestamp = us_ticker_read();
+
+    CriticalSectionLock lock;
+
+    // the newest inputs matter most, make room at the old end
+    while (total > TRACE_CAPTURE_LENGTH - (head - tail))
+    {
+        tail += recordLength(tail);
+        statistics.overwritten++;
+    }
+
+    put(0, type);
+    put(1, count);
+    put(2, length);
+    put32(3, timestamp);
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        put32(RECORD_HEADER_LENGTH + 4 * idx, values[idx]);
+    }
+
+    for (uint16_t idx = 0; idx < length; idx++)
+    {
+        put(RECORD_HEADER_LENGTH + 4 * count + idx, data[idx]);
+    }
+
+    head += total;
+
+    statistics.recorded++;
+#else
+    (void) type;
+    (void) values;
+    (void) count;
+    (void) data;
+    (void) length;
+#endif
+}
+
+const TraceCapture::statistics_t& TraceCapture::getStatistics()
+{
+#if TRACE_CAPTURE
+    statistics.length = head - tail;
+#endif
+
+    return statistics;
+}
+
+void TraceCapture::send(uint32_t offset)
+{
+#if TRACE_CAPTURE
+    // previous chunk still owns the buffer
+    if (chunkSending)
+    {
+        return;
+    }
+
+    uint32_t total;
+    uint32_t length = 0;
+
+    {
+        CriticalSectionLock lock;
+
+        total = head - tail;
+
+        while ((offset + length < total) && (length < TRACE_CAPTURE_CHUNK))
+        {
+            chunk[length] = ring[(tail + offset + length) & TRACE_CAPTURE_MASK];
+            length++;
+        }
+    }
+
+    chunkSending = MessageQueue::send(MessageCenter::ControlPort,
+                                      chunkMessage.encode(16, offset, total, CborSchema::bytes(chunk, length)),
+                                      chunkSendDone);
+#else
+    // answer so the host knows there is nothing to read
+    CborMessage<ChunkMessage> message;
+    BlockStatic& block = message.encode(16, offset, 0, CborSchema::bytes(NULL, 0));
+
+    MessageQueue::send(MessageCenter::ControlPort, block.getData(), block.getLength());
+#endif
+}
@@ -0,0 +1,113 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TRACE_CAPTURE_H__
+#define __TRACE_CAPTURE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// build with the capture ring; costs TRACE_CAPTURE_LENGTH bytes of RAM
+#ifndef TRACE_CAPTURE
+#define TRACE_CAPTURE 0
+#endif
+
+// ring size in bytes, power of two
+#ifndef TRACE_CAPTURE_LENGTH
+#define TRACE_CAPTURE_LENGTH 2048
+#endif
+
+// longer payloads are cut; the original length is kept in the values
+#ifndef TRACE_CAPTURE_DATA_MAX
+#define TRACE_CAPTURE_DATA_MAX 64
+#endif
+
+// bytes per [16, offset] reply
+#ifndef TRACE_CAPTURE_CHUNK
+#define TRACE_CAPTURE_CHUNK 64
+#endif
+
+/*
+    Capture of the inputs that drive the firmware, for replay and
+    analysis off the device. Every record is
+
+        [type] [value count] [data length] [timestamp us, 4 bytes]
+        [values, 4 bytes each] [data]
+
+    little endian, in a RAM ring that overwrites the oldest records when
+    full. Capture starts and stops with Control [15, 1 | 0]; the host
+    then reads the ring with [16, offset]; tools/decode_trace_capture.py
+    decodes it and tools/trace_replay.cpp replays it into the ANCS
+    pipeline on the host. Each input record corresponds to one handler:
+
+        Connected, Disconnected     whenConnected, whenDisconnected
+        Received                    receivedControl, receivedRadio
+        ParameterUpdate             result of Gap::updateConnectionParams
+        ServiceFound, Notification  ANCSClient callbacks
+        Characteristic              ANCS discovery
+        DataSource                  GATT notification from the phone
+        AttributeData               ANCSClient data block
+        Written, Read               GATT write and read responses
+
+    AlertQueued and HeapCall are outputs, recorded so latency and
+    allocations can be profiled from the same capture.
+*/
+namespace TraceCapture
+{
+    typedef enum {
+        RecordConnected         = 0x01, // handle, role, peer type, min, max, latency, timeout; peer address
+        RecordDisconnected      = 0x02, // handle, reason
+        RecordParameterUpdate   = 0x03, // profile, result
+        RecordServiceFound      = 0x10,
+        RecordNotification      = 0x11, // event, flags, category, count, uid
+        RecordCharacteristic    = 0x12, // 1 control point | 2 data source, handle
+        RecordDataSource        = 0x13, // connection, handle, length; bytes
+        RecordAttributeData     = 0x14, // attribute, length; bytes
+        RecordWritten           = 0x15, // connection, handle
+        RecordRead              = 0x16, // connection, handle, offset, length; bytes
+        RecordReceived          = 0x20, // port, length; bytes
+        RecordAlertQueued       = 0x30, // uid, length
+        RecordHeapCall          = 0x31  // size, 0 for a release
+    } record_t;
+
+    typedef struct {
+        uint32_t recorded;
+        uint32_t overwritten;           // oldest records lost to newer ones
+        uint32_t length;                // bytes in the ring
+        bool capturing;
+    } statistics_t;
+
+    /*
+        Clear the ring and start recording.
+    */
+    void start();
+    void stop();
+
+    void record(record_t type);
+    void record(record_t type, uint32_t value0, uint32_t value1);
+    void record(record_t type, const uint32_t* values, uint8_t count,
+                const uint8_t* data = NULL, uint16_t length = 0);
+
+    const statistics_t& getStatistics();
+
+    /*
+        Send [16, offset, total, bytes] on ControlPort with the ring
+        contents from offset, oldest record first.
+    */
+    void send(uint32_t offset);
+}
+
+#endif // __TRACE_CAPTURE_H__
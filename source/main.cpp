@@ -21,18 +21,40 @@
 #include "watchdog/Watchdog.h"
 
 #include "ancs/ANCSManager.h"
+#include "scanner/Scanner.h"
+#include "connection/ConnectionManager.h"
+#include "advertising/AdvertisingManager.h"
+#include "advertising/AdvertisingBuilder.h"
 
 #include "message-center/MessageCenter.h"
 #include "message-center-transport/MessageCenterSPISlave.h"
 
-#include "cborg/Cbor.h"
+#include "cbor/CborSchema.h"
+#include "message/MessageBatcher.h"
+#include "message/MessageQueue.h"
+#include "message/CommandDispatcher.h"
+
+#include "log/EventLog.h"
+#include "log/LatencyTrace.h"
+#include "log/TraceCapture.h"
+
+#include "memory/MemoryMonitor.h"
+
+#include "timer/TimerService.h"
+
+#include "storage/RamStorage.h"
 
 /*****************************************************************************/
 /* Configuration                                                             */
 /*****************************************************************************/
 
 // set default device name
-#define DEVICE_NAME "mbed Watch";
+#define DEVICE_NAME "mbed Watch"
+
+// longest name accepted with the control command [5, "name"]
+#ifndef DEVICE_NAME_MAX_LENGTH
+#define DEVICE_NAME_MAX_LENGTH 31
+#endif
 
 // set TX power
 #ifndef CFG_BLE_TX_POWER_LEVEL
@@ -48,12 +70,23 @@
 
 #define VERBOSE_DEBUG_OUT 0
 
-const uint8_t txPowerLevel = CFG_BLE_TX_POWER_LEVEL;
+// the watchdog is fed on any TimerService wakeup from WATCHDOG_FEED_MS after
+// the last feed and at the latest WATCHDOG_FEED_SLACK_MS after that; the wide
+// slack lets feeds ride on other wakeups, and feeds must still leave a
+// quarter of the timeout as margin
+#define WATCHDOG_TIMEOUT_MS 20000
+#define WATCHDOG_FEED_MS 2000
+#define WATCHDOG_FEED_SLACK_MS 13000
+
+typedef char WatchdogFeedCheck[(WATCHDOG_FEED_MS + WATCHDOG_FEED_SLACK_MS <= WATCHDOG_TIMEOUT_MS * 3 / 4) ? 1 : -1];
+
+static int8_t txPowerLevel = CFG_BLE_TX_POWER_LEVEL;
 
 static bool ancsIsEnabled = true;
 static bool radioIsEnabled = true;
 
-std::string deviceNameString;
+static char deviceName[DEVICE_NAME_MAX_LENGTH + 1] = DEVICE_NAME;
+static uint8_t deviceNameLength = sizeof(DEVICE_NAME) - 1;
 
 static spi_slave_config_t spi_slave_config = {
     .pin_miso         = SPIS_MISO,
@@ -63,129 +96,797 @@ static spi_slave_config_t spi_slave_config = {
 
 static MessageCenterSPISlave transport(spi_slave_config, SPIS_CSN, SPIS_IRQ);
 
+/*****************************************************************************/
+/* Variables used by the app                                                 */
+/*****************************************************************************/
+
+static BLE ble;
+
+static Gap::Handle_t connectionHandle;
+
+// connection to a sensor found by the scanner, watch is central
+static Gap::Handle_t peripheralHandle;
+static bool peripheralIsConnected = false;
+
+// ANCS handles per peer; RAM until a flash backed PersistentStorage exists
+static RamStorage<HandleCache::StorageLength> handleStorage;
+
+
+/*****************************************************************************/
+/* Message Center                                                            */
 /*****************************************************************************/
 
-static void slowBeaconing()
+// [1, 1 connected | 2 disconnected | 3 sensor connected | 4 sensor disconnected]
+typedef CborSchema::Array<CborSchema::Unsigned<1>,
+                          CborSchema::Unsigned<4> > ConnectionEventMessage;
+
+// [2, advertising ms, connected ms, off ms, events, starts, state, stage]
+typedef CborSchema::Array<CborSchema::Unsigned<2>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<AdvertisingManager::StateConnected>,
+                          CborSchema::Unsigned<ADVERTISING_MAX_STAGES - 1> > AdvertisingStatisticsMessage;
+
+// [10, app name hits, misses, evictions, alerts dropped, stream overruns]
+typedef CborSchema::Array<CborSchema::Unsigned<10>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > ANCSStatisticsMessage;
+
+// [11, superseded, suppressed, replayed, admitted]
+typedef CborSchema::Array<CborSchema::Unsigned<11>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > SuppressionStatisticsMessage;
+
+// [12, text encoding in effect]
+typedef CborSchema::Array<CborSchema::Unsigned<12>,
+                          CborSchema::Unsigned<ANCSManager::TextPacked> > TextEncodingMessage;
+
+// [13, stack used, stack size, heap calls, queue buffers, control queue,
+//  alert queue, notification queue, send slots, notifications dropped];
+// pool entries are high-water marks
+typedef CborSchema::Array<CborSchema::Unsigned<13>,
+                          CborSchema::Unsigned<0xFFFF>,
+                          CborSchema::Unsigned<0xFFFF>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<0xFF>,
+                          CborSchema::Unsigned<0xFF>,
+                          CborSchema::Unsigned<0xFF>,
+                          CborSchema::Unsigned<0xFF>,
+                          CborSchema::Unsigned<0xFF>,
+                          CborSchema::Unsigned<> > MemoryStatisticsMessage;
+
+// [14, seconds, wakeups, timers run, timers that shared a wakeup]
+typedef CborSchema::Array<CborSchema::Unsigned<14>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > TimerStatisticsMessage;
+
+// [15, capturing, bytes captured, records overwritten]
+typedef CborSchema::Array<CborSchema::Unsigned<15>,
+                          CborSchema::Unsigned<1>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > CaptureStatusMessage;
+
+// [17, batching in effect]
+typedef CborSchema::Array<CborSchema::Unsigned<17>,
+                          CborSchema::Unsigned<1> > BatchingMessage;
+
+// [18, messages, transfers, batches, direct, most messages in one transfer]
+typedef CborSchema::Array<CborSchema::Unsigned<18>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<0xFF> > BatchStatisticsMessage;
+
+// [19, port, sent, dropped, total wait ms, longest wait ms, most waiting]
+typedef CborSchema::Array<CborSchema::Unsigned<19>,
+                          CborSchema::Unsigned<0xFFFF>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<0xFF> > QueueStatisticsMessage;
+
+// [20, port, type, 1 unknown | 2 malformed]: a command that was not run
+typedef CborSchema::Array<CborSchema::Unsigned<20>,
+                          CborSchema::Unsigned<0xFFFF>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<CommandDispatcher::RejectMalformed> > CommandRejectedMessage;
+
+// [21, commands dispatched, unknown, malformed]
+typedef CborSchema::Array<CborSchema::Unsigned<21>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > DispatcherStatisticsMessage;
+
+// [22, handle cache hits, misses, stores, invalidations]
+typedef CborSchema::Array<CborSchema::Unsigned<22>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > HandleCacheStatisticsMessage;
+
+// [23, payloads applied, unchanged, patched in place, replaced]
+typedef CborSchema::Array<CborSchema::Unsigned<23>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > BuilderStatisticsMessage;
+
+// [24, parameter requests, deferred, rejected, profile requested]
+typedef CborSchema::Array<CborSchema::Unsigned<24>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<ConnectionManager::ProfileIdle> > ConnectionStatisticsMessage;
+
+// [25, scan reports, duplicates, filtered, evictions, batches]
+typedef CborSchema::Array<CborSchema::Unsigned<25>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<> > ScannerStatisticsMessage;
+
+// control messages are copied into queue owned buffers
+typedef char ConnectionEventCheck[(ConnectionEventMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char AdvertisingStatisticsCheck[(AdvertisingStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char ANCSStatisticsCheck[(ANCSStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char SuppressionStatisticsCheck[(SuppressionStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char TextEncodingCheck[(TextEncodingMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char MemoryStatisticsCheck[(MemoryStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char TimerStatisticsCheck[(TimerStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char CaptureStatusCheck[(CaptureStatusMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char BatchingCheck[(BatchingMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char BatchStatisticsCheck[(BatchStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char QueueStatisticsCheck[(QueueStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char CommandRejectedCheck[(CommandRejectedMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char DispatcherStatisticsCheck[(DispatcherStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char HandleCacheStatisticsCheck[(HandleCacheStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char BuilderStatisticsCheck[(BuilderStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char ConnectionStatisticsCheck[(ConnectionStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+typedef char ScannerStatisticsCheck[(ScannerStatisticsMessage::MaxLength <= MessageQueue::BufferLength) ? 1 : -1];
+
+static void sendControl(BlockStatic& block)
 {
-    if (radioIsEnabled)
-    {
-        DEBUGOUT("main: Restarting the advertising process\r\n");
+    MessageQueue::send(MessageCenter::ControlPort, block.getData(), block.getLength());
+}
 
-        BLE::Instance().gap().stopAdvertising();
-        BLE::Instance().gap().setAdvertisingInterval(1285);
-        BLE::Instance().gap().startAdvertising();
-    }
+void sendAdvertisingStatistics()
+{
+    const AdvertisingManager::statistics_t& stats = AdvertisingManager::getStatistics();
+
+    CborMessage<AdvertisingStatisticsMessage> message;
+
+    sendControl(message.encode(2,
+                               stats.advertisingMs,
+                               stats.connectedMs,
+                               stats.offMs,
+                               stats.advertisingEvents,
+                               stats.starts,
+                               AdvertisingManager::getState(),
+                               AdvertisingManager::getStage()));
 }
 
-static void fastBeaconing()
+static void sendANCSStatistics()
 {
-    if (radioIsEnabled)
-    {
-        DEBUGOUT("main: Restarting the advertising process\r\n");
+    const AppNameCache::statistics_t& apps = ANCSManager::getAppCacheStatistics();
+
+    CborMessage<ANCSStatisticsMessage> message;
+
+    sendControl(message.encode(10,
+                               apps.hits,
+                               apps.misses,
+                               apps.evictions,
+                               ANCSManager::getDroppedAlerts(),
+                               ANCSManager::getStreamOverruns()));
+}
+
+static void sendSuppressionStatistics()
+{
+    const AlertRateLimiter::statistics_t& rate = ANCSManager::getRateStatistics();
+
+    CborMessage<SuppressionStatisticsMessage> message;
+
+    sendControl(message.encode(11,
+                               ANCSManager::getQueueStatistics().superseded,
+                               rate.suppressed,
+                               rate.replayed,
+                               rate.admitted));
+}
+
+static void sendMemoryStatistics()
+{
+    const MemoryMonitor::statistics_t& memory = MemoryMonitor::getStatistics();
+    const MessageQueue::statistics_t* control = MessageQueue::getStatistics(MessageCenter::ControlPort);
+    const MessageQueue::statistics_t* alert = MessageQueue::getStatistics(MessageCenter::AlertPort);
+
+    CborMessage<MemoryStatisticsMessage> message;
+
+    sendControl(message.encode(13,
+                               memory.stackUsed,
+                               memory.stackSize,
+                               memory.heapCalls,
+                               MessageQueue::getBufferHighWaterMark(),
+                               (control) ? control->highWaterMark : 0,
+                               (alert) ? alert->highWaterMark : 0,
+                               ANCSManager::getQueueStatistics().highWaterMark,
+                               ANCSManager::getSlotHighWaterMark(),
+                               ANCSManager::getQueueStatistics().dropped));
+}
+
+static void sendTimerStatistics()
+{
+    const TimerQueue::statistics_t& timers = TimerService::getStatistics();
+
+    CborMessage<TimerStatisticsMessage> message;
+
+    sendControl(message.encode(14,
+                               TimerService::getUptimeMs() / 1000,
+                               timers.wakeups,
+                               timers.expired,
+                               timers.shared));
+}
+
+// transfers saved is messages - transfers
+static void sendBatchStatistics()
+{
+    const MessageBatcher::statistics_t& batcher = MessageBatcher::getStatistics();
 
-        BLE::Instance().gap().stopAdvertising();
-        BLE::Instance().gap().setAdvertisingInterval(319);
-        BLE::Instance().gap().startAdvertising();
+    CborMessage<BatchStatisticsMessage> message;
 
-        minar::Scheduler::postCallback(slowBeaconing)
-            .delay(minar::milliseconds(30 * 1000));
+    sendControl(message.encode(18,
+                               batcher.messages,
+                               batcher.transfers,
+                               batcher.batches,
+                               batcher.direct,
+                               batcher.maxPerTransfer));
+}
+
+// mean wait is total wait / sent
+static void sendQueueStatistics(uint16_t port)
+{
+    const MessageQueue::statistics_t* queue = MessageQueue::getStatistics(port);
+
+    if (queue)
+    {
+        CborMessage<QueueStatisticsMessage> message;
+
+        sendControl(message.encode(19,
+                                   port,
+                                   queue->sent,
+                                   queue->dropped,
+                                   queue->waitTotalMs,
+                                   queue->waitMaxMs,
+                                   queue->highWaterMark));
     }
 }
 
-/*****************************************************************************/
-/* Variables used by the app                                                 */
-/*****************************************************************************/
+static void sendDispatcherStatistics()
+{
+    const CommandDispatcher::statistics_t& dispatcher = CommandDispatcher::getStatistics();
 
-static BLE ble;
+    CborMessage<DispatcherStatisticsMessage> message;
 
-static Gap::Handle_t connectionHandle;
-static Gap::Handle_t peripheralHandle;
+    sendControl(message.encode(21,
+                               dispatcher.dispatched,
+                               dispatcher.unknown,
+                               dispatcher.malformed));
+}
 
-#if 0
-static const Gap::ConnectionParams_t custom = {
-        .minConnectionInterval = 80,          // 100 ms
-        .maxConnectionInterval = 100,         // 125 ms
-        .slaveLatency = 4,                    // 4 events
-        .connectionSupervisionTimeout = 200,  // 2000 ms
-    };
-#elif 0
-static const Gap::ConnectionParams_t custom = {
-        .minConnectionInterval = 304,         // 380 ms
-        .maxConnectionInterval = 320,         // 405 ms
-        .slaveLatency = 4,                    // 4 events
-        .connectionSupervisionTimeout = 600,  // 6000 ms
-    };
-#else
-static const Gap::ConnectionParams_t custom = {
-        .minConnectionInterval = 400,         // 500 ms
-        .maxConnectionInterval = 480,         // 600 ms
-        .slaveLatency = 2,                    // 2 events
-        .connectionSupervisionTimeout = 540,  // 5400 ms
-    };
-#endif
+static void sendHandleCacheStatistics()
+{
+    const HandleCache::statistics_t& handles = ANCSManager::getHandleCacheStatistics();
+
+    CborMessage<HandleCacheStatisticsMessage> message;
+
+    sendControl(message.encode(22,
+                               handles.hits,
+                               handles.misses,
+                               handles.stores,
+                               handles.invalidations));
+}
+
+static void sendBuilderStatistics()
+{
+    const AdvertisingBuilder::statistics_t& builder = AdvertisingBuilder::getStatistics();
+
+    CborMessage<BuilderStatisticsMessage> message;
+
+    sendControl(message.encode(23,
+                               builder.applied,
+                               builder.unchanged,
+                               builder.patched,
+                               builder.replaced));
+}
+
+static void sendConnectionStatistics()
+{
+    const ConnectionManager::statistics_t& connection = ConnectionManager::getStatistics();
+
+    CborMessage<ConnectionStatisticsMessage> message;
+
+    sendControl(message.encode(24,
+                               connection.requests,
+                               connection.deferred,
+                               connection.rejected,
+                               ConnectionManager::getProfile()));
+}
+
+static void sendScannerStatistics()
+{
+    const Scanner::statistics_t& scanner = Scanner::getStatistics();
+
+    CborMessage<ScannerStatisticsMessage> message;
+
+    sendControl(message.encode(25,
+                               scanner.reports,
+                               scanner.duplicates,
+                               scanner.filtered,
+                               scanner.evictions,
+                               scanner.batches));
+}
 
 /*****************************************************************************/
-/* Message Center                                                            */
+/* Commands                                                                  */
 /*****************************************************************************/
 
-uint8_t payload[10];
-BlockStatic block(payload, 10);
+void updateAdvertisement();
 
-void receivedControl(BlockStatic block)
+// advertising policies selected with the radio command [6, policy]
+static const AdvertisingManager::stage_t policyCurve[] = {
+    { 319,   30 * 1000 },
+    { 760,   5 * 60 * 1000 },
+    { 1285,  0 }
+};
+
+static const AdvertisingManager::stage_t policyFast[] = {
+    { 319,   0 }
+};
+
+static const AdvertisingManager::stage_t policySlow[] = {
+    { 1285,  0 }
+};
+
+// [1, 1234567890]
+static void commandReset(const CommandDispatcher::argument_t& argument)
 {
-    DEBUGOUT("main: Control: %p\r\n", block.getData());
-    for (std::size_t idx = 0; idx < block.getLength(); idx++)
+    if (argument.value == 1234567890)
     {
-        DEBUGOUT("%02X", block.at(idx));
+        NVIC_SystemReset();
     }
-    DEBUGOUT("\r\n");
+}
+
+// [2]
+static void commandStatistics(const CommandDispatcher::argument_t&)
+{
+    sendAdvertisingStatistics();
+}
+
+// [3, battery level]
+static void commandBatteryLevel(const CommandDispatcher::argument_t& argument)
+{
+    AdvertisingBuilder::setBatteryLevel(argument.value);
+    AdvertisingBuilder::apply();
+}
+
+// [4, unread count]
+static void commandUnreadCount(const CommandDispatcher::argument_t& argument)
+{
+    AdvertisingBuilder::setUnreadCount(argument.value);
+    AdvertisingBuilder::apply();
+}
+
+// [5, "name"]
+static void commandDeviceName(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventDeviceName, argument.length);
+
+    deviceNameLength = (argument.length > DEVICE_NAME_MAX_LENGTH) ? DEVICE_NAME_MAX_LENGTH : argument.length;
+
+    memcpy(deviceName, argument.text, deviceNameLength);
+    deviceName[deviceNameLength] = '\0';
 
-    uint32_t type = 0;
-    uint32_t value = 0;
+    ble.gap().setDeviceName((const uint8_t*) deviceName);
 
-    Cborg cbor(block.getData(), block.getLength());
-    cbor.at(0).getUnsigned(&type);
-    cbor.at(1).getUnsigned(&value);
+    updateAdvertisement();
+}
 
-    if ((type == 1) && (value == 1234567890))
+// [6, enable]
+static void commandANCS(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventANCSEnabled, argument.value);
+
+    ancsIsEnabled = (argument.value != 0);
+    ANCSManager::setEnabled(ancsIsEnabled);
+
+    // solicitation follows the setting
+    updateAdvertisement();
+}
+
+// [7]
+static void commandLatency(const CommandDispatcher::argument_t&)
+{
+    LatencyTrace::sendStatistics();
+}
+
+// [8]
+static void commandLatencyReset(const CommandDispatcher::argument_t&)
+{
+    LatencyTrace::reset();
+}
+
+// [9, uid]: rest of a message sent with final = 0
+static void commandMessage(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventMessageRequested, argument.value);
+
+    ANCSManager::requestMessage(argument.value);
+}
+
+// [10]
+static void commandANCSStatistics(const CommandDispatcher::argument_t&)
+{
+    sendANCSStatistics();
+}
+
+// [11]
+static void commandSuppressionStatistics(const CommandDispatcher::argument_t&)
+{
+    sendSuppressionStatistics();
+}
+
+// [12, encoding]: 0 plain text, 1 packed; answered with the encoding in effect
+static void commandTextEncoding(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventTextEncoding, argument.value);
+
+    ANCSManager::setTextEncoding(argument.value);
+
+    CborMessage<TextEncodingMessage> message;
+    sendControl(message.encode(12, ANCSManager::getTextEncoding()));
+}
+
+// [13]
+static void commandMemoryStatistics(const CommandDispatcher::argument_t&)
+{
+    sendMemoryStatistics();
+}
+
+// [14]
+static void commandTimerStatistics(const CommandDispatcher::argument_t&)
+{
+    sendTimerStatistics();
+}
+
+// [15, 1 start | 0 stop]: capture restarts from empty, answered with the status
+static void commandCapture(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventCaptureControl, argument.value);
+
+    if (argument.value)
     {
-        NVIC_SystemReset();
+        TraceCapture::start();
+    }
+    else
+    {
+        TraceCapture::stop();
     }
+
+    const TraceCapture::statistics_t& capture = TraceCapture::getStatistics();
+
+    CborMessage<CaptureStatusMessage> message;
+    sendControl(message.encode(15, capture.capturing, capture.length, capture.overwritten));
 }
 
-void receivedRadio(BlockStatic block)
+// [16, offset]
+static void commandCaptureRead(const CommandDispatcher::argument_t& argument)
+{
+    TraceCapture::send(argument.value);
+}
+
+// [17, 1 batch | 0 separate]: only hosts that unpack BatchPort may enable
+// batching; answered with the setting in effect
+static void commandBatching(const CommandDispatcher::argument_t& argument)
+{
+    MessageBatcher::setEnabled(argument.value == 1);
+
+    CborMessage<BatchingMessage> message;
+    sendControl(message.encode(17, MessageBatcher::isEnabled()));
+}
+
+// [18]
+static void commandBatchStatistics(const CommandDispatcher::argument_t&)
 {
-    DEBUGOUT("main: Radio: %p\r\n", block.getData());
-    for (std::size_t idx = 0; idx < block.getLength(); idx++)
+    sendBatchStatistics();
+}
+
+// [19, port]: ports without a queue are not answered
+static void commandQueueStatistics(const CommandDispatcher::argument_t& argument)
+{
+    if (argument.value <= 0xFFFF)
     {
-        DEBUGOUT("%02X", block.at(idx));
+        sendQueueStatistics(argument.value);
     }
-    DEBUGOUT("\r\n");
+}
+
+// [21]
+static void commandDispatcherStatistics(const CommandDispatcher::argument_t&)
+{
+    sendDispatcherStatistics();
+}
+
+// [22]
+static void commandHandleCacheStatistics(const CommandDispatcher::argument_t&)
+{
+    sendHandleCacheStatistics();
+}
 
-    uint32_t type = 0;
-    uint32_t value = 0;
+// [23]
+static void commandBuilderStatistics(const CommandDispatcher::argument_t&)
+{
+    sendBuilderStatistics();
+}
 
-    Cborg cbor(block.getData(), block.getLength());
-    cbor.at(0).getUnsigned(&type);
-    cbor.at(1).getUnsigned(&value);
+// [24]
+static void commandConnectionStatistics(const CommandDispatcher::argument_t&)
+{
+    sendConnectionStatistics();
+}
 
-    if ((type == 1) && (value == 1))
+// [25]
+static void commandScannerStatistics(const CommandDispatcher::argument_t&)
+{
+    sendScannerStatistics();
+}
+
+// [1, enable]
+static void commandRadio(const CommandDispatcher::argument_t& argument)
+{
+    if (argument.value == 1)
     {
-        DEBUGOUT("main: Radio: enable\r\n");
+        EventLog::record(EventLog::EventRadioEnabled, 1);
         radioIsEnabled = true;
-        fastBeaconing();
+        AdvertisingManager::start();
     }
-    else if ((type == 1) && (value == 0))
+    else if (argument.value == 0)
     {
-        DEBUGOUT("main: Radio: disable\r\n");
+        EventLog::record(EventLog::EventRadioEnabled, 0);
         radioIsEnabled = false;
-        ble.gap().stopAdvertising();
+        AdvertisingManager::stop();
+        Scanner::stop();
+
+        if (peripheralIsConnected)
+        {
+            ble.gap().disconnect(peripheralHandle, Gap::LOCAL_HOST_TERMINATED_CONNECTION);
+        }
+    }
+}
+
+// [2, enable]
+static void commandScan(const CommandDispatcher::argument_t& argument)
+{
+    if ((argument.value == 1) && radioIsEnabled)
+    {
+        EventLog::record(EventLog::EventScanEnabled, 1);
+        Scanner::start();
+    }
+    else if (argument.value == 0)
+    {
+        EventLog::record(EventLog::EventScanEnabled, 0);
+        Scanner::stop();
+    }
+}
+
+// [3, seconds]
+static void commandIdleTimeout(const CommandDispatcher::argument_t& argument)
+{
+    // checked before scaling, a large value would wrap into a short timeout
+    if (argument.value <= ConnectionManager::MaxIdleTimeout / 1000)
+    {
+        EventLog::record(EventLog::EventIdleTimeout, argument.value);
+        ConnectionManager::setIdleTimeout(argument.value * 1000);
+    }
+}
+
+// [4, mode]
+static void commandConnectionMode(const CommandDispatcher::argument_t& argument)
+{
+    if (argument.value <= ConnectionManager::ModeAlwaysIdle)
+    {
+        EventLog::record(EventLog::EventConnectionMode, argument.value);
+        ConnectionManager::setMode((ConnectionManager::connection_mode_t) argument.value);
+    }
+}
+
+// [5, dBm]
+static void commandTxPower(const CommandDispatcher::argument_t& argument)
+{
+    if ((argument.integer >= -40) && (argument.integer <= 4))
+    {
+        EventLog::record(EventLog::EventTxPower, argument.integer);
+
+        if (ble.gap().setTxPower(argument.integer) == BLE_ERROR_NONE)
+        {
+            txPowerLevel = argument.integer;
+            updateAdvertisement();
+        }
+    }
+}
+
+// [6, policy]: 0 fast to slow curve, 1 always fast, 2 always slow
+static void commandAdvertisingPolicy(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventAdvertisingPolicy, argument.value);
+
+    if (argument.value == 0)
+    {
+        AdvertisingManager::setStages(policyCurve, sizeof(policyCurve) / sizeof(AdvertisingManager::stage_t));
+    }
+    else if (argument.value == 1)
+    {
+        AdvertisingManager::setStages(policyFast, sizeof(policyFast) / sizeof(AdvertisingManager::stage_t));
+    }
+    else if (argument.value == 2)
+    {
+        AdvertisingManager::setStages(policySlow, sizeof(policySlow) / sizeof(AdvertisingManager::stage_t));
+    }
+}
+
+// [7, uuid]: 2 or 16 bytes, most significant byte first
+static void commandScanUUID(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventScanUUIDFilter, argument.length);
+
+    if (argument.length == UUID::LENGTH_OF_LONG_UUID)
+    {
+        Scanner::addUUIDFilter(UUID(argument.bytes, UUID::MSB));
+    }
+    else if (argument.length == sizeof(UUID::ShortUUIDBytes_t))
+    {
+        Scanner::addUUIDFilter(UUID((UUID::ShortUUIDBytes_t) ((argument.bytes[0] << 8) | argument.bytes[1])));
+    }
+}
+
+// [8, "prefix"]: empty prefix removes the name filter
+static void commandScanName(const CommandDispatcher::argument_t& argument)
+{
+    EventLog::record(EventLog::EventScanNameFilter, argument.length);
+
+    Scanner::setNameFilter(argument.text, (argument.length > 0xFF) ? 0xFF : argument.length);
+}
+
+// [9]
+static void commandScanClearFilters(const CommandDispatcher::argument_t&)
+{
+    EventLog::record(EventLog::EventScanFiltersCleared);
+
+    Scanner::clearFilters();
+}
+
+// [10, address + type]: address as reported by the scanner, then its type
+static void commandConnect(const CommandDispatcher::argument_t& argument)
+{
+    if ((argument.length != Gap::ADDR_LEN + 1) || !radioIsEnabled || peripheralIsConnected)
+    {
+        return;
+    }
+
+    uint8_t addressType = argument.bytes[Gap::ADDR_LEN];
+
+    if (addressType <= BLEProtocol::AddressType::RANDOM_PRIVATE_NON_RESOLVABLE)
+    {
+        EventLog::record(EventLog::EventConnect, addressType);
+
+        Scanner::connect(argument.bytes, (BLEProtocol::AddressType_t) addressType);
+    }
+}
+
+// [11, profile, min interval, max interval, slave latency, supervision timeout]
+// profile 1 fast, 2 idle; intervals in 1.25 ms units, timeout in 10 ms units
+static void commandConnectionProfile(const CommandDispatcher::argument_t& argument)
+{
+    if ((argument.length != 5) ||
+        ((argument.values[0] != ConnectionManager::ProfileFast) &&
+         (argument.values[0] != ConnectionManager::ProfileIdle)) ||
+        (argument.values[1] > 0xFFFF) || (argument.values[2] > 0xFFFF) ||
+        (argument.values[3] > 0xFFFF) || (argument.values[4] > 0xFFFF))
+    {
+        return;
     }
+
+    Gap::ConnectionParams_t params;
+    params.minConnectionInterval = argument.values[1];
+    params.maxConnectionInterval = argument.values[2];
+    params.slaveLatency = argument.values[3];
+    params.connectionSupervisionTimeout = argument.values[4];
+
+    EventLog::record(EventLog::EventConnectionProfile, argument.values[0], argument.values[1],
+                                                       argument.values[2], argument.values[3]);
+
+    // parameters outside the iOS guidelines are rejected
+    ConnectionManager::setProfile((ConnectionManager::profile_t) argument.values[0], params);
+}
+
+static const CommandDispatcher::command_t commands[] = {
+    { MessageCenter::ControlPort,   1, CommandDispatcher::ArgumentUnsigned, commandReset },
+    { MessageCenter::ControlPort,   2, CommandDispatcher::ArgumentNone,     commandStatistics },
+    { MessageCenter::ControlPort,   3, CommandDispatcher::ArgumentUnsigned, commandBatteryLevel },
+    { MessageCenter::ControlPort,   4, CommandDispatcher::ArgumentUnsigned, commandUnreadCount },
+    { MessageCenter::ControlPort,   5, CommandDispatcher::ArgumentText,     commandDeviceName },
+    { MessageCenter::ControlPort,   6, CommandDispatcher::ArgumentUnsigned, commandANCS },
+    { MessageCenter::ControlPort,   7, CommandDispatcher::ArgumentNone,     commandLatency },
+    { MessageCenter::ControlPort,   8, CommandDispatcher::ArgumentNone,     commandLatencyReset },
+    { MessageCenter::ControlPort,   9, CommandDispatcher::ArgumentUnsigned, commandMessage },
+    { MessageCenter::ControlPort,  10, CommandDispatcher::ArgumentNone,     commandANCSStatistics },
+    { MessageCenter::ControlPort,  11, CommandDispatcher::ArgumentNone,     commandSuppressionStatistics },
+    { MessageCenter::ControlPort,  12, CommandDispatcher::ArgumentUnsigned, commandTextEncoding },
+    { MessageCenter::ControlPort,  13, CommandDispatcher::ArgumentNone,     commandMemoryStatistics },
+    { MessageCenter::ControlPort,  14, CommandDispatcher::ArgumentNone,     commandTimerStatistics },
+    { MessageCenter::ControlPort,  15, CommandDispatcher::ArgumentUnsigned, commandCapture },
+    { MessageCenter::ControlPort,  16, CommandDispatcher::ArgumentUnsigned, commandCaptureRead },
+    { MessageCenter::ControlPort,  17, CommandDispatcher::ArgumentUnsigned, commandBatching },
+    { MessageCenter::ControlPort,  18, CommandDispatcher::ArgumentNone,     commandBatchStatistics },
+    { MessageCenter::ControlPort,  19, CommandDispatcher::ArgumentUnsigned, commandQueueStatistics },
+    { MessageCenter::ControlPort,  21, CommandDispatcher::ArgumentNone,     commandDispatcherStatistics },
+    { MessageCenter::ControlPort,  22, CommandDispatcher::ArgumentNone,     commandHandleCacheStatistics },
+    { MessageCenter::ControlPort,  23, CommandDispatcher::ArgumentNone,     commandBuilderStatistics },
+    { MessageCenter::ControlPort,  24, CommandDispatcher::ArgumentNone,     commandConnectionStatistics },
+    { MessageCenter::ControlPort,  25, CommandDispatcher::ArgumentNone,     commandScannerStatistics },
+    { MessageCenter::RadioPort,     1, CommandDispatcher::ArgumentUnsigned, commandRadio },
+    { MessageCenter::RadioPort,     2, CommandDispatcher::ArgumentUnsigned, commandScan },
+    { MessageCenter::RadioPort,     3, CommandDispatcher::ArgumentUnsigned, commandIdleTimeout },
+    { MessageCenter::RadioPort,     4, CommandDispatcher::ArgumentUnsigned, commandConnectionMode },
+    { MessageCenter::RadioPort,     5, CommandDispatcher::ArgumentInteger,  commandTxPower },
+    { MessageCenter::RadioPort,     6, CommandDispatcher::ArgumentUnsigned, commandAdvertisingPolicy },
+    { MessageCenter::RadioPort,     7, CommandDispatcher::ArgumentBytes,    commandScanUUID },
+    { MessageCenter::RadioPort,     8, CommandDispatcher::ArgumentText,     commandScanName },
+    { MessageCenter::RadioPort,     9, CommandDispatcher::ArgumentNone,     commandScanClearFilters },
+    { MessageCenter::RadioPort,    10, CommandDispatcher::ArgumentBytes,    commandConnect },
+    { MessageCenter::RadioPort,    11, CommandDispatcher::ArgumentList,     commandConnectionProfile }
+};
+
+// the host learns that a command was not run instead of waiting for a reply
+static void commandRejected(uint16_t port, uint32_t type, CommandDispatcher::reject_t reason)
+{
+    CborMessage<CommandRejectedMessage> message;
+    sendControl(message.encode(20, port, type, reason));
 }
 
-void sendDone()
+void receivedControl(BlockStatic block)
 {
-    DEBUGOUT("sendDone\r\n");
+    uint32_t start = LatencyTrace::now();
+
+    uint32_t values[2] = { MessageCenter::ControlPort, block.getLength() };
+    TraceCapture::record(TraceCapture::RecordReceived, values, 2, block.getData(), block.getLength());
+
+    CommandDispatcher::dispatch(commands, sizeof(commands) / sizeof(CommandDispatcher::command_t),
+                                MessageCenter::ControlPort, block.getData(), block.getLength());
+
+    LatencyTrace::record(LatencyTrace::StageCommand, start);
+}
+
+void receivedRadio(BlockStatic block)
+{
+    uint32_t start = LatencyTrace::now();
+
+    uint32_t values[2] = { MessageCenter::RadioPort, block.getLength() };
+    TraceCapture::record(TraceCapture::RecordReceived, values, 2, block.getData(), block.getLength());
+
+    CommandDispatcher::dispatch(commands, sizeof(commands) / sizeof(CommandDispatcher::command_t),
+                                MessageCenter::RadioPort, block.getData(), block.getLength());
+
+    LatencyTrace::record(LatencyTrace::StageCommand, start);
 }
 
 /*****************************************************************************/
@@ -194,10 +895,10 @@ void sendDone()
 
 void updateConnectionParameters()
 {
-    DEBUGOUT("main: update connection parameters\r\n");
+    EventLog::record(EventLog::EventConnectionManaged);
 
-    // update connection to the prefered parameters
-    ble.gap().updateConnectionParams(connectionHandle, &custom);
+    // central is ready, let the manager pick parameters from now on
+    ConnectionManager::start(connectionHandle);
 }
 
 /*
@@ -205,11 +906,18 @@ void updateConnectionParameters()
 */
 void whenConnected(const Gap::ConnectionCallbackParams_t* params)
 {
-    DEBUGOUT("main: Connected: %d %d %d\r\n", params->connectionParams->minConnectionInterval,
-                                              params->connectionParams->maxConnectionInterval,
-                                              params->connectionParams->slaveLatency);
-
-    Cbore cbor(block.getData(), block.getLength());
+    EventLog::record(EventLog::EventConnected, params->connectionParams->minConnectionInterval,
+                                               params->connectionParams->maxConnectionInterval,
+                                               params->connectionParams->slaveLatency);
+
+    uint32_t values[7] = { params->handle,
+                           params->role,
+                           params->peerAddrType,
+                           params->connectionParams->minConnectionInterval,
+                           params->connectionParams->maxConnectionInterval,
+                           params->connectionParams->slaveLatency,
+                           params->connectionParams->connectionSupervisionTimeout };
+    TraceCapture::record(TraceCapture::RecordConnected, values, 7, params->peerAddr, 6);
 
     // connected as peripheral to a central
     if (params->role == Gap::PERIPHERAL)
@@ -217,45 +925,56 @@ void whenConnected(const Gap::ConnectionCallbackParams_t* params)
         // store connection handle
         connectionHandle = params->handle;
 
-        // construct "on connection peripheral" cbor object
-        cbor.array(2)
-            .item(1)
-            .item(1);
+        AdvertisingManager::setConnected();
+
+        // send "on connection peripheral" event
+        CborMessage<ConnectionEventMessage> message;
+        sendControl(message.encode(1, 1));
     }
+    // connected as central to a sensor
+    else if (params->role == Gap::CENTRAL)
+    {
+        peripheralHandle = params->handle;
+        peripheralIsConnected = true;
 
-    block.setLength(cbor.getLength());
-    MessageCenter::sendTask(MessageCenter::RemoteHost,
-                            MessageCenter::ControlPort,
-                            block,
-                            sendDone);
+        // send "on connection central" event
+        CborMessage<ConnectionEventMessage> message;
+        sendControl(message.encode(1, 3));
+    }
 }
 
 void whenDisconnected(const Gap::DisconnectionCallbackParams_t* params)
 {
-    DEBUGOUT("main: Disconnected!\r\n");
+    EventLog::record(EventLog::EventDisconnected, params->reason);
+    TraceCapture::record(TraceCapture::RecordDisconnected, params->handle, params->reason);
 
-    Cbore cbor(block.getData(), block.getLength());
+    // disconnected from sensor
+    if (peripheralIsConnected && (params->handle == peripheralHandle))
+    {
+        peripheralIsConnected = false;
 
+        // send "disconnected as central" event
+        CborMessage<ConnectionEventMessage> message;
+        sendControl(message.encode(1, 4));
+    }
     // disconnected from central
-    if (params->handle == connectionHandle)
+    else if (params->handle == connectionHandle)
     {
         // clear handle
         connectionHandle = 0;
 
         // begin advertising again
-        slowBeaconing();
+        AdvertisingManager::setDisconnected();
 
-        // construct "disconnected as peripheral" cbor
-        cbor.array(2)
-            .item(1)
-            .item(2);
-    }
+        if (radioIsEnabled)
+        {
+            AdvertisingManager::startSlow();
+        }
 
-    block.setLength(cbor.getLength());
-    MessageCenter::sendTask(MessageCenter::RemoteHost,
-                            MessageCenter::ControlPort,
-                            block,
-                            sendDone);
+        // send "disconnected as peripheral" event
+        CborMessage<ConnectionEventMessage> message;
+        sendControl(message.encode(1, 2));
+    }
 }
 
 
@@ -266,34 +985,17 @@ void whenDisconnected(const Gap::DisconnectionCallbackParams_t* params)
 
 void updateAdvertisement()
 {
-    ble.gap().stopAdvertising();
+    // only bytes that differ from the current payload reach the stack
+    AdvertisingBuilder::setSolicitation(ancsIsEnabled);
+    AdvertisingBuilder::setTxPower(txPowerLevel);
+    AdvertisingBuilder::setName(deviceName, deviceNameLength);
+    AdvertisingBuilder::apply();
 
-    // clear advertisement beacon
-    ble.gap().clearAdvertisingPayload();
-
-    // construct advertising beacon
-    ble.gap().setAdvertisingType(GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED);
-
-    ble.gap().accumulateAdvertisingPayload(GapAdvertisingData::BREDR_NOT_SUPPORTED|GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
-
-    if (ancsIsEnabled)
+    // ble setup complete - start advertising
+    if (radioIsEnabled && (AdvertisingManager::getState() == AdvertisingManager::StateOff))
     {
-        ble.gap().accumulateAdvertisingPayload(GapAdvertisingData::LIST_128BIT_SOLICITATION_IDS, ANCS::UUID.getBaseUUID(), ANCS::UUID.getLen());
+        AdvertisingManager::startSlow();
     }
-
-    /*************************************************************************/
-
-    // clear scan response
-    ble.gap().clearScanResponse();
-
-    // set Tx power level
-    ble.gap().accumulateScanResponse(GapAdvertisingData::TX_POWER_LEVEL, &txPowerLevel, 1);
-
-    // set name
-    ble.gap().accumulateScanResponse(GapAdvertisingData::COMPLETE_LOCAL_NAME, (uint8_t*) deviceNameString.c_str(), deviceNameString.length());
-
-    // ble setup complete - start advertising
-    slowBeaconing();
 }
 
 static void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
@@ -302,17 +1004,28 @@ static void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
 
     MessageCenter::addTransportTask(MessageCenter::RemoteHost, &transport);
 
-    MessageCenter::addListenerTask(MessageCenter::LocalHost,
-                                   MessageCenter::ControlPort,
-                                   receivedControl);
+    // messages for these ports may also arrive inside a batch
+    MessageBatcher::init();
+
+    MessageBatcher::addListener(MessageCenter::ControlPort,
+                                receivedControl);
+
+    MessageBatcher::addListener(MessageCenter::RadioPort,
+                                receivedRadio);
+
+    MessageQueue::addPort(MessageCenter::ControlPort, MessageQueue::PriorityControl);
 
-    MessageCenter::addListenerTask(MessageCenter::LocalHost,
-                                   MessageCenter::RadioPort,
-                                   receivedRadio);
+    CommandDispatcher::setRejectHandler(commandRejected);
 
     /*************************************************************************/
 
-    ANCSManager::init();
+    ANCSManager::init(&handleStorage);
+
+    Scanner::init();
+
+    ConnectionManager::init();
+
+    AdvertisingManager::init();
 
     /*************************************************************************/
 
@@ -323,28 +1036,36 @@ static void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
     // set TX power
     ble.gap().setTxPower(CFG_BLE_TX_POWER_LEVEL);
 
+    ble.gap().setAdvertisingType(GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED);
+
     // set device name
-    deviceNameString = DEVICE_NAME;
-    BLE::Instance().gap().setDeviceName((const uint8_t*) deviceNameString.c_str());
+    BLE::Instance().gap().setDeviceName((const uint8_t*) deviceName);
 
     updateAdvertisement();
 
+    // from here on every buffer must come from static memory
+    MemoryMonitor::seal();
+
     DEBUGOUT("Watch BLE Test: %s %s\r\n", __DATE__, __TIME__);
 }
 
 void feedWatchDog()
 {
-    DEBUGOUT("feed\r\n");
+    EventLog::record(EventLog::EventWatchdogFed);
 
     watchdog::feed();
 }
 
 void app_start(int, char *[])
 {
-    watchdog::enable(20000);
+    MemoryMonitor::paintStack();
+
+    EventLog::init();
+    EventLog::record(EventLog::EventBoot);
+
+    watchdog::enable(WATCHDOG_TIMEOUT_MS);
 
-    minar::Scheduler::postCallback(feedWatchDog)
-        .period(minar::milliseconds(10000));
+    TimerService::start(feedWatchDog, WATCHDOG_FEED_MS, WATCHDOG_FEED_SLACK_MS, WATCHDOG_FEED_MS);
 
     /*************************************************************************/
     /*************************************************************************/
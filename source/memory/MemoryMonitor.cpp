@@ -0,0 +1,172 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+
+#include "MemoryMonitor.h"
+#include "../log/EventLog.h"
+#include "../log/TraceCapture.h"
+
+#include <stdlib.h>
+
+// fill pattern for unused stack
+#define STACK_PAINT 0xC5C5C5C5
+
+// words below the stack pointer left alone while painting
+#define STACK_PAINT_MARGIN 16
+
+#if defined(TOOLCHAIN_GCC_ARM)
+// stack bounds from the linker script
+extern uint32_t __StackLimit;
+extern uint32_t __StackTop;
+
+#define STACK_BOUNDS 1
+#else
+#define STACK_BOUNDS 0
+#endif
+
+static MemoryMonitor::statistics_t statistics = { 0, 0, 0 };
+static bool sealed = false;
+static uint8_t allowances = 0;
+
+/*****************************************************************************/
+
+#if MEMORY_HEAP_FREE
+static void heapCall(uint32_t size)
+{
+    if (!sealed)
+    {
+        return;
+    }
+
+    statistics.heapCalls++;
+
+    EventLog::record(EventLog::EventHeapCall, size);
+    TraceCapture::record(TraceCapture::RecordHeapCall, &size, 1);
+
+#if MEMORY_HEAP_TRAP
+    if (allowances == 0)
+    {
+        error("heap call after init: %lu bytes\r\n", size);
+    }
+#endif
+}
+
+static void* allocate(size_t size)
+{
+    heapCall(size);
+
+    // new of 0 bytes must still return a unique pointer
+    void* pointer = malloc((size > 0) ? size : 1);
+
+    if (pointer == NULL)
+    {
+        error("out of memory: %lu bytes\r\n", (uint32_t) size);
+    }
+
+    return pointer;
+}
+
+static void release(void* pointer)
+{
+    if (pointer)
+    {
+        // releases are reported with size 0
+        heapCall(0);
+        free(pointer);
+    }
+}
+
+/*****************************************************************************/
+/* Global allocation                                                         */
+/*****************************************************************************/
+
+void* operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void* pointer)
+{
+    release(pointer);
+}
+
+void operator delete[](void* pointer)
+{
+    release(pointer);
+}
+#endif // MEMORY_HEAP_FREE
+
+/*****************************************************************************/
+/* Memory Monitor                                                            */
+/*****************************************************************************/
+
+void MemoryMonitor::paintStack()
+{
+#if STACK_BOUNDS
+    uint32_t* word = &__StackLimit;
+    uint32_t* end = (uint32_t*) __get_MSP() - STACK_PAINT_MARGIN;
+
+    while (word < end)
+    {
+        *word++ = STACK_PAINT;
+    }
+
+    statistics.stackSize = (&__StackTop - &__StackLimit) * sizeof(uint32_t);
+#endif
+}
+
+void MemoryMonitor::seal()
+{
+    sealed = true;
+}
+
+bool MemoryMonitor::isSealed()
+{
+    return sealed;
+}
+
+const MemoryMonitor::statistics_t& MemoryMonitor::getStatistics()
+{
+#if STACK_BOUNDS
+    // the stack grows down, the lowest overwritten word is the deepest
+    const uint32_t* word = &__StackLimit;
+
+    while ((word < &__StackTop) && (*word == STACK_PAINT))
+    {
+        word++;
+    }
+
+    statistics.stackUsed = (&__StackTop - word) * sizeof(uint32_t);
+#endif
+
+    return statistics;
+}
+
+MemoryMonitor::Allowance::Allowance()
+{
+    allowances++;
+}
+
+MemoryMonitor::Allowance::~Allowance()
+{
+    allowances--;
+}
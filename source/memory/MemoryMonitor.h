@@ -0,0 +1,85 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MEMORY_MONITOR_H__
+#define __MEMORY_MONITOR_H__
+
+#include <stdint.h>
+
+// keep the heap out of steady-state paths; buffers come from static memory
+#ifndef MEMORY_HEAP_FREE
+#define MEMORY_HEAP_FREE 1
+#endif
+
+// stop on the first heap call after seal() instead of only counting it;
+// on in debug builds, yotta defines NDEBUG for release builds
+#ifndef MEMORY_HEAP_TRAP
+#if MEMORY_HEAP_FREE && !defined(NDEBUG)
+#define MEMORY_HEAP_TRAP 1
+#else
+#define MEMORY_HEAP_TRAP 0
+#endif
+#endif
+
+#if MEMORY_HEAP_TRAP && !MEMORY_HEAP_FREE
+#error "MEMORY_HEAP_TRAP needs MEMORY_HEAP_FREE"
+#endif
+
+/*
+    Heap and stack usage for sizing static pools from field data.
+
+    seal() marks the end of initialisation. With MEMORY_HEAP_FREE every
+    C++ allocation or release after it is counted and, with
+    MEMORY_HEAP_TRAP, halts in error() so the debugger shows the caller.
+    Calls into libraries that are known to allocate, such as
+    MessageCenter::sendTask, are wrapped in an Allowance: their heap
+    calls are still counted and logged but do not trap. C malloc calls
+    are not seen.
+
+    The free part of the stack is painted at boot and the deepest
+    overwritten word gives the most stack ever used.
+*/
+namespace MemoryMonitor
+{
+    typedef struct {
+        uint32_t heapCalls;             // after seal()
+        uint32_t stackUsed;             // bytes, most ever
+        uint32_t stackSize;             // 0 if the stack bounds are unknown
+    } statistics_t;
+
+    /*
+        Call first thing at boot, before the stack gets deep.
+    */
+    void paintStack();
+
+    void seal();
+    bool isSealed();
+
+    const statistics_t& getStatistics();
+
+    /*
+        Heap calls while an Allowance is in scope do not trap. Allowances
+        nest.
+    */
+    class Allowance
+    {
+    public:
+        Allowance();
+        ~Allowance();
+    };
+}
+
+#endif // __MEMORY_MONITOR_H__
@@ -0,0 +1,138 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CommandDispatcher.h"
+#include "../cbor/CborReader.h"
+#include "../log/EventLog.h"
+
+#include <string.h>
+
+static CommandDispatcher::statistics_t statistics = { 0, 0, 0 };
+static CommandDispatcher::reject_handler_t rejectHandler = NULL;
+
+static void reject(uint16_t port, uint32_t type, uint32_t length, CommandDispatcher::reject_t reason)
+{
+    EventLog::record(EventLog::EventCommandRejected, port, length);
+
+    if (rejectHandler)
+    {
+        rejectHandler(port, type, reason);
+    }
+}
+
+/*****************************************************************************/
+/* Command Dispatcher                                                        */
+/*****************************************************************************/
+
+bool CommandDispatcher::dispatch(const command_t* table, uint8_t count,
+                                 uint16_t port, const uint8_t* data, uint32_t length)
+{
+    CborReader cbor(data, length);
+
+    uint32_t items = 0;
+    uint32_t type = 0;
+
+    if (!cbor.readArray(&items) || (items == 0) || !cbor.readUnsigned(&type))
+    {
+        statistics.malformed++;
+        reject(port, 0, length, RejectMalformed);
+
+        return false;
+    }
+
+    const command_t* command = NULL;
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if ((table[idx].port == port) && (table[idx].type == type))
+        {
+            command = &table[idx];
+            break;
+        }
+    }
+
+    if (command == NULL)
+    {
+        statistics.unknown++;
+        reject(port, type, length, RejectUnknown);
+
+        return false;
+    }
+
+    argument_t argument;
+    memset(&argument, 0, sizeof(argument_t));
+
+    bool valid = true;
+
+    if (command->argumentType != ArgumentNone)
+    {
+        valid = (items >= 2);
+    }
+
+    if (valid)
+    {
+        switch (command->argumentType)
+        {
+            case ArgumentUnsigned:
+                valid = cbor.readUnsigned(&argument.value);
+                break;
+            case ArgumentInteger:
+                valid = cbor.readInteger(&argument.integer);
+                break;
+            case ArgumentText:
+                valid = cbor.readText(&argument.text, &argument.length);
+                break;
+            case ArgumentBytes:
+                valid = cbor.readBytes(&argument.bytes, &argument.length);
+                break;
+            case ArgumentList:
+                argument.length = (items - 1 > MaxValues) ? MaxValues : items - 1;
+
+                for (uint32_t idx = 0; valid && (idx < argument.length); idx++)
+                {
+                    valid = cbor.readUnsigned(&argument.values[idx]);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!valid)
+    {
+        statistics.malformed++;
+        reject(port, type, length, RejectMalformed);
+
+        return false;
+    }
+
+    EventLog::record(EventLog::EventCommand, port, type, length);
+
+    statistics.dispatched++;
+    command->handler(argument);
+
+    return true;
+}
+
+void CommandDispatcher::setRejectHandler(reject_handler_t handler)
+{
+    rejectHandler = handler;
+}
+
+const CommandDispatcher::statistics_t& CommandDispatcher::getStatistics()
+{
+    return statistics;
+}
@@ -0,0 +1,87 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __COMMAND_DISPATCHER_H__
+#define __COMMAND_DISPATCHER_H__
+
+#include <stdint.h>
+
+/*
+    Commands are cbor arrays: [type, argument]. The message is decoded in a
+    single pass; the type selects an entry from a constant table keyed by
+    (port, type), and the entry says how the argument is decoded before
+    its handler is called. Extra items after the argument are ignored.
+    An ArgumentList takes the remaining items instead, as unsigned values,
+    up to MaxValues of them: [type, value, value, ...].
+*/
+namespace CommandDispatcher
+{
+    const uint8_t MaxValues = 5;
+
+    typedef enum {
+        ArgumentNone,
+        ArgumentUnsigned,
+        ArgumentInteger,
+        ArgumentText,
+        ArgumentBytes,
+        ArgumentList
+    } argument_type_t;
+
+    typedef struct {
+        uint32_t value;                 // ArgumentUnsigned
+        int32_t integer;                // ArgumentInteger
+        const char* text;               // ArgumentText, points into message
+        const uint8_t* bytes;           // ArgumentBytes, points into message
+        uint32_t length;
+        uint32_t values[MaxValues];     // ArgumentList, length items
+    } argument_t;
+
+    typedef void (*handler_t)(const argument_t& argument);
+
+    typedef struct {
+        uint16_t port;
+        uint8_t type;
+        argument_type_t argumentType;
+        handler_t handler;
+    } command_t;
+
+    typedef struct {
+        uint32_t dispatched;
+        uint32_t unknown;
+        uint32_t malformed;
+    } statistics_t;
+
+    typedef enum {
+        RejectUnknown   = 1,
+        RejectMalformed = 2
+    } reject_t;
+
+    // type is 0 when the message is too malformed to carry one
+    typedef void (*reject_handler_t)(uint16_t port, uint32_t type, reject_t reason);
+
+    /*
+        Returns false if the message is malformed or has no table entry;
+        the reject handler, if any, is called first.
+    */
+    bool dispatch(const command_t* table, uint8_t count,
+                  uint16_t port, const uint8_t* data, uint32_t length);
+
+    void setRejectHandler(reject_handler_t handler);
+
+    const statistics_t& getStatistics();
+}
+
+#endif // __COMMAND_DISPATCHER_H__
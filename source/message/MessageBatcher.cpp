@@ -0,0 +1,335 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+
+#include "MessageBatcher.h"
+#include "../cbor/CborWriter.h"
+#include "../cbor/CborReader.h"
+#include "../memory/MemoryMonitor.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+// set to 0 to compile batching out, the host can then never enable it
+#ifndef MESSAGE_BATCHING
+#define MESSAGE_BATCHING 1
+#endif
+
+// how long the first message in a batch may wait
+#ifndef MESSAGE_BATCH_WINDOW_MS
+#define MESSAGE_BATCH_WINDOW_MS 20
+#endif
+
+// byte budget for one transfer
+#ifndef MESSAGE_BATCH_LENGTH
+#define MESSAGE_BATCH_LENGTH 400
+#endif
+
+// keeps the array header at a single byte
+#define MESSAGE_BATCH_MAX 23
+
+#define MAX_LISTENERS 4
+
+typedef enum {
+    BufferFree,
+    BufferFilling,
+    BufferSending
+} buffer_state_t;
+
+typedef struct {
+    uint8_t data[MESSAGE_BATCH_LENGTH];
+    BlockStatic block;
+    buffer_state_t state;
+    uint32_t used;
+    uint8_t count;
+} batch_t;
+
+typedef struct {
+    uint16_t port;
+    MessageBatcher::listener_t listener;
+} listener_entry_t;
+
+static batch_t batches[2];
+static int8_t filling = -1;
+static minar::callback_handle_t windowHandle = NULL;
+
+// hosts that do not know BatchPort must see every message on its own port
+static bool enabled = false;
+
+static listener_entry_t listeners[MAX_LISTENERS];
+static uint8_t listenerCount = 0;
+
+static MessageBatcher::statistics_t statistics;
+
+static void receivedBatch(BlockStatic block);
+
+/*****************************************************************************/
+
+template <uint8_t Batch>
+static void batchSendDone()
+{
+    batches[Batch].state = BufferFree;
+}
+
+static void (* const batchSendDoneHandlers[2])(void) = {
+    batchSendDone<0>,
+    batchSendDone<1>
+};
+
+static void directSend(uint16_t port, BlockStatic& block, void (*callback)(void))
+{
+    statistics.direct++;
+    statistics.transfers++;
+
+    if (statistics.maxPerTransfer == 0)
+    {
+        statistics.maxPerTransfer = 1;
+    }
+
+    // MessageCenter queues the transfer on the heap
+    MemoryMonitor::Allowance allowance;
+
+    MessageCenter::sendTask(MessageCenter::RemoteHost,
+                            port,
+                            block,
+                            callback);
+}
+
+static void windowExpired()
+{
+    windowHandle = NULL;
+
+    MessageBatcher::flush();
+}
+
+/*****************************************************************************/
+/* Message Batcher                                                           */
+/*****************************************************************************/
+
+void MessageBatcher::init()
+{
+    memset(&statistics, 0, sizeof(statistics));
+
+    MessageCenter::addListenerTask(MessageCenter::LocalHost,
+                                   BatchPort,
+                                   receivedBatch);
+}
+
+void MessageBatcher::send(uint16_t port, BlockStatic& block, void (*callback)(void))
+{
+    statistics.messages++;
+
+#if MESSAGE_BATCHING
+    uint32_t payloadLength = block.getLength();
+    uint32_t frameLength = 1
+                         + CborWriter::headerLength(port)
+                         + CborWriter::headerLength(payloadLength) + payloadLength;
+
+    // batching off or too large for any batch, send pending messages first
+    // to keep the order
+    if (!enabled || (1 + frameLength > MESSAGE_BATCH_LENGTH))
+    {
+        flush();
+        directSend(port, block, callback);
+        return;
+    }
+
+    // close batch if the message does not fit
+    if ((filling >= 0) &&
+        ((batches[filling].used + frameLength > MESSAGE_BATCH_LENGTH) ||
+         (batches[filling].count == MESSAGE_BATCH_MAX)))
+    {
+        flush();
+    }
+
+    // open new batch, array header is written on flush
+    if (filling < 0)
+    {
+        for (uint8_t idx = 0; idx < 2; idx++)
+        {
+            if (batches[idx].state == BufferFree)
+            {
+                filling = idx;
+                batches[idx].state = BufferFilling;
+                batches[idx].used = 1;
+                batches[idx].count = 0;
+                break;
+            }
+        }
+    }
+
+    // no buffer, message center keeps the order
+    if (filling < 0)
+    {
+        directSend(port, block, callback);
+        return;
+    }
+
+    batch_t& batch = batches[filling];
+
+    CborWriter cbor(&batch.data[batch.used], MESSAGE_BATCH_LENGTH - batch.used);
+
+    cbor.array(2)
+        .item((uint32_t) port)
+        .bytes(block.getData(), payloadLength);
+
+    batch.used += cbor.getLength();
+    batch.count++;
+
+    // message has been copied, sender can reuse its buffer
+    if (callback)
+    {
+        minar::Scheduler::postCallback(callback);
+    }
+
+    if (batch.used == MESSAGE_BATCH_LENGTH)
+    {
+        flush();
+    }
+    else if (batch.count == 1)
+    {
+        windowHandle = minar::Scheduler::postCallback(windowExpired)
+                        .delay(minar::milliseconds(MESSAGE_BATCH_WINDOW_MS))
+                        .getHandle();
+    }
+#else
+    directSend(port, block, callback);
+#endif
+}
+
+void MessageBatcher::flush()
+{
+    if (windowHandle)
+    {
+        minar::Scheduler::cancelCallback(windowHandle);
+        windowHandle = NULL;
+    }
+
+    if (filling < 0)
+    {
+        return;
+    }
+
+    uint8_t index = filling;
+    batch_t& batch = batches[index];
+
+    filling = -1;
+
+    DEBUGOUT("batch: %u messages, %lu bytes\r\n", batch.count, batch.used);
+
+    // count fits the initial byte
+    batch.data[0] = (CborWriter::TypeArray << 5) | batch.count;
+
+    batch.block = BlockStatic(batch.data, batch.used);
+    batch.state = BufferSending;
+
+    statistics.batches++;
+    statistics.transfers++;
+
+    if (batch.count > statistics.maxPerTransfer)
+    {
+        statistics.maxPerTransfer = batch.count;
+    }
+
+    MemoryMonitor::Allowance allowance;
+
+    MessageCenter::sendTask(MessageCenter::RemoteHost,
+                            BatchPort,
+                            batch.block,
+                            batchSendDoneHandlers[index]);
+}
+
+void MessageBatcher::setEnabled(bool enable)
+{
+#if MESSAGE_BATCHING
+    enabled = enable;
+#else
+    (void) enable;
+#endif
+
+    if (!enabled)
+    {
+        flush();
+    }
+}
+
+bool MessageBatcher::isEnabled()
+{
+    return enabled;
+}
+
+void MessageBatcher::addListener(uint16_t port, listener_t listener)
+{
+    MessageCenter::addListenerTask(MessageCenter::LocalHost,
+                                   port,
+                                   listener);
+
+    if (listenerCount < MAX_LISTENERS)
+    {
+        listeners[listenerCount].port = port;
+        listeners[listenerCount].listener = listener;
+        listenerCount++;
+    }
+}
+
+const MessageBatcher::statistics_t& MessageBatcher::getStatistics()
+{
+    return statistics;
+}
+
+static void receivedBatch(BlockStatic block)
+{
+    CborReader cbor(block.getData(), block.getLength());
+
+    uint32_t count = 0;
+
+    if (!cbor.readArray(&count))
+    {
+        return;
+    }
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        uint32_t pair = 0;
+        uint32_t port = 0;
+        const uint8_t* data = NULL;
+        uint32_t length = 0;
+
+        if (!cbor.readArray(&pair) || (pair != 2) ||
+            !cbor.readUnsigned(&port) ||
+            !cbor.readBytes(&data, &length))
+        {
+            DEBUGOUT("batch: malformed\r\n");
+            return;
+        }
+
+        for (uint8_t entry = 0; entry < listenerCount; entry++)
+        {
+            if (listeners[entry].port == port)
+            {
+                // message is handled in place
+                listeners[entry].listener(BlockStatic((uint8_t*) data, length));
+                break;
+            }
+        }
+    }
+}
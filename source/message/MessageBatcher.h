@@ -0,0 +1,73 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MESSAGE_BATCHER_H__
+#define __MESSAGE_BATCHER_H__
+
+#include "message-center/MessageCenter.h"
+
+/*
+    Collects outgoing messages for the remote host and sends them as one
+    SPI transfer on BatchPort once the batch window expires or the byte
+    budget is reached. A batch is a cbor array of [port, payload] pairs,
+    where payload is a byte string holding the original message.
+
+    Batching is off after init() and every message goes out on its own
+    port; the host turns it on once it knows how to unpack BatchPort.
+
+    Messages are copied into the batch buffer, so the sender's callback is
+    posted as soon as send() returns. Batches received from the host on
+    BatchPort are unpacked and each message handed to the listener for its
+    port, exactly as if it had arrived on its own.
+*/
+namespace MessageBatcher
+{
+    const uint16_t BatchPort = 0x0F;
+
+    typedef void (*listener_t)(BlockStatic block);
+
+    typedef struct {
+        uint32_t messages;              // messages sent to the remote host
+        uint32_t transfers;             // message center transfers used
+        uint32_t batches;
+        uint32_t direct;                // messages sent outside a batch
+        uint8_t maxPerTransfer;
+    } statistics_t;
+
+    void init();
+
+    void send(uint16_t port, BlockStatic& block, void (*callback)(void));
+
+    /*
+        Turning batching off sends any pending batch first.
+    */
+    void setEnabled(bool enable);
+    bool isEnabled();
+
+    /*
+        Listen on port both directly and inside received batches.
+    */
+    void addListener(uint16_t port, listener_t listener);
+
+    /*
+        Send pending messages without waiting for the batch window.
+    */
+    void flush();
+
+    const statistics_t& getStatistics();
+}
+
+#endif // __MESSAGE_BATCHER_H__
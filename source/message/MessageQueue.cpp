@@ -0,0 +1,273 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+
+#include "MessageQueue.h"
+#include "MessageBatcher.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+// number of ports with a queue
+#ifndef MESSAGE_QUEUE_PORTS
+#define MESSAGE_QUEUE_PORTS 4
+#endif
+
+// messages waiting per port
+#ifndef MESSAGE_QUEUE_DEPTH
+#define MESSAGE_QUEUE_DEPTH 4
+#endif
+
+// number of queue owned buffers
+#ifndef MESSAGE_QUEUE_BUFFERS
+#define MESSAGE_QUEUE_BUFFERS 6
+#endif
+
+#define NO_BUFFER 0xFF
+
+typedef struct {
+    BlockStatic* block;
+    void (*callback)(void);
+    minar::tick_t enqueued;
+    uint8_t buffer;
+} entry_t;
+
+typedef struct {
+    uint16_t port;
+    MessageQueue::priority_t priority;
+    entry_t entries[MESSAGE_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    MessageQueue::statistics_t statistics;
+} queue_t;
+
+static queue_t queues[MESSAGE_QUEUE_PORTS];
+static uint8_t queueCount = 0;
+
+static uint8_t bufferData[MESSAGE_QUEUE_BUFFERS][MessageQueue::BufferLength];
+static BlockStatic bufferBlocks[MESSAGE_QUEUE_BUFFERS];
+static bool bufferTaken[MESSAGE_QUEUE_BUFFERS] = { false };
+static uint8_t bufferCount = 0;
+static uint8_t bufferHighWaterMark = 0;
+
+// message handed to the batcher
+static bool inFlight = false;
+static entry_t current;
+
+static void dispatch();
+static void dispatchDone();
+
+/*****************************************************************************/
+
+static queue_t* findQueue(uint16_t port)
+{
+    for (uint8_t idx = 0; idx < queueCount; idx++)
+    {
+        if (queues[idx].port == port)
+        {
+            return &queues[idx];
+        }
+    }
+
+    return NULL;
+}
+
+static bool enqueue(queue_t* queue, BlockStatic* block, void (*callback)(void), uint8_t buffer)
+{
+    if (queue->count == MESSAGE_QUEUE_DEPTH)
+    {
+        queue->statistics.dropped++;
+        return false;
+    }
+
+    entry_t& entry = queue->entries[(queue->head + queue->count) % MESSAGE_QUEUE_DEPTH];
+
+    entry.block = block;
+    entry.callback = callback;
+    entry.enqueued = minar::Scheduler::getTime();
+    entry.buffer = buffer;
+
+    queue->count++;
+
+    if (queue->count > queue->statistics.highWaterMark)
+    {
+        queue->statistics.highWaterMark = queue->count;
+    }
+
+    dispatch();
+
+    return true;
+}
+
+/*
+    Hand the oldest message from the highest priority queue to the batcher.
+*/
+static void dispatch()
+{
+    if (inFlight)
+    {
+        return;
+    }
+
+    queue_t* next = NULL;
+
+    for (uint8_t idx = 0; idx < queueCount; idx++)
+    {
+        if ((queues[idx].count > 0) &&
+            ((next == NULL) || (queues[idx].priority < next->priority)))
+        {
+            next = &queues[idx];
+        }
+    }
+
+    if (next == NULL)
+    {
+        return;
+    }
+
+    current = next->entries[next->head];
+    next->head = (next->head + 1) % MESSAGE_QUEUE_DEPTH;
+    next->count--;
+
+    minar::tick_t waited = minar::Scheduler::getTime() - current.enqueued;
+    uint32_t waitMs = ((uint64_t) waited * 1000) / minar::milliseconds(1000);
+
+    next->statistics.sent++;
+    next->statistics.waitTotalMs += waitMs;
+
+    if (waitMs > next->statistics.waitMaxMs)
+    {
+        next->statistics.waitMaxMs = waitMs;
+    }
+
+    DEBUGOUT("queue: %02X waited %lu ms\r\n", next->port, waitMs);
+
+    inFlight = true;
+
+    MessageBatcher::send(next->port, *current.block, dispatchDone);
+}
+
+static void dispatchDone()
+{
+    inFlight = false;
+
+    if (current.buffer != NO_BUFFER)
+    {
+        bufferTaken[current.buffer] = false;
+        bufferCount--;
+    }
+
+    if (current.callback)
+    {
+        current.callback();
+    }
+
+    dispatch();
+}
+
+/*****************************************************************************/
+/* Message Queue                                                             */
+/*****************************************************************************/
+
+bool MessageQueue::addPort(uint16_t port, priority_t priority)
+{
+    if (findQueue(port))
+    {
+        return true;
+    }
+
+    if (queueCount == MESSAGE_QUEUE_PORTS)
+    {
+        return false;
+    }
+
+    queue_t& queue = queues[queueCount++];
+
+    memset(&queue, 0, sizeof(queue_t));
+    queue.port = port;
+    queue.priority = priority;
+
+    return true;
+}
+
+bool MessageQueue::send(uint16_t port, const uint8_t* data, uint32_t length)
+{
+    queue_t* queue = findQueue(port);
+
+    if ((queue == NULL) || (length > BufferLength))
+    {
+        return false;
+    }
+
+    for (uint8_t idx = 0; idx < MESSAGE_QUEUE_BUFFERS; idx++)
+    {
+        if (!bufferTaken[idx])
+        {
+            memcpy(bufferData[idx], data, length);
+            bufferBlocks[idx] = BlockStatic(bufferData[idx], length);
+            bufferTaken[idx] = true;
+            bufferCount++;
+
+            if (bufferCount > bufferHighWaterMark)
+            {
+                bufferHighWaterMark = bufferCount;
+            }
+
+            if (!enqueue(queue, &bufferBlocks[idx], NULL, idx))
+            {
+                bufferTaken[idx] = false;
+                bufferCount--;
+                return false;
+            }
+
+            return true;
+        }
+    }
+
+    queue->statistics.dropped++;
+
+    return false;
+}
+
+bool MessageQueue::send(uint16_t port, BlockStatic& block, void (*callback)(void))
+{
+    queue_t* queue = findQueue(port);
+
+    if (queue == NULL)
+    {
+        return false;
+    }
+
+    return enqueue(queue, &block, callback, NO_BUFFER);
+}
+
+const MessageQueue::statistics_t* MessageQueue::getStatistics(uint16_t port)
+{
+    queue_t* queue = findQueue(port);
+
+    return (queue) ? &queue->statistics : NULL;
+}
+
+uint8_t MessageQueue::getBufferHighWaterMark()
+{
+    return bufferHighWaterMark;
+}
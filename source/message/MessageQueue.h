@@ -0,0 +1,81 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MESSAGE_QUEUE_H__
+#define __MESSAGE_QUEUE_H__
+
+#include "message-center/MessageCenter.h"
+
+// size of queue owned buffers, shared by all ports
+#ifndef MESSAGE_QUEUE_BUFFER_LENGTH
+#define MESSAGE_QUEUE_BUFFER_LENGTH 32
+#endif
+
+/*
+    Outgoing dispatcher in front of the message batcher. Every port has its
+    own bounded queue and only one message is handed on at a time, so a
+    control event waits for at most one message regardless of how many
+    alerts are queued behind it. Queues are served in strict priority
+    order; ports with equal priority are served in registration order.
+
+    Messages are either copied into a buffer owned by the queue, or refer
+    to a caller buffer that must stay untouched until the callback.
+*/
+namespace MessageQueue
+{
+    const uint32_t BufferLength = MESSAGE_QUEUE_BUFFER_LENGTH;
+
+    typedef enum {
+        PriorityControl = 0,
+        PriorityRadio   = 1,
+        PriorityAlert   = 2
+    } priority_t;
+
+    typedef struct {
+        uint32_t sent;
+        uint32_t dropped;
+        uint32_t waitTotalMs;           // queue wait summed over sent messages
+        uint32_t waitMaxMs;
+        uint8_t highWaterMark;
+    } statistics_t;
+
+    /*
+        Register a queue for port. Returns false when all queues are taken.
+    */
+    bool addPort(uint16_t port, priority_t priority);
+
+    /*
+        Copy message into a queue owned buffer.
+        Returns false when the queue or the buffer pool is full.
+    */
+    bool send(uint16_t port, const uint8_t* data, uint32_t length);
+
+    /*
+        Queue caller buffer, callback is called once it may be reused.
+        Returns false when the queue is full; callback is not called.
+    */
+    bool send(uint16_t port, BlockStatic& block, void (*callback)(void));
+
+    /*
+        Returns NULL for ports without a queue.
+    */
+    const statistics_t* getStatistics(uint16_t port);
+
+    // most queue owned buffers taken at once, of MESSAGE_QUEUE_BUFFERS
+    uint8_t getBufferHighWaterMark();
+}
+
+#endif // __MESSAGE_QUEUE_H__
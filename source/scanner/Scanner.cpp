@@ -0,0 +1,570 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+
+#include "message-center/MessageCenter.h"
+#include "../message/MessageQueue.h"
+
+#include "Scanner.h"
+#include "../AdvertisingParsing.h"
+#include "../cbor/CborSchema.h"
+#include "../timer/TimerService.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+// number of devices tracked, must be a power of two
+#ifndef SCANNER_TABLE_SIZE
+#define SCANNER_TABLE_SIZE 16
+#endif
+
+// scan interval and window in milliseconds
+#ifndef SCANNER_INTERVAL_MS
+#define SCANNER_INTERVAL_MS 200
+#endif
+
+#ifndef SCANNER_WINDOW_MS
+#define SCANNER_WINDOW_MS 50
+#endif
+
+// change in averaged RSSI (dB) before the host is told
+#ifndef SCANNER_RSSI_THRESHOLD
+#define SCANNER_RSSI_THRESHOLD 4
+#endif
+
+// device is reported lost when not seen for this long
+#ifndef SCANNER_EXPIRY_MS
+#define SCANNER_EXPIRY_MS 10000
+#endif
+
+// how often pending changes are sent to the host
+#ifndef SCANNER_BATCH_MS
+#define SCANNER_BATCH_MS 1000
+#endif
+
+// a batch may wait this long to share a wakeup
+#ifndef SCANNER_BATCH_SLACK_MS
+#define SCANNER_BATCH_SLACK_MS 1000
+#endif
+
+// maximum number of changes in one message
+#ifndef SCANNER_BATCH_MAX
+#define SCANNER_BATCH_MAX 8
+#endif
+
+#define SCANNER_NAME_MAX 16
+
+// RSSI average is kept in 1/16 dB, new samples weighted 1/4
+#define RSSI_FRACTION_BITS 4
+#define RSSI_SMOOTHING_SHIFT 2
+
+// RSSI is negative and a negative left shift is undefined, so scale instead
+#define RSSI_FIXED(rssi) ((int16_t) ((rssi) * (1 << RSSI_FRACTION_BITS)))
+
+// [[event, address, rssi, name], ...]
+typedef CborSchema::Array<CborSchema::Unsigned<Scanner::EventLost>,
+                          CborSchema::Bytes<Gap::ADDR_LEN>,
+                          CborSchema::Integer<-128, 127>,
+                          CborSchema::Text<SCANNER_NAME_MAX> > BatchEntry;
+
+typedef CborSchema::List<BatchEntry, SCANNER_BATCH_MAX> BatchMessage;
+
+#if (SCANNER_TABLE_SIZE & (SCANNER_TABLE_SIZE - 1)) != 0
+#error "SCANNER_TABLE_SIZE must be a power of two"
+#endif
+
+typedef enum {
+    EntryEmpty,
+    EntryUsed,
+    EntryDeleted
+} entry_state_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t pending;                // event_t not yet sent to host, or 0
+    uint8_t nameLength;
+    Gap::Address_t address;
+    int8_t rssiReported;
+    int16_t rssiAverage;
+    minar::tick_t lastSeen;
+    char name[SCANNER_NAME_MAX];
+} device_t;
+
+static device_t devices[SCANNER_TABLE_SIZE];
+
+// reported devices evicted from the full table, their Lost is still due
+typedef struct {
+    Gap::Address_t address;
+    int8_t rssi;
+} evicted_t;
+
+static evicted_t evicted[SCANNER_BATCH_MAX];
+static uint8_t evictedCount = 0;
+
+static UUIDFilterSet<8> uuidFilters;
+static char nameFilter[SCANNER_NAME_MAX];
+static uint8_t nameFilterLength = 0;
+
+static bool scanning = false;
+static TimerService::handle_t batchTimer = TimerService::NoHandle;
+
+static CborMessage<BatchMessage> batchMessage;
+static bool batchInFlight = false;
+
+static Scanner::statistics_t statistics;
+
+static void onAdvertisement(const Gap::AdvertisementCallbackParams_t* params);
+static void sendBatch(void);
+static void sendBatchDone(void);
+
+/*****************************************************************************/
+/* Device table                                                              */
+/*****************************************************************************/
+
+static uint8_t hashAddress(const Gap::Address_t address)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+
+    for (uint8_t idx = 0; idx < Gap::ADDR_LEN; idx++)
+    {
+        hash = (hash ^ address[idx]) * 16777619UL;
+    }
+
+    return hash & (SCANNER_TABLE_SIZE - 1);
+}
+
+static device_t* findDevice(const Gap::Address_t address)
+{
+    uint8_t slot = hashAddress(address);
+
+    for (uint8_t probe = 0; probe < SCANNER_TABLE_SIZE; probe++)
+    {
+        device_t* device = &devices[(slot + probe) & (SCANNER_TABLE_SIZE - 1)];
+
+        if (device->state == EntryEmpty)
+        {
+            return NULL;
+        }
+
+        if ((device->state == EntryUsed) &&
+            (memcmp(device->address, address, Gap::ADDR_LEN) == 0))
+        {
+            return device;
+        }
+    }
+
+    return NULL;
+}
+
+static device_t* probeFreeSlot(const Gap::Address_t address)
+{
+    uint8_t slot = hashAddress(address);
+
+    for (uint8_t probe = 0; probe < SCANNER_TABLE_SIZE; probe++)
+    {
+        device_t* device = &devices[(slot + probe) & (SCANNER_TABLE_SIZE - 1)];
+
+        if (device->state != EntryUsed)
+        {
+            return device;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Returns NULL when the table is full and the Lost events of earlier
+    evictions have not been sent yet.
+*/
+static device_t* insertDevice(const Gap::Address_t address)
+{
+    device_t* device = probeFreeSlot(address);
+
+    if (device)
+    {
+        return device;
+    }
+
+    // table is full, forget the device seen least recently
+    minar::tick_t now = minar::Scheduler::getTime();
+    device_t* oldest = &devices[0];
+
+    for (uint8_t idx = 1; idx < SCANNER_TABLE_SIZE; idx++)
+    {
+        if ((now - devices[idx].lastSeen) > (now - oldest->lastSeen))
+        {
+            oldest = &devices[idx];
+        }
+    }
+
+    // a device the host has not heard of can go quietly, others are lost
+    if (oldest->pending != Scanner::EventFound)
+    {
+        if (evictedCount == SCANNER_BATCH_MAX)
+        {
+            return NULL;
+        }
+
+        memcpy(evicted[evictedCount].address, oldest->address, Gap::ADDR_LEN);
+        evicted[evictedCount].rssi = oldest->rssiAverage >> RSSI_FRACTION_BITS;
+        evictedCount++;
+    }
+
+    oldest->state = EntryDeleted;
+    statistics.evictions++;
+
+    return probeFreeSlot(address);
+}
+
+/*
+    Drop the Lost of an evicted device that is back. Returns false if
+    there was none.
+*/
+static bool cancelEvicted(const Gap::Address_t address)
+{
+    for (uint8_t idx = 0; idx < evictedCount; idx++)
+    {
+        if (memcmp(evicted[idx].address, address, Gap::ADDR_LEN) == 0)
+        {
+            evictedCount--;
+            memmove(&evicted[idx], &evicted[idx + 1], (evictedCount - idx) * sizeof(evicted_t));
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool matchesFilters(const AdvertisementIndex& index,
+                           const Gap::AdvertisementCallbackParams_t* params)
+{
+    if ((nameFilterLength == 0) && (uuidFilters.size() == 0))
+    {
+        return true;
+    }
+
+    const char* name;
+    uint8_t nameLength;
+
+    if ((nameFilterLength > 0) &&
+        index.getName(&name, &nameLength) &&
+        (nameLength >= nameFilterLength) &&
+        (memcmp(name, nameFilter, nameFilterLength) == 0))
+    {
+        return true;
+    }
+
+    return (uuidFilters.size() > 0) && (uuidFilters.match(params) != 0);
+}
+
+/*****************************************************************************/
+/* Scanner                                                                   */
+/*****************************************************************************/
+
+void Scanner::init()
+{
+    memset(devices, 0, sizeof(devices));
+    memset(&statistics, 0, sizeof(statistics));
+
+    BLE::Instance().gap().setScanParams(SCANNER_INTERVAL_MS, SCANNER_WINDOW_MS, 0, true);
+
+    MessageQueue::addPort(Scanner::ScannerPort, MessageQueue::PriorityRadio);
+}
+
+void Scanner::start()
+{
+    if (scanning)
+    {
+        return;
+    }
+
+    DEBUGOUT("scanner: start\r\n");
+
+    if (BLE::Instance().gap().startScan(onAdvertisement) == BLE_ERROR_NONE)
+    {
+        scanning = true;
+
+        batchTimer = TimerService::start(sendBatch, SCANNER_BATCH_MS, SCANNER_BATCH_SLACK_MS, SCANNER_BATCH_MS);
+    }
+}
+
+void Scanner::stop()
+{
+    if (!scanning)
+    {
+        return;
+    }
+
+    DEBUGOUT("scanner: stop\r\n");
+
+    BLE::Instance().gap().stopScan();
+    scanning = false;
+
+    TimerService::stop(batchTimer);
+    batchTimer = TimerService::NoHandle;
+
+    // devices are found again on the next scan
+    memset(devices, 0, sizeof(devices));
+    evictedCount = 0;
+}
+
+bool Scanner::isScanning()
+{
+    return scanning;
+}
+
+void Scanner::setNameFilter(const char* prefix, uint8_t length)
+{
+    nameFilterLength = (length > SCANNER_NAME_MAX) ? SCANNER_NAME_MAX : length;
+    memcpy(nameFilter, prefix, nameFilterLength);
+}
+
+bool Scanner::addUUIDFilter(const UUID& uuid)
+{
+    return (uuidFilters.add(uuid) >= 0);
+}
+
+void Scanner::clearFilters()
+{
+    nameFilterLength = 0;
+    uuidFilters.clear();
+}
+
+bool Scanner::connect(const Gap::Address_t address, BLEProtocol::AddressType_t addressType)
+{
+    if (findDevice(address) == NULL)
+    {
+        return false;
+    }
+
+    DEBUGOUT("scanner: connect\r\n");
+
+    // stop() clears the table the address may point into
+    Gap::Address_t peer;
+    memcpy(peer, address, Gap::ADDR_LEN);
+
+    stop();
+
+    return (BLE::Instance().gap().connect(peer, addressType, NULL, NULL) == BLE_ERROR_NONE);
+}
+
+const Scanner::statistics_t& Scanner::getStatistics()
+{
+    return statistics;
+}
+
+static void onAdvertisement(const Gap::AdvertisementCallbackParams_t* params)
+{
+    statistics.reports++;
+
+    AdvertisementIndex index(params);
+
+    const char* name = NULL;
+    uint8_t nameLength = 0;
+    bool hasName = index.getName(&name, &nameLength);
+
+    if (nameLength > SCANNER_NAME_MAX)
+    {
+        nameLength = SCANNER_NAME_MAX;
+    }
+
+    device_t* device = findDevice(params->peerAddr);
+
+    if (device)
+    {
+        // smooth RSSI with an exponential moving average
+        device->rssiAverage += (RSSI_FIXED(params->rssi) - device->rssiAverage) >> RSSI_SMOOTHING_SHIFT;
+        device->lastSeen = minar::Scheduler::getTime();
+
+        int8_t rssi = device->rssiAverage >> RSSI_FRACTION_BITS;
+        int8_t change = rssi - device->rssiReported;
+
+        // back before its Lost was queued, the host never heard it was gone
+        if (device->pending == Scanner::EventLost)
+        {
+            device->pending = 0;
+        }
+
+        bool nameChanged = hasName &&
+                           ((nameLength != device->nameLength) ||
+                            (memcmp(name, device->name, nameLength) != 0));
+
+        if (nameChanged)
+        {
+            memcpy(device->name, name, nameLength);
+            device->nameLength = nameLength;
+        }
+
+        if ((device->pending == 0) &&
+            (nameChanged || (change >= SCANNER_RSSI_THRESHOLD) || (change <= -SCANNER_RSSI_THRESHOLD)))
+        {
+            device->pending = Scanner::EventUpdated;
+        }
+        else
+        {
+            statistics.duplicates++;
+        }
+
+        return;
+    }
+
+    if (!matchesFilters(index, params))
+    {
+        statistics.filtered++;
+        return;
+    }
+
+    device = insertDevice(params->peerAddr);
+
+    // no room until pending Lost events are sent, the device is found later
+    if (device == NULL)
+    {
+        statistics.filtered++;
+        return;
+    }
+
+    memcpy(device->address, params->peerAddr, Gap::ADDR_LEN);
+    device->state = EntryUsed;
+
+    // the host still knows an evicted device whose Lost was not sent
+    device->pending = (cancelEvicted(params->peerAddr)) ? Scanner::EventUpdated : Scanner::EventFound;
+    device->rssiAverage = RSSI_FIXED(params->rssi);
+    device->rssiReported = params->rssi;
+    device->lastSeen = minar::Scheduler::getTime();
+    device->nameLength = hasName ? nameLength : 0;
+
+    if (hasName)
+    {
+        memcpy(device->name, name, nameLength);
+    }
+}
+
+/*****************************************************************************/
+/* Message Center                                                            */
+/*****************************************************************************/
+
+static void sendBatch()
+{
+    minar::tick_t now = minar::Scheduler::getTime();
+    uint8_t count = evictedCount;
+
+    for (uint8_t idx = 0; idx < SCANNER_TABLE_SIZE; idx++)
+    {
+        device_t* device = &devices[idx];
+
+        if ((device->state == EntryUsed) &&
+            ((now - device->lastSeen) > minar::milliseconds(SCANNER_EXPIRY_MS)))
+        {
+            device->pending = Scanner::EventLost;
+        }
+
+        if ((device->state == EntryUsed) && (device->pending != 0))
+        {
+            count++;
+        }
+    }
+
+    // try again on the next period
+    if ((count == 0) || batchInFlight)
+    {
+        return;
+    }
+
+    CborWriter cbor = batchMessage.writer();
+    count = BatchMessage::begin(cbor, count);
+
+    // evicted devices go first, they have no name left
+    uint8_t evictedBatched = (evictedCount < count) ? evictedCount : count;
+
+    for (uint8_t idx = 0; idx < evictedBatched; idx++)
+    {
+        BatchEntry::encode(cbor,
+                           Scanner::EventLost,
+                           CborSchema::bytes(evicted[idx].address, Gap::ADDR_LEN),
+                           evicted[idx].rssi,
+                           CborSchema::text("", 0));
+    }
+
+    // devices in this batch; they stay pending until the batch is queued
+    uint8_t batched[SCANNER_BATCH_MAX];
+    uint8_t batchedCount = 0;
+
+    for (uint8_t idx = 0; (idx < SCANNER_TABLE_SIZE) && (evictedBatched + batchedCount < count); idx++)
+    {
+        device_t* device = &devices[idx];
+
+        if ((device->state != EntryUsed) || (device->pending == 0))
+        {
+            continue;
+        }
+
+        BatchEntry::encode(cbor,
+                           device->pending,
+                           CborSchema::bytes(device->address, Gap::ADDR_LEN),
+                           (int8_t) (device->rssiAverage >> RSSI_FRACTION_BITS),
+                           CborSchema::text(device->name, device->nameLength));
+
+        batched[batchedCount++] = idx;
+    }
+
+    DEBUGOUT("scanner: batch: %lu\r\n", cbor.getLength());
+
+    BlockStatic& batchBlock = batchMessage.finish(cbor);
+    batchInFlight = true;
+
+    // try again on the next period, nothing has been marked as sent
+    if (!MessageQueue::send(Scanner::ScannerPort,
+                            batchBlock,
+                            sendBatchDone))
+    {
+        batchInFlight = false;
+        return;
+    }
+
+    statistics.batches++;
+
+    evictedCount -= evictedBatched;
+    memmove(&evicted[0], &evicted[evictedBatched], evictedCount * sizeof(evicted_t));
+
+    for (uint8_t idx = 0; idx < batchedCount; idx++)
+    {
+        device_t* device = &devices[batched[idx]];
+
+        if (device->pending == Scanner::EventLost)
+        {
+            // keep probe chains intact
+            device->state = EntryDeleted;
+        }
+
+        device->pending = 0;
+        device->rssiReported = device->rssiAverage >> RSSI_FRACTION_BITS;
+    }
+}
+
+static void sendBatchDone()
+{
+    batchInFlight = false;
+}
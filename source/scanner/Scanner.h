@@ -0,0 +1,75 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_SCANNER_H__
+#define __BLE_SCANNER_H__
+
+#include "ble/BLE.h"
+
+/*
+    Central role scanner. Advertisement reports are merged into a table of
+    recently seen devices; only new devices, significant RSSI changes, and
+    devices that disappear are sent to the host, batched on ScannerPort as
+    a cbor array of [event, address, rssi, name] entries. A device pushed
+    out of the full table is reported lost with an empty name; one that
+    advertises again before its Lost is sent is never reported lost.
+*/
+namespace Scanner
+{
+    // message center port for scan results
+    const uint16_t ScannerPort = 0x10;
+
+    typedef enum {
+        EventFound      = 1,
+        EventUpdated    = 2,
+        EventLost       = 3
+    } event_t;
+
+    typedef struct {
+        uint32_t reports;
+        uint32_t duplicates;
+        uint32_t filtered;              // or not tracked for lack of room
+        uint32_t evictions;
+        uint32_t batches;
+    } statistics_t;
+
+    void init();
+
+    void start();
+    void stop();
+    bool isScanning();
+
+    /*
+        Only report devices whose name starts with the given prefix or that
+        advertise one of the filter UUIDs. No filters reports everything.
+    */
+    void setNameFilter(const char* prefix, uint8_t length);
+    bool addUUIDFilter(const UUID& uuid);
+    void clearFilters();
+
+    /*
+        Connect to a device in the table of recently seen devices. Scanning
+        stops first, the stack cannot scan and initiate at the same time.
+        The address type is not part of the advertisement report in this
+        API, so the caller supplies it. Returns false if the device is not
+        known or the stack rejects the request.
+    */
+    bool connect(const Gap::Address_t address, BLEProtocol::AddressType_t addressType);
+
+    const statistics_t& getStatistics();
+}
+
+#endif // __BLE_SCANNER_H__
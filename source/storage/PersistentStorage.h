@@ -0,0 +1,42 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PERSISTENT_STORAGE_H__
+#define __PERSISTENT_STORAGE_H__
+
+#include <stdint.h>
+
+/*
+    Small byte-addressed store for state that should outlive a connection.
+    Implementations decide where it lives; callers assume nothing about
+    erase blocks and write whole records. Erased or never written bytes
+    read as 0xFF, as on flash.
+*/
+class PersistentStorage
+{
+public:
+    virtual ~PersistentStorage() {}
+
+    virtual uint32_t getSize() const = 0;
+
+    /*
+        Returns false if the range is outside the store.
+    */
+    virtual bool read(uint32_t offset, uint8_t* data, uint32_t length) = 0;
+    virtual bool write(uint32_t offset, const uint8_t* data, uint32_t length) = 0;
+};
+
+#endif // __PERSISTENT_STORAGE_H__
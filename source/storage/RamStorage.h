@@ -0,0 +1,69 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RAM_STORAGE_H__
+#define __RAM_STORAGE_H__
+
+#include "PersistentStorage.h"
+
+#include <string.h>
+
+/*
+    PersistentStorage in static RAM. Contents survive disconnections but
+    not a reset; used where no flash backend is available and in host
+    builds.
+*/
+template <uint32_t Size>
+class RamStorage : public PersistentStorage
+{
+public:
+    RamStorage()
+    {
+        memset(buffer, 0xFF, Size);
+    }
+
+    virtual uint32_t getSize() const
+    {
+        return Size;
+    }
+
+    virtual bool read(uint32_t offset, uint8_t* data, uint32_t length)
+    {
+        if ((offset > Size) || (length > Size - offset))
+        {
+            return false;
+        }
+
+        memcpy(data, &buffer[offset], length);
+        return true;
+    }
+
+    virtual bool write(uint32_t offset, const uint8_t* data, uint32_t length)
+    {
+        if ((offset > Size) || (length > Size - offset))
+        {
+            return false;
+        }
+
+        memcpy(&buffer[offset], data, length);
+        return true;
+    }
+
+private:
+    uint8_t buffer[Size];
+};
+
+#endif // __RAM_STORAGE_H__
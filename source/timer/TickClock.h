@@ -0,0 +1,75 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TICK_CLOCK_H__
+#define __TICK_CLOCK_H__
+
+#include <stdint.h>
+
+/*
+    Millisecond clock from a tick counter that wraps. Scaling the tick
+    count itself jumps back when the counter wraps, so only the ticks
+    since the last reading are converted and added up. The remainder of
+    each conversion is carried, so no time is lost to rounding.
+
+    The counter may be narrower than 32 bits; mask holds its valid bits.
+    Read at least once per counter period or whole periods are missed.
+    The result wraps after 49 days, compare it with signed differences.
+*/
+class TickClock
+{
+public:
+    TickClock(uint32_t _ticksPerSecond, uint32_t _mask = 0xFFFFFFFF)
+        :   ticksPerSecond(_ticksPerSecond),
+            mask(_mask),
+            lastTicks(0),
+            milliseconds(0),
+            remainder(0),
+            started(false)
+    {}
+
+    uint32_t read(uint32_t ticks)
+    {
+        ticks &= mask;
+
+        if (!started)
+        {
+            started = true;
+            lastTicks = ticks;
+        }
+
+        uint32_t delta = (ticks - lastTicks) & mask;
+        lastTicks = ticks;
+
+        // remainder is in thousandths of a tick, always below ticksPerSecond
+        uint64_t scaled = (uint64_t) delta * 1000 + remainder;
+
+        milliseconds += (uint32_t) (scaled / ticksPerSecond);
+        remainder = (uint32_t) (scaled % ticksPerSecond);
+
+        return milliseconds;
+    }
+
+private:
+    uint32_t ticksPerSecond;
+    uint32_t mask;
+    uint32_t lastTicks;
+    uint32_t milliseconds;
+    uint32_t remainder;
+    bool started;
+};
+
+#endif // __TICK_CLOCK_H__
@@ -0,0 +1,124 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TimerQueue.h"
+
+#include <string.h>
+
+// true if a is before b, for times that wrap
+#define BEFORE(a, b) ((int32_t) ((a) - (b)) < 0)
+
+typedef char TimerQueueEntriesCheck[(TIMER_QUEUE_ENTRIES <= 127) ? 1 : -1];
+
+TimerQueue::TimerQueue(uint32_t _align)
+    :   align((_align > 0) ? _align : 1)
+{
+    memset(entries, 0, sizeof(entries));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+TimerQueue::handle_t TimerQueue::add(callback_t callback, uint32_t now, uint32_t delay, uint32_t slack, uint32_t period)
+{
+    for (uint8_t idx = 0; idx < TIMER_QUEUE_ENTRIES; idx++)
+    {
+        entry_t& entry = entries[idx];
+
+        if (entry.callback == NULL)
+        {
+            entry.callback = callback;
+            entry.due = now + delay;
+            entry.deadline = entry.due + slack;
+            entry.period = period;
+            entry.slack = slack;
+
+            return idx;
+        }
+    }
+
+    return NoHandle;
+}
+
+void TimerQueue::remove(handle_t handle)
+{
+    if ((handle >= 0) && (handle < TIMER_QUEUE_ENTRIES))
+    {
+        entries[handle].callback = NULL;
+    }
+}
+
+bool TimerQueue::getWakeup(uint32_t* wakeup) const
+{
+    const entry_t* first = NULL;
+
+    for (uint8_t idx = 0; idx < TIMER_QUEUE_ENTRIES; idx++)
+    {
+        const entry_t& entry = entries[idx];
+
+        if (entry.callback && ((first == NULL) || BEFORE(entry.deadline, first->deadline)))
+        {
+            first = &entry;
+        }
+    }
+
+    if (first == NULL)
+    {
+        return false;
+    }
+
+    // a shared grid lets unrelated timers land on the same wakeup
+    uint32_t aligned = first->deadline - (first->deadline % align);
+
+    *wakeup = BEFORE(aligned, first->due) ? first->deadline : aligned;
+
+    return true;
+}
+
+void TimerQueue::expire(uint32_t now)
+{
+    statistics.wakeups++;
+
+    for (uint8_t idx = 0; idx < TIMER_QUEUE_ENTRIES; idx++)
+    {
+        entry_t& entry = entries[idx];
+
+        if ((entry.callback == NULL) || BEFORE(now, entry.due))
+        {
+            continue;
+        }
+
+        callback_t callback = entry.callback;
+
+        statistics.expired++;
+
+        if (BEFORE(now, entry.deadline))
+        {
+            statistics.shared++;
+        }
+
+        // rearm or free first, the callback may reuse the entry
+        if (entry.period > 0)
+        {
+            entry.due = now + entry.period;
+            entry.deadline = entry.due + entry.slack;
+        }
+        else
+        {
+            entry.callback = NULL;
+        }
+
+        callback();
+    }
+}
@@ -0,0 +1,100 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TIMER_QUEUE_H__
+#define __TIMER_QUEUE_H__
+
+#include <stdint.h>
+
+// timers that can be armed at the same time
+#ifndef TIMER_QUEUE_ENTRIES
+#define TIMER_QUEUE_ENTRIES 8
+#endif
+
+// wakeups are pulled back onto multiples of this where slack allows
+#ifndef TIMER_QUEUE_ALIGN_MS
+#define TIMER_QUEUE_ALIGN_MS 1000
+#endif
+
+/*
+    Timers with slack, sharing wakeups. A timer is due after its delay
+    and may run up to slack later. The queue wakes at the earliest
+    deadline, moved back to a multiple of the alignment if that is still
+    inside the window, and then runs every timer that is due, so timers
+    with overlapping windows cost one wakeup.
+
+    A periodic timer runs period to period + slack after its last run.
+    Work that may run early, like feeding the watchdog, declares a short
+    period and wide slack and mostly rides on other wakeups of the queue.
+
+    Times are in milliseconds from any monotonic source that wraps at 32
+    bits, like TickClock. A tick count scaled to milliseconds is not one.
+*/
+class TimerQueue
+{
+public:
+    typedef void (*callback_t)(void);
+    typedef int8_t handle_t;
+
+    static const handle_t NoHandle = -1;
+
+    typedef struct {
+        uint32_t wakeups;
+        uint32_t expired;               // timers run; wakeups without coalescing
+        uint32_t shared;                // timers run before their own deadline
+    } statistics_t;
+
+    TimerQueue(uint32_t align = TIMER_QUEUE_ALIGN_MS);
+
+    /*
+        Returns NoHandle if all entries are taken. A handle is free for
+        reuse once a one-shot timer has run, like a minar handle.
+    */
+    handle_t add(callback_t callback, uint32_t now, uint32_t delay, uint32_t slack, uint32_t period = 0);
+
+    void remove(handle_t handle);
+
+    /*
+        Time of the next wakeup. Returns false if no timer is armed.
+    */
+    bool getWakeup(uint32_t* wakeup) const;
+
+    /*
+        Run every timer that is due. Callbacks may add and remove timers.
+    */
+    void expire(uint32_t now);
+
+    const statistics_t& getStatistics() const
+    {
+        return statistics;
+    }
+
+private:
+    typedef struct {
+        callback_t callback;            // NULL for free entries
+        uint32_t due;
+        uint32_t deadline;
+        uint32_t period;
+        uint32_t slack;
+    } entry_t;
+
+    entry_t entries[TIMER_QUEUE_ENTRIES];
+    uint32_t align;
+
+    statistics_t statistics;
+};
+
+#endif // __TIMER_QUEUE_H__
@@ -0,0 +1,143 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed-drivers/mbed.h"
+
+#include "TimerService.h"
+#include "TickClock.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+static TimerQueue queue;
+
+// the queue runs on milliseconds added up from tick deltas, so it does not
+// jump back when the minar tick counter wraps; the watchdog feed reads it
+// every 10 s at the latest, well inside one counter period
+static TickClock tickClock(minar::milliseconds(1000), minar::platform::Time_Mask);
+
+static minar::callback_handle_t wakeupHandle = NULL;
+static uint32_t wakeupTime = 0;
+static bool expiring = false;
+
+static bool started = false;
+static uint32_t startTime = 0;
+
+static void onWakeup(void);
+
+/*****************************************************************************/
+
+static uint32_t nowMs()
+{
+    return tickClock.read(minar::Scheduler::getTime());
+}
+
+/*
+    Keep exactly one minar callback, posted for the queue's next wakeup.
+*/
+static void reschedule()
+{
+    // expire() may start and stop timers; settle once it returns
+    if (expiring)
+    {
+        return;
+    }
+
+    uint32_t wakeup;
+    bool armed = queue.getWakeup(&wakeup);
+
+    if (wakeupHandle && armed && (wakeup == wakeupTime))
+    {
+        return;
+    }
+
+    if (wakeupHandle)
+    {
+        minar::Scheduler::cancelCallback(wakeupHandle);
+        wakeupHandle = NULL;
+    }
+
+    if (armed)
+    {
+        int32_t delay = (int32_t) (wakeup - nowMs());
+
+        wakeupTime = wakeup;
+        wakeupHandle = minar::Scheduler::postCallback(onWakeup)
+                        .delay(minar::milliseconds((delay > 0) ? delay : 0))
+                        .getHandle();
+    }
+}
+
+static void onWakeup()
+{
+    wakeupHandle = NULL;
+
+    expiring = true;
+    queue.expire(nowMs());
+    expiring = false;
+
+    DEBUGOUT("timer: wakeup %lu\r\n", queue.getStatistics().wakeups);
+
+    reschedule();
+}
+
+/*****************************************************************************/
+/* Timer Service                                                             */
+/*****************************************************************************/
+
+TimerService::handle_t TimerService::start(void (*callback)(void), uint32_t delayMs, uint32_t slackMs, uint32_t periodMs)
+{
+    uint32_t now = nowMs();
+
+    if (!started)
+    {
+        started = true;
+        startTime = now;
+    }
+
+    handle_t handle = queue.add(callback, now, delayMs, slackMs, periodMs);
+
+    reschedule();
+
+    return handle;
+}
+
+void TimerService::stop(handle_t handle)
+{
+    queue.remove(handle);
+
+    reschedule();
+}
+
+const TimerQueue::statistics_t& TimerService::getStatistics()
+{
+    return queue.getStatistics();
+}
+
+uint32_t TimerService::getTimeMs()
+{
+    return nowMs();
+}
+
+uint32_t TimerService::getUptimeMs()
+{
+    return (started) ? nowMs() - startTime : 0;
+}
@@ -0,0 +1,54 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TIMER_SERVICE_H__
+#define __TIMER_SERVICE_H__
+
+#include "TimerQueue.h"
+
+/*
+    TimerQueue on the minar scheduler. Only one minar callback is posted,
+    for the next wakeup of the queue. Use it for background work that can
+    tolerate some delay; latency sensitive timeouts stay on minar.
+*/
+namespace TimerService
+{
+    typedef TimerQueue::handle_t handle_t;
+
+    const handle_t NoHandle = TimerQueue::NoHandle;
+
+    /*
+        Run callback after delayMs, up to slackMs later, and then every
+        periodMs to periodMs + slackMs if periodMs is not 0.
+    */
+    handle_t start(void (*callback)(void), uint32_t delayMs, uint32_t slackMs, uint32_t periodMs = 0);
+
+    void stop(handle_t handle);
+
+    // wakeups, timers run, and timers that shared a wakeup
+    const TimerQueue::statistics_t& getStatistics();
+
+    /*
+        Milliseconds that keep counting across wraps of the minar tick
+        counter. Wraps after 49 days; compare with signed differences.
+    */
+    uint32_t getTimeMs();
+
+    // milliseconds since the first timer was started
+    uint32_t getUptimeMs();
+}
+
+#endif // __TIMER_SERVICE_H__
@@ -0,0 +1,372 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host benchmark of advertisement parsing throughput.
+
+    Build and run from this directory:
+
+        g++ -O2 -Ihost -I../source advertising_benchmark.cpp -o advertising_benchmark
+        ./advertising_benchmark
+
+    Scan reports are generated the way a busy scan sees them: flags,
+    service lists, names, TX power, and manufacturer data in varying order,
+    some with no fields of interest at all. Each report is asked the
+    questions onAdvertisement asks: name, TX power, manufacturer data, one
+    16-bit and one 128-bit service UUID.
+
+    rescan answers every question with its own pass over the payload, as
+    advertisementContainsUUID does. index builds an AdvertisementIndex
+    once per report and answers from it. Both must give
+    the same answers; the program fails if they do not. Cycle counts are
+    taken on the host and only indicate relative cost.
+*/
+
+#include "ble/BLE.h"
+#include "AdvertisingParsing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+
+#define REPORTS 4096
+#define PAYLOAD_LENGTH 31
+#define ROUNDS 200
+
+typedef struct {
+    uint8_t data[PAYLOAD_LENGTH];
+    uint8_t length;
+} report_t;
+
+static report_t reports[REPORTS];
+
+typedef struct {
+    uint32_t names;
+    uint32_t txPowers;
+    uint32_t manufacturers;
+    uint32_t shortUUIDs;
+    uint32_t longUUIDs;
+    uint32_t checksum;
+} answers_t;
+
+static const uint8_t longService[UUID::LENGTH_OF_LONG_UUID] = {
+    0xD0, 0x00, 0x2D, 0x12, 0x1E, 0x4B, 0x0F, 0xA4,
+    0x99, 0x4E, 0xCE, 0xB5, 0x31, 0xF4, 0x05, 0x79
+};
+
+static const uint16_t shortService = 0x180D;
+
+/*****************************************************************************/
+/* Generator                                                                 */
+/*****************************************************************************/
+
+static uint32_t randomState = 2463534242UL;
+
+static uint32_t random32()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+static bool append(report_t& report, uint8_t type, const uint8_t* value, uint8_t valueLength)
+{
+    if (report.length + 2 + valueLength > PAYLOAD_LENGTH)
+    {
+        return false;
+    }
+
+    report.data[report.length++] = 1 + valueLength;
+    report.data[report.length++] = type;
+    memcpy(&report.data[report.length], value, valueLength);
+    report.length += valueLength;
+
+    return true;
+}
+
+static void generate(report_t& report)
+{
+    uint8_t value[PAYLOAD_LENGTH];
+
+    report.length = 0;
+
+    // flags come first in nearly every advertisement
+    value[0] = 0x06;
+    append(report, GapAdvertisingData::FLAGS, value, 1);
+
+    for (uint8_t attempt = 0; attempt < 6; attempt++)
+    {
+        switch (random32() % 6)
+        {
+            case 0:
+                {
+                    // a few 16-bit services, sometimes the one looked for
+                    uint8_t count = 1 + random32() % 3;
+
+                    for (uint8_t idx = 0; idx < count; idx++)
+                    {
+                        uint16_t service = (random32() % 4) ? 0x1800 + random32() % 64 : shortService;
+
+                        value[2 * idx] = service;
+                        value[2 * idx + 1] = service >> 8;
+                    }
+
+                    append(report, GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, value, 2 * count);
+                }
+                break;
+            case 1:
+                memcpy(value, longService, UUID::LENGTH_OF_LONG_UUID);
+                value[0] ^= (random32() % 2);
+                append(report, GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS, value, UUID::LENGTH_OF_LONG_UUID);
+                break;
+            case 2:
+                {
+                    uint8_t nameLength = 4 + random32() % 10;
+
+                    for (uint8_t idx = 0; idx < nameLength; idx++)
+                    {
+                        value[idx] = 'a' + random32() % 26;
+                    }
+
+                    append(report,
+                           (random32() % 2) ? GapAdvertisingData::COMPLETE_LOCAL_NAME : GapAdvertisingData::SHORTENED_LOCAL_NAME,
+                           value, nameLength);
+                }
+                break;
+            case 3:
+                value[0] = -4 * (random32() % 5);
+                append(report, GapAdvertisingData::TX_POWER_LEVEL, value, 1);
+                break;
+            case 4:
+                {
+                    uint8_t dataLength = 2 + random32() % 20;
+
+                    for (uint8_t idx = 0; idx < dataLength; idx++)
+                    {
+                        value[idx] = random32();
+                    }
+
+                    append(report, GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA, value, dataLength);
+                }
+                break;
+            default:
+                // nothing of interest, as most reports around a phone
+                break;
+        }
+    }
+}
+
+/*****************************************************************************/
+/* Lookups                                                                   */
+/*****************************************************************************/
+
+static bool rescanFind(const Gap::AdvertisementCallbackParams_t* params,
+                       uint8_t type,
+                       AdvertisementPayload::DataField_t* field)
+{
+    AdvertisementPayload payload(params->advertisingData, params->advertisingDataLen);
+
+    for (AdvertisementPayload::iterator iter = payload.begin(); iter != payload.end(); ++iter)
+    {
+        if (iter->type == type)
+        {
+            *field = *iter;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+    Every question answered with its own pass over the payload.
+*/
+static void answerRescan(const Gap::AdvertisementCallbackParams_t* params,
+                         const UUID& shortUUID,
+                         const UUID& longUUID,
+                         answers_t& answers)
+{
+    AdvertisementPayload::DataField_t field;
+
+    // complete name preferred, as the index does
+    if (rescanFind(params, GapAdvertisingData::COMPLETE_LOCAL_NAME, &field) ||
+        rescanFind(params, GapAdvertisingData::SHORTENED_LOCAL_NAME, &field))
+    {
+        answers.names++;
+        answers.checksum += field.length + field.value[0];
+    }
+
+    if (rescanFind(params, GapAdvertisingData::TX_POWER_LEVEL, &field) && (field.length >= 1))
+    {
+        answers.txPowers++;
+        answers.checksum += (uint8_t) field.value[0];
+    }
+
+    if (rescanFind(params, GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA, &field))
+    {
+        answers.manufacturers++;
+        answers.checksum += field.length;
+    }
+
+    answers.shortUUIDs += advertisementContainsUUID(params, shortUUID);
+    answers.longUUIDs += advertisementContainsUUID(params, longUUID);
+}
+
+/*
+    One index per report, every question answered from it.
+*/
+static void answerIndex(const Gap::AdvertisementCallbackParams_t* params,
+                        const UUID& shortUUID,
+                        const UUID& longUUID,
+                        answers_t& answers)
+{
+    AdvertisementIndex index(params);
+
+    const char* name;
+    uint8_t nameLength;
+    int8_t txPower;
+    const uint8_t* manufacturer;
+    uint8_t manufacturerLength;
+
+    if (index.getName(&name, &nameLength))
+    {
+        answers.names++;
+        answers.checksum += nameLength + name[0];
+    }
+
+    if (index.getTxPower(&txPower))
+    {
+        answers.txPowers++;
+        answers.checksum += (uint8_t) txPower;
+    }
+
+    if (index.getManufacturerData(&manufacturer, &manufacturerLength))
+    {
+        answers.manufacturers++;
+        answers.checksum += manufacturerLength;
+    }
+
+    answers.shortUUIDs += index.containsUUID(shortUUID);
+    answers.longUUIDs += index.containsUUID(longUUID);
+}
+
+typedef void (*answer_t)(const Gap::AdvertisementCallbackParams_t* params,
+                         const UUID& shortUUID,
+                         const UUID& longUUID,
+                         answers_t& answers);
+
+static const answer_t answerers[] = { answerRescan, answerIndex };
+static const char* const names[] = { "rescan", "index" };
+
+#define MODES (sizeof(answerers) / sizeof(answer_t))
+
+/*****************************************************************************/
+
+int main()
+{
+    for (uint32_t idx = 0; idx < REPORTS; idx++)
+    {
+        generate(reports[idx]);
+    }
+
+    UUID shortUUID(shortService);
+    UUID longUUID(longService, UUID::LSB);
+
+    Gap::AdvertisementCallbackParams_t params;
+    memset(&params, 0, sizeof(params));
+
+    answers_t answers[MODES];
+    uint64_t cycles[MODES];
+    uint32_t bytes = 0;
+
+    memset(answers, 0, sizeof(answers));
+
+    for (uint32_t idx = 0; idx < REPORTS; idx++)
+    {
+        bytes += reports[idx].length;
+    }
+
+    for (uint8_t mode = 0; mode < MODES; mode++)
+    {
+        for (uint32_t idx = 0; idx < REPORTS; idx++)
+        {
+            params.advertisingData = reports[idx].data;
+            params.advertisingDataLen = reports[idx].length;
+
+            answerers[mode](&params, shortUUID, longUUID, answers[mode]);
+        }
+
+        answers_t ignored;
+        memset(&ignored, 0, sizeof(ignored));
+
+        uint64_t start = CYCLES();
+
+        for (uint32_t round = 0; round < ROUNDS; round++)
+        {
+            for (uint32_t idx = 0; idx < REPORTS; idx++)
+            {
+                params.advertisingData = reports[idx].data;
+                params.advertisingDataLen = reports[idx].length;
+
+                answerers[mode](&params, shortUUID, longUUID, ignored);
+            }
+        }
+
+        cycles[mode] = CYCLES() - start;
+
+        // keep the lookups from being optimised away
+        if (ignored.checksum == 0xFFFFFFFF)
+        {
+            printf("\n");
+        }
+    }
+
+    printf("%u reports, %.1f bytes average\n", REPORTS, (double) bytes / REPORTS);
+    printf("%-8s %8s %8s %8s %8s %8s %12s %12s\n",
+           "", "names", "tx power", "mfr data", "16-bit", "128-bit", "cycles/rep", "cycles/byte");
+
+    for (uint8_t mode = 0; mode < MODES; mode++)
+    {
+        printf("%-8s %8u %8u %8u %8u %8u %12.1f %12.2f\n",
+               names[mode],
+               answers[mode].names,
+               answers[mode].txPowers,
+               answers[mode].manufacturers,
+               answers[mode].shortUUIDs,
+               answers[mode].longUUIDs,
+               (double) cycles[mode] / ((uint64_t) REPORTS * ROUNDS),
+               (double) cycles[mode] / ((uint64_t) bytes * ROUNDS));
+    }
+
+    // both ways must find the same fields
+    bool passed = (memcmp(&answers[0], &answers[1], sizeof(answers_t)) == 0);
+
+    if (!passed)
+    {
+        printf("answers differ\n");
+    }
+
+    return (passed) ? 0 : 1;
+}
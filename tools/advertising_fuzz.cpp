@@ -0,0 +1,514 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Fuzz harness for AdvertisingParsing.h.
+
+    Build and run from this directory, standalone with its own generator:
+
+        g++ -O1 -g -fsanitize=address,undefined -Ihost -I../source advertising_fuzz.cpp -o advertising_fuzz
+        ./advertising_fuzz [iterations] [seed]
+
+    or with libFuzzer:
+
+        clang++ -O1 -g -fsanitize=fuzzer,address,undefined -DADVERTISING_FUZZ_LIBFUZZER \
+            -Ihost -I../source advertising_fuzz.cpp -o advertising_fuzz
+        ./advertising_fuzz
+
+    Every payload is copied into a buffer of exactly its length, so the
+    sanitizer catches any read past the end. The iterator, the index, the
+    name, TX power, manufacturer data, and UUID lookups, and UUIDFilterSet
+    are compared with a plain reference parser, and every pointer they
+    return must lie inside the payload. The generator mixes well formed
+    AD structures with truncated, oversized, and zero length fields and
+    plain random bytes. A failing payload is printed in hex and the
+    program exits with 1.
+*/
+
+#include "ble/BLE.h"
+#include "AdvertisingParsing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FIELDS 128
+
+typedef struct {
+    uint8_t position;
+    uint8_t type;
+    uint8_t length;
+} reference_field_t;
+
+static const uint8_t* payloadStart;
+static uint8_t payloadLength;
+static bool failed;
+
+static void fail(const char* what)
+{
+    if (!failed)
+    {
+        printf("%s, payload:", what);
+
+        for (uint8_t idx = 0; idx < payloadLength; idx++)
+        {
+            printf(" %02X", payloadStart[idx]);
+        }
+
+        printf("\n");
+    }
+
+    failed = true;
+
+#ifdef ADVERTISING_FUZZ_LIBFUZZER
+    abort();
+#endif
+}
+
+static void checkInside(const uint8_t* value, uint8_t length)
+{
+    if ((value < payloadStart) || (value + length > payloadStart + payloadLength))
+    {
+        fail("value outside payload");
+    }
+}
+
+/*
+    Fields as the Core Specification lays them out, stopping at the first
+    zero length or a field that does not fit.
+*/
+static uint8_t referenceParse(const uint8_t* data, uint8_t length, reference_field_t* fields)
+{
+    uint8_t count = 0;
+    uint16_t position = 0;
+
+    while (position + 2 <= length)
+    {
+        uint8_t fieldLength = data[position];
+
+        if ((fieldLength == 0) || (position + 1 + fieldLength > length))
+        {
+            break;
+        }
+
+        fields[count].position = position;
+        fields[count].type = data[position + 1];
+        fields[count].length = fieldLength - 1;
+        count++;
+
+        position += 1 + fieldLength;
+    }
+
+    return count;
+}
+
+static int16_t referenceFind(const reference_field_t* fields, uint8_t count, uint8_t type)
+{
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if (fields[idx].type == type)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+static bool referenceContains(const uint8_t* data, const reference_field_t* fields, uint8_t count,
+                              uint8_t complete, uint8_t incomplete, const uint8_t* uuid, uint8_t uuidLength)
+{
+    // only the first field of each type is searched, like the index
+    const uint8_t types[2] = { complete, incomplete };
+
+    for (uint8_t kind = 0; kind < 2; kind++)
+    {
+        int16_t idx = referenceFind(fields, count, types[kind]);
+
+        if (idx < 0)
+        {
+            continue;
+        }
+
+        const uint8_t* value = &data[fields[idx].position + 2];
+
+        for (uint16_t offset = 0; offset + uuidLength <= fields[idx].length; offset += uuidLength)
+        {
+            if (memcmp(&value[offset], uuid, uuidLength) == 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// every field of the type is searched, like the filter set
+static bool referenceAnyContains(const uint8_t* data, const reference_field_t* fields, uint8_t count,
+                                 uint8_t complete, uint8_t incomplete, const uint8_t* uuid, uint8_t uuidLength)
+{
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if ((fields[idx].type != complete) && (fields[idx].type != incomplete))
+        {
+            continue;
+        }
+
+        const uint8_t* value = &data[fields[idx].position + 2];
+
+        for (uint16_t offset = 0; offset + uuidLength <= fields[idx].length; offset += uuidLength)
+        {
+            if (memcmp(&value[offset], uuid, uuidLength) == 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static void checkPayload(const uint8_t* data, uint8_t length)
+{
+    payloadStart = data;
+    payloadLength = length;
+
+    reference_field_t fields[MAX_FIELDS];
+    uint8_t count = referenceParse(data, length, fields);
+
+    // iterator yields exactly the reference fields
+    AdvertisementPayload payload(data, length);
+    uint8_t seen = 0;
+
+    for (AdvertisementPayload::iterator iter = payload.begin(); iter != payload.end(); ++iter)
+    {
+        if ((seen >= count) ||
+            (iter.getPosition() != fields[seen].position) ||
+            (iter->type != fields[seen].type) ||
+            (iter->length != fields[seen].length) ||
+            (iter->value != &data[fields[seen].position + 2]))
+        {
+            fail("iterator differs from reference");
+            return;
+        }
+
+        checkInside(iter->value, iter->length);
+        seen++;
+    }
+
+    if (seen != count)
+    {
+        fail("iterator stopped early");
+    }
+
+    // index finds the first field of every type it covers
+    AdvertisementIndex index(data, length);
+
+    for (uint16_t type = 0; type <= 0xFF; type++)
+    {
+        AdvertisementPayload::DataField_t field;
+        int16_t expected = referenceFind(fields, count, type);
+        bool covered = (type < 0x40) || (type == GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA);
+        bool found = index.find(type, &field);
+
+        if (found != (covered && (expected >= 0)))
+        {
+            fail("index presence differs from reference");
+        }
+        else if (found)
+        {
+            if ((field.value != &data[fields[expected].position + 2]) || (field.length != fields[expected].length))
+            {
+                fail("index field differs from reference");
+            }
+
+            checkInside(field.value, field.length);
+        }
+    }
+
+    const char* name;
+    uint8_t nameLength;
+
+    if (index.getName(&name, &nameLength))
+    {
+        checkInside((const uint8_t*) name, nameLength);
+    }
+    else if ((referenceFind(fields, count, GapAdvertisingData::COMPLETE_LOCAL_NAME) >= 0) ||
+             (referenceFind(fields, count, GapAdvertisingData::SHORTENED_LOCAL_NAME) >= 0))
+    {
+        fail("name not found");
+    }
+
+    int8_t txPower;
+    int16_t txField = referenceFind(fields, count, GapAdvertisingData::TX_POWER_LEVEL);
+
+    if (index.getTxPower(&txPower) != ((txField >= 0) && (fields[txField].length >= 1)))
+    {
+        fail("tx power differs from reference");
+    }
+
+    const uint8_t* manufacturer;
+    uint8_t manufacturerLength;
+
+    if (index.getManufacturerData(&manufacturer, &manufacturerLength))
+    {
+        checkInside(manufacturer, manufacturerLength);
+    }
+
+    // every 16-bit UUID in the payload, and a few that are not
+    UUIDFilterSet<8> filters;
+    uint8_t shortBytes[8][2];
+    uint8_t filterCount = 0;
+
+    for (uint16_t offset = 0; (offset + 2 <= length) && (filterCount < 4); offset += 7)
+    {
+        uint8_t bytes[2] = { data[offset], data[offset + 1] };
+        UUID uuid((UUID::ShortUUIDBytes_t) (bytes[0] | (bytes[1] << 8)));
+
+        bool expected = referenceContains(data, fields, count,
+                                          GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS,
+                                          GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS,
+                                          bytes, 2);
+
+        if (index.containsUUID(uuid) != expected)
+        {
+            fail("16-bit UUID lookup differs from reference");
+        }
+
+        memcpy(shortBytes[filterCount], bytes, 2);
+        filters.add(uuid);
+        filterCount++;
+    }
+
+    // 128-bit UUIDs taken from the payload, stored little endian
+    uint8_t longBytes[4][UUID::LENGTH_OF_LONG_UUID];
+    uint8_t longCount = 0;
+
+    for (uint16_t offset = 0; (offset + UUID::LENGTH_OF_LONG_UUID <= length) && (longCount < 4); offset += 11)
+    {
+        UUID uuid(&data[offset], UUID::LSB);
+
+        bool expected = referenceContains(data, fields, count,
+                                          GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS,
+                                          GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS,
+                                          &data[offset], UUID::LENGTH_OF_LONG_UUID);
+
+        if (index.containsUUID(uuid) != expected)
+        {
+            fail("128-bit UUID lookup differs from reference");
+        }
+
+        memcpy(longBytes[longCount], &data[offset], UUID::LENGTH_OF_LONG_UUID);
+        filters.add(uuid);
+        longCount++;
+    }
+
+    // filter bits follow the order UUIDs were added: short ones, then long ones
+    UUIDFilterSet<8>::mask_t mask = filters.match(data, length);
+
+    for (uint8_t bit = 0; bit < filterCount + longCount; bit++)
+    {
+        bool expected = (bit < filterCount)
+            ? referenceAnyContains(data, fields, count,
+                                   GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS,
+                                   GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS,
+                                   shortBytes[bit], 2)
+            : referenceAnyContains(data, fields, count,
+                                   GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS,
+                                   GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS,
+                                   longBytes[bit - filterCount], UUID::LENGTH_OF_LONG_UUID);
+
+        if (((mask >> bit) & 1) != expected)
+        {
+            fail("filter set differs from reference");
+        }
+    }
+}
+
+/*
+    Copy into a buffer of exactly the payload length so reads past the
+    end are caught.
+*/
+static void check(const uint8_t* data, size_t size)
+{
+    uint8_t length = (size > 0xFF) ? 0xFF : size;
+    uint8_t* copy = (uint8_t*) malloc(length ? length : 1);
+
+    memcpy(copy, data, length);
+    checkPayload(copy, length);
+
+    free(copy);
+}
+
+#ifdef ADVERTISING_FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    check(data, size);
+
+    return 0;
+}
+
+#else
+
+/*****************************************************************************/
+/* Generator                                                                 */
+/*****************************************************************************/
+
+static uint32_t randomState;
+
+static uint32_t random32()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+static const uint8_t commonTypes[] = {
+    GapAdvertisingData::FLAGS,
+    GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS,
+    GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS,
+    GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS,
+    GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS,
+    GapAdvertisingData::SHORTENED_LOCAL_NAME,
+    GapAdvertisingData::COMPLETE_LOCAL_NAME,
+    GapAdvertisingData::TX_POWER_LEVEL,
+    GapAdvertisingData::SERVICE_DATA,
+    GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA
+};
+
+static uint8_t generate(uint8_t* buffer)
+{
+    // advertising payloads are 31 bytes, extended ones may be longer
+    uint8_t capacity = (random32() % 4) ? 31 : 1 + random32() % 255;
+    uint8_t length = 0;
+
+    if (random32() % 8 == 0)
+    {
+        // plain random bytes
+        length = random32() % (capacity + 1);
+
+        for (uint8_t idx = 0; idx < length; idx++)
+        {
+            buffer[idx] = random32();
+        }
+
+        return length;
+    }
+
+    while (length + 2 <= capacity)
+    {
+        uint8_t type = commonTypes[random32() % sizeof(commonTypes)];
+        uint8_t valueLength;
+
+        if ((type == GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS) ||
+            (type == GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS))
+        {
+            valueLength = 2 * (random32() % 4) + ((random32() % 8) == 0);
+        }
+        else if ((type == GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS) ||
+                 (type == GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS))
+        {
+            valueLength = 16 * (random32() % 2) + ((random32() % 8) == 0);
+        }
+        else
+        {
+            valueLength = random32() % 12;
+        }
+
+        uint8_t fieldLength = 1 + valueLength;
+
+        // corrupt the length now and then: zero, or past the end
+        uint32_t corruption = random32() % 16;
+
+        if (corruption == 0)
+        {
+            fieldLength = 0;
+        }
+        else if (corruption == 1)
+        {
+            fieldLength = 0xFF;
+        }
+
+        buffer[length++] = fieldLength;
+        buffer[length++] = type;
+
+        for (uint8_t idx = 0; (idx < valueLength) && (length < capacity); idx++)
+        {
+            // small alphabet so UUIDs repeat across fields
+            buffer[length++] = random32() % 4;
+        }
+    }
+
+    return length;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+    randomState = (argc > 2) ? strtoul(argv[2], NULL, 0) : 2463534242UL;
+
+    if (randomState == 0)
+    {
+        randomState = 1;
+    }
+
+    uint8_t buffer[0xFF];
+    uint32_t failures = 0;
+
+    // edge cases first
+    check(buffer, 0);
+
+    const uint8_t edges[][4] = {
+        { 0x00, 0x09, 'a', 'b' },
+        { 0x01, 0x09, 0x00, 0x00 },
+        { 0x02, 0x09, 'a', 0x00 },
+        { 0x04, 0x09, 'a', 'b' }
+    };
+
+    for (uint8_t idx = 0; idx < sizeof(edges) / sizeof(edges[0]); idx++)
+    {
+        for (uint8_t length = 0; length <= 4; length++)
+        {
+            failed = false;
+            check(edges[idx], length);
+            failures += failed;
+        }
+    }
+
+    for (uint32_t iteration = 0; iteration < iterations; iteration++)
+    {
+        uint8_t length = generate(buffer);
+
+        failed = false;
+        check(buffer, length);
+        failures += failed;
+
+        if (failures >= 10)
+        {
+            break;
+        }
+    }
+
+    printf("%u payloads, %u failed\n", iterations, failures);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+#endif
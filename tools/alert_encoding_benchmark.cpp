@@ -0,0 +1,370 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host benchmark of the ANCS alert encoding, before and after alerts
+    were encoded straight into static send buffers.
+
+    Build and run from this directory:
+
+        g++ -O2 -Ihost -I../source alert_encoding_benchmark.cpp ../source/cbor/TextCodec.cpp -o alert_encoding_benchmark
+        ./alert_encoding_benchmark notification_corpus.txt
+
+    before is the old sendAlert: title and subtitle joined in a stack
+    buffer, then copied again into a BlockDynamic sized with a uint8_t.
+    after is the current sendAlert: CborMessage<AlertMessage> written
+    from the attribute data into a static buffer, once with the old three
+    fields and once with all eight the default build sends.
+
+    Every notification in the corpus is encoded, plus one with every
+    attribute at its maximum length. Reports bytes copied, heap
+    allocations, and encode cost per alert, and how many alerts overflowed
+    the old uint8_t length. Allocations are counted by replacing operator
+    new; the program fails if the new path allocates. Cycle counts are
+    taken on the host and only indicate relative cost.
+*/
+
+#include "cbor/CborSchema.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+
+// same settings as the defaults in ANCSManager.cpp
+#define ALERT_LEVEL 1
+#define MAX_RETRIEVE_LENGTH 110
+#define ANCS_APP_NAME_MAX_LENGTH 24
+
+#define MAX_NOTIFICATIONS 1024
+#define LINE_LENGTH 1024
+#define ROUNDS 1000
+
+// [alert level, "title subtitle", "message", uid, final, "app name", count, category count]
+typedef CborSchema::Array<CborSchema::Unsigned<ALERT_LEVEL>,
+                          CborSchema::JoinedText<MAX_RETRIEVE_LENGTH, MAX_RETRIEVE_LENGTH>,
+                          CborSchema::Text<MAX_RETRIEVE_LENGTH>,
+                          CborSchema::Unsigned<>,
+                          CborSchema::Unsigned<1>,
+                          CborSchema::Text<ANCS_APP_NAME_MAX_LENGTH>,
+                          CborSchema::Unsigned<0xFF>,
+                          CborSchema::Unsigned<0xFF> > AlertMessage;
+
+// the old layout, [alert level, "title subtitle", "message"], to compare like with like
+typedef CborSchema::Array<CborSchema::Unsigned<ALERT_LEVEL>,
+                          CborSchema::JoinedText<MAX_RETRIEVE_LENGTH, MAX_RETRIEVE_LENGTH>,
+                          CborSchema::Text<MAX_RETRIEVE_LENGTH> > ShortAlertMessage;
+
+typedef struct {
+    char line[LINE_LENGTH];
+    const char* fields[4];
+    uint32_t lengths[4];
+} notification_t;
+
+static notification_t notifications[MAX_NOTIFICATIONS + 1];
+
+typedef struct {
+    uint64_t copied;
+    uint64_t allocations;
+    uint64_t allocated;
+    uint64_t encoded;
+    uint32_t overflows;
+} totals_t;
+
+/*****************************************************************************/
+/* Allocation counting                                                       */
+/*****************************************************************************/
+
+static uint64_t allocations = 0;
+static uint64_t allocated = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    allocated += size;
+
+    void* pointer = malloc(size ? size : 1);
+
+    if (pointer == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// out of line, so the compiler does not pair free with operator new
+static void __attribute__((noinline)) release(void* pointer)
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    release(pointer);
+}
+
+/*****************************************************************************/
+
+static uint32_t clamp(uint32_t length, uint32_t max)
+{
+    return (length > max) ? max : length;
+}
+
+/*
+    The old sendAlert, with Cbore replaced by CborWriter. The old code
+    allocated the uint8_t length; the full length is allocated here so the
+    host does not overrun the buffer, and the wrap is counted instead.
+*/
+static uint32_t encodeBefore(const notification_t& notification, totals_t& totals)
+{
+    uint32_t titleLength = clamp(notification.lengths[0], MAX_RETRIEVE_LENGTH);
+    uint32_t subtitleLength = clamp(notification.lengths[1], MAX_RETRIEVE_LENGTH);
+    uint32_t messageLength = clamp(notification.lengths[2], MAX_RETRIEVE_LENGTH);
+
+    // allocate buffer for combined title
+    uint32_t combinedLength = 1 + titleLength + subtitleLength;
+    char combinedBuffer[combinedLength];
+
+    // copy title and subtitle into combined buffer
+    memcpy(&combinedBuffer[0], notification.fields[0], titleLength);
+    combinedBuffer[titleLength] = ' ';
+    memcpy(&combinedBuffer[titleLength + 1], notification.fields[1], subtitleLength);
+
+    // allocate buffer for message center
+    uint8_t cborLength = 1 + 1                  // array and alert level
+                       + 2 + combinedLength     // title
+                       + 2 + messageLength;     // message
+
+    uint32_t fullLength = 1 + 1 + 3 + combinedLength + 3 + messageLength;
+
+    BlockDynamic* sendBlock = new BlockDynamic(fullLength);
+
+    // construct cbor
+    CborWriter cbor(sendBlock->getData(), sendBlock->getLength());
+
+    cbor.array(3)
+        .item((uint32_t) ALERT_LEVEL)
+        .item((const char*) combinedBuffer, combinedLength)
+        .item(notification.fields[2], messageLength);
+
+    sendBlock->setLength(cbor.getLength());
+
+    uint32_t length = sendBlock->getLength();
+
+    totals.copied += combinedLength + length;
+    totals.encoded += length;
+    totals.overflows += (length > cborLength);
+
+    delete sendBlock;
+
+    return length;
+}
+
+static CborMessage<AlertMessage> slotMessage;
+
+static uint32_t encodeAfter(const notification_t& notification, totals_t& totals)
+{
+    uint32_t messageLength = notification.lengths[2];
+
+    BlockStatic& block = slotMessage.encode(ALERT_LEVEL,
+                                            CborSchema::joined(notification.fields[0], notification.lengths[0],
+                                                               notification.fields[1], notification.lengths[1]),
+                                            CborSchema::text(notification.fields[2], messageLength),
+                                            0x1234,
+                                            (messageLength < MAX_RETRIEVE_LENGTH),
+                                            CborSchema::text(notification.fields[3], notification.lengths[3]),
+                                            1,
+                                            1);
+
+    totals.copied += block.getLength();
+    totals.encoded += block.getLength();
+
+    return block.getLength();
+}
+
+static CborMessage<ShortAlertMessage> shortMessage;
+
+static uint32_t encodeAfterShort(const notification_t& notification, totals_t& totals)
+{
+    BlockStatic& block = shortMessage.encode(ALERT_LEVEL,
+                                             CborSchema::joined(notification.fields[0], notification.lengths[0],
+                                                                notification.fields[1], notification.lengths[1]),
+                                             CborSchema::text(notification.fields[2], notification.lengths[2]));
+
+    totals.copied += block.getLength();
+    totals.encoded += block.getLength();
+
+    return block.getLength();
+}
+
+typedef uint32_t (*encoder_t)(const notification_t& notification, totals_t& totals);
+
+static const encoder_t encoders[] = { encodeBefore, encodeAfterShort, encodeAfter };
+static const char* const names[] = { "before", "after, 3 fields", "after, 8 fields" };
+
+#define MODES (sizeof(encoders) / sizeof(encoder_t))
+
+static uint32_t load(FILE* file)
+{
+    uint32_t count = 0;
+
+    while ((count < MAX_NOTIFICATIONS) && fgets(notifications[count].line, LINE_LENGTH, file))
+    {
+        notification_t& notification = notifications[count];
+        char* cursor = notification.line;
+
+        if (*cursor == '#')
+        {
+            continue;
+        }
+
+        cursor[strcspn(cursor, "\r\n")] = '\0';
+
+        for (uint8_t field = 0; field < 4; field++)
+        {
+            uint32_t length = strcspn(cursor, "\t");
+
+            notification.fields[field] = cursor;
+            notification.lengths[field] = length;
+
+            cursor += (cursor[length] == '\t') ? length + 1 : length;
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+/*
+    Every attribute at the longest length the phone is asked for.
+*/
+static void addWorstCase(notification_t& notification)
+{
+    memset(notification.line, 'w', 3 * MAX_RETRIEVE_LENGTH + ANCS_APP_NAME_MAX_LENGTH);
+
+    for (uint8_t field = 0; field < 4; field++)
+    {
+        notification.fields[field] = &notification.line[field * MAX_RETRIEVE_LENGTH];
+        notification.lengths[field] = (field < 3) ? MAX_RETRIEVE_LENGTH : ANCS_APP_NAME_MAX_LENGTH;
+    }
+}
+
+static void report(const char* name, const totals_t& totals, uint32_t count, uint64_t cycles)
+{
+    printf("%-16s %10.1f %10.2f %10.1f %10.1f %10.1f %10u\n",
+           name,
+           (double) totals.copied / count,
+           (double) totals.allocations / count,
+           (double) totals.allocated / count,
+           (double) totals.encoded / count,
+           (double) cycles / ((uint64_t) count * ROUNDS),
+           totals.overflows);
+}
+
+/*****************************************************************************/
+
+int main(int argc, char** argv)
+{
+    FILE* file = (argc > 1) ? fopen(argv[1], "r") : stdin;
+
+    if (file == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint32_t count = load(file);
+    addWorstCase(notifications[count++]);
+
+    totals_t totals[MODES];
+    uint64_t cycles[MODES];
+
+    memset(totals, 0, sizeof(totals));
+
+    for (uint8_t mode = 0; mode < MODES; mode++)
+    {
+        allocations = 0;
+        allocated = 0;
+
+        for (uint32_t idx = 0; idx < count; idx++)
+        {
+            encoders[mode](notifications[idx], totals[mode]);
+        }
+
+        totals[mode].allocations = allocations;
+        totals[mode].allocated = allocated;
+
+        totals_t ignored;
+        uint64_t start = CYCLES();
+
+        for (uint32_t round = 0; round < ROUNDS; round++)
+        {
+            for (uint32_t idx = 0; idx < count; idx++)
+            {
+                encoders[mode](notifications[idx], ignored);
+            }
+        }
+
+        cycles[mode] = CYCLES() - start;
+    }
+
+    printf("%u alerts, per alert:\n", count);
+    printf("%-16s %10s %10s %10s %10s %10s %10s\n",
+           "", "copied", "allocs", "heap bytes", "encoded", "cycles", "overflows");
+
+    bool passed = true;
+
+    for (uint8_t mode = 0; mode < MODES; mode++)
+    {
+        report(names[mode], totals[mode], count, cycles[mode]);
+
+        // the new path must never touch the heap
+        passed = passed && ((mode == 0) || (totals[mode].allocations == 0));
+    }
+
+    printf("static buffer    %u bytes per send slot\n", (unsigned) CborMessage<AlertMessage>::MaxLength);
+
+    return (passed) ? 0 : 1;
+}
@@ -0,0 +1,406 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host test for ANCSAttributeAssembler.
+
+    Build and run from this directory:
+
+        g++ -O2 -I../source ancs_assembler_test.cpp ../source/ancs/ANCSAttributeAssembler.cpp -o ancs_assembler_test
+        ./ancs_assembler_test
+
+    Responses laid out as an iPhone sends them are replayed as 20 byte
+    Data Source notifications, the payload of a 23 byte ATT MTU, and
+    again split at every possible position, to check that the assembler
+    returns the same attributes however the response is fragmented.
+    Exits with 1 if any check fails.
+*/
+
+#include "ancs/ANCSAttributeAssembler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ATTRIBUTE_ID_APP_IDENTIFIER 0
+#define ATTRIBUTE_ID_TITLE          1
+#define ATTRIBUTE_ID_SUBTITLE       2
+#define ATTRIBUTE_ID_MESSAGE        3
+#define ATTRIBUTE_ID_DATE           5
+
+#define NOTIFICATION_LENGTH 20
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        checks++;                                                           \
+        if (!(condition))                                                   \
+        {                                                                   \
+            failures++;                                                     \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #condition);   \
+        }                                                                   \
+    } while (0)
+
+/*****************************************************************************/
+/* Responses                                                                 */
+/*****************************************************************************/
+
+// UID 0x0000002A: app, title, subtitle, message, and date
+static const uint8_t messagesResponse[] = {
+    0x00, 0x2A, 0x00, 0x00, 0x00,
+    0x00, 0x13, 0x00, 'c', 'o', 'm', '.', 'a', 'p', 'p', 'l', 'e', '.',
+    'M', 'o', 'b', 'i', 'l', 'e', 'S', 'M', 'S',
+    0x01, 0x0C, 0x00, 'J', 'o', 'h', 'n', ' ', 'A', 'p', 'p', 'l', 'e', 's', 'e',
+    0x02, 0x00, 0x00,
+    0x03, 0x1C, 0x00, 'A', 'r', 'e', ' ', 'w', 'e', ' ', 's', 't', 'i', 'l', 'l', ' ',
+    'o', 'n', ' ', 'f', 'o', 'r', ' ', 't', 'o', 'n', 'i', 'g', 'h', 't', '?',
+    0x05, 0x0F, 0x00, '2', '0', '1', '5', '1', '0', '0', '5', 'T', '1', '9', '3', '0', '0', '0'
+};
+
+static const uint8_t messagesAttributes[] = {
+    ATTRIBUTE_ID_APP_IDENTIFIER,
+    ATTRIBUTE_ID_TITLE,
+    ATTRIBUTE_ID_SUBTITLE,
+    ATTRIBUTE_ID_MESSAGE,
+    ATTRIBUTE_ID_DATE
+};
+
+// UID 0x01020304: title and message, message longer than local storage
+static const uint8_t longResponse[] = {
+    0x00, 0x04, 0x03, 0x02, 0x01,
+    0x01, 0x04, 0x00, 'M', 'a', 'i', 'l',
+    0x03, 0x2C, 0x01
+    // 300 bytes of message follow, see longMessage()
+};
+
+// app attributes for com.apple.MobileSMS: display name
+static const uint8_t appResponse[] = {
+    0x01, 'c', 'o', 'm', '.', 'a', 'p', 'p', 'l', 'e', '.',
+    'M', 'o', 'b', 'i', 'l', 'e', 'S', 'M', 'S', 0x00,
+    0x00, 0x08, 0x00, 'M', 'e', 's', 's', 'a', 'g', 'e', 's'
+};
+
+/*****************************************************************************/
+
+static bool hasAttribute(const ANCSAttributeAssembler& assembler, uint8_t attributeID, const char* expected)
+{
+    const uint8_t* data;
+    uint16_t length;
+
+    if (!assembler.getAttribute(attributeID, &data, &length))
+    {
+        return false;
+    }
+
+    return (length == strlen(expected)) && (memcmp(data, expected, length) == 0);
+}
+
+/*
+    Feed response in pieces that end at the given offsets, returns the
+    status after the last piece.
+*/
+static ANCSAttributeAssembler::status_t feedSplit(ANCSAttributeAssembler& assembler,
+                                                  const uint8_t* response,
+                                                  uint16_t length,
+                                                  const uint16_t* splits,
+                                                  uint8_t count)
+{
+    ANCSAttributeAssembler::status_t status = ANCSAttributeAssembler::StatusInProgress;
+    uint16_t offset = 0;
+
+    for (uint8_t idx = 0; idx <= count; idx++)
+    {
+        uint16_t end = (idx < count) ? splits[idx] : length;
+
+        status = assembler.feed(&response[offset], end - offset);
+        offset = end;
+
+        // nothing may complete before the last byte has arrived
+        if ((idx < count) && (status != ANCSAttributeAssembler::StatusInProgress))
+        {
+            return ANCSAttributeAssembler::StatusError;
+        }
+    }
+
+    return status;
+}
+
+static void checkMessages(const ANCSAttributeAssembler& assembler)
+{
+    CHECK(assembler.getNotificationUID() == 0x2A);
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_APP_IDENTIFIER, "com.apple.MobileSMS"));
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_TITLE, "John Applese"));
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_SUBTITLE, ""));
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_MESSAGE, "Are we still on for tonight?"));
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_DATE, "20151005T193000"));
+    CHECK(!hasAttribute(assembler, 4, ""));
+}
+
+/*****************************************************************************/
+/* Tests                                                                     */
+/*****************************************************************************/
+
+static ANCSAttributeAssembler assembler;
+
+static void testCommand()
+{
+    uint8_t buffer[ANCSAttributeAssembler::MaxRequestLength];
+
+    uint8_t length = assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                                     ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+    // title, subtitle, and message carry a maximum length
+    const uint8_t expected[] = {
+        0x00, 0x2A, 0x00, 0x00, 0x00,
+        0x00,
+        0x01, ANCS_ATTRIBUTE_MAX_LENGTH, 0x00,
+        0x02, ANCS_ATTRIBUTE_MAX_LENGTH, 0x00,
+        0x03, ANCS_ATTRIBUTE_MAX_LENGTH, 0x00,
+        0x05
+    };
+
+    CHECK(length == sizeof(expected));
+    CHECK(memcmp(buffer, expected, sizeof(expected)) == 0);
+
+    // buffer too small, unknown attribute, and no attributes
+    const uint8_t unknown[] = { 6 };
+
+    CHECK(assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes), 32, buffer, 10) == 0);
+    CHECK(assembler.begin(0x2A, unknown, 1, 32, buffer, sizeof(buffer)) == 0);
+    CHECK(assembler.begin(0x2A, messagesAttributes, 0, 32, buffer, sizeof(buffer)) == 0);
+}
+
+static void testRecorded()
+{
+    uint8_t buffer[ANCSAttributeAssembler::MaxRequestLength];
+
+    assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                    ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+    // as received: one notification per 20 bytes
+    uint16_t splits[sizeof(messagesResponse) / NOTIFICATION_LENGTH];
+    uint8_t count = 0;
+
+    for (uint16_t offset = NOTIFICATION_LENGTH; offset < sizeof(messagesResponse); offset += NOTIFICATION_LENGTH)
+    {
+        splits[count++] = offset;
+    }
+
+    CHECK(feedSplit(assembler, messagesResponse, sizeof(messagesResponse), splits, count)
+          == ANCSAttributeAssembler::StatusComplete);
+    checkMessages(assembler);
+}
+
+static void testEverySplit()
+{
+    uint8_t buffer[ANCSAttributeAssembler::MaxRequestLength];
+    uint32_t failed = 0;
+
+    // two pieces split anywhere, then three pieces split anywhere
+    for (uint16_t first = 1; first < sizeof(messagesResponse); first++)
+    {
+        for (uint16_t second = first; second < sizeof(messagesResponse); second++)
+        {
+            uint16_t splits[2] = { first, second };
+
+            assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                            ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+            if (feedSplit(assembler, messagesResponse, sizeof(messagesResponse), splits, 2)
+                != ANCSAttributeAssembler::StatusComplete)
+            {
+                failed++;
+            }
+        }
+    }
+
+    CHECK(failed == 0);
+    checkMessages(assembler);
+
+    // one byte per notification
+    assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                    ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+    ANCSAttributeAssembler::status_t status = ANCSAttributeAssembler::StatusInProgress;
+
+    for (uint16_t idx = 0; idx < sizeof(messagesResponse); idx++)
+    {
+        status = assembler.feed(&messagesResponse[idx], 1);
+    }
+
+    CHECK(status == ANCSAttributeAssembler::StatusComplete);
+    checkMessages(assembler);
+}
+
+static void longMessage(uint8_t* response, uint16_t* length)
+{
+    memcpy(response, longResponse, sizeof(longResponse));
+    *length = sizeof(longResponse);
+
+    for (uint16_t idx = 0; idx < 300; idx++)
+    {
+        response[(*length)++] = 'a' + (idx % 26);
+    }
+}
+
+static void testTruncated()
+{
+    uint8_t buffer[ANCSAttributeAssembler::MaxRequestLength];
+    uint8_t response[sizeof(longResponse) + 300];
+    uint16_t length;
+
+    longMessage(response, &length);
+
+    const uint8_t attributes[] = { ATTRIBUTE_ID_TITLE, ATTRIBUTE_ID_MESSAGE };
+    assembler.begin(0x01020304, attributes, sizeof(attributes), 1000, buffer, sizeof(buffer));
+
+    // maximum length is limited to local storage
+    CHECK((buffer[6] | (buffer[7] << 8)) == ANCS_ATTRIBUTE_MAX_LENGTH);
+
+    CHECK(assembler.feed(response, length) == ANCSAttributeAssembler::StatusComplete);
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_TITLE, "Mail"));
+
+    const uint8_t* data;
+    uint16_t dataLength;
+
+    CHECK(assembler.getAttribute(ATTRIBUTE_ID_MESSAGE, &data, &dataLength));
+    CHECK(dataLength == ANCS_ATTRIBUTE_MAX_LENGTH);
+    CHECK(memcmp(data, &response[sizeof(longResponse)], ANCS_ATTRIBUTE_MAX_LENGTH) == 0);
+}
+
+static void testMismatch()
+{
+    uint8_t buffer[ANCSAttributeAssembler::MaxRequestLength];
+
+    // response for a different notification
+    assembler.begin(0x2B, messagesAttributes, sizeof(messagesAttributes),
+                    ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+    CHECK(assembler.feed(messagesResponse, sizeof(messagesResponse)) == ANCSAttributeAssembler::StatusError);
+
+    // response for a different command
+    assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                    ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+    CHECK(assembler.feed(appResponse, sizeof(appResponse)) == ANCSAttributeAssembler::StatusError);
+
+    // attribute ID out of range
+    const uint8_t bad[] = { 0x00, 0x2A, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00 };
+
+    assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                    ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+
+    CHECK(assembler.feed(bad, sizeof(bad)) == ANCSAttributeAssembler::StatusError);
+}
+
+static uint8_t streamed[300];
+static uint16_t streamedLength;
+static uint16_t streamCalls;
+static bool streamFinal;
+static bool streamInOrder;
+
+static void streamSink(const uint8_t* data, uint16_t length, uint16_t offset, bool final)
+{
+    streamInOrder = streamInOrder && (offset == streamedLength) && !streamFinal;
+
+    memcpy(&streamed[offset], data, length);
+    streamedLength += length;
+    streamCalls++;
+    streamFinal = final;
+}
+
+static void testStream()
+{
+    uint8_t buffer[ANCSAttributeAssembler::MaxRequestLength];
+    uint8_t response[sizeof(longResponse) + 300];
+    uint16_t length;
+
+    longMessage(response, &length);
+
+    // the rest of a long message only: command, UID, and the message
+    uint8_t* message = &response[12 - 5];
+    memcpy(message, response, 5);
+    length -= 12 - 5;
+
+    streamedLength = 0;
+    streamCalls = 0;
+    streamFinal = false;
+    streamInOrder = true;
+
+    CHECK(assembler.beginStream(0x01020304, ATTRIBUTE_ID_MESSAGE, 300, streamSink, buffer, sizeof(buffer)) == 8);
+    CHECK(assembler.beginStream(0x01020304, ATTRIBUTE_ID_DATE, 300, streamSink, buffer, sizeof(buffer)) == 0);
+    assembler.beginStream(0x01020304, ATTRIBUTE_ID_MESSAGE, 300, streamSink, buffer, sizeof(buffer));
+
+    uint16_t splits[32];
+    uint8_t count = 0;
+
+    for (uint16_t offset = NOTIFICATION_LENGTH; offset < length; offset += NOTIFICATION_LENGTH)
+    {
+        splits[count++] = offset;
+    }
+
+    CHECK(feedSplit(assembler, message, length, splits, count) == ANCSAttributeAssembler::StatusComplete);
+
+    // one call per notification, none stored
+    CHECK(streamInOrder);
+    CHECK(streamFinal);
+    CHECK(streamedLength == 300);
+    CHECK(streamCalls == count + 1);
+    CHECK(memcmp(streamed, &response[sizeof(longResponse)], 300) == 0);
+}
+
+static void testApp()
+{
+    uint8_t buffer[64];
+    const char* identifier = "com.apple.MobileSMS";
+    const char* other = "com.apple.mobilemail";
+
+    // notification attributes are kept across the app request
+    assembler.begin(0x2A, messagesAttributes, sizeof(messagesAttributes),
+                    ANCS_ATTRIBUTE_MAX_LENGTH, buffer, sizeof(buffer));
+    assembler.feed(messagesResponse, sizeof(messagesResponse));
+
+    CHECK(assembler.beginApp((const uint8_t*) identifier, strlen(identifier), buffer, 8) == 0);
+    CHECK(assembler.beginApp((const uint8_t*) identifier, strlen(identifier), buffer, sizeof(buffer))
+          == 1 + strlen(identifier) + 2);
+
+    uint16_t splits[] = { 5, 21, 22, 24 };
+    CHECK(feedSplit(assembler, appResponse, sizeof(appResponse), splits, 4) == ANCSAttributeAssembler::StatusComplete);
+    CHECK(hasAttribute(assembler, 0, "Messages"));
+    CHECK(hasAttribute(assembler, ATTRIBUTE_ID_TITLE, "John Applese"));
+
+    // response for another app
+    assembler.beginApp((const uint8_t*) other, strlen(other), buffer, sizeof(buffer));
+    CHECK(assembler.feed(appResponse, sizeof(appResponse)) == ANCSAttributeAssembler::StatusError);
+}
+
+/*****************************************************************************/
+
+int main()
+{
+    testCommand();
+    testRecorded();
+    testEverySplit();
+    testTruncated();
+    testMismatch();
+    testStream();
+    testApp();
+
+    printf("%lu checks, %lu failed\n", (unsigned long) checks, (unsigned long) failures);
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,947 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host harness for the ANCS fetch pipeline in virtual time.
+
+    Build and run from this directory:
+
+        g++ -O2 -DTARGET_LIKE_WATCH -DADVERTISING_COMPANY_ID=0x0059 -Ihost -I../source \
+            ancs_pipeline_harness.cpp $(find ../source host -name '*.cpp') -o ancs_pipeline_harness
+        ./ancs_pipeline_harness
+
+    The firmware is compiled as it is, main.cpp and ANCSManager included,
+    against the stand-ins under host/: BLE, minar in virtual time,
+    ANCSClient, MessageCenter, and the watchdog. Build options such as
+    -DANCS_QUEUE_OVERFLOW_POLICY=NotificationScheduler::OverflowDropNewest
+    or -DANCS_COALESCE_ALERTS=0 apply to the firmware as they would on the
+    device.
+
+    Each scenario boots the firmware with app_start in a process of its
+    own, so no state carries over, and plays a phone against it:
+
+    - The phone connects, reports the ANCS service, and then raises its
+      notifications on the Notification Source, either spaced out or as
+      the storm of pre-existing notifications it sends on every
+      reconnect.
+    - Every connection event the phone sends up to packetsPerEvent
+      packets, Notification Source events first, then Data Source
+      fragments of 20 bytes. A storm on a slow link can therefore hold a
+      response back past the fetch timeout.
+    - A Control Point write is acknowledged on the next connection event
+      and its response starts on the event after that. Get Notification
+      Attributes and Get App Attributes are answered; a share of commands
+      can go unanswered, which the firmware's timeouts recover from.
+    - Characteristic discovery completes a few events after it starts.
+    - Connection parameter requests are accepted at the next event, at
+      the longest interval asked for. Slave latency is not modelled, the
+      phone reaches the watch at every event.
+
+    For each scenario reports the alerts on AlertPort, the notifications
+    merged into them, drops, suppressions by the rate limit, commands the
+    phone lost, peak queue depth, alert latency from the moment the phone
+    raised the notification, and minar wakeups, all in virtual time. Every
+    alert is checked against what the phone holds for its UID. The program
+    fails if an alert is wrong, if the firmware stops with error() or
+    allocates from the heap after init, or if the phone still has work
+    after ten minutes.
+
+    With -c the harness runs only the given scenario with the firmware's
+    trace capture on, read back through Control [16, offset] as a host
+    would, and writes it to the file for trace_replay. Capture has to be
+    built in:
+
+        g++ ... -DTRACE_CAPTURE=1 -DTRACE_CAPTURE_LENGTH=32768 ...
+        ./ancs_pipeline_harness -c 6 trace_replay_sample.bin
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+#include "ble-ancs-client/ANCSClient.h"
+#include "message-center/MessageCenter.h"
+#include "minar/minar.h"
+
+#include "ancs/ANCSManager.h"
+#include "ancs/ANCSAttributeAssembler.h"
+#include "ancs/AppNameCache.h"
+#include "cbor/CborReader.h"
+#include "memory/MemoryMonitor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PACKET_LENGTH 20
+#define MAX_NOTIFICATIONS 256
+#define MAX_EVENTS (2 * MAX_NOTIFICATIONS)
+#define MAX_COMMAND_LENGTH 64
+#define MAX_RESPONSE_LENGTH 512
+#define MAX_RESPONSES 4
+#define DISCOVERY_EVENTS 4
+#define FIRST_UID 1000
+#define SETTLE_MS (60UL * 1000)
+#define RUN_LIMIT_MS (10UL * 60 * 1000)
+
+// handles of the ANCS characteristic values; each declaration is one below
+#define CONTROL_POINT_HANDLE 0x0010
+#define DATA_SOURCE_HANDLE 0x0013
+#define CONNECTION_HANDLE 1
+
+// firmware entry point, see main.cpp
+void app_start(int, char *[]);
+
+typedef struct {
+    const char* name;
+    uint32_t interval;                  // connection interval until the watch asks for another, ms
+    uint8_t packetsPerEvent;            // packets the phone sends per event
+    uint16_t notifications;
+    uint32_t spacing;                   // ms between notifications, 0 for a burst on connect
+    uint8_t modifiedPercent;            // notifications sent again as modified
+    uint8_t lossPercent;                // commands the phone never answers
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "single alert, idle",      1800, 4, 1,   0,    0,  0  },
+    { "steady, fast",            30,   4, 60,  2000, 0,  0  },
+    { "reconnect 40, fast",      30,   4, 40,  0,    10, 0  },
+    { "reconnect 40, idle",      1800, 4, 40,  0,    10, 0  },
+    { "reconnect 40, 1 packet",  1800, 1, 40,  0,    10, 0  },
+    { "reconnect 100",           30,   4, 100, 0,    10, 0  },
+    { "reconnect 40, 10% loss",  30,   4, 40,  0,    0,  10 }
+};
+
+static const scenario_t* scenario;
+
+/*****************************************************************************/
+/* Phone                                                                     */
+/*****************************************************************************/
+
+static const UUID controlPointUUID("69D1D8F3-45E1-49A8-9821-9BBDFDAAD9D9");
+static const UUID dataSourceUUID("22EAC6E9-24D6-4BB5-BE44-B36ACE7C7BFB");
+
+// categories of the notifications in turn, and the app that raises them
+static const uint8_t categories[] = { 4, 4, 4, 6, 6, 0, 5, 2, 1, 7 };
+
+typedef struct {
+    uint8_t categoryID;
+    const char* identifier;
+    const char* name;
+} app_t;
+
+static const app_t apps[] = {
+    { 0, "com.example.reminders", "Reminders" },
+    { 1, "com.apple.mobilephone", "Phone" },
+    { 2, "com.apple.mobilephone", "Phone" },
+    { 4, "com.example.chat", "Chat" },
+    { 5, "com.apple.mobilecal", "Calendar" },
+    { 6, "com.apple.mobilemail", "Mail" },
+    { 7, "com.example.news.reader.with.a.long.identifier", "A News Reader With A Long Name" }
+};
+
+typedef struct {
+    uint32_t raised;                    // ms
+    uint8_t categoryID;
+    uint8_t titleLength;
+    uint8_t messageLength;
+    const app_t* app;
+} notification_t;
+
+typedef struct {
+    uint64_t due;                       // ms
+    ANCSClient::Notification_t event;
+} source_event_t;
+
+typedef struct {
+    uint8_t data[MAX_RESPONSE_LENGTH];
+    uint16_t length;
+    uint16_t sent;
+    uint32_t readyEvent;
+} response_t;
+
+static notification_t notifications[MAX_NOTIFICATIONS];
+
+// Notification Source events in the order they are raised
+static source_event_t sourceEvents[MAX_EVENTS];
+static uint32_t sourceCount = 0;
+static uint32_t sourceRaised = 0;
+static uint32_t sourceSent = 0;
+
+static response_t responses[MAX_RESPONSES];
+static uint8_t responseHead = 0;
+static uint8_t responseCount = 0;
+
+static uint8_t command[MAX_COMMAND_LENGTH];
+static uint16_t commandLength = 0;
+static bool commandPending = false;
+
+static GattAttribute::Handle_t readHandle = 0;
+static bool readPending = false;
+
+static uint8_t discoveryEvents = 0;
+
+static uint64_t phoneUs = 0;
+static uint32_t phoneEvent = 0;
+static uint32_t intervalUs = 0;
+static uint32_t parameterUpdates = 0;
+
+static uint32_t commandsLost = 0;
+
+// notifications are raised relative to the connection
+static uint64_t connectedMs = 0;
+
+// trace capture read back from the firmware with -c
+static const char* capturePath = NULL;
+static uint8_t capture[65536];
+static uint32_t captureLength = 0;
+static uint32_t captureTotal = 0;
+static bool captureChunk = false;
+
+static uint32_t randomState = 2463534242UL;
+
+static uint32_t random32()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+static uint64_t ticks(uint64_t us)
+{
+    return us * minar::platform::Time_Base / 1000000;
+}
+
+static uint64_t nowMs()
+{
+    return minar::hostMilliseconds(minar::Scheduler::hostNow());
+}
+
+static const notification_t* lookup(uint32_t uid)
+{
+    return ((uid >= FIRST_UID) && (uid < FIRST_UID + (uint32_t) scenario->notifications)) ? &notifications[uid - FIRST_UID] : NULL;
+}
+
+// contents are derived from the UID so every alert can be checked
+static char content(uint32_t uid, uint16_t offset, uint8_t attributeID)
+{
+    return 'a' + (uid * 7 + offset * 3 + attributeID) % 26;
+}
+
+static const app_t* appFor(uint8_t categoryID)
+{
+    for (uint8_t idx = 0; idx < sizeof(apps) / sizeof(app_t); idx++)
+    {
+        if (apps[idx].categoryID == categoryID)
+        {
+            return &apps[idx];
+        }
+    }
+
+    return &apps[0];
+}
+
+static void generate()
+{
+    uint32_t spacing = scenario->spacing;
+
+    for (uint32_t idx = 0; idx < scenario->notifications; idx++)
+    {
+        notification_t& notification = notifications[idx];
+
+        notification.raised = idx * spacing;
+        notification.categoryID = categories[idx % sizeof(categories)];
+        notification.titleLength = 3 + random32() % 38;
+        notification.messageLength = 5 + random32() % 156;
+        notification.app = appFor(notification.categoryID);
+
+        source_event_t& added = sourceEvents[sourceCount++];
+
+        added.due = notification.raised;
+        added.event.eventID = ANCSClient::EventIDNotificationAdded;
+        added.event.eventFlags = (spacing == 0) ? ANCSClient::EventFlagPreExisting : 0;
+        added.event.categoryID = notification.categoryID;
+        added.event.categoryCount = 1 + idx / sizeof(categories);
+        added.event.notificationUID = FIRST_UID + idx;
+
+        // e.g., a message thread that grew while the watch was away
+        if ((idx > 0) && (random32() % 100 < scenario->modifiedPercent))
+        {
+            uint32_t earlier = random32() % idx;
+            source_event_t& modified = sourceEvents[sourceCount++];
+
+            modified.due = notification.raised;
+            modified.event = sourceEvents[0].event;
+            modified.event.eventID = ANCSClient::EventIDNotificationModified;
+            modified.event.categoryID = notifications[earlier].categoryID;
+            modified.event.notificationUID = FIRST_UID + earlier;
+        }
+    }
+}
+
+static response_t* queueResponse()
+{
+    if (responseCount == MAX_RESPONSES)
+    {
+        return NULL;
+    }
+
+    response_t* response = &responses[(responseHead + responseCount) % MAX_RESPONSES];
+
+    response->length = 0;
+    response->sent = 0;
+    response->readyEvent = phoneEvent + 1;
+
+    responseCount++;
+
+    return response;
+}
+
+static void put(response_t* response, uint8_t value)
+{
+    if (response->length < MAX_RESPONSE_LENGTH)
+    {
+        response->data[response->length++] = value;
+    }
+}
+
+static void putAttribute(response_t* response, uint8_t attributeID, uint16_t length, const char* data)
+{
+    put(response, attributeID);
+    put(response, length);
+    put(response, length >> 8);
+
+    for (uint16_t idx = 0; idx < length; idx++)
+    {
+        put(response, data[idx]);
+    }
+}
+
+/*
+    Answer the Control Point command as the phone would, or not at all if
+    the UID is unknown, which is how ANCS reports an error.
+*/
+static void answer()
+{
+    if (random32() % 100 < scenario->lossPercent)
+    {
+        commandsLost++;
+        return;
+    }
+
+    if ((commandLength >= 5) && (command[0] == 0))
+    {
+        uint32_t uid = command[1] | (command[2] << 8) | (command[3] << 16) | ((uint32_t) command[4] << 24);
+        const notification_t* notification = lookup(uid);
+        response_t* response = (notification) ? queueResponse() : NULL;
+
+        if (response == NULL)
+        {
+            return;
+        }
+
+        for (uint8_t idx = 0; idx < 5; idx++)
+        {
+            put(response, command[idx]);
+        }
+
+        for (uint16_t idx = 5; idx < commandLength; )
+        {
+            uint8_t attributeID = command[idx++];
+            uint16_t maxLength = 0xFFFF;
+
+            // only title, subtitle, and message carry a length
+            if ((attributeID >= ANCSClient::NotificationAttributeIDTitle) &&
+                (attributeID <= ANCSClient::NotificationAttributeIDMessage))
+            {
+                maxLength = command[idx] | (command[idx + 1] << 8);
+                idx += 2;
+            }
+
+            char value[256];
+            uint16_t length = 0;
+
+            if (attributeID == ANCSClient::NotificationAttributeIDAppIdentifier)
+            {
+                length = strlen(notification->app->identifier);
+                memcpy(value, notification->app->identifier, length);
+            }
+            else if ((attributeID == ANCSClient::NotificationAttributeIDTitle) ||
+                     (attributeID == ANCSClient::NotificationAttributeIDMessage))
+            {
+                length = (attributeID == ANCSClient::NotificationAttributeIDTitle) ? notification->titleLength
+                                                                                   : notification->messageLength;
+
+                for (uint16_t offset = 0; offset < length; offset++)
+                {
+                    value[offset] = content(uid, offset, attributeID);
+                }
+            }
+
+            length = (length > maxLength) ? maxLength : length;
+
+            putAttribute(response, attributeID, length, value);
+        }
+    }
+    else if ((commandLength >= 3) && (command[0] == 1))
+    {
+        const char* identifier = (const char*) &command[1];
+        uint16_t identifierLength = strnlen(identifier, commandLength - 1);
+        const app_t* app = NULL;
+
+        for (uint8_t idx = 0; idx < sizeof(apps) / sizeof(app_t); idx++)
+        {
+            if ((strlen(apps[idx].identifier) == identifierLength) &&
+                (memcmp(apps[idx].identifier, identifier, identifierLength) == 0))
+            {
+                app = &apps[idx];
+            }
+        }
+
+        response_t* response = (app) ? queueResponse() : NULL;
+
+        if (response == NULL)
+        {
+            return;
+        }
+
+        for (uint16_t idx = 0; idx < 1 + identifierLength + 1; idx++)
+        {
+            put(response, command[idx]);
+        }
+
+        putAttribute(response, 0, strlen(app->name), app->name);
+    }
+}
+
+static ble_error_t onDiscovery(Gap::Handle_t, const UUID&)
+{
+    discoveryEvents = DISCOVERY_EVENTS;
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onRead(Gap::Handle_t, GattAttribute::Handle_t handle)
+{
+    if (readPending)
+    {
+        return BLE_STACK_BUSY;
+    }
+
+    readHandle = handle;
+    readPending = true;
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onWrite(Gap::Handle_t, GattAttribute::Handle_t handle, uint16_t length, const uint8_t* value)
+{
+    // one write request at a time, as on the device
+    if (commandPending || (handle != CONTROL_POINT_HANDLE) || (length > MAX_COMMAND_LENGTH))
+    {
+        return BLE_STACK_BUSY;
+    }
+
+    memcpy(command, value, length);
+    commandLength = length;
+    commandPending = true;
+
+    return BLE_ERROR_NONE;
+}
+
+static void readDeclaration()
+{
+    GattAttribute::Handle_t value = readHandle + 1;
+    const UUID& uuid = (value == CONTROL_POINT_HANDLE) ? controlPointUUID : dataSourceUUID;
+    uint8_t declaration[3 + UUID::LENGTH_OF_LONG_UUID];
+
+    // properties, value handle, and the 128-bit UUID
+    declaration[0] = (value == CONTROL_POINT_HANDLE) ? 0x08 : 0x10;
+    declaration[1] = value;
+    declaration[2] = value >> 8;
+    memcpy(&declaration[3], uuid.getBaseUUID(), UUID::LENGTH_OF_LONG_UUID);
+
+    GattReadCallbackParams params = { CONNECTION_HANDLE, readHandle, 0, sizeof(declaration), declaration };
+
+    readPending = false;
+
+    BLE::Instance().gattClient().hostDataRead(params);
+}
+
+/*
+    One connection event: finish discovery, answer outstanding requests,
+    then send what the event has room for.
+*/
+static void connectionEvent()
+{
+    GattClient& client = BLE::Instance().gattClient();
+
+    if ((discoveryEvents > 0) && (--discoveryEvents == 0))
+    {
+        client.hostCharacteristic(DiscoveredCharacteristic(controlPointUUID, CONTROL_POINT_HANDLE - 1, CONTROL_POINT_HANDLE));
+        client.hostCharacteristic(DiscoveredCharacteristic(dataSourceUUID, DATA_SOURCE_HANDLE - 1, DATA_SOURCE_HANDLE));
+        client.hostDiscoveryDone();
+    }
+
+    if (readPending)
+    {
+        readDeclaration();
+    }
+
+    if (commandPending)
+    {
+        GattWriteCallbackParams params = { CONNECTION_HANDLE, CONTROL_POINT_HANDLE, GattClient::GATT_OP_WRITE_REQ, 0, 0, NULL };
+
+        answer();
+
+        commandPending = false;
+        client.hostDataWritten(params);
+    }
+
+    for (uint8_t packet = 0; packet < scenario->packetsPerEvent; packet++)
+    {
+        if (sourceSent < sourceRaised)
+        {
+            ANCSClient::hostNotification(sourceEvents[sourceSent++].event);
+        }
+        else if ((responseCount > 0) && (responses[responseHead].readyEvent <= phoneEvent))
+        {
+            response_t& response = responses[responseHead];
+            uint16_t length = response.length - response.sent;
+
+            length = (length > PACKET_LENGTH) ? PACKET_LENGTH : length;
+
+            GattHVXCallbackParams params = { CONNECTION_HANDLE, DATA_SOURCE_HANDLE, 1, length, &response.data[response.sent] };
+
+            response.sent += length;
+
+            if (response.sent == response.length)
+            {
+                responseHead = (responseHead + 1) % MAX_RESPONSES;
+                responseCount--;
+            }
+
+            client.hostHVX(params);
+        }
+    }
+
+    // accept the watch's latest request, at the slowest interval it allows
+    const Gap::host_state_t& gap = BLE::Instance().gap().hostState();
+
+    if (gap.parameterUpdates != parameterUpdates)
+    {
+        parameterUpdates = gap.parameterUpdates;
+        intervalUs = gap.requested.maxConnectionInterval * 1250;
+    }
+
+    phoneEvent++;
+}
+
+static bool phoneBusy()
+{
+    return (sourceSent < sourceCount) || (responseCount > 0) || commandPending || readPending || (discoveryEvents > 0);
+}
+
+/*****************************************************************************/
+/* Host                                                                      */
+/*****************************************************************************/
+
+static uint32_t alerts = 0;
+static uint32_t merged = 0;
+static uint32_t wrong = 0;
+static uint32_t latencies[MAX_EVENTS];
+
+static bool expectText(const char* text, uint32_t length, uint32_t uid, uint8_t attributeID, uint16_t fullLength)
+{
+    uint16_t expected = (fullLength > ANCS_ATTRIBUTE_MAX_LENGTH) ? ANCS_ATTRIBUTE_MAX_LENGTH : fullLength;
+
+    if (length < expected)
+    {
+        return false;
+    }
+
+    for (uint16_t offset = 0; offset < expected; offset++)
+    {
+        if (text[offset] != content(uid, offset, attributeID))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+    [16, offset, total, bytes], a piece of the trace capture
+*/
+static void onControl(const uint8_t* data, uint32_t length)
+{
+    CborReader cbor(data, length);
+    uint32_t items;
+    uint32_t type;
+    uint32_t offset;
+    const uint8_t* bytes;
+    uint32_t bytesLength;
+
+    if (cbor.readArray(&items) && (items == 4) &&
+        cbor.readUnsigned(&type) && (type == 16) &&
+        cbor.readUnsigned(&offset) && (offset == captureLength) &&
+        cbor.readUnsigned(&captureTotal) &&
+        cbor.readBytes(&bytes, &bytesLength) &&
+        (captureLength + bytesLength <= sizeof(capture)))
+    {
+        memcpy(&capture[captureLength], bytes, bytesLength);
+        captureLength += bytesLength;
+        captureChunk = true;
+    }
+}
+
+// [type, value] on ControlPort, as the host sends it
+static void sendControl(uint8_t type, uint32_t value)
+{
+    uint8_t message[5] = { 0x82, type };
+    uint8_t length = 2;
+
+    if (value < 24)
+    {
+        message[length++] = value;
+    }
+    else if (value < 0x100)
+    {
+        message[length++] = 0x18;
+        message[length++] = value;
+    }
+    else
+    {
+        message[length++] = 0x19;
+        message[length++] = value >> 8;
+        message[length++] = value;
+    }
+
+    MessageCenter::hostReceive(MessageCenter::ControlPort, message, length);
+}
+
+/*
+    Stop the capture and read it back a chunk at a time.
+*/
+static bool readCapture()
+{
+    sendControl(15, 0);
+
+    do
+    {
+        captureChunk = false;
+        sendControl(16, captureLength);
+
+        // the reply takes a transfer on the host link
+        minar::Scheduler::hostRunUntil(minar::Scheduler::hostNow() + ticks(100000));
+    }
+    while (captureChunk && (captureLength < captureTotal));
+
+    FILE* file = fopen(capturePath, "wb");
+
+    if ((captureLength == 0) || (captureLength != captureTotal) || (file == NULL) ||
+        (fwrite(capture, 1, captureLength, file) != captureLength))
+    {
+        printf("  capture: %u of %u bytes read, not written\n", captureLength, captureTotal);
+
+        if (file)
+        {
+            fclose(file);
+        }
+
+        return false;
+    }
+
+    fclose(file);
+
+    printf("  capture: %u bytes written to %s\n", captureLength, capturePath);
+    return true;
+}
+
+/*
+    [alert level, "title subtitle", "message", uid, final], followed by
+    "app" and by count and category count as the firmware was built.
+    Fragments, [uid, offset, final, bytes], and the other ports are not
+    checked.
+*/
+static void onHostMessage(uint16_t port, const uint8_t* data, uint32_t length)
+{
+    CborReader cbor(data, length);
+    uint32_t items;
+    uint32_t level;
+    const char* title;
+    uint32_t titleLength;
+    const char* message;
+    uint32_t messageLength;
+    uint32_t uid;
+    uint32_t final;
+    const char* app = NULL;
+    uint32_t appLength = 0;
+    uint32_t count = 1;
+    uint32_t categoryCount = 0;
+
+    if (port == MessageCenter::ControlPort)
+    {
+        onControl(data, length);
+        return;
+    }
+
+    if ((port != MessageCenter::AlertPort) ||
+        !cbor.readArray(&items) ||
+        !cbor.readUnsigned(&level) ||
+        (level >= FIRST_UID))
+    {
+        return;
+    }
+
+    alerts++;
+
+    // the UID comes with streaming, which is on unless built without
+    bool hasApp = (items == 6) || (items == 8);
+    bool hasCount = (items >= 7);
+
+    if ((items < 5) ||
+        !cbor.readText(&title, &titleLength) ||
+        !cbor.readText(&message, &messageLength) ||
+        !cbor.readUnsigned(&uid) ||
+        !cbor.readUnsigned(&final) ||
+        (hasApp && !cbor.readText(&app, &appLength)) ||
+        (hasCount && (!cbor.readUnsigned(&count) || !cbor.readUnsigned(&categoryCount))))
+    {
+        printf("  alert %u: not [level, title, message, uid, final, ...]\n", alerts);
+        wrong++;
+        return;
+    }
+
+    const notification_t* notification = lookup(uid);
+
+    // the subtitle is empty, the title is followed by the separator
+    bool correct = (notification != NULL) &&
+                   expectText(title, titleLength, uid, ANCSClient::NotificationAttributeIDTitle, notification->titleLength) &&
+                   (titleLength == ((notification->titleLength > ANCS_ATTRIBUTE_MAX_LENGTH) ? ANCS_ATTRIBUTE_MAX_LENGTH : notification->titleLength) + 1U) &&
+                   (title[titleLength - 1] == ' ') &&
+                   expectText(message, messageLength, uid, ANCSClient::NotificationAttributeIDMessage, notification->messageLength) &&
+                   (final == (notification->messageLength < ANCS_ATTRIBUTE_MAX_LENGTH)) &&
+                   (count >= 1);
+
+    // names longer than the cache holds are cut short
+    if (correct && hasApp)
+    {
+        uint32_t nameLength = strlen(notification->app->name);
+
+        nameLength = (nameLength > ANCS_APP_NAME_MAX_LENGTH) ? ANCS_APP_NAME_MAX_LENGTH : nameLength;
+        correct = (appLength == nameLength) && (memcmp(app, notification->app->name, nameLength) == 0);
+    }
+
+    if (!correct)
+    {
+        printf("  alert %u for uid %u does not match the phone\n", alerts, uid);
+        wrong++;
+        return;
+    }
+
+    merged += count - 1;
+
+    if (alerts <= MAX_EVENTS)
+    {
+        latencies[alerts - 1] = nowMs() - notification->raised - connectedMs;
+    }
+}
+
+static int compare(const void* a, const void* b)
+{
+    uint32_t first = *(const uint32_t*) a;
+    uint32_t second = *(const uint32_t*) b;
+
+    return (first > second) - (first < second);
+}
+
+/*
+    Boot the firmware, connect, and play the scenario's notifications.
+    Returns the exit status for the parent.
+*/
+static int run()
+{
+    generate();
+
+    BLE::Instance().gattClient().hostSetHandlers(onDiscovery, onRead, onWrite);
+    MessageCenter::hostSetSink(onHostMessage);
+
+    app_start(0, NULL);
+
+    // advertise for a while before the phone connects
+    minar::Scheduler::hostRunUntil(ticks(5000000));
+
+    if (capturePath)
+    {
+        sendControl(15, 1);
+    }
+
+    Gap::ConnectionParams_t connectionParams = { (uint16_t) (scenario->interval * 4 / 5),
+                                                 (uint16_t) (scenario->interval * 4 / 5),
+                                                 0, 600 };
+    Gap::ConnectionCallbackParams_t params;
+
+    memset(&params, 0, sizeof(params));
+    params.handle = CONNECTION_HANDLE;
+    params.role = Gap::PERIPHERAL;
+    params.peerAddrType = BLEProtocol::AddressType::RANDOM_PRIVATE_RESOLVABLE;
+    params.connectionParams = &connectionParams;
+
+    intervalUs = scenario->interval * 1000;
+    phoneUs = minar::Scheduler::hostNow() * 1000000 / minar::platform::Time_Base;
+    connectedMs = nowMs();
+
+    uint32_t wakeupsBefore = minar::Scheduler::hostWakeups();
+
+    BLE::Instance().gap().hostConnect(params);
+
+    // the client has subscribed by the time it reports the service
+    ANCSClient::hostServiceFound();
+
+    uint64_t lastRaised = notifications[scenario->notifications - 1].raised;
+
+    while (true)
+    {
+        phoneUs += intervalUs;
+        minar::Scheduler::hostRunUntil(ticks(phoneUs));
+
+        uint64_t elapsed = nowMs() - connectedMs;
+
+        while ((sourceRaised < sourceCount) && (sourceEvents[sourceRaised].due <= elapsed))
+        {
+            sourceRaised++;
+        }
+
+        connectionEvent();
+
+        if ((elapsed > lastRaised + SETTLE_MS) && !phoneBusy())
+        {
+            break;
+        }
+
+        if (elapsed > RUN_LIMIT_MS)
+        {
+            printf("  phone still busy after %lu s\n", RUN_LIMIT_MS / 1000);
+            return 1;
+        }
+    }
+
+    uint32_t wakeups = minar::Scheduler::hostWakeups() - wakeupsBefore;
+    uint32_t samples = (alerts < MAX_EVENTS) ? alerts : MAX_EVENTS;
+    uint64_t sum = 0;
+
+    qsort(latencies, samples, sizeof(uint32_t), compare);
+
+    for (uint32_t idx = 0; idx < samples; idx++)
+    {
+        sum += latencies[idx];
+    }
+
+    const NotificationScheduler::statistics_t& queue = ANCSManager::getQueueStatistics();
+    const AlertRateLimiter::statistics_t& rate = ANCSManager::getRateStatistics();
+    uint32_t heapCalls = MemoryMonitor::getStatistics().heapCalls;
+
+    printf("%-24s %6u %6u %5u %5u %5u %5u %7u %7u %7u %6u %6u\n",
+           scenario->name,
+           alerts,
+           merged,
+           queue.dropped + ANCSManager::getDroppedAlerts(),
+           rate.suppressed,
+           commandsLost,
+           queue.highWaterMark,
+           (samples) ? (uint32_t) (sum / samples) : 0,
+           (samples) ? latencies[samples / 2] : 0,
+           (samples) ? latencies[samples - 1] : 0,
+           wakeups,
+           heapCalls);
+
+    if (capturePath && !readCapture())
+    {
+        return 1;
+    }
+
+    return ((wrong == 0) && (alerts > 0) && (heapCalls == 0)) ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    bool passed = true;
+    uint8_t first = 0;
+    uint8_t last = sizeof(scenarios) / sizeof(scenario_t);
+
+    if ((argc == 4) && (strcmp(argv[1], "-c") == 0) && ((uint32_t) atoi(argv[2]) < last))
+    {
+        first = atoi(argv[2]);
+        last = first + 1;
+        capturePath = argv[3];
+    }
+    else if (argc != 1)
+    {
+        printf("usage: ancs_pipeline_harness [-c scenario capture.bin]\n");
+        return 1;
+    }
+
+    printf("%-24s %6s %6s %5s %5s %5s %5s %7s %7s %7s %6s %6s\n",
+           "scenario", "alerts", "merged", "drops", "suppr", "lost", "peak",
+           "avg ms", "p50 ms", "max ms", "wakes", "allocs");
+
+    for (uint8_t idx = first; idx < last; idx++)
+    {
+        fflush(stdout);
+
+        // the firmware keeps its state in statics, so each run gets a fresh process
+        pid_t child = fork();
+
+        if (child == 0)
+        {
+            scenario = &scenarios[idx];
+
+            int status = run();
+
+            fflush(stdout);
+            exit(status);
+        }
+
+        int status = 0;
+
+        if ((child < 0) || (waitpid(child, &status, 0) != child))
+        {
+            printf("%-24s could not be run\n", scenarios[idx].name);
+            passed = false;
+        }
+        else if (WIFSIGNALED(status))
+        {
+            printf("%-24s stopped by signal %d\n", scenarios[idx].name, WTERMSIG(status));
+            passed = false;
+        }
+        else if (WEXITSTATUS(status) != 0)
+        {
+            // error() in the firmware exits with 3, e.g., for heap use after init
+            if (WEXITSTATUS(status) != 1)
+            {
+                printf("%-24s firmware stopped, exit status %d\n", scenarios[idx].name, WEXITSTATUS(status));
+            }
+
+            passed = false;
+        }
+    }
+
+    return (passed) ? 0 : 1;
+}
@@ -0,0 +1,1277 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host test for CborSchema: every message the firmware sends on the
+    Control, Radio and Alert ports must be byte for byte what the Cbore
+    calls it replaced produce.
+
+    Build and run from this directory:
+
+        g++ -O2 -DTARGET_LIKE_WATCH -DADVERTISING_COMPANY_ID=0x0059 -DTRACE_CAPTURE=1 -Ihost -I../source \
+            cbor_schema_test.cpp $(find ../source host -name '*.cpp') -o cbor_schema_test
+        ./cbor_schema_test
+
+    cborg is not part of the host build, so Reference below stands in
+    for Cbore: definite lengths and the shortest head for every value,
+    written by the same array() and item() calls. Cbore has no byte
+    strings; Reference::bytes() writes them the same way under major
+    type 2, for the fields that only exist since CborSchema.
+
+    Each schema element is first encoded on its own at the values where
+    the CBOR head grows, and past its bound, where it must match
+    Reference given the clamped value or truncated string. Then the
+    firmware is booted with app_start and every message it sends is
+    compared with Reference called as the baseline called Cbore:
+
+        Radio       a scanner batch of found devices, with names of 0, 16
+                    and more than 16 characters, then the batch of the
+                    same devices lost
+        Control     [1, 1..4] for both connection roles, the reply to
+                    every command that answers, and [20] for an unknown
+                    and a malformed command
+        Alert       alerts with short, maximum-length, and over-length
+                    title, subtitle, message, and app name, and the
+                    fragments of a message streamed after [9, uid]
+
+    Values the firmware chose, e.g., statistics, are read back from the
+    message; the test checks that they are encoded as Cbore would have.
+    Exits with 1 if any check fails.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+#include "ble-ancs-client/ANCSClient.h"
+#include "message-center/MessageCenter.h"
+#include "minar/minar.h"
+
+#include "ancs/ANCSManager.h"
+#include "cbor/CborReader.h"
+#include "cbor/CborSchema.h"
+#include "log/LatencyTrace.h"
+#include "log/TraceCapture.h"
+#include "message/CommandDispatcher.h"
+#include "scanner/Scanner.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_MESSAGES 256
+#define MAX_MESSAGE_LENGTH 512
+#define MAX_STRING_LENGTH 320
+
+#define PACKET_LENGTH 20
+#define PACKETS_PER_EVENT 4
+#define MAX_COMMAND_LENGTH 64
+#define MAX_RESPONSE_LENGTH 1024
+#define INTERVAL_US 30000
+#define DISCOVERY_EVENTS 4
+#define WAIT_LIMIT_MS 10000
+#define CONNECTION_HANDLE 1
+#define SENSOR_HANDLE 2
+#define FIRST_UID 3000
+
+#define CONTROL_POINT_HANDLE 0x0010
+#define DATA_SOURCE_HANDLE 0x0013
+
+// as in ANCSManager.cpp, AppNameCache.h, and Scanner.cpp
+#define ALERT_LEVEL 1
+#define ATTRIBUTE_MAX_LENGTH 110
+#define APP_NAME_MAX_LENGTH 24
+#define FRAGMENT_LENGTH 64
+#define SCANNER_NAME_MAX 16
+#define SCANNER_EXPIRY_MS 10000
+
+// firmware entry point, see main.cpp
+void app_start(int, char *[]);
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        checks++;                                                           \
+        if (!(condition))                                                   \
+        {                                                                   \
+            failures++;                                                     \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #condition);   \
+        }                                                                   \
+    } while (0)
+
+/*****************************************************************************/
+/* Reference encoder                                                         */
+/*****************************************************************************/
+
+/*
+    Cbore's encoder, call for call: array(items), item(value), and
+    item(text, length), each with the shortest head.
+*/
+class Reference
+{
+public:
+    Reference()
+        :   length(0)
+    {}
+
+    Reference& array(uint32_t items)
+    {
+        return head(4, items);
+    }
+
+    Reference& item(uint32_t value)
+    {
+        return head(0, value);
+    }
+
+    Reference& item(int32_t value)
+    {
+        return (value < 0) ? head(1, (uint32_t) (-1 - value)) : head(0, value);
+    }
+
+    Reference& item(const char* text, uint32_t textLength)
+    {
+        head(3, textLength);
+        return raw((const uint8_t*) text, textLength);
+    }
+
+    // not in Cbore
+    Reference& bytes(const uint8_t* data, uint32_t dataLength)
+    {
+        head(2, dataLength);
+        return raw(data, dataLength);
+    }
+
+    const uint8_t* getData() const
+    {
+        return buffer;
+    }
+
+    uint32_t getLength() const
+    {
+        return length;
+    }
+
+private:
+    Reference& head(uint8_t type, uint32_t value)
+    {
+        type <<= 5;
+
+        if (value < 24)
+        {
+            put(type | value);
+        }
+        else if (value <= 0xFF)
+        {
+            put(type | 24);
+            put(value);
+        }
+        else if (value <= 0xFFFF)
+        {
+            put(type | 25);
+            put(value >> 8);
+            put(value);
+        }
+        else
+        {
+            put(type | 26);
+            put(value >> 24);
+            put(value >> 16);
+            put(value >> 8);
+            put(value);
+        }
+
+        return *this;
+    }
+
+    Reference& raw(const uint8_t* data, uint32_t dataLength)
+    {
+        for (uint32_t idx = 0; idx < dataLength; idx++)
+        {
+            put(data[idx]);
+        }
+
+        return *this;
+    }
+
+    void put(uint8_t value)
+    {
+        if (length < sizeof(buffer))
+        {
+            buffer[length++] = value;
+        }
+    }
+
+    uint8_t buffer[1024];
+    uint32_t length;
+};
+
+static bool same(const Reference& expected, const uint8_t* data, uint32_t length)
+{
+    if ((expected.getLength() != length) || (memcmp(expected.getData(), data, length) != 0))
+    {
+        printf("  expected");
+
+        for (uint32_t idx = 0; idx < expected.getLength(); idx++)
+        {
+            printf(" %02X", expected.getData()[idx]);
+        }
+
+        printf("\n  got     ");
+
+        for (uint32_t idx = 0; idx < length; idx++)
+        {
+            printf(" %02X", data[idx]);
+        }
+
+        printf("\n");
+
+        return false;
+    }
+
+    return true;
+}
+
+// letters from first on, so truncation shows which end was kept
+static const char* pattern(char first, uint32_t length)
+{
+    static char strings[8][MAX_STRING_LENGTH];
+    static uint8_t next = 0;
+
+    char* string = strings[next++ & 7];
+    char base = (first >= 'a') ? 'a' : 'A';
+
+    for (uint32_t idx = 0; idx < length; idx++)
+    {
+        string[idx] = base + ((first - base + idx) % 26);
+    }
+
+    string[length] = '\0';
+
+    return string;
+}
+
+/*****************************************************************************/
+/* Schema elements                                                           */
+/*****************************************************************************/
+
+static const uint32_t unsignedValues[] = {
+    0, 1, 23, 24, 255, 256, 65535, 65536, 0xFFFFFFFF
+};
+
+static const int32_t integerValues[] = {
+    0, 23, 24, 127, -1, -24, -25, -128
+};
+
+// lengths where the head grows, and the bound of the elements below
+static const uint32_t stringLengths[] = {
+    0, 23, 24, 255, 256, 300
+};
+
+template <typename Element>
+static bool encodes(const typename Element::value_type& value, const Reference& expected)
+{
+    uint8_t buffer[Element::MaxLength];
+    CborWriter cbor(buffer, sizeof(buffer));
+
+    Element::encode(cbor, value);
+
+    return same(expected, buffer, cbor.getLength());
+}
+
+static void testElements()
+{
+    // the bound is the longest encoding
+    CHECK(CborSchema::Unsigned<>::MaxLength == 5);
+    CHECK(CborSchema::Unsigned<23>::MaxLength == 1);
+    CHECK(CborSchema::Unsigned<24>::MaxLength == 2);
+    CHECK(CborSchema::Unsigned<0xFFFF>::MaxLength == 3);
+    CHECK((CborSchema::Integer<-128, 127>::MaxLength == 2));
+    CHECK((CborSchema::Integer<-24, 23>::MaxLength == 1));
+    CHECK(CborSchema::Text<300>::MaxLength == 303);
+    CHECK(CborSchema::Bytes<64>::MaxLength == 66);
+    CHECK((CborSchema::JoinedText<110, 110>::MaxLength == 223));
+    CHECK((CborSchema::List<CborSchema::Unsigned<0xFF>, 24>::MaxLength == 2 + 24 * 2));
+
+    for (uint32_t idx = 0; idx < sizeof(unsignedValues) / sizeof(uint32_t); idx++)
+    {
+        uint32_t value = unsignedValues[idx];
+
+        CHECK(encodes<CborSchema::Unsigned<> >(value, Reference().item(value)));
+        CHECK(encodes<CborSchema::Unsigned<0xFFFF> >(value, Reference().item((value > 0xFFFF) ? 0xFFFF : value)));
+        CHECK(encodes<CborSchema::Unsigned<23> >(value, Reference().item((value > 23) ? 23 : value)));
+    }
+
+    for (uint32_t idx = 0; idx < sizeof(integerValues) / sizeof(int32_t); idx++)
+    {
+        int32_t value = integerValues[idx];
+
+        CHECK((encodes<CborSchema::Integer<-128, 127> >(value, Reference().item(value))));
+    }
+
+    CHECK((encodes<CborSchema::Integer<-128, 127> >(-129, Reference().item((int32_t) -128))));
+    CHECK((encodes<CborSchema::Integer<-128, 127> >(128, Reference().item((int32_t) 127))));
+    CHECK((encodes<CborSchema::Integer<-1000, 1000> >(-257, Reference().item((int32_t) -257))));
+
+    for (uint32_t idx = 0; idx < sizeof(stringLengths) / sizeof(uint32_t); idx++)
+    {
+        uint32_t length = stringLengths[idx];
+        const char* text = pattern('A', length + 1);
+
+        CHECK(encodes<CborSchema::Text<300> >(CborSchema::text(text, length), Reference().item(text, length)));
+        CHECK(encodes<CborSchema::Bytes<300> >(CborSchema::bytes((const uint8_t*) text, length),
+                                               Reference().bytes((const uint8_t*) text, length)));
+
+        // past the bound the start is kept
+        CHECK(encodes<CborSchema::Text<24> >(CborSchema::text(text, length),
+                                             Reference().item(text, (length > 24) ? 24 : length)));
+    }
+
+    // the baseline joined title and subtitle in a buffer of its own
+    const uint32_t joinedLengths[][2] = { { 0, 0 }, { 4, 0 }, { 11, 11 }, { 12, 11 }, { 110, 110 }, { 150, 120 } };
+
+    for (uint32_t idx = 0; idx < sizeof(joinedLengths) / sizeof(joinedLengths[0]); idx++)
+    {
+        const char* first = pattern('A', joinedLengths[idx][0]);
+        const char* second = pattern('N', joinedLengths[idx][1]);
+        char joined[2 * ATTRIBUTE_MAX_LENGTH + 2];
+
+        int length = snprintf(joined, sizeof(joined), "%.*s %.*s",
+                              ATTRIBUTE_MAX_LENGTH, first, ATTRIBUTE_MAX_LENGTH, second);
+
+        CHECK((encodes<CborSchema::JoinedText<ATTRIBUTE_MAX_LENGTH, ATTRIBUTE_MAX_LENGTH> >(
+                   CborSchema::joined(first, joinedLengths[idx][0], second, joinedLengths[idx][1]),
+                   Reference().item(joined, length))));
+    }
+
+    // arrays and lists are a head and their items in order
+    typedef CborSchema::Array<CborSchema::Unsigned<>,
+                              CborSchema::Integer<-128, 127>,
+                              CborSchema::Text<24>,
+                              CborSchema::Bytes<6> > Mixed;
+
+    const uint8_t address[6] = { 1, 2, 3, 4, 5, 6 };
+    CborMessage<Mixed> mixed;
+    BlockStatic& block = mixed.encode(70000, -60, CborSchema::text("Watch", 5), CborSchema::bytes(address, 6));
+
+    CHECK(same(Reference().array(4).item(70000).item((int32_t) -60).item("Watch", 5).bytes(address, 6),
+               block.getData(), block.getLength()));
+
+    uint32_t items[30];
+
+    for (uint32_t idx = 0; idx < 30; idx++)
+    {
+        items[idx] = idx * 20;
+    }
+
+    const uint32_t counts[] = { 0, 1, 23, 24, 30 };
+
+    for (uint32_t idx = 0; idx < sizeof(counts) / sizeof(uint32_t); idx++)
+    {
+        // a list longer than its bound is cut at the bound
+        uint32_t count = (counts[idx] > 24) ? 24 : counts[idx];
+        Reference expected;
+
+        expected.array(count);
+
+        for (uint32_t item = 0; item < count; item++)
+        {
+            expected.item(items[item]);
+        }
+
+        CHECK((encodes<CborSchema::List<CborSchema::Unsigned<>, 24> >(CborSchema::list(items, counts[idx]), expected)));
+    }
+}
+
+/*****************************************************************************/
+/* Messages the firmware sent                                                */
+/*****************************************************************************/
+
+typedef struct {
+    uint16_t port;
+    uint32_t length;
+    uint8_t data[MAX_MESSAGE_LENGTH];
+} message_t;
+
+static message_t messages[MAX_MESSAGES];
+static uint32_t messageCount = 0;
+
+static void onHostMessage(uint16_t port, const uint8_t* data, uint32_t length)
+{
+    if ((messageCount < MAX_MESSAGES) && (length <= MAX_MESSAGE_LENGTH))
+    {
+        messages[messageCount].port = port;
+        messages[messageCount].length = length;
+        memcpy(messages[messageCount].data, data, length);
+
+        messageCount++;
+    }
+    else
+    {
+        printf("message on port %u not kept\n", port);
+        failures++;
+    }
+}
+
+/*
+    Next message on port, from index on, that is an array of items
+    whose first is an unsigned value at least first.
+*/
+static const message_t* findMessage(uint32_t* index, uint16_t port, uint32_t items, uint32_t first)
+{
+    for ( ; *index < messageCount; (*index)++)
+    {
+        const message_t* message = &messages[*index];
+        CborReader cbor(message->data, message->length);
+        uint32_t count;
+        uint32_t value;
+
+        if ((message->port == port) &&
+            cbor.readArray(&count) && (count == items) &&
+            cbor.readUnsigned(&value) && (value >= first))
+        {
+            (*index)++;
+            return message;
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t ticks(uint64_t us)
+{
+    return us * minar::platform::Time_Base / 1000000;
+}
+
+static void runFor(uint32_t ms)
+{
+    minar::Scheduler::hostRunUntil(minar::Scheduler::hostNow() + ticks(ms * 1000));
+}
+
+/*****************************************************************************/
+/* Phone                                                                     */
+/*****************************************************************************/
+
+static const UUID controlPointUUID("69D1D8F3-45E1-49A8-9821-9BBDFDAAD9D9");
+static const UUID dataSourceUUID("22EAC6E9-24D6-4BB5-BE44-B36ACE7C7BFB");
+
+static const uint8_t phoneAddress[6] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+// attributes of the notification the phone has now
+typedef struct {
+    const char* title;
+    const char* subtitle;
+    const char* message;
+    const char* app;
+    bool overlong;                      // ignores the lengths requested
+} notification_t;
+
+static notification_t notification;
+
+static uint8_t command[MAX_COMMAND_LENGTH];
+static uint16_t commandLength = 0;
+static bool commandPending = false;
+
+static uint8_t response[MAX_RESPONSE_LENGTH];
+static uint16_t responseLength = 0;
+static uint16_t responseSent = 0;
+static bool responseReady = false;
+
+static uint8_t discoveryEvents = 0;
+
+static uint64_t phoneUs = 0;
+
+static void put(uint8_t value)
+{
+    if (responseLength < MAX_RESPONSE_LENGTH)
+    {
+        response[responseLength++] = value;
+    }
+}
+
+static void putAttribute(uint8_t attributeID, const char* value, uint16_t maxLength)
+{
+    uint16_t length = strlen(value);
+
+    length = (length > maxLength) ? maxLength : length;
+
+    put(attributeID);
+    put(length);
+    put(length >> 8);
+
+    for (uint16_t idx = 0; idx < length; idx++)
+    {
+        put(value[idx]);
+    }
+}
+
+/*
+    Get Notification Attributes or Get App Attributes, answered with the
+    current notification for any UID. Each UID has an app of its own.
+*/
+static void answer()
+{
+    responseLength = 0;
+    responseSent = 0;
+
+    if ((commandLength >= 5) && (command[0] == 0))
+    {
+        char identifier[24];
+
+        snprintf(identifier, sizeof(identifier), "com.example.app%u", command[1] | (command[2] << 8));
+
+        for (uint8_t idx = 0; idx < 5; idx++)
+        {
+            put(command[idx]);
+        }
+
+        for (uint16_t idx = 5; idx < commandLength; )
+        {
+            uint8_t attributeID = command[idx++];
+            uint16_t maxLength = 0xFFFF;
+
+            // only title, subtitle, and message carry a length
+            if ((attributeID >= ANCSClient::NotificationAttributeIDTitle) &&
+                (attributeID <= ANCSClient::NotificationAttributeIDMessage))
+            {
+                maxLength = (notification.overlong) ? 0xFFFF : (command[idx] | (command[idx + 1] << 8));
+                idx += 2;
+            }
+
+            const char* value = (attributeID == ANCSClient::NotificationAttributeIDAppIdentifier) ? identifier :
+                                (attributeID == ANCSClient::NotificationAttributeIDTitle) ? notification.title :
+                                (attributeID == ANCSClient::NotificationAttributeIDSubtitle) ? notification.subtitle :
+                                (attributeID == ANCSClient::NotificationAttributeIDMessage) ? notification.message : "";
+
+            putAttribute(attributeID, value, maxLength);
+        }
+    }
+    else if ((commandLength >= 3) && (command[0] == 1))
+    {
+        uint16_t identifierLength = strnlen((const char*) &command[1], commandLength - 1);
+
+        for (uint16_t idx = 0; idx < 1 + identifierLength + 1; idx++)
+        {
+            put(command[idx]);
+        }
+
+        putAttribute(0, notification.app, 0xFFFF);
+    }
+}
+
+static ble_error_t onDiscovery(Gap::Handle_t, const UUID&)
+{
+    discoveryEvents = DISCOVERY_EVENTS;
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onRead(Gap::Handle_t, GattAttribute::Handle_t)
+{
+    // nothing is cached on the first connection
+    return BLE_STACK_BUSY;
+}
+
+static ble_error_t onWrite(Gap::Handle_t, GattAttribute::Handle_t handle, uint16_t length, const uint8_t* value)
+{
+    if (commandPending || (handle != CONTROL_POINT_HANDLE) || (length > MAX_COMMAND_LENGTH))
+    {
+        return BLE_STACK_BUSY;
+    }
+
+    memcpy(command, value, length);
+    commandLength = length;
+    commandPending = true;
+
+    return BLE_ERROR_NONE;
+}
+
+/*
+    One connection event: finish discovery, acknowledge the command, and
+    send the response from the event after.
+*/
+static void connectionEvent()
+{
+    GattClient& client = BLE::Instance().gattClient();
+
+    if ((discoveryEvents > 0) && (--discoveryEvents == 0))
+    {
+        client.hostCharacteristic(DiscoveredCharacteristic(controlPointUUID, CONTROL_POINT_HANDLE - 1, CONTROL_POINT_HANDLE));
+        client.hostCharacteristic(DiscoveredCharacteristic(dataSourceUUID, DATA_SOURCE_HANDLE - 1, DATA_SOURCE_HANDLE));
+        client.hostDiscoveryDone();
+    }
+
+    if (responseReady)
+    {
+        for (uint8_t packet = 0; (packet < PACKETS_PER_EVENT) && (responseSent < responseLength); packet++)
+        {
+            uint16_t length = responseLength - responseSent;
+
+            length = (length > PACKET_LENGTH) ? PACKET_LENGTH : length;
+
+            GattHVXCallbackParams params = { CONNECTION_HANDLE, DATA_SOURCE_HANDLE, 1, length, &response[responseSent] };
+
+            responseSent += length;
+
+            client.hostHVX(params);
+        }
+
+        responseReady = (responseSent < responseLength);
+    }
+
+    if (commandPending && !responseReady)
+    {
+        GattWriteCallbackParams params = { CONNECTION_HANDLE, CONTROL_POINT_HANDLE, GattClient::GATT_OP_WRITE_REQ, 0, 0, NULL };
+
+        answer();
+
+        commandPending = false;
+        responseReady = (responseLength > 0);
+
+        client.hostDataWritten(params);
+    }
+}
+
+/*
+    Run connection events until a message of items on port arrives, or
+    the limit passes.
+*/
+static const message_t* waitFor(uint32_t* index, uint16_t port, uint32_t items, uint32_t first)
+{
+    uint64_t start = minar::Scheduler::hostNow();
+
+    while (minar::Scheduler::hostNow() - start < ticks(WAIT_LIMIT_MS * 1000))
+    {
+        uint32_t from = *index;
+        const message_t* message = findMessage(&from, port, items, first);
+
+        if (message)
+        {
+            *index = from;
+            return message;
+        }
+
+        phoneUs += INTERVAL_US;
+        minar::Scheduler::hostRunUntil(ticks(phoneUs));
+
+        connectionEvent();
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+/* Control                                                                   */
+/*****************************************************************************/
+
+/*
+    Decode [values...] of count unsigned items and check the message is
+    what Cbore writes for them.
+*/
+static bool checkUnsigned(const message_t* message, uint32_t* values, uint32_t count)
+{
+    if (message == NULL)
+    {
+        return false;
+    }
+
+    CborReader cbor(message->data, message->length);
+    uint32_t items;
+
+    if (!cbor.readArray(&items) || (items != count))
+    {
+        return false;
+    }
+
+    Reference expected;
+
+    expected.array(count);
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        if (!cbor.readUnsigned(&values[idx]))
+        {
+            return false;
+        }
+
+        expected.item(values[idx]);
+    }
+
+    return cbor.atEnd() && same(expected, message->data, message->length);
+}
+
+/*
+    Send a command on ControlPort and check the reply, an array of
+    count unsigned values starting with type.
+*/
+static bool sendCommand(const uint8_t* request, uint32_t requestLength, uint32_t type, uint32_t count, uint32_t* values)
+{
+    uint32_t index = messageCount;
+
+    MessageCenter::hostReceive(MessageCenter::ControlPort, request, requestLength);
+    runFor(200);
+
+    const message_t* message = findMessage(&index, MessageCenter::ControlPort, count, type);
+
+    if ((message == NULL) || !checkUnsigned(message, values, count) || (values[0] != type))
+    {
+        printf("  no reply [%u, ...] of %u items\n", type, count);
+        return false;
+    }
+
+    return true;
+}
+
+static void testConnectionEvents()
+{
+    uint32_t values[2];
+    uint32_t index = messageCount;
+
+    // watch as central, connected to a sensor it found
+    Gap::ConnectionParams_t connectionParams = { 24, 24, 0, 600 };
+    Gap::ConnectionCallbackParams_t params;
+
+    memset(&params, 0, sizeof(params));
+    params.handle = SENSOR_HANDLE;
+    params.role = Gap::CENTRAL;
+    params.peerAddrType = BLEProtocol::AddressType::RANDOM_STATIC;
+    params.connectionParams = &connectionParams;
+
+    BLE::Instance().gap().hostConnect(params);
+    runFor(100);
+
+    CHECK(checkUnsigned(findMessage(&index, MessageCenter::ControlPort, 2, 1), values, 2));
+    CHECK((values[0] == 1) && (values[1] == 3));
+
+    BLE::Instance().gap().hostDisconnect(SENSOR_HANDLE, Gap::REMOTE_USER_TERMINATED_CONNECTION);
+    runFor(100);
+
+    CHECK(checkUnsigned(findMessage(&index, MessageCenter::ControlPort, 2, 1), values, 2));
+    CHECK((values[0] == 1) && (values[1] == 4));
+}
+
+static void testControl()
+{
+    uint32_t values[16];
+
+    // [2]
+    const uint8_t advertising[] = { 0x81, 2 };
+    CHECK(sendCommand(advertising, sizeof(advertising), 2, 8, values));
+
+    // [10], [11]
+    const uint8_t ancs[] = { 0x81, 10 };
+    CHECK(sendCommand(ancs, sizeof(ancs), 10, 6, values));
+
+    const uint8_t suppression[] = { 0x81, 11 };
+    CHECK(sendCommand(suppression, sizeof(suppression), 11, 5, values));
+
+    // [12, 0] answers plain text, the only encoding Cbore had
+    const uint8_t encoding[] = { 0x82, 12, 0 };
+    CHECK(sendCommand(encoding, sizeof(encoding), 12, 2, values));
+    CHECK(values[1] == 0);
+
+    // [13], [14]
+    const uint8_t memory[] = { 0x81, 13 };
+    CHECK(sendCommand(memory, sizeof(memory), 13, 10, values));
+
+    const uint8_t timers[] = { 0x81, 14 };
+    CHECK(sendCommand(timers, sizeof(timers), 14, 5, values));
+
+    // [15, 0], capturing since testFirmware sent [15, 1]
+    const uint8_t captureOff[] = { 0x82, 15, 0 };
+    CHECK(sendCommand(captureOff, sizeof(captureOff), 15, 4, values));
+    CHECK(values[1] == 0);
+
+    // [17, 0]
+    const uint8_t batching[] = { 0x82, 17, 0 };
+    CHECK(sendCommand(batching, sizeof(batching), 17, 2, values));
+    CHECK(values[1] == 0);
+
+    // [18]
+    const uint8_t batches[] = { 0x81, 18 };
+    CHECK(sendCommand(batches, sizeof(batches), 18, 6, values));
+
+    // [19, port] for every port the test used
+    const uint16_t ports[] = { MessageCenter::ControlPort, MessageCenter::AlertPort, Scanner::ScannerPort };
+
+    for (uint8_t idx = 0; idx < sizeof(ports) / sizeof(uint16_t); idx++)
+    {
+        const uint8_t queue[] = { 0x82, 19, (uint8_t) ports[idx] };
+
+        CHECK(sendCommand(queue, sizeof(queue), 19, 7, values));
+        CHECK(values[1] == ports[idx]);
+        CHECK(values[2] > 0);
+    }
+
+    // [20] for an unknown command and one without its argument
+    const uint8_t unknown[] = { 0x81, 0x18, 99 };
+    CHECK(sendCommand(unknown, sizeof(unknown), 20, 4, values));
+    CHECK((values[1] == MessageCenter::ControlPort) && (values[2] == 99) && (values[3] == CommandDispatcher::RejectUnknown));
+
+    const uint8_t malformed[] = { 0x81, 3 };
+    CHECK(sendCommand(malformed, sizeof(malformed), 20, 4, values));
+    CHECK((values[1] == MessageCenter::ControlPort) && (values[2] == 3) && (values[3] == CommandDispatcher::RejectMalformed));
+
+    // [21] to [25]
+    const uint8_t dispatcher[] = { 0x81, 21 };
+    CHECK(sendCommand(dispatcher, sizeof(dispatcher), 21, 4, values));
+    CHECK(values[2] == 1);
+    CHECK(values[3] == 1);
+
+    const uint8_t handles[] = { 0x81, 22 };
+    CHECK(sendCommand(handles, sizeof(handles), 22, 5, values));
+    CHECK(values[2] == ANCSManager::getHandleCacheStatistics().misses);
+
+    const uint8_t builder[] = { 0x81, 23 };
+    CHECK(sendCommand(builder, sizeof(builder), 23, 5, values));
+
+    const uint8_t connection[] = { 0x81, 0x18, 24 };
+    CHECK(sendCommand(connection, sizeof(connection), 24, 5, values));
+
+    const uint8_t scanner[] = { 0x81, 0x18, 25 };
+    CHECK(sendCommand(scanner, sizeof(scanner), 25, 6, values));
+    CHECK(values[1] == Scanner::getStatistics().reports);
+    CHECK(values[5] == Scanner::getStatistics().batches);
+
+    // [7]: [7, [[count, min, max, mean, [buckets]], ...]]
+    uint32_t index = messageCount;
+    const uint8_t latency[] = { 0x81, 7 };
+
+    MessageCenter::hostReceive(MessageCenter::ControlPort, latency, sizeof(latency));
+    runFor(200);
+
+    const message_t* message = findMessage(&index, MessageCenter::ControlPort, 2, 7);
+    bool decoded = (message != NULL);
+    Reference expected;
+
+    if (message)
+    {
+        CborReader cbor(message->data, message->length);
+        uint32_t items;
+        uint32_t value;
+
+        decoded = cbor.readArray(&items) && cbor.readUnsigned(&value) &&
+                  cbor.readArray(&items) && (items == LatencyTrace::StageCount);
+
+        expected.array(2).item(7).array(LatencyTrace::StageCount);
+
+        for (uint8_t stage = 0; decoded && (stage < LatencyTrace::StageCount); stage++)
+        {
+            decoded = cbor.readArray(&items) && (items == 5);
+            expected.array(5);
+
+            for (uint8_t idx = 0; decoded && (idx < 4); idx++)
+            {
+                decoded = cbor.readUnsigned(&value);
+                expected.item(value);
+            }
+
+            decoded = decoded && cbor.readArray(&items) && (items == LATENCY_TRACE_BUCKETS);
+            expected.array(LATENCY_TRACE_BUCKETS);
+
+            for (uint8_t idx = 0; decoded && (idx < LATENCY_TRACE_BUCKETS); idx++)
+            {
+                decoded = cbor.readUnsigned(&value);
+                expected.item(value);
+            }
+        }
+
+        decoded = decoded && cbor.atEnd();
+    }
+
+    CHECK(decoded);
+    CHECK(decoded && same(expected, message->data, message->length));
+    CHECK(LatencyTrace::getHistogram(LatencyTrace::StageTotal).count > 0);
+
+    // [16, offset]: [16, offset, total, bytes]
+    for (uint32_t offset = 0; offset <= TRACE_CAPTURE_CHUNK; offset += TRACE_CAPTURE_CHUNK)
+    {
+        index = messageCount;
+
+        Reference read;
+
+        read.array(2).item(16).item(offset);
+
+        MessageCenter::hostReceive(MessageCenter::ControlPort, read.getData(), read.getLength());
+        runFor(200);
+
+        message = findMessage(&index, MessageCenter::ControlPort, 4, 16);
+        decoded = (message != NULL);
+
+        if (message)
+        {
+            CborReader cbor(message->data, message->length);
+            uint32_t items;
+            uint32_t first;
+            uint32_t at;
+            uint32_t total;
+            const uint8_t* chunk;
+            uint32_t chunkLength;
+
+            decoded = cbor.readArray(&items) && cbor.readUnsigned(&first) &&
+                      cbor.readUnsigned(&at) && cbor.readUnsigned(&total) &&
+                      cbor.readBytes(&chunk, &chunkLength) && cbor.atEnd();
+
+            CHECK(decoded && (at == offset));
+            CHECK(decoded && (total > 2 * TRACE_CAPTURE_CHUNK) && (chunkLength == TRACE_CAPTURE_CHUNK));
+            CHECK(decoded && same(Reference().array(4).item(16).item(at).item(total).bytes(chunk, chunkLength),
+                                  message->data, message->length));
+        }
+
+        CHECK(decoded);
+    }
+}
+
+/*****************************************************************************/
+/* Radio                                                                     */
+/*****************************************************************************/
+
+typedef struct {
+    uint8_t address[6];
+    int8_t rssi;
+    const char* name;                   // NULL for none
+} device_t;
+
+static device_t devices[] = {
+    { { 0xA0, 1, 2, 3, 4, 5 },  -1,   NULL },
+    { { 0xA1, 1, 2, 3, 4, 5 },  -24,  "" },
+    { { 0xA2, 1, 2, 3, 4, 5 },  -25,  "Sensor" },
+    { { 0xA3, 1, 2, 3, 4, 5 },  -128, NULL },
+    { { 0xA4, 1, 2, 3, 4, 5 },  20,   NULL },
+};
+
+static const uint8_t deviceCount = sizeof(devices) / sizeof(device_t);
+
+static void advertise(const device_t& device)
+{
+    uint8_t data[31];
+    uint8_t length = 0;
+
+    data[length++] = 2;
+    data[length++] = GapAdvertisingData::FLAGS;
+    data[length++] = GapAdvertisingData::LE_GENERAL_DISCOVERABLE | GapAdvertisingData::BREDR_NOT_SUPPORTED;
+
+    if (device.name)
+    {
+        uint8_t nameLength = strlen(device.name);
+
+        data[length++] = 1 + nameLength;
+        data[length++] = GapAdvertisingData::COMPLETE_LOCAL_NAME;
+        memcpy(&data[length], device.name, nameLength);
+        length += nameLength;
+    }
+
+    Gap::AdvertisementCallbackParams_t params;
+
+    memcpy(params.peerAddr, device.address, 6);
+    params.rssi = device.rssi;
+    params.isScanResponse = false;
+    params.type = GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED;
+    params.advertisingDataLen = length;
+    params.advertisingData = data;
+
+    BLE::Instance().gap().hostAdvertisement(params);
+}
+
+// next batch on ScannerPort, a list rather than [type, ...]
+static const message_t* findBatch(uint32_t* index)
+{
+    for ( ; *index < messageCount; (*index)++)
+    {
+        if (messages[*index].port == Scanner::ScannerPort)
+        {
+            return &messages[(*index)++];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Check a batch against Cbore writing every device reported with
+    event, in the order the batch has them.
+*/
+static void checkBatch(const message_t* message, uint8_t event)
+{
+    CHECK(message != NULL);
+
+    if (message == NULL)
+    {
+        return;
+    }
+
+    CborReader cbor(message->data, message->length);
+    uint32_t items;
+    bool seen[deviceCount] = { false };
+    Reference expected;
+
+    CHECK(cbor.readArray(&items) && (items == deviceCount));
+    expected.array(items);
+
+    for (uint32_t entry = 0; entry < items; entry++)
+    {
+        uint32_t fields;
+        uint32_t value;
+        const uint8_t* address;
+        uint32_t addressLength;
+        int32_t rssi;
+        const char* name;
+        uint32_t nameLength;
+
+        bool decoded = cbor.readArray(&fields) && (fields == 4) && cbor.readUnsigned(&value) &&
+                       cbor.readBytes(&address, &addressLength) && (addressLength == 6) &&
+                       cbor.readInteger(&rssi) && cbor.readText(&name, &nameLength);
+
+        CHECK(decoded);
+
+        if (!decoded)
+        {
+            return;
+        }
+
+        for (uint8_t idx = 0; idx < deviceCount; idx++)
+        {
+            const device_t& device = devices[idx];
+
+            if (memcmp(device.address, address, 6) == 0)
+            {
+                uint32_t length = (device.name) ? strlen(device.name) : 0;
+
+                seen[idx] = true;
+
+                expected.array(4)
+                        .item((uint32_t) event)
+                        .bytes(device.address, 6)
+                        .item((int32_t) device.rssi)
+                        .item(device.name, (length > SCANNER_NAME_MAX) ? SCANNER_NAME_MAX : length);
+            }
+        }
+    }
+
+    for (uint8_t idx = 0; idx < deviceCount; idx++)
+    {
+        CHECK(seen[idx]);
+    }
+
+    CHECK(same(expected, message->data, message->length));
+}
+
+static void testRadio()
+{
+    // a name at the scanner's bound and one past it
+    devices[0].name = pattern('a', SCANNER_NAME_MAX);
+    devices[3].name = pattern('k', SCANNER_NAME_MAX + 8);
+
+    uint32_t index = messageCount;
+
+    const uint8_t radio[] = { 0x82, 1, 1 };
+    const uint8_t scan[] = { 0x82, 2, 1 };
+
+    MessageCenter::hostReceive(MessageCenter::RadioPort, radio, sizeof(radio));
+    MessageCenter::hostReceive(MessageCenter::RadioPort, scan, sizeof(scan));
+    runFor(100);
+
+    CHECK(BLE::Instance().gap().hostState().scanning);
+
+    for (uint8_t idx = 0; idx < deviceCount; idx++)
+    {
+        advertise(devices[idx]);
+    }
+
+    runFor(2500);
+
+    checkBatch(findBatch(&index), Scanner::EventFound);
+
+    // nothing heard since, all are lost at once
+    runFor(SCANNER_EXPIRY_MS + 2500);
+
+    checkBatch(findBatch(&index), Scanner::EventLost);
+
+    const uint8_t stop[] = { 0x82, 2, 0 };
+
+    MessageCenter::hostReceive(MessageCenter::RadioPort, stop, sizeof(stop));
+    runFor(100);
+}
+
+/*****************************************************************************/
+/* Alert                                                                     */
+/*****************************************************************************/
+
+typedef struct {
+    uint32_t title;
+    uint32_t subtitle;
+    uint32_t message;
+    uint32_t app;
+    bool overlong;
+} lengths_t;
+
+static const lengths_t alertLengths[] = {
+    { 4,   0,   14,  8,  false },       // "title ", short strings
+    { 11,  11,  23,  23, false },       // text heads of one byte
+    { 12,  11,  24,  24, false },       // and of two
+    { 110, 0,   109, 0,  false },       // a complete message one short of the bound
+    { 110, 110, 110, 24, false },       // every string at its bound
+    { 150, 120, 300, 40, true },        // phone sent more than requested
+};
+
+static uint32_t lesser(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static void testAlerts()
+{
+    Gap::ConnectionParams_t connectionParams = { 24, 24, 0, 600 };
+    Gap::ConnectionCallbackParams_t params;
+    uint32_t values[2];
+    uint32_t index = messageCount;
+
+    memset(&params, 0, sizeof(params));
+    params.handle = CONNECTION_HANDLE;
+    params.role = Gap::PERIPHERAL;
+    params.peerAddrType = BLEProtocol::AddressType::PUBLIC;
+    params.connectionParams = &connectionParams;
+    memcpy(params.peerAddr, phoneAddress, sizeof(phoneAddress));
+
+    phoneUs = minar::Scheduler::hostNow() * 1000000 / minar::platform::Time_Base;
+
+    BLE::Instance().gap().hostConnect(params);
+
+    // the client has subscribed by the time it reports the service
+    ANCSClient::hostServiceFound();
+
+    CHECK(checkUnsigned(waitFor(&index, MessageCenter::ControlPort, 2, 1), values, 2));
+    CHECK((values[0] == 1) && (values[1] == 1));
+
+    uint32_t uid = FIRST_UID;
+
+    for (uint8_t idx = 0; idx < sizeof(alertLengths) / sizeof(lengths_t); idx++, uid++)
+    {
+        const lengths_t& lengths = alertLengths[idx];
+
+        notification.title = pattern('A' + idx, lengths.title);
+        notification.subtitle = pattern('N' + idx, lengths.subtitle);
+        notification.message = pattern('a' + idx, lengths.message);
+        notification.app = pattern('n' + idx, lengths.app);
+        notification.overlong = lengths.overlong;
+
+        ANCSClient::Notification_t event = { ANCSClient::EventIDNotificationAdded, 0, 4, (uint8_t) (idx + 1), uid };
+
+        ANCSClient::hostNotification(event);
+
+        const message_t* message = waitFor(&index, MessageCenter::AlertPort, 8, ALERT_LEVEL);
+
+        CHECK(message != NULL);
+
+        if (message == NULL)
+        {
+            continue;
+        }
+
+        // the baseline joined title and subtitle in a buffer
+        uint32_t titleLength = lesser(lengths.title, ATTRIBUTE_MAX_LENGTH);
+        uint32_t subtitleLength = lesser(lengths.subtitle, ATTRIBUTE_MAX_LENGTH);
+        uint32_t messageLength = lesser(lengths.message, ATTRIBUTE_MAX_LENGTH);
+        char joined[2 * ATTRIBUTE_MAX_LENGTH + 1];
+
+        memcpy(joined, notification.title, titleLength);
+        joined[titleLength] = ' ';
+        memcpy(&joined[titleLength + 1], notification.subtitle, subtitleLength);
+
+        Reference expected;
+
+        expected.array(8)
+                .item(ALERT_LEVEL)
+                .item(joined, titleLength + 1 + subtitleLength)
+                .item(notification.message, messageLength)
+                .item(uid)
+                .item((uint32_t) (lengths.message < ATTRIBUTE_MAX_LENGTH))
+                .item(notification.app, lesser(lengths.app, APP_NAME_MAX_LENGTH))
+                .item(1)
+                .item((uint32_t) (idx + 1));
+
+        CHECK(same(expected, message->data, message->length));
+    }
+
+    // the rest of the longest message, from where the alert stopped
+    uint32_t last = uid - 1;
+    const uint8_t rest[] = { 0x82, 9, 0x19, (uint8_t) (last >> 8), (uint8_t) last };
+
+    MessageCenter::hostReceive(MessageCenter::ControlPort, rest, sizeof(rest));
+
+    uint32_t messageLength = strlen(notification.message);
+
+    for (uint32_t offset = ATTRIBUTE_MAX_LENGTH; offset < messageLength; offset += FRAGMENT_LENGTH)
+    {
+        const message_t* message = waitFor(&index, MessageCenter::AlertPort, 4, FIRST_UID);
+        uint32_t length = lesser(messageLength - offset, FRAGMENT_LENGTH);
+        bool final = (offset + length == messageLength);
+
+        CHECK(message != NULL);
+
+        if (message)
+        {
+            Reference expected;
+
+            expected.array(4)
+                    .item(last)
+                    .item(offset)
+                    .item((uint32_t) final)
+                    .bytes((const uint8_t*) &notification.message[offset], length);
+
+            CHECK(same(expected, message->data, message->length));
+        }
+    }
+
+    BLE::Instance().gap().hostDisconnect(CONNECTION_HANDLE, Gap::REMOTE_USER_TERMINATED_CONNECTION);
+    runFor(100);
+
+    CHECK(checkUnsigned(findMessage(&index, MessageCenter::ControlPort, 2, 1), values, 2));
+    CHECK((values[0] == 1) && (values[1] == 2));
+}
+
+/*****************************************************************************/
+
+static void testFirmware()
+{
+    BLE::Instance().gattClient().hostSetHandlers(onDiscovery, onRead, onWrite);
+    MessageCenter::hostSetSink(onHostMessage);
+
+    app_start(0, NULL);
+
+    runFor(5000);
+
+    // capture everything, for [16] to read back
+    uint32_t values[4];
+    const uint8_t capture[] = { 0x82, 15, 1 };
+
+    CHECK(sendCommand(capture, sizeof(capture), 15, 4, values));
+    CHECK(values[1] == 1);
+
+    testRadio();
+    testConnectionEvents();
+    testAlerts();
+    testControl();
+}
+
+int main()
+{
+    testElements();
+    testFirmware();
+
+    printf("%lu checks, %lu failed\n", (unsigned long) checks, (unsigned long) failures);
+
+    return (failures == 0) ? 0 : 1;
+}
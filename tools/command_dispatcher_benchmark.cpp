@@ -0,0 +1,383 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host benchmark of command decode cost, before and after the
+    CommandDispatcher table.
+
+    Build and run from this directory:
+
+        g++ -O2 -I../source command_dispatcher_benchmark.cpp ../source/message/CommandDispatcher.cpp -o command_dispatcher_benchmark
+        ./command_dispatcher_benchmark
+
+    Every entry in the command table from main.cpp is encoded once with a
+    typical argument.
+
+    before is the old receivedControl and receivedRadio: every item is
+    reached with at(n), which walks the array from the start, and the
+    handler is found by comparing types in turn. before, dump adds the
+    hex dump of the message the debug build printed first; it is formatted
+    into a buffer here instead of the console, so it understates the cost
+    on the device. after is CommandDispatcher::dispatch.
+
+    Both paths must hand the same argument to the same handler; the
+    program fails if they do not. EventLog::record is a no-op here. Cycle
+    counts are taken on the host and only indicate relative cost.
+*/
+
+#include "message/CommandDispatcher.h"
+#include "log/EventLog.h"
+#include "cbor/CborReader.h"
+#include "cbor/CborWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+
+#define MESSAGE_LENGTH 64
+#define ROUNDS 100000
+
+// stand-ins for the MessageCenter ports
+enum {
+    ControlPort = 1,
+    RadioPort   = 2
+};
+
+/*****************************************************************************/
+/* Event log stub                                                            */
+/*****************************************************************************/
+
+void EventLog::record(event_t) {}
+void EventLog::record(event_t, uint32_t) {}
+void EventLog::record(event_t, uint32_t, uint32_t) {}
+void EventLog::record(event_t, uint32_t, uint32_t, uint32_t) {}
+void EventLog::record(event_t, uint32_t, uint32_t, uint32_t, uint32_t) {}
+
+/*****************************************************************************/
+/* Handlers                                                                  */
+/*****************************************************************************/
+
+static uint32_t handled;
+static uint32_t checksum;
+
+static void handler(const CommandDispatcher::argument_t& argument)
+{
+    handled++;
+
+    // fold the argument in, so both paths can be compared
+    checksum = checksum * 31 + argument.value;
+    checksum = checksum * 31 + (uint32_t) argument.integer;
+    checksum = checksum * 31 + argument.length;
+    checksum = checksum * 31 + (argument.text ? (uint8_t) argument.text[0] : 0);
+    checksum = checksum * 31 + (argument.bytes ? argument.bytes[0] : 0);
+
+    for (uint8_t idx = 0; idx < CommandDispatcher::MaxValues; idx++)
+    {
+        checksum = checksum * 31 + argument.values[idx];
+    }
+}
+
+// the table in main.cpp, with every handler replaced
+static const CommandDispatcher::command_t commands[] = {
+    { ControlPort,   1, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,   2, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,   3, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,   4, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,   5, CommandDispatcher::ArgumentText,     handler },
+    { ControlPort,   6, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,   7, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,   8, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,   9, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,  10, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,  11, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,  12, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,  13, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,  14, CommandDispatcher::ArgumentNone,     handler },
+    { ControlPort,  15, CommandDispatcher::ArgumentUnsigned, handler },
+    { ControlPort,  16, CommandDispatcher::ArgumentUnsigned, handler },
+    { RadioPort,     1, CommandDispatcher::ArgumentUnsigned, handler },
+    { RadioPort,     2, CommandDispatcher::ArgumentUnsigned, handler },
+    { RadioPort,     3, CommandDispatcher::ArgumentUnsigned, handler },
+    { RadioPort,     4, CommandDispatcher::ArgumentUnsigned, handler },
+    { RadioPort,     5, CommandDispatcher::ArgumentInteger,  handler },
+    { RadioPort,     6, CommandDispatcher::ArgumentUnsigned, handler },
+    { RadioPort,     7, CommandDispatcher::ArgumentBytes,    handler },
+    { RadioPort,     8, CommandDispatcher::ArgumentText,     handler },
+    { RadioPort,     9, CommandDispatcher::ArgumentNone,     handler },
+    { RadioPort,    10, CommandDispatcher::ArgumentBytes,    handler },
+    { RadioPort,    11, CommandDispatcher::ArgumentList,     handler }
+};
+
+#define COMMANDS (sizeof(commands) / sizeof(CommandDispatcher::command_t))
+
+typedef struct {
+    uint8_t data[MESSAGE_LENGTH];
+    uint32_t length;
+} message_t;
+
+static message_t messages[COMMANDS];
+
+/*****************************************************************************/
+/* Before                                                                    */
+/*****************************************************************************/
+
+/*
+    Cborg::at(index): walk the array from the start to the item.
+*/
+static bool at(const uint8_t* data, uint32_t length, uint32_t index, CborReader* item)
+{
+    CborReader cbor(data, length);
+    uint32_t items;
+
+    if (!cbor.readArray(&items) || (index >= items))
+    {
+        return false;
+    }
+
+    for (uint32_t idx = 0; idx < index; idx++)
+    {
+        if (!cbor.skip())
+        {
+            return false;
+        }
+    }
+
+    *item = cbor;
+
+    return true;
+}
+
+static char dumpBuffer[2 * MESSAGE_LENGTH + 1];
+
+static bool dispatchBefore(uint16_t port, const uint8_t* data, uint32_t length, bool dump)
+{
+    if (dump)
+    {
+        for (uint32_t idx = 0; idx < length; idx++)
+        {
+            snprintf(&dumpBuffer[2 * idx], 3, "%02X", data[idx]);
+        }
+    }
+
+    CborReader item(data, length);
+    uint32_t type = 0;
+
+    if (!at(data, length, 0, &item) || !item.readUnsigned(&type))
+    {
+        return false;
+    }
+
+    // the if/else chain compared types one after another
+    const CommandDispatcher::command_t* command = NULL;
+
+    for (uint8_t idx = 0; idx < COMMANDS; idx++)
+    {
+        if ((commands[idx].port == port) && (commands[idx].type == type))
+        {
+            command = &commands[idx];
+            break;
+        }
+    }
+
+    if (command == NULL)
+    {
+        return false;
+    }
+
+    CommandDispatcher::argument_t argument;
+    memset(&argument, 0, sizeof(argument));
+
+    bool valid = true;
+
+    switch (command->argumentType)
+    {
+        case CommandDispatcher::ArgumentUnsigned:
+            valid = at(data, length, 1, &item) && item.readUnsigned(&argument.value);
+            break;
+        case CommandDispatcher::ArgumentInteger:
+            valid = at(data, length, 1, &item) && item.readInteger(&argument.integer);
+            break;
+        case CommandDispatcher::ArgumentText:
+            valid = at(data, length, 1, &item) && item.readText(&argument.text, &argument.length);
+            break;
+        case CommandDispatcher::ArgumentBytes:
+            valid = at(data, length, 1, &item) && item.readBytes(&argument.bytes, &argument.length);
+            break;
+        case CommandDispatcher::ArgumentList:
+            while (valid && (argument.length < CommandDispatcher::MaxValues) &&
+                   at(data, length, 1 + argument.length, &item))
+            {
+                valid = item.readUnsigned(&argument.values[argument.length]);
+                argument.length++;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (!valid)
+    {
+        return false;
+    }
+
+    command->handler(argument);
+
+    return true;
+}
+
+/*****************************************************************************/
+
+static void encode(const CommandDispatcher::command_t& command, message_t& message)
+{
+    static const uint8_t address[7] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x01 };
+    static const uint8_t uuid[16] = { 0x79, 0x05, 0xF4, 0x31, 0xB5, 0xCE, 0x4E, 0x99,
+                                      0xA4, 0x0F, 0x4B, 0x1E, 0x12, 0x2D, 0x00, 0xD0 };
+
+    CborWriter cbor(message.data, MESSAGE_LENGTH);
+
+    switch (command.argumentType)
+    {
+        case CommandDispatcher::ArgumentNone:
+            cbor.array(1).item((uint32_t) command.type);
+            break;
+        case CommandDispatcher::ArgumentUnsigned:
+            cbor.array(2).item((uint32_t) command.type).item((uint32_t) 1000 + command.type);
+            break;
+        case CommandDispatcher::ArgumentInteger:
+            cbor.array(2).item((uint32_t) command.type).item((int32_t) -8);
+            break;
+        case CommandDispatcher::ArgumentText:
+            cbor.array(2).item((uint32_t) command.type).item("Watch 2A", 8);
+            break;
+        case CommandDispatcher::ArgumentBytes:
+            if (command.type == 7)
+            {
+                cbor.array(2).item((uint32_t) command.type).bytes(uuid, sizeof(uuid));
+            }
+            else
+            {
+                cbor.array(2).item((uint32_t) command.type).bytes(address, sizeof(address));
+            }
+            break;
+        case CommandDispatcher::ArgumentList:
+            // [11, profile, min, max, latency, timeout]
+            cbor.array(6)
+                .item((uint32_t) command.type)
+                .item((uint32_t) 1)
+                .item((uint32_t) 12)
+                .item((uint32_t) 24)
+                .item((uint32_t) 0)
+                .item((uint32_t) 400);
+            break;
+    }
+
+    message.length = cbor.getLength();
+}
+
+static const char* argumentName(CommandDispatcher::argument_type_t type)
+{
+    static const char* const names[] = { "none", "unsigned", "integer", "text", "bytes", "list" };
+
+    return names[type];
+}
+
+int main()
+{
+    for (uint8_t idx = 0; idx < COMMANDS; idx++)
+    {
+        encode(commands[idx], messages[idx]);
+    }
+
+    bool passed = true;
+    uint64_t totals[3] = { 0, 0, 0 };
+
+    printf("cycles per command:\n");
+    printf("%-6s %-5s %-9s %6s %12s %12s %12s\n", "port", "type", "argument", "bytes", "before", "before, dump", "after");
+
+    for (uint8_t idx = 0; idx < COMMANDS; idx++)
+    {
+        const CommandDispatcher::command_t& command = commands[idx];
+        const message_t& message = messages[idx];
+
+        // same argument handed over both ways
+        handled = 0;
+        checksum = 0;
+        dispatchBefore(command.port, message.data, message.length, false);
+        uint32_t before = checksum;
+
+        checksum = 0;
+        CommandDispatcher::dispatch(commands, COMMANDS, command.port, message.data, message.length);
+        uint32_t after = checksum;
+
+        if ((handled != 2) || (before != after))
+        {
+            printf("port %u type %u: arguments differ\n", command.port, command.type);
+            passed = false;
+        }
+
+        uint64_t cycles[3];
+
+        for (uint8_t mode = 0; mode < 3; mode++)
+        {
+            uint64_t start = CYCLES();
+
+            for (uint32_t round = 0; round < ROUNDS; round++)
+            {
+                if (mode < 2)
+                {
+                    dispatchBefore(command.port, message.data, message.length, (mode == 1));
+                }
+                else
+                {
+                    CommandDispatcher::dispatch(commands, COMMANDS, command.port, message.data, message.length);
+                }
+            }
+
+            cycles[mode] = CYCLES() - start;
+            totals[mode] += cycles[mode];
+        }
+
+        printf("%-6s %-5u %-9s %6u %12.1f %12.1f %12.1f\n",
+               (command.port == ControlPort) ? "ctrl" : "radio",
+               command.type,
+               argumentName(command.argumentType),
+               message.length,
+               (double) cycles[0] / ROUNDS,
+               (double) cycles[1] / ROUNDS,
+               (double) cycles[2] / ROUNDS);
+    }
+
+    printf("%-6s %-5s %-9s %6s %12.1f %12.1f %12.1f\n", "mean", "", "", "",
+           (double) totals[0] / ((uint64_t) COMMANDS * ROUNDS),
+           (double) totals[1] / ((uint64_t) COMMANDS * ROUNDS),
+           (double) totals[2] / ((uint64_t) COMMANDS * ROUNDS));
+
+    // malformed and unknown commands are still rejected
+    static const uint8_t unknown[] = { 0x82, 0x18, 0x63, 0x01 };
+    static const uint8_t truncated[] = { 0x82, 0x05, 0x78, 0x10, 'a' };
+
+    passed = passed &&
+             !CommandDispatcher::dispatch(commands, COMMANDS, ControlPort, unknown, sizeof(unknown)) &&
+             !CommandDispatcher::dispatch(commands, COMMANDS, ControlPort, truncated, sizeof(truncated));
+
+    return (passed) ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2006-2015 ARM Limited
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decode the binary event log from a UART capture.
+
+Usage: decode_event_log.py [capture] < capture
+
+Lines starting with "#L " are log entries, "#D " reports dropped entries;
+everything else (DEBUGOUT output) is passed through unchanged. Event names
+and formats are read from source/log/EventLogEvents.h.
+"""
+
+import os
+import re
+import struct
+import sys
+
+EVENTS_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                             '..', 'source', 'log', 'EventLogEvents.h')
+
+EVENT_PATTERN = re.compile(r'EVENT\((0x[0-9A-Fa-f]+),\s*(\w+),\s*"([^"]*)"\)')
+
+CONVERSION_PATTERN = re.compile(r'%[-+ #0]*\d*(?:\.\d+)?([a-zA-Z%])')
+
+
+def load_events(path):
+    events = {}
+
+    with open(path) as header:
+        for match in EVENT_PATTERN.finditer(header.read()):
+            events[int(match.group(1), 16)] = (match.group(2), match.group(3))
+
+    return events
+
+
+def signed_arguments(fmt, args):
+    # arguments are recorded as uint32, %d ones were int32
+    conversions = [c for c in CONVERSION_PATTERN.findall(fmt) if c != '%']
+
+    return tuple(value - (1 << 32) if (index < len(conversions) and
+                                       conversions[index] in 'di' and
+                                       value >= (1 << 31)) else value
+                 for index, value in enumerate(args))
+
+
+def decode_entry(events, data):
+    event, count = struct.unpack_from('<BB', data)
+    timestamp, = struct.unpack_from('<I', data, 2)
+    args = struct.unpack_from('<%dI' % count, data, 6)
+
+    name, fmt = events.get(event, ('0x%02X' % event, ' '.join(['%u'] * count)))
+
+    try:
+        text = fmt % signed_arguments(fmt, args)
+    except TypeError:
+        text = '%s %s' % (fmt, args)
+
+    return '%10.6f %-16s %s' % (timestamp / 1e6, name, text)
+
+
+def main():
+    events = load_events(EVENTS_HEADER)
+    capture = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+
+    for line in capture:
+        line = line.rstrip('\r\n')
+
+        if line.startswith('#L '):
+            try:
+                print(decode_entry(events, bytearray.fromhex(line[3:])))
+            except (ValueError, struct.error):
+                print('malformed entry: %s' % line)
+        elif line.startswith('#D '):
+            print('--- %s entries dropped ---' % line[3:])
+        else:
+            print(line)
+
+
+if __name__ == '__main__':
+    main()
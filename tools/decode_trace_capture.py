@@ -0,0 +1,233 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2006-2015 ARM Limited
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decode and profile a trace capture read from the device.
+
+Usage: decode_trace_capture.py [-v] capture.bin
+
+The capture is the byte strings of the [16, offset, total, bytes] replies
+joined in offset order. Records are described in source/log/TraceCapture.h.
+Prints a summary of inputs, notification bursts, Data Source fragment
+sizes, connection parameter updates, notification to alert latency, and
+heap calls; -v also lists every record.
+"""
+
+import struct
+import sys
+
+RECORD_HEADER = struct.Struct('<BBBI')
+
+RECORDS = {
+    0x01: ('Connected', ['handle', 'role', 'peer type', 'min', 'max', 'latency', 'timeout']),
+    0x02: ('Disconnected', ['handle', 'reason']),
+    0x03: ('ParameterUpdate', ['profile', 'result']),
+    0x10: ('ServiceFound', []),
+    0x11: ('Notification', ['event', 'flags', 'category', 'count', 'uid']),
+    0x12: ('Characteristic', ['kind', 'handle']),
+    0x13: ('DataSource', ['connection', 'handle', 'length']),
+    0x14: ('AttributeData', ['attribute', 'length']),
+    0x15: ('Written', ['connection', 'handle']),
+    0x16: ('Read', ['connection', 'handle', 'offset', 'length']),
+    0x20: ('Received', ['port', 'length']),
+    0x30: ('AlertQueued', ['uid', 'length']),
+    0x31: ('HeapCall', ['size']),
+}
+
+# ANCS EventID
+EVENT_ADDED = 0
+EVENT_MODIFIED = 1
+
+# a storm is this many notifications within one second
+STORM_COUNT = 5
+
+
+class Record(object):
+    def __init__(self, kind, time, values, data):
+        self.kind = kind
+        self.time = time
+        self.values = values
+        self.data = data
+
+    @property
+    def name(self):
+        return RECORDS.get(self.kind, ('0x%02X' % self.kind, []))[0]
+
+    def value(self, field):
+        names = RECORDS.get(self.kind, ('', []))[1]
+        return self.values[names.index(field)]
+
+    def __str__(self):
+        names = RECORDS.get(self.kind, ('', []))[1]
+        fields = []
+
+        for idx, value in enumerate(self.values):
+            label = names[idx] if idx < len(names) else str(idx)
+            fields.append('%s %u' % (label, value))
+
+        if self.data:
+            fields.append('[%s]' % ''.join('%02X' % byte for byte in self.data))
+
+        return '%12.6f %-16s %s' % (self.time / 1e6, self.name, ' '.join(fields))
+
+
+def parse(capture):
+    records = []
+    offset = 0
+    previous = None
+    wraps = 0
+
+    while offset + RECORD_HEADER.size <= len(capture):
+        kind, count, length, stamp = RECORD_HEADER.unpack_from(capture, offset)
+        end = offset + RECORD_HEADER.size + 4 * count + length
+
+        if end > len(capture):
+            print('truncated record at offset %u' % offset)
+            break
+
+        values = struct.unpack_from('<%dI' % count, capture, offset + RECORD_HEADER.size)
+        data = bytearray(capture[end - length:end])
+
+        # us ticker wraps every 71 minutes; interrupts can reorder close stamps
+        if previous is not None and previous - stamp > 0x80000000:
+            wraps += 1
+
+        previous = stamp
+        records.append(Record(kind, (wraps << 32) + stamp, values, data))
+
+        offset = end
+
+    return records
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def summarise(records):
+    if not records:
+        print('no records')
+        return
+
+    start = records[0].time
+    span = (records[-1].time - start) / 1e6
+
+    print('%u records over %.3f s' % (len(records), span))
+    print('')
+
+    counts = {}
+
+    for record in records:
+        counts[record.name] = counts.get(record.name, 0) + 1
+
+    for name in sorted(counts):
+        print('  %-16s %u' % (name, counts[name]))
+
+    # notification bursts, e.g., the phone replaying everything on reconnect
+    arrivals = [record.time for record in records
+                if record.name == 'Notification' and record.value('event') in (EVENT_ADDED, EVENT_MODIFIED)]
+
+    if arrivals:
+        busiest = 0
+        storms = 0
+        first = 0
+
+        for last in range(len(arrivals)):
+            while arrivals[last] - arrivals[first] > 1000000:
+                first += 1
+
+            window = last - first + 1
+
+            if window == STORM_COUNT:
+                storms += 1
+
+            busiest = max(busiest, window)
+
+        print('')
+        print('notifications: %u, most in one second %u, storms of %u or more %u'
+              % (len(arrivals), busiest, STORM_COUNT, storms))
+
+    fragments = [record.value('length') for record in records if record.name == 'DataSource']
+
+    if fragments:
+        sizes = {}
+
+        for size in fragments:
+            sizes[size] = sizes.get(size, 0) + 1
+
+        print('')
+        print('data source fragments: %u' % len(fragments))
+
+        for size in sorted(sizes):
+            print('  %3u bytes  %u' % (size, sizes[size]))
+
+    updates = [record.value('result') for record in records if record.name == 'ParameterUpdate']
+
+    if updates:
+        rejected = len([result for result in updates if result != 0])
+
+        print('')
+        print('parameter updates: %u, rejected by the stack %u' % (len(updates), rejected))
+
+    # first arrival of a uid to the alert sent for it
+    pending = {}
+    latencies = []
+
+    for record in records:
+        if record.name == 'Notification' and record.value('event') in (EVENT_ADDED, EVENT_MODIFIED):
+            pending.setdefault(record.value('uid'), record.time)
+        elif record.name == 'AlertQueued' and record.value('uid') in pending:
+            latencies.append((record.time - pending.pop(record.value('uid'))) / 1000.0)
+
+    if latencies:
+        print('')
+        print('notification to alert: %u alerts, %u without one' % (len(latencies), len(pending)))
+        print('  p50 %.1f ms  p90 %.1f ms  max %.1f ms'
+              % (percentile(latencies, 0.5), percentile(latencies, 0.9), max(latencies)))
+
+    heap = [record.value('size') for record in records if record.name == 'HeapCall']
+
+    if heap:
+        allocations = [size for size in heap if size > 0]
+
+        print('')
+        print('heap calls after init: %u allocations, %u bytes, %u releases'
+              % (len(allocations), sum(allocations), len(heap) - len(allocations)))
+
+
+def main():
+    arguments = sys.argv[1:]
+    verbose = '-v' in arguments
+    arguments = [argument for argument in arguments if argument != '-v']
+
+    if len(arguments) != 1:
+        print(__doc__)
+        sys.exit(1)
+
+    with open(arguments[0], 'rb') as capture:
+        records = parse(bytearray(capture.read()))
+
+    if verbose:
+        for record in records:
+            print(record)
+
+        print('')
+
+    summarise(records)
+
+
+if __name__ == '__main__':
+    main()
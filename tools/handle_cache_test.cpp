@@ -0,0 +1,586 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host test for the ANCS handle cache.
+
+    Build and run from this directory:
+
+        g++ -O2 -DTARGET_LIKE_WATCH -DADVERTISING_COMPANY_ID=0x0059 -Ihost -I../source \
+            handle_cache_test.cpp $(find ../source host -name '*.cpp') -o handle_cache_test
+        ./handle_cache_test
+
+    HandleCache is first checked on a RamStorage of its own: erased
+    storage, eviction of the least recently stored peer, removal, and a
+    corrupted record. Then the firmware is booted with app_start, with
+    the RamStorage main.cpp gives ANCSManager, and the same phone
+    connects four times, each time with one notification waiting:
+
+        first           nothing cached, the handles are discovered
+        reconnect       cached handles, checked by reading declarations
+        service changed the phone's database moved, the first declaration
+                        read does not match, handles are discovered again
+        reconnect       the handles found after the change are cached
+
+    Each connection reports how many discoveries and declaration reads
+    the phone saw, and the time from the connection to the alert in
+    minar's virtual time; the difference between the first two is the
+    time the cache saves. Control [22] must report the counters
+    ANCSManager kept. Exits with 1 if any check fails.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+#include "ble-ancs-client/ANCSClient.h"
+#include "message-center/MessageCenter.h"
+#include "minar/minar.h"
+
+#include "ancs/ANCSManager.h"
+#include "ancs/HandleCache.h"
+#include "cbor/CborReader.h"
+#include "storage/RamStorage.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PACKET_LENGTH 20
+#define PACKETS_PER_EVENT 4
+#define MAX_COMMAND_LENGTH 64
+#define MAX_RESPONSE_LENGTH 256
+#define INTERVAL_US 30000
+#define DISCOVERY_EVENTS 4
+#define ALERT_LIMIT_MS 10000
+#define DISCONNECTED_MS 2000
+#define CONNECTION_HANDLE 1
+#define FIRST_UID 2000
+
+// the phone's database before and after the service changed
+#define CONTROL_POINT_HANDLE 0x0010
+#define DATA_SOURCE_HANDLE 0x0013
+#define MOVED_CONTROL_POINT_HANDLE 0x0020
+#define MOVED_DATA_SOURCE_HANDLE 0x0023
+
+// firmware entry point, see main.cpp
+void app_start(int, char *[]);
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        checks++;                                                           \
+        if (!(condition))                                                   \
+        {                                                                   \
+            failures++;                                                     \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #condition);   \
+        }                                                                   \
+    } while (0)
+
+/*****************************************************************************/
+/* HandleCache on its own storage                                            */
+/*****************************************************************************/
+
+static void setAddress(uint8_t address[6], uint8_t peer)
+{
+    for (uint8_t idx = 0; idx < 6; idx++)
+    {
+        address[idx] = peer + idx;
+    }
+}
+
+static void testCache()
+{
+    RamStorage<HandleCache::StorageLength> storage;
+    HandleCache cache;
+    HandleCache::handles_t handles;
+    uint8_t address[6];
+
+    cache.setStorage(&storage);
+
+    // erased storage holds nothing
+    setAddress(address, 1);
+    CHECK(!cache.find(0, address, &handles));
+
+    // fill every entry, then one more replaces the first stored
+    for (uint8_t peer = 1; peer <= ANCS_HANDLE_CACHE_ENTRIES + 1; peer++)
+    {
+        HandleCache::handles_t stored = { (uint16_t) (0x10 + peer), (uint16_t) (0x20 + peer) };
+
+        setAddress(address, peer);
+        CHECK(cache.store(0, address, stored));
+    }
+
+    setAddress(address, 1);
+    CHECK(!cache.find(0, address, &handles));
+
+    for (uint8_t peer = 2; peer <= ANCS_HANDLE_CACHE_ENTRIES + 1; peer++)
+    {
+        setAddress(address, peer);
+        CHECK(cache.find(0, address, &handles) &&
+              (handles.controlPoint == 0x10 + peer) &&
+              (handles.dataSource == 0x20 + peer));
+    }
+
+    // the address type is part of the key
+    setAddress(address, 2);
+    CHECK(!cache.find(1, address, &handles));
+
+    cache.remove(0, address);
+    CHECK(!cache.find(0, address, &handles));
+
+    // a record that fails its checksum reads as empty
+    uint8_t byte;
+
+    setAddress(address, 3);
+    CHECK(cache.find(0, address, &handles));
+
+    for (uint32_t offset = 0; offset < HandleCache::StorageLength; offset += HandleCache::RecordLength)
+    {
+        uint8_t record[HandleCache::RecordLength];
+
+        storage.read(offset, record, sizeof(record));
+
+        if (memcmp(&record[2], address, sizeof(address)) == 0)
+        {
+            byte = record[8] ^ 0x01;
+            storage.write(offset + 8, &byte, 1);
+        }
+    }
+
+    CHECK(!cache.find(0, address, &handles));
+
+    const HandleCache::statistics_t& statistics = cache.getStatistics();
+
+    CHECK(statistics.stores == ANCS_HANDLE_CACHE_ENTRIES + 1);
+    CHECK(statistics.invalidations == 1);
+}
+
+/*****************************************************************************/
+/* Phone                                                                     */
+/*****************************************************************************/
+
+static const UUID controlPointUUID("69D1D8F3-45E1-49A8-9821-9BBDFDAAD9D9");
+static const UUID dataSourceUUID("22EAC6E9-24D6-4BB5-BE44-B36ACE7C7BFB");
+
+// what the phone has at a moved handle instead, e.g., Notification Source
+static const UUID otherUUID("9FBF120D-6301-42D9-8C58-25E699A21DBD");
+
+static const uint8_t peerAddress[6] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+static GattAttribute::Handle_t controlPointHandle = CONTROL_POINT_HANDLE;
+static GattAttribute::Handle_t dataSourceHandle = DATA_SOURCE_HANDLE;
+
+static uint8_t command[MAX_COMMAND_LENGTH];
+static uint16_t commandLength = 0;
+static bool commandPending = false;
+
+static uint8_t response[MAX_RESPONSE_LENGTH];
+static uint16_t responseLength = 0;
+static uint16_t responseSent = 0;
+static bool responseReady = false;
+
+static GattAttribute::Handle_t readHandle = 0;
+static bool readPending = false;
+
+static uint8_t discoveryEvents = 0;
+
+static uint32_t discoveries = 0;
+static uint32_t reads = 0;
+
+static uint64_t phoneUs = 0;
+
+// alerts and [22] replies the firmware sent
+static uint32_t alerts = 0;
+static bool cacheReply = false;
+static uint32_t cacheValues[4];
+
+static void put(uint8_t value)
+{
+    if (responseLength < MAX_RESPONSE_LENGTH)
+    {
+        response[responseLength++] = value;
+    }
+}
+
+static void putAttribute(uint8_t attributeID, const char* value, uint16_t maxLength)
+{
+    uint16_t length = strlen(value);
+
+    length = (length > maxLength) ? maxLength : length;
+
+    put(attributeID);
+    put(length);
+    put(length >> 8);
+
+    for (uint16_t idx = 0; idx < length; idx++)
+    {
+        put(value[idx]);
+    }
+}
+
+/*
+    Get Notification Attributes or Get App Attributes, answered for any
+    UID and app. Each UID has an app of its own, so the rate limiter
+    lets every alert through.
+*/
+static void answer()
+{
+    responseLength = 0;
+    responseSent = 0;
+
+    if ((commandLength >= 5) && (command[0] == 0))
+    {
+        char identifier[24];
+
+        snprintf(identifier, sizeof(identifier), "com.example.app%u", command[1]);
+
+        for (uint8_t idx = 0; idx < 5; idx++)
+        {
+            put(command[idx]);
+        }
+
+        for (uint16_t idx = 5; idx < commandLength; )
+        {
+            uint8_t attributeID = command[idx++];
+            uint16_t maxLength = 0xFFFF;
+
+            // only title, subtitle, and message carry a length
+            if ((attributeID >= ANCSClient::NotificationAttributeIDTitle) &&
+                (attributeID <= ANCSClient::NotificationAttributeIDMessage))
+            {
+                maxLength = command[idx] | (command[idx + 1] << 8);
+                idx += 2;
+            }
+
+            const char* value = (attributeID == ANCSClient::NotificationAttributeIDAppIdentifier) ? identifier :
+                                (attributeID == ANCSClient::NotificationAttributeIDTitle) ? "Anna" :
+                                (attributeID == ANCSClient::NotificationAttributeIDMessage) ? "Lunch at noon?" : "";
+
+            putAttribute(attributeID, value, maxLength);
+        }
+    }
+    else if ((commandLength >= 3) && (command[0] == 1))
+    {
+        uint16_t identifierLength = strnlen((const char*) &command[1], commandLength - 1);
+
+        for (uint16_t idx = 0; idx < 1 + identifierLength + 1; idx++)
+        {
+            put(command[idx]);
+        }
+
+        putAttribute(0, "App", 0xFFFF);
+    }
+}
+
+static ble_error_t onDiscovery(Gap::Handle_t, const UUID&)
+{
+    discoveries++;
+    discoveryEvents = DISCOVERY_EVENTS;
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onRead(Gap::Handle_t, GattAttribute::Handle_t handle)
+{
+    if (readPending)
+    {
+        return BLE_STACK_BUSY;
+    }
+
+    reads++;
+    readHandle = handle;
+    readPending = true;
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onWrite(Gap::Handle_t, GattAttribute::Handle_t handle, uint16_t length, const uint8_t* value)
+{
+    // a write to a handle that moved reaches nothing that answers
+    if (commandPending || (handle != controlPointHandle) || (length > MAX_COMMAND_LENGTH))
+    {
+        return BLE_STACK_BUSY;
+    }
+
+    memcpy(command, value, length);
+    commandLength = length;
+    commandPending = true;
+
+    return BLE_ERROR_NONE;
+}
+
+static void readDeclaration()
+{
+    GattAttribute::Handle_t value = readHandle + 1;
+    const UUID& uuid = (value == controlPointHandle) ? controlPointUUID :
+                       (value == dataSourceHandle) ? dataSourceUUID : otherUUID;
+    uint8_t declaration[3 + UUID::LENGTH_OF_LONG_UUID];
+
+    // properties, value handle, and the 128-bit UUID
+    declaration[0] = (value == controlPointHandle) ? 0x08 : 0x10;
+    declaration[1] = value;
+    declaration[2] = value >> 8;
+    memcpy(&declaration[3], uuid.getBaseUUID(), UUID::LENGTH_OF_LONG_UUID);
+
+    GattReadCallbackParams params = { CONNECTION_HANDLE, readHandle, 0, sizeof(declaration), declaration };
+
+    readPending = false;
+
+    BLE::Instance().gattClient().hostDataRead(params);
+}
+
+/*
+    One connection event: finish discovery, answer outstanding requests,
+    and send the response that is ready.
+*/
+static void connectionEvent()
+{
+    GattClient& client = BLE::Instance().gattClient();
+
+    if ((discoveryEvents > 0) && (--discoveryEvents == 0))
+    {
+        client.hostCharacteristic(DiscoveredCharacteristic(controlPointUUID, controlPointHandle - 1, controlPointHandle));
+        client.hostCharacteristic(DiscoveredCharacteristic(dataSourceUUID, dataSourceHandle - 1, dataSourceHandle));
+        client.hostDiscoveryDone();
+    }
+
+    if (readPending)
+    {
+        readDeclaration();
+    }
+
+    // the response goes out from the event after the acknowledgement
+    if (responseReady)
+    {
+        for (uint8_t packet = 0; (packet < PACKETS_PER_EVENT) && (responseSent < responseLength); packet++)
+        {
+            uint16_t length = responseLength - responseSent;
+
+            length = (length > PACKET_LENGTH) ? PACKET_LENGTH : length;
+
+            GattHVXCallbackParams params = { CONNECTION_HANDLE, dataSourceHandle, 1, length, &response[responseSent] };
+
+            responseSent += length;
+
+            client.hostHVX(params);
+        }
+
+        responseReady = (responseSent < responseLength);
+    }
+
+    if (commandPending && !responseReady)
+    {
+        GattWriteCallbackParams params = { CONNECTION_HANDLE, controlPointHandle, GattClient::GATT_OP_WRITE_REQ, 0, 0, NULL };
+
+        answer();
+
+        commandPending = false;
+        responseReady = (responseLength > 0);
+
+        client.hostDataWritten(params);
+    }
+}
+
+static void onHostMessage(uint16_t port, const uint8_t* data, uint32_t length)
+{
+    CborReader cbor(data, length);
+    uint32_t items;
+    uint32_t first;
+
+    if (!cbor.readArray(&items) || !cbor.readUnsigned(&first))
+    {
+        return;
+    }
+
+    // [level, ...], not a fragment, [uid, ...]
+    if ((port == MessageCenter::AlertPort) && (items >= 5) && (first < FIRST_UID))
+    {
+        alerts++;
+    }
+    else if ((port == MessageCenter::ControlPort) && (items == 5) && (first == 22))
+    {
+        cacheReply = true;
+
+        for (uint8_t idx = 0; idx < 4; idx++)
+        {
+            cacheReply = cacheReply && cbor.readUnsigned(&cacheValues[idx]);
+        }
+    }
+}
+
+static uint64_t ticks(uint64_t us)
+{
+    return us * minar::platform::Time_Base / 1000000;
+}
+
+static uint64_t nowMs()
+{
+    return minar::hostMilliseconds(minar::Scheduler::hostNow());
+}
+
+/*****************************************************************************/
+/* Connections                                                               */
+/*****************************************************************************/
+
+typedef struct {
+    uint32_t discoveries;
+    uint32_t reads;
+    uint32_t alertMs;                   // from the connection, 0 if none came
+} connection_t;
+
+/*
+    Connect, report one new notification, and run connection events
+    until the alert arrives; then disconnect.
+*/
+static connection_t connect(const char* name, uint32_t uid)
+{
+    connection_t result = { discoveries, reads, 0 };
+    Gap::ConnectionParams_t connectionParams = { 24, 24, 0, 600 };
+    Gap::ConnectionCallbackParams_t params;
+
+    memset(&params, 0, sizeof(params));
+    params.handle = CONNECTION_HANDLE;
+    params.role = Gap::PERIPHERAL;
+    params.peerAddrType = BLEProtocol::AddressType::PUBLIC;
+    params.connectionParams = &connectionParams;
+    memcpy(params.peerAddr, peerAddress, sizeof(peerAddress));
+
+    uint64_t connectedMs = nowMs();
+    uint32_t alertsBefore = alerts;
+
+    phoneUs = minar::Scheduler::hostNow() * 1000000 / minar::platform::Time_Base;
+
+    BLE::Instance().gap().hostConnect(params);
+
+    // the client has subscribed by the time it reports the service
+    ANCSClient::hostServiceFound();
+
+    ANCSClient::Notification_t event = { ANCSClient::EventIDNotificationAdded, 0, 4, 1, uid };
+
+    ANCSClient::hostNotification(event);
+
+    while ((alerts == alertsBefore) && (nowMs() - connectedMs < ALERT_LIMIT_MS))
+    {
+        phoneUs += INTERVAL_US;
+        minar::Scheduler::hostRunUntil(ticks(phoneUs));
+
+        connectionEvent();
+    }
+
+    if (alerts > alertsBefore)
+    {
+        result.alertMs = nowMs() - connectedMs;
+    }
+
+    result.discoveries = discoveries - result.discoveries;
+    result.reads = reads - result.reads;
+
+    printf("%-16s %11u %5u %8u\n", name, result.discoveries, result.reads, result.alertMs);
+
+    BLE::Instance().gap().hostDisconnect(CONNECTION_HANDLE, Gap::REMOTE_USER_TERMINATED_CONNECTION);
+
+    discoveryEvents = 0;
+    commandPending = false;
+    responseReady = false;
+    readPending = false;
+
+    minar::Scheduler::hostRunUntil(minar::Scheduler::hostNow() + ticks(DISCONNECTED_MS * 1000));
+
+    return result;
+}
+
+static void checkStatistics(uint32_t hits, uint32_t misses, uint32_t stores, uint32_t invalidations)
+{
+    const HandleCache::statistics_t& statistics = ANCSManager::getHandleCacheStatistics();
+
+    CHECK(statistics.hits == hits);
+    CHECK(statistics.misses == misses);
+    CHECK(statistics.stores == stores);
+    CHECK(statistics.invalidations == invalidations);
+}
+
+static void testFirmware()
+{
+    BLE::Instance().gattClient().hostSetHandlers(onDiscovery, onRead, onWrite);
+    MessageCenter::hostSetSink(onHostMessage);
+
+    app_start(0, NULL);
+
+    // advertise for a while before the phone connects
+    minar::Scheduler::hostRunUntil(ticks(5000000));
+
+    printf("%-16s %11s %5s %8s\n", "connection", "discoveries", "reads", "alert ms");
+
+    connection_t first = connect("first", FIRST_UID);
+
+    CHECK(first.alertMs > 0);
+    CHECK(first.discoveries == 1);
+    CHECK(first.reads == 0);
+    checkStatistics(0, 1, 1, 0);
+
+    connection_t cached = connect("reconnect", FIRST_UID + 1);
+
+    CHECK(cached.alertMs > 0);
+    CHECK(cached.discoveries == 0);
+    CHECK(cached.reads == 2);
+    CHECK(cached.alertMs < first.alertMs);
+    checkStatistics(1, 1, 1, 0);
+
+    controlPointHandle = MOVED_CONTROL_POINT_HANDLE;
+    dataSourceHandle = MOVED_DATA_SOURCE_HANDLE;
+
+    connection_t changed = connect("service changed", FIRST_UID + 2);
+
+    CHECK(changed.alertMs > 0);
+    CHECK(changed.discoveries == 1);
+    CHECK(changed.reads == 1);
+    checkStatistics(2, 1, 2, 1);
+
+    connection_t moved = connect("reconnect", FIRST_UID + 3);
+
+    CHECK(moved.alertMs > 0);
+    CHECK(moved.discoveries == 0);
+    CHECK(moved.reads == 2);
+    checkStatistics(3, 1, 2, 1);
+
+    printf("\ncached handles save %d ms to the first alert\n", (int) first.alertMs - (int) cached.alertMs);
+
+    // [22] as the host sends it
+    const uint8_t request[2] = { 0x81, 22 };
+
+    MessageCenter::hostReceive(MessageCenter::ControlPort, request, sizeof(request));
+    minar::Scheduler::hostRunUntil(minar::Scheduler::hostNow() + ticks(100000));
+
+    const HandleCache::statistics_t& statistics = ANCSManager::getHandleCacheStatistics();
+
+    CHECK(cacheReply);
+    CHECK(cacheValues[0] == statistics.hits);
+    CHECK(cacheValues[1] == statistics.misses);
+    CHECK(cacheValues[2] == statistics.stores);
+    CHECK(cacheValues[3] == statistics.invalidations);
+
+    printf("[22, %u, %u, %u, %u]\n", cacheValues[0], cacheValues[1], cacheValues[2], cacheValues[3]);
+}
+
+int main()
+{
+    testCache();
+    testFirmware();
+
+    printf("%lu checks, %lu failed\n", (unsigned long) checks, (unsigned long) failures);
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ble-ancs-client/ANCSClient.h"
+
+#include <string.h>
+
+static ANCSClient::ServiceFoundHandler_t serviceFoundHandler = NULL;
+static ANCSClient::NotificationHandler_t notificationHandler = NULL;
+static ANCSClient::DataHandler_t dataHandler = NULL;
+static ANCSClient::HostRequestHandler_t requestHandler = NULL;
+static uint32_t requests = 0;
+
+void ANCSClient::init()
+{
+}
+
+void ANCSClient::registerServiceFoundHandlerTask(ServiceFoundHandler_t handler)
+{
+    serviceFoundHandler = handler;
+}
+
+void ANCSClient::registerNotificationHandlerTask(NotificationHandler_t handler)
+{
+    notificationHandler = handler;
+}
+
+void ANCSClient::registerDataHandlerTask(DataHandler_t handler)
+{
+    dataHandler = handler;
+}
+
+void ANCSClient::getNotificationAttribute(uint32_t notificationUID, notification_attribute_id_t attributeID, uint16_t maxLength)
+{
+    requests++;
+
+    if (requestHandler)
+    {
+        requestHandler(notificationUID, attributeID, maxLength);
+    }
+}
+
+void ANCSClient::hostSetRequestHandler(HostRequestHandler_t handler)
+{
+    requestHandler = handler;
+}
+
+void ANCSClient::hostServiceFound()
+{
+    if (serviceFoundHandler)
+    {
+        serviceFoundHandler();
+    }
+}
+
+void ANCSClient::hostNotification(const Notification_t& event)
+{
+    if (notificationHandler)
+    {
+        notificationHandler(event);
+    }
+}
+
+void ANCSClient::hostAttribute(const uint8_t* data, uint32_t length)
+{
+    if (dataHandler)
+    {
+        BlockDynamic* block = new BlockDynamic(length);
+
+        memcpy(block->getData(), data, length);
+
+        dataHandler(mbed::util::SharedPointer<BlockStatic>(block));
+    }
+}
+
+uint32_t ANCSClient::hostRequests()
+{
+    return requests;
+}
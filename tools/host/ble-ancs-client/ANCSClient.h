@@ -0,0 +1,116 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HOST_ANCS_CLIENT_H__
+#define __HOST_ANCS_CLIENT_H__
+
+#include "ble/BLE.h"
+#include "ble-blocktransfer/BlockStatic.h"
+#include "core-util/SharedPointer.h"
+
+/*
+    Host stand-in for ble-ancs-client. Discovery and subscription are left
+    to the host, which reports the service with hostServiceFound and plays
+    the phone's Notification Source with hostNotification. Attribute
+    requests go to the host's request handler and the answer comes back
+    through hostAttribute, which copies it into a BlockDynamic the way the
+    library does, so the sequential fetch allocates as on the device.
+*/
+namespace ANCS
+{
+    const ::UUID UUID("7905F431-B5CE-4E99-A40F-4B1E122D00D0");
+}
+
+class ANCSClient
+{
+public:
+    typedef enum {
+        CategoryIDOther                 = 0,
+        CategoryIDIncomingCall          = 1,
+        CategoryIDMissedCall            = 2,
+        CategoryIDVoicemail             = 3,
+        CategoryIDSocial                = 4,
+        CategoryIDSchedule              = 5,
+        CategoryIDEmail                 = 6,
+        CategoryIDNews                  = 7,
+        CategoryIDHealthAndFitness      = 8,
+        CategoryIDBusinessAndFinance    = 9,
+        CategoryIDLocation              = 10,
+        CategoryIDEntertainment         = 11
+    } category_id_t;
+
+    typedef enum {
+        EventIDNotificationAdded        = 0,
+        EventIDNotificationModified     = 1,
+        EventIDNotificationRemoved      = 2
+    } event_id_t;
+
+    typedef enum {
+        EventFlagSilent                 = 0x01,
+        EventFlagImportant              = 0x02,
+        EventFlagPreExisting            = 0x04,
+        EventFlagPositiveAction         = 0x08,
+        EventFlagNegativeAction         = 0x10
+    } event_flags_t;
+
+    typedef enum {
+        NotificationAttributeIDAppIdentifier        = 0,
+        NotificationAttributeIDTitle                = 1,
+        NotificationAttributeIDSubtitle             = 2,
+        NotificationAttributeIDMessage              = 3,
+        NotificationAttributeIDMessageSize          = 4,
+        NotificationAttributeIDDate                 = 5,
+        NotificationAttributeIDPositiveActionLabel  = 6,
+        NotificationAttributeIDNegativeActionLabel  = 7
+    } notification_attribute_id_t;
+
+    typedef struct {
+        uint8_t eventID;
+        uint8_t eventFlags;
+        uint8_t categoryID;
+        uint8_t categoryCount;
+        uint32_t notificationUID;
+    } Notification_t;
+
+    typedef void (*ServiceFoundHandler_t)(void);
+    typedef void (*NotificationHandler_t)(Notification_t event);
+    typedef void (*DataHandler_t)(mbed::util::SharedPointer<BlockStatic> block);
+
+    void init();
+
+    void registerServiceFoundHandlerTask(ServiceFoundHandler_t handler);
+    void registerNotificationHandlerTask(NotificationHandler_t handler);
+    void registerDataHandlerTask(DataHandler_t handler);
+
+    void getNotificationAttribute(uint32_t notificationUID, notification_attribute_id_t attributeID, uint16_t maxLength);
+
+    /*
+        Host side. The firmware has a single client, so these act on it
+        whichever object the firmware holds.
+    */
+    typedef void (*HostRequestHandler_t)(uint32_t notificationUID, uint8_t attributeID, uint16_t maxLength);
+
+    static void hostSetRequestHandler(HostRequestHandler_t handler);
+
+    static void hostServiceFound();
+    static void hostNotification(const Notification_t& event);
+    static void hostAttribute(const uint8_t* data, uint32_t length);
+
+    static uint32_t hostRequests();
+};
+
+#endif // __HOST_ANCS_CLIENT_H__
@@ -0,0 +1,83 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLOCK_STATIC_H__
+#define __HOST_BLOCK_STATIC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Host stand-in for ble-blocktransfer's BlockStatic and BlockDynamic,
+    enough for CborSchema and the host tools. Put tools/host first on the
+    include path.
+*/
+class BlockStatic
+{
+public:
+    BlockStatic(uint8_t* _data = NULL, uint32_t _length = 0)
+        :   data(_data),
+            length(_length),
+            maxLength(_length)
+    {}
+
+    virtual ~BlockStatic()
+    {}
+
+    uint8_t* getData() const
+    {
+        return data;
+    }
+
+    uint32_t getLength() const
+    {
+        return length;
+    }
+
+    uint32_t getMaxLength() const
+    {
+        return maxLength;
+    }
+
+    void setLength(uint32_t _length)
+    {
+        length = (_length > maxLength) ? maxLength : _length;
+    }
+
+protected:
+    uint8_t* data;
+    uint32_t length;
+    uint32_t maxLength;
+};
+
+class BlockDynamic : public BlockStatic
+{
+public:
+    BlockDynamic(uint32_t _length)
+        :   BlockStatic(new uint8_t[_length], _length)
+    {}
+
+    virtual ~BlockDynamic()
+    {
+        delete[] data;
+    }
+
+private:
+    BlockDynamic(const BlockDynamic&);
+    BlockDynamic& operator=(const BlockDynamic&);
+};
+
+#endif // __HOST_BLOCK_STATIC_H__
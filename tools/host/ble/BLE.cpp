@@ -0,0 +1,369 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ble/BLE.h"
+
+#define BLE_HOST_CALLBACKS 4
+
+template <typename Callback>
+class CallChain
+{
+public:
+    CallChain()
+        :   count(0)
+    {}
+
+    void add(Callback callback)
+    {
+        if (count < BLE_HOST_CALLBACKS)
+        {
+            callbacks[count++] = callback;
+        }
+    }
+
+    template <typename Params>
+    void call(const Params* params) const
+    {
+        for (uint8_t idx = 0; idx < count; idx++)
+        {
+            callbacks[idx](params);
+        }
+    }
+
+private:
+    Callback callbacks[BLE_HOST_CALLBACKS];
+    uint8_t count;
+};
+
+static Gap gap;
+static GattClient gattClient;
+static BLE ble;
+
+static Gap::host_state_t gapState;
+static Gap::AdvertisementReportCallback_t scanCallback = NULL;
+static CallChain<Gap::ConnectionEventCallback_t> connectionChain;
+static CallChain<Gap::DisconnectionEventCallback_t> disconnectionChain;
+
+static GattClient::CharacteristicCallback_t characteristicCallback = NULL;
+static bool discoveryActive = false;
+static CallChain<GattClient::ReadCallback_t> readChain;
+static CallChain<GattClient::WriteCallback_t> writeChain;
+static CallChain<GattClient::HVXCallback_t> hvxChain;
+
+static GattClient::HostDiscoveryHandler_t discoveryHandler = NULL;
+static GattClient::HostReadHandler_t readHandler = NULL;
+static GattClient::HostWriteHandler_t writeHandler = NULL;
+static uint32_t writes = 0;
+
+/*****************************************************************************/
+/* Gap                                                                       */
+/*****************************************************************************/
+
+ble_error_t Gap::setTxPower(int8_t txPower)
+{
+    gapState.txPower = txPower;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::setDeviceName(const uint8_t*)
+{
+    return BLE_ERROR_NONE;
+}
+
+void Gap::setAdvertisingType(GapAdvertisingParams::AdvertisingType)
+{
+}
+
+void Gap::setAdvertisingInterval(uint16_t intervalMs)
+{
+    gapState.advertisingIntervalMs = intervalMs;
+}
+
+ble_error_t Gap::startAdvertising()
+{
+    gapState.advertising = true;
+    gapState.advertisingStarts++;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::stopAdvertising()
+{
+    gapState.advertising = false;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::setAdvertisingPayload(const GapAdvertisingData& payload)
+{
+    gapState.payload = payload;
+    gapState.payloadsSet++;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::updateAdvertisingPayload(GapAdvertisingData::DataType type, const uint8_t* data, uint8_t length)
+{
+    GapAdvertisingData updated;
+    const uint8_t* payload = gapState.payload.getPayload();
+    bool found = false;
+
+    // same type and length replaced in place, as the stack requires
+    for (uint8_t idx = 0; idx + 1 < gapState.payload.getPayloadLen(); idx += payload[idx] + 1)
+    {
+        if ((payload[idx + 1] == type) && (payload[idx] == length + 1))
+        {
+            updated.addData(type, data, length);
+            found = true;
+        }
+        else
+        {
+            updated.addData((GapAdvertisingData::DataType) payload[idx + 1], &payload[idx + 2], payload[idx] - 1);
+        }
+    }
+
+    if (!found)
+    {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    gapState.payload = updated;
+    gapState.payloadsUpdated++;
+    return BLE_ERROR_NONE;
+}
+
+void Gap::clearScanResponse()
+{
+}
+
+ble_error_t Gap::accumulateScanResponse(GapAdvertisingData::DataType, const uint8_t*, uint8_t)
+{
+    gapState.scanResponsesSet++;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::setScanParams(uint16_t, uint16_t, uint16_t, bool)
+{
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::startScan(AdvertisementReportCallback_t callback)
+{
+    scanCallback = callback;
+    gapState.scanning = true;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::stopScan()
+{
+    gapState.scanning = false;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::connect(const Address_t, AddressType_t, const ConnectionParams_t*, const GapScanningParams*)
+{
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::disconnect(Handle_t, DisconnectionReason_t)
+{
+    gapState.disconnects++;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::updateConnectionParams(Handle_t, const ConnectionParams_t* params)
+{
+    gapState.requested = *params;
+    gapState.parameterUpdates++;
+    return BLE_ERROR_NONE;
+}
+
+void Gap::onConnection(ConnectionEventCallback_t callback)
+{
+    connectionChain.add(callback);
+}
+
+void Gap::onDisconnection(DisconnectionEventCallback_t callback)
+{
+    disconnectionChain.add(callback);
+}
+
+void Gap::hostConnect(const ConnectionCallbackParams_t& params)
+{
+    if (params.role == PERIPHERAL)
+    {
+        gapState.advertising = false;
+    }
+
+    connectionChain.call(&params);
+}
+
+void Gap::hostDisconnect(Handle_t handle, DisconnectionReason_t reason)
+{
+    DisconnectionCallbackParams_t params = { handle, reason };
+
+    discoveryActive = false;
+
+    disconnectionChain.call(&params);
+}
+
+bool Gap::hostAdvertisement(const AdvertisementCallbackParams_t& params)
+{
+    if (!gapState.scanning || (scanCallback == NULL))
+    {
+        return false;
+    }
+
+    scanCallback(&params);
+    return true;
+}
+
+const Gap::host_state_t& Gap::hostState() const
+{
+    return gapState;
+}
+
+/*****************************************************************************/
+/* GattClient                                                                */
+/*****************************************************************************/
+
+ble_error_t GattClient::launchServiceDiscovery(Gap::Handle_t connectionHandle,
+                                               ServiceCallback_t,
+                                               CharacteristicCallback_t callback,
+                                               const UUID& matchingServiceUUID)
+{
+    if (discoveryActive || (discoveryHandler == NULL))
+    {
+        return BLE_STACK_BUSY;
+    }
+
+    ble_error_t result = discoveryHandler(connectionHandle, matchingServiceUUID);
+
+    if (result == BLE_ERROR_NONE)
+    {
+        characteristicCallback = callback;
+        discoveryActive = true;
+    }
+
+    return result;
+}
+
+bool GattClient::isServiceDiscoveryActive() const
+{
+    return discoveryActive;
+}
+
+ble_error_t GattClient::read(Gap::Handle_t connectionHandle, GattAttribute::Handle_t attributeHandle, uint16_t)
+{
+    return (readHandler) ? readHandler(connectionHandle, attributeHandle) : BLE_STACK_BUSY;
+}
+
+ble_error_t GattClient::write(WriteOp_t,
+                              Gap::Handle_t connectionHandle,
+                              GattAttribute::Handle_t attributeHandle,
+                              uint16_t length,
+                              const uint8_t* value)
+{
+    ble_error_t result = (writeHandler) ? writeHandler(connectionHandle, attributeHandle, length, value) : BLE_STACK_BUSY;
+
+    writes += (result == BLE_ERROR_NONE) ? 1 : 0;
+
+    return result;
+}
+
+void GattClient::onDataRead(ReadCallback_t callback)
+{
+    readChain.add(callback);
+}
+
+void GattClient::onDataWritten(WriteCallback_t callback)
+{
+    writeChain.add(callback);
+}
+
+void GattClient::onHVX(HVXCallback_t callback)
+{
+    hvxChain.add(callback);
+}
+
+void GattClient::hostSetHandlers(HostDiscoveryHandler_t discovery, HostReadHandler_t read, HostWriteHandler_t write)
+{
+    discoveryHandler = discovery;
+    readHandler = read;
+    writeHandler = write;
+}
+
+void GattClient::hostCharacteristic(const DiscoveredCharacteristic& characteristic)
+{
+    if (discoveryActive && characteristicCallback)
+    {
+        characteristicCallback(&characteristic);
+    }
+}
+
+void GattClient::hostDiscoveryDone()
+{
+    discoveryActive = false;
+}
+
+void GattClient::hostDataRead(const GattReadCallbackParams& params)
+{
+    readChain.call(&params);
+}
+
+void GattClient::hostDataWritten(const GattWriteCallbackParams& params)
+{
+    writeChain.call(&params);
+}
+
+void GattClient::hostHVX(const GattHVXCallbackParams& params)
+{
+    hvxChain.call(&params);
+}
+
+uint32_t GattClient::hostWrites() const
+{
+    return writes;
+}
+
+/*****************************************************************************/
+/* BLE                                                                       */
+/*****************************************************************************/
+
+BLE& BLE::Instance(InstanceID_t)
+{
+    return ble;
+}
+
+ble_error_t BLE::init(InitializationCompleteCallback_t callback)
+{
+    InitializationCompleteCallbackContext context = { *this, BLE_ERROR_NONE };
+
+    if (callback)
+    {
+        callback(&context);
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+Gap& BLE::gap()
+{
+    return ::gap;
+}
+
+GattClient& BLE::gattClient()
+{
+    return ::gattClient;
+}
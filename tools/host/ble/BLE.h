@@ -0,0 +1,529 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLE_H__
+#define __HOST_BLE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Host stand-in for the BLE API. UUID, the AD type constants, and the
+    advertisement report are enough for AdvertisingParsing.h; Gap,
+    GattClient, and BLE are enough to build the firmware, see
+    host/ble/BLE.cpp. Every BLE object shares one Gap and one GattClient,
+    as on the device. Put tools/host first on the include path.
+
+    Members starting with host are not in the BLE API. The host uses them
+    to play the stack and the peer: deliver connections, notifications,
+    and read or write responses, and answer requests the firmware makes.
+*/
+typedef enum {
+    BLE_ERROR_NONE                      = 0,
+    BLE_ERROR_BUFFER_OVERFLOW           = 1,
+    BLE_ERROR_NOT_IMPLEMENTED           = 2,
+    BLE_ERROR_PARAM_OUT_OF_RANGE        = 3,
+    BLE_ERROR_INVALID_PARAM             = 4,
+    BLE_STACK_BUSY                      = 5,
+    BLE_ERROR_INVALID_STATE             = 6,
+    BLE_ERROR_NO_MEM                    = 7,
+    BLE_ERROR_OPERATION_NOT_PERMITTED   = 8,
+    BLE_ERROR_INITIALIZATION_INCOMPLETE = 9,
+    BLE_ERROR_ALREADY_INITIALIZED       = 10,
+    BLE_ERROR_UNSPECIFIED               = 11,
+    BLE_ERROR_INTERNAL_STACK_FAILURE    = 12
+} ble_error_t;
+
+class UUID
+{
+public:
+    typedef enum {
+        UUID_TYPE_SHORT = 0,
+        UUID_TYPE_LONG  = 1
+    } UUID_Type_t;
+
+    typedef enum {
+        MSB,
+        LSB
+    } ByteOrder_t;
+
+    typedef uint16_t ShortUUIDBytes_t;
+
+    static const unsigned LENGTH_OF_LONG_UUID = 16;
+    typedef uint8_t LongUUIDBytes_t[LENGTH_OF_LONG_UUID];
+
+    /*
+        "XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX", most significant byte
+        first; dashes are skipped.
+    */
+    UUID(const char* text)
+        :   type(UUID_TYPE_LONG),
+            shortUUID(0)
+    {
+        LongUUIDBytes_t longUUID;
+        uint8_t count = 0;
+
+        memset(longUUID, 0, sizeof(longUUID));
+
+        for (const char* digit = text; (*digit != '\0') && (count < 2 * LENGTH_OF_LONG_UUID); digit++)
+        {
+            int8_t value = hexValue(*digit);
+
+            if (value >= 0)
+            {
+                longUUID[count / 2] |= value << ((count % 2) ? 0 : 4);
+                count++;
+            }
+        }
+
+        setupLong(longUUID, MSB);
+    }
+
+    UUID(const LongUUIDBytes_t longUUID, ByteOrder_t order = MSB)
+        :   type(UUID_TYPE_LONG),
+            shortUUID(0)
+    {
+        setupLong(longUUID, order);
+    }
+
+    UUID(ShortUUIDBytes_t _shortUUID)
+        :   type(UUID_TYPE_SHORT),
+            shortUUID(_shortUUID)
+    {
+        memset(baseUUID, 0, sizeof(baseUUID));
+    }
+
+    UUID_Type_t shortOrLong() const
+    {
+        return type;
+    }
+
+    const uint8_t* getBaseUUID() const
+    {
+        return baseUUID;
+    }
+
+    ShortUUIDBytes_t getShortUUID() const
+    {
+        return shortUUID;
+    }
+
+    bool operator==(const UUID& other) const
+    {
+        if ((type == UUID_TYPE_SHORT) && (other.type == UUID_TYPE_SHORT))
+        {
+            return (shortUUID == other.shortUUID);
+        }
+
+        return (type == UUID_TYPE_LONG) && (other.type == UUID_TYPE_LONG) &&
+               (memcmp(baseUUID, other.baseUUID, LENGTH_OF_LONG_UUID) == 0);
+    }
+
+    bool operator!=(const UUID& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    static int8_t hexValue(char digit)
+    {
+        if ((digit >= '0') && (digit <= '9'))
+        {
+            return digit - '0';
+        }
+        else if ((digit >= 'a') && (digit <= 'f'))
+        {
+            return digit - 'a' + 10;
+        }
+        else if ((digit >= 'A') && (digit <= 'F'))
+        {
+            return digit - 'A' + 10;
+        }
+
+        return -1;
+    }
+
+    void setupLong(const LongUUIDBytes_t longUUID, ByteOrder_t order)
+    {
+        // stored little endian, like the stack
+        for (uint8_t idx = 0; idx < LENGTH_OF_LONG_UUID; idx++)
+        {
+            baseUUID[idx] = (order == MSB) ? longUUID[LENGTH_OF_LONG_UUID - 1 - idx] : longUUID[idx];
+        }
+
+        shortUUID = baseUUID[12] | (baseUUID[13] << 8);
+    }
+
+    UUID_Type_t type;
+    LongUUIDBytes_t baseUUID;
+    ShortUUIDBytes_t shortUUID;
+};
+
+namespace BLEProtocol
+{
+    struct AddressType {
+        enum Type {
+            PUBLIC = 0,
+            RANDOM_STATIC,
+            RANDOM_PRIVATE_RESOLVABLE,
+            RANDOM_PRIVATE_NON_RESOLVABLE
+        };
+    };
+
+    typedef AddressType::Type AddressType_t;
+}
+
+class GapAdvertisingData
+{
+public:
+    enum DataType_t {
+        FLAGS                              = 0x01,
+        INCOMPLETE_LIST_16BIT_SERVICE_IDS  = 0x02,
+        COMPLETE_LIST_16BIT_SERVICE_IDS    = 0x03,
+        INCOMPLETE_LIST_32BIT_SERVICE_IDS  = 0x04,
+        COMPLETE_LIST_32BIT_SERVICE_IDS    = 0x05,
+        INCOMPLETE_LIST_128BIT_SERVICE_IDS = 0x06,
+        COMPLETE_LIST_128BIT_SERVICE_IDS   = 0x07,
+        SHORTENED_LOCAL_NAME               = 0x08,
+        COMPLETE_LOCAL_NAME                = 0x09,
+        TX_POWER_LEVEL                     = 0x0A,
+        DEVICE_ID                          = 0x10,
+        SLAVE_CONNECTION_INTERVAL_RANGE    = 0x12,
+        LIST_128BIT_SOLICITATION_IDS       = 0x15,
+        SERVICE_DATA                       = 0x16,
+        APPEARANCE                         = 0x19,
+        ADVERTISING_INTERVAL               = 0x1A,
+        MANUFACTURER_SPECIFIC_DATA         = 0xFF
+    };
+    typedef enum DataType_t DataType;
+
+    enum Flags_t {
+        LE_LIMITED_DISCOVERABLE = 0x01,
+        LE_GENERAL_DISCOVERABLE = 0x02,
+        BREDR_NOT_SUPPORTED     = 0x04
+    };
+
+    static const uint8_t GAP_ADVERTISING_DATA_MAX_PAYLOAD = 31;
+
+    GapAdvertisingData()
+        :   payloadLength(0)
+    {
+        memset(payload, 0, sizeof(payload));
+    }
+
+    ble_error_t addData(DataType type, const uint8_t* data, uint8_t length)
+    {
+        if (payloadLength + 2 + length > GAP_ADVERTISING_DATA_MAX_PAYLOAD)
+        {
+            return BLE_ERROR_BUFFER_OVERFLOW;
+        }
+
+        payload[payloadLength++] = length + 1;
+        payload[payloadLength++] = type;
+        memcpy(&payload[payloadLength], data, length);
+        payloadLength += length;
+
+        return BLE_ERROR_NONE;
+    }
+
+    void clear()
+    {
+        payloadLength = 0;
+    }
+
+    const uint8_t* getPayload() const
+    {
+        return payload;
+    }
+
+    uint8_t getPayloadLen() const
+    {
+        return payloadLength;
+    }
+
+private:
+    uint8_t payload[GAP_ADVERTISING_DATA_MAX_PAYLOAD];
+    uint8_t payloadLength;
+};
+
+class GapAdvertisingParams
+{
+public:
+    enum AdvertisingType_t {
+        ADV_CONNECTABLE_UNDIRECTED,
+        ADV_CONNECTABLE_DIRECTED,
+        ADV_SCANNABLE_UNDIRECTED,
+        ADV_NON_CONNECTABLE_UNDIRECTED
+    };
+    typedef enum AdvertisingType_t AdvertisingType;
+};
+
+class GapScanningParams;
+
+class Gap
+{
+public:
+    static const unsigned ADDR_LEN = 6;
+    typedef uint8_t Address_t[ADDR_LEN];
+
+    typedef BLEProtocol::AddressType_t AddressType_t;
+    typedef uint16_t Handle_t;
+
+    enum Role_t {
+        PERIPHERAL  = 0x1,
+        CENTRAL     = 0x2
+    };
+
+    enum DisconnectionReason_t {
+        CONNECTION_TIMEOUT                          = 0x08,
+        REMOTE_USER_TERMINATED_CONNECTION           = 0x13,
+        REMOTE_DEV_TERMINATION_DUE_TO_LOW_RESOURCES = 0x14,
+        REMOTE_DEV_TERMINATION_DUE_TO_POWER_OFF     = 0x15,
+        LOCAL_HOST_TERMINATED_CONNECTION            = 0x16,
+        CONN_INTERVAL_UNACCEPTABLE                  = 0x3B
+    };
+
+    // intervals in 1.25 ms units, supervision timeout in 10 ms units
+    typedef struct {
+        uint16_t minConnectionInterval;
+        uint16_t maxConnectionInterval;
+        uint16_t slaveLatency;
+        uint16_t connectionSupervisionTimeout;
+    } ConnectionParams_t;
+
+    struct AdvertisementCallbackParams_t {
+        Address_t peerAddr;
+        int8_t rssi;
+        bool isScanResponse;
+        uint8_t type;
+        uint8_t advertisingDataLen;
+        const uint8_t* advertisingData;
+    };
+
+    struct ConnectionCallbackParams_t {
+        Handle_t handle;
+        Role_t role;
+        AddressType_t peerAddrType;
+        Address_t peerAddr;
+        AddressType_t ownAddrType;
+        Address_t ownAddr;
+        const ConnectionParams_t* connectionParams;
+    };
+
+    struct DisconnectionCallbackParams_t {
+        Handle_t handle;
+        DisconnectionReason_t reason;
+    };
+
+    typedef void (*ConnectionEventCallback_t)(const ConnectionCallbackParams_t* params);
+    typedef void (*DisconnectionEventCallback_t)(const DisconnectionCallbackParams_t* params);
+    typedef void (*AdvertisementReportCallback_t)(const AdvertisementCallbackParams_t* params);
+
+    ble_error_t setTxPower(int8_t txPower);
+    ble_error_t setDeviceName(const uint8_t* deviceName);
+
+    void setAdvertisingType(GapAdvertisingParams::AdvertisingType type);
+    void setAdvertisingInterval(uint16_t intervalMs);
+    ble_error_t startAdvertising();
+    ble_error_t stopAdvertising();
+
+    ble_error_t setAdvertisingPayload(const GapAdvertisingData& payload);
+    ble_error_t updateAdvertisingPayload(GapAdvertisingData::DataType type, const uint8_t* data, uint8_t length);
+    void clearScanResponse();
+    ble_error_t accumulateScanResponse(GapAdvertisingData::DataType type, const uint8_t* data, uint8_t length);
+
+    ble_error_t setScanParams(uint16_t interval, uint16_t window, uint16_t timeout, bool activeScanning);
+    ble_error_t startScan(AdvertisementReportCallback_t callback);
+    ble_error_t stopScan();
+
+    ble_error_t connect(const Address_t peerAddr,
+                        AddressType_t peerAddrType,
+                        const ConnectionParams_t* connectionParams,
+                        const GapScanningParams* scanParams);
+    ble_error_t disconnect(Handle_t connectionHandle, DisconnectionReason_t reason);
+    ble_error_t updateConnectionParams(Handle_t handle, const ConnectionParams_t* params);
+
+    void onConnection(ConnectionEventCallback_t callback);
+    void onDisconnection(DisconnectionEventCallback_t callback);
+
+    /*
+        Host side. Connection and disconnection run every callback in
+        registration order; a central connection stops advertising, as
+        the stack does.
+    */
+    void hostConnect(const ConnectionCallbackParams_t& params);
+    void hostDisconnect(Handle_t handle, DisconnectionReason_t reason);
+    bool hostAdvertisement(const AdvertisementCallbackParams_t& params);
+
+    typedef struct {
+        bool advertising;
+        bool scanning;
+        uint16_t advertisingIntervalMs;
+        int8_t txPower;
+        uint32_t advertisingStarts;
+        uint32_t payloadsSet;
+        uint32_t payloadsUpdated;
+        uint32_t scanResponsesSet;
+        uint32_t parameterUpdates;
+        uint32_t disconnects;
+        ConnectionParams_t requested;   // last updateConnectionParams
+        GapAdvertisingData payload;
+    } host_state_t;
+
+    const host_state_t& hostState() const;
+};
+
+class GattAttribute
+{
+public:
+    typedef uint16_t Handle_t;
+};
+
+struct GattReadCallbackParams {
+    Gap::Handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t* data;
+};
+
+struct GattWriteCallbackParams {
+    Gap::Handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    uint8_t writeOp;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t* data;
+};
+
+struct GattHVXCallbackParams {
+    Gap::Handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    uint8_t type;
+    uint16_t len;
+    const uint8_t* data;
+};
+
+class DiscoveredService;
+
+class DiscoveredCharacteristic
+{
+public:
+    DiscoveredCharacteristic(const UUID& _uuid, GattAttribute::Handle_t _declHandle, GattAttribute::Handle_t _valueHandle)
+        :   uuid(_uuid),
+            declHandle(_declHandle),
+            valueHandle(_valueHandle)
+    {}
+
+    const UUID& getUUID() const
+    {
+        return uuid;
+    }
+
+    GattAttribute::Handle_t getDeclHandle() const
+    {
+        return declHandle;
+    }
+
+    GattAttribute::Handle_t getValueHandle() const
+    {
+        return valueHandle;
+    }
+
+private:
+    UUID uuid;
+    GattAttribute::Handle_t declHandle;
+    GattAttribute::Handle_t valueHandle;
+};
+
+class GattClient
+{
+public:
+    enum WriteOp_t {
+        GATT_OP_WRITE_REQ = 0x01,
+        GATT_OP_WRITE_CMD = 0x02
+    };
+
+    typedef void (*ServiceCallback_t)(const DiscoveredService* service);
+    typedef void (*CharacteristicCallback_t)(const DiscoveredCharacteristic* characteristic);
+    typedef void (*ReadCallback_t)(const GattReadCallbackParams* params);
+    typedef void (*WriteCallback_t)(const GattWriteCallbackParams* params);
+    typedef void (*HVXCallback_t)(const GattHVXCallbackParams* params);
+
+    ble_error_t launchServiceDiscovery(Gap::Handle_t connectionHandle,
+                                       ServiceCallback_t serviceCallback,
+                                       CharacteristicCallback_t characteristicCallback,
+                                       const UUID& matchingServiceUUID);
+    bool isServiceDiscoveryActive() const;
+
+    ble_error_t read(Gap::Handle_t connectionHandle, GattAttribute::Handle_t attributeHandle, uint16_t offset);
+    ble_error_t write(WriteOp_t op,
+                      Gap::Handle_t connectionHandle,
+                      GattAttribute::Handle_t attributeHandle,
+                      uint16_t length,
+                      const uint8_t* value);
+
+    void onDataRead(ReadCallback_t callback);
+    void onDataWritten(WriteCallback_t callback);
+    void onHVX(HVXCallback_t callback);
+
+    /*
+        Host side. The peer answers requests through these handlers;
+        without one a request fails with BLE_STACK_BUSY. Responses are
+        delivered with the host functions below.
+    */
+    typedef ble_error_t (*HostDiscoveryHandler_t)(Gap::Handle_t connectionHandle, const UUID& service);
+    typedef ble_error_t (*HostReadHandler_t)(Gap::Handle_t connectionHandle, GattAttribute::Handle_t handle);
+    typedef ble_error_t (*HostWriteHandler_t)(Gap::Handle_t connectionHandle,
+                                              GattAttribute::Handle_t handle,
+                                              uint16_t length,
+                                              const uint8_t* value);
+
+    void hostSetHandlers(HostDiscoveryHandler_t discovery, HostReadHandler_t read, HostWriteHandler_t write);
+
+    void hostCharacteristic(const DiscoveredCharacteristic& characteristic);
+    void hostDiscoveryDone();
+    void hostDataRead(const GattReadCallbackParams& params);
+    void hostDataWritten(const GattWriteCallbackParams& params);
+    void hostHVX(const GattHVXCallbackParams& params);
+
+    uint32_t hostWrites() const;
+};
+
+class BLE
+{
+public:
+    typedef unsigned InstanceID_t;
+
+    static const InstanceID_t DEFAULT_INSTANCE = 0;
+
+    struct InitializationCompleteCallbackContext {
+        BLE& ble;
+        ble_error_t error;
+    };
+
+    typedef void (*InitializationCompleteCallback_t)(InitializationCompleteCallbackContext* context);
+
+    static BLE& Instance(InstanceID_t id = DEFAULT_INSTANCE);
+
+    // completes at once, the callback runs before init returns
+    ble_error_t init(InitializationCompleteCallback_t callback);
+
+    Gap& gap();
+    GattClient& gattClient();
+};
+
+#endif // __HOST_BLE_H__
@@ -0,0 +1,40 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HOST_CRITICAL_SECTION_LOCK_H__
+#define __HOST_CRITICAL_SECTION_LOCK_H__
+
+/*
+    Host stand-in; the host build has no interrupts to keep out.
+*/
+namespace mbed
+{
+namespace util
+{
+    class CriticalSectionLock
+    {
+    public:
+        CriticalSectionLock()
+        {}
+
+        ~CriticalSectionLock()
+        {}
+    };
+}
+}
+
+#endif // __HOST_CRITICAL_SECTION_LOCK_H__
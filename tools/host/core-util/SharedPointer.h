@@ -0,0 +1,124 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HOST_SHARED_POINTER_H__
+#define __HOST_SHARED_POINTER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Host stand-in for core-util's SharedPointer. The reference count is
+    allocated next to the object, as in the library, so the heap counters
+    see the same calls.
+*/
+namespace mbed
+{
+namespace util
+{
+    template <class T>
+    class SharedPointer
+    {
+    public:
+        SharedPointer()
+            :   pointer(NULL),
+                counter(NULL)
+        {}
+
+        SharedPointer(T* _pointer)
+            :   pointer(_pointer),
+                counter(NULL)
+        {
+            if (pointer)
+            {
+                counter = new uint32_t(1);
+            }
+        }
+
+        SharedPointer(const SharedPointer& other)
+            :   pointer(other.pointer),
+                counter(other.counter)
+        {
+            if (counter)
+            {
+                (*counter)++;
+            }
+        }
+
+        ~SharedPointer()
+        {
+            decrement();
+        }
+
+        SharedPointer& operator=(const SharedPointer& other)
+        {
+            if (this != &other)
+            {
+                decrement();
+
+                pointer = other.pointer;
+                counter = other.counter;
+
+                if (counter)
+                {
+                    (*counter)++;
+                }
+            }
+
+            return *this;
+        }
+
+        T* get() const
+        {
+            return pointer;
+        }
+
+        T* operator->() const
+        {
+            return pointer;
+        }
+
+        T& operator*() const
+        {
+            return *pointer;
+        }
+
+        uint32_t use_count() const
+        {
+            return (counter) ? *counter : 0;
+        }
+
+    private:
+        void decrement()
+        {
+            if (counter && (--(*counter) == 0))
+            {
+                delete pointer;
+                delete counter;
+            }
+
+            pointer = NULL;
+            counter = NULL;
+        }
+
+        T* pointer;
+        uint32_t* counter;
+    };
+}
+}
+
+#endif // __HOST_SHARED_POINTER_H__
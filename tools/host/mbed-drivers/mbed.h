@@ -0,0 +1,54 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HOST_MBED_H__
+#define __HOST_MBED_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minar/minar.h"
+
+/*
+    Host stand-in for the parts of mbed-drivers the firmware uses. The us
+    ticker follows minar's virtual time. NVIC_SystemReset and error() end
+    the program, as they end the firmware.
+*/
+typedef enum {
+    SPIS_MISO,
+    SPIS_MOSI,
+    SPIS_SCK,
+    SPIS_CSN,
+    SPIS_IRQ,
+    NC
+} PinName;
+
+typedef struct {
+    PinName pin_miso;
+    PinName pin_mosi;
+    PinName pin_sck;
+} spi_slave_config_t;
+
+uint32_t us_ticker_read(void);
+
+void NVIC_SystemReset(void);
+
+void error(const char* format, ...);
+
+#endif // __HOST_MBED_H__
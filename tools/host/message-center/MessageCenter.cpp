@@ -0,0 +1,155 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "message-center/MessageCenter.h"
+#include "minar/minar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESSAGE_CENTER_HOST_LISTENERS 8
+#define MESSAGE_CENTER_HOST_TRANSFERS 16
+
+typedef struct {
+    uint16_t port;
+    MessageCenter::listener_t listener;
+} listener_entry_t;
+
+typedef struct {
+    uint16_t port;
+    BlockStatic* block;
+    void (*callback)(void);
+} transfer_t;
+
+static listener_entry_t listeners[MESSAGE_CENTER_HOST_LISTENERS];
+static uint8_t listenerCount = 0;
+
+static transfer_t transfers[MESSAGE_CENTER_HOST_TRANSFERS];
+static uint8_t transferHead = 0;
+static uint8_t transferCount = 0;
+static bool transferring = false;
+
+static MessageCenter::sink_t sink = NULL;
+static uint32_t transferMs = 2;
+static uint32_t transferTotal = 0;
+
+static void startTransfer(void);
+
+static void transferDone()
+{
+    transfer_t& transfer = transfers[transferHead];
+
+    transferHead = (transferHead + 1) % MESSAGE_CENTER_HOST_TRANSFERS;
+    transferCount--;
+    transferring = false;
+    transferTotal++;
+
+    if (sink)
+    {
+        sink(transfer.port, transfer.block->getData(), transfer.block->getLength());
+    }
+
+    if (transfer.callback)
+    {
+        minar::Scheduler::postCallback(transfer.callback);
+    }
+
+    startTransfer();
+}
+
+static void startTransfer()
+{
+    if (transferring || (transferCount == 0))
+    {
+        return;
+    }
+
+    transferring = true;
+
+    minar::Scheduler::postCallback(transferDone)
+        .delay(minar::milliseconds(transferMs));
+}
+
+/*****************************************************************************/
+
+void MessageCenter::addTransportTask(host_t, MessageCenterTransport*)
+{
+}
+
+void MessageCenter::addListenerTask(host_t, uint16_t port, listener_t listener)
+{
+    if (listenerCount < MESSAGE_CENTER_HOST_LISTENERS)
+    {
+        listeners[listenerCount].port = port;
+        listeners[listenerCount].listener = listener;
+        listenerCount++;
+    }
+}
+
+void MessageCenter::sendTask(host_t, uint16_t port, BlockStatic& block, void (*callback)(void))
+{
+    // the library queues without bound; the firmware keeps far fewer in flight
+    if (transferCount == MESSAGE_CENTER_HOST_TRANSFERS)
+    {
+        fprintf(stderr, "message center: more than %u transfers pending\n", MESSAGE_CENTER_HOST_TRANSFERS);
+        abort();
+    }
+
+    transfer_t& transfer = transfers[(transferHead + transferCount) % MESSAGE_CENTER_HOST_TRANSFERS];
+
+    transfer.port = port;
+    transfer.block = &block;
+    transfer.callback = callback;
+    transferCount++;
+
+    startTransfer();
+}
+
+bool MessageCenter::hostReceive(uint16_t port, const uint8_t* data, uint32_t length)
+{
+    for (uint8_t idx = 0; idx < listenerCount; idx++)
+    {
+        if (listeners[idx].port == port)
+        {
+            listeners[idx].listener(BlockStatic((uint8_t*) data, length));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MessageCenter::hostSetSink(sink_t _sink)
+{
+    sink = _sink;
+}
+
+void MessageCenter::hostSetTransferMs(uint32_t ms)
+{
+    transferMs = ms;
+}
+
+uint32_t MessageCenter::hostTransfers()
+{
+    return transferTotal;
+}
+
+uint32_t MessageCenter::hostPending()
+{
+    return transferCount;
+}
@@ -0,0 +1,70 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HOST_MESSAGE_CENTER_H__
+#define __HOST_MESSAGE_CENTER_H__
+
+#include <stdint.h>
+
+#include "ble-blocktransfer/BlockStatic.h"
+
+/*
+    Host stand-in for message-center with one simulated SPI link to the
+    remote host. Transfers go out one at a time; each takes a fixed time,
+    after which its bytes are handed to the host sink and the sender's
+    callback is posted. Messages from the remote host are injected with
+    hostReceive and reach the listener for their port at once.
+*/
+class MessageCenterTransport
+{
+public:
+    virtual ~MessageCenterTransport()
+    {}
+};
+
+namespace MessageCenter
+{
+    typedef enum {
+        LocalHost,
+        RemoteHost
+    } host_t;
+
+    const uint16_t ControlPort  = 0x01;
+    const uint16_t RadioPort    = 0x02;
+    const uint16_t AlertPort    = 0x03;
+
+    typedef void (*listener_t)(BlockStatic block);
+    typedef void (*sink_t)(uint16_t port, const uint8_t* data, uint32_t length);
+
+    void addTransportTask(host_t host, MessageCenterTransport* transport);
+    void addListenerTask(host_t host, uint16_t port, listener_t listener);
+    void sendTask(host_t host, uint16_t port, BlockStatic& block, void (*callback)(void));
+
+    /*
+        Host side. Deliver a message to the firmware's listener for port;
+        returns false without one.
+    */
+    bool hostReceive(uint16_t port, const uint8_t* data, uint32_t length);
+
+    void hostSetSink(sink_t sink);
+    void hostSetTransferMs(uint32_t ms);
+
+    uint32_t hostTransfers();
+    uint32_t hostPending();
+}
+
+#endif // __HOST_MESSAGE_CENTER_H__
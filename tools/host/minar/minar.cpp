@@ -0,0 +1,231 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minar/minar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MINAR_HOST_CALLBACKS 128
+
+typedef struct {
+    minar::Scheduler::function_t function;
+    uint64_t due;
+    uint64_t sequence;
+    minar::tick_t period;
+    bool used;
+} entry_t;
+
+static entry_t entries[MINAR_HOST_CALLBACKS];
+static uint64_t now = 0;
+static uint64_t sequence = 0;
+static uint32_t dispatched = 0;
+static uint32_t wakeups = 0;
+static uint64_t lastWakeup = (uint64_t) -1;
+
+/*****************************************************************************/
+
+minar::Scheduler::CallbackAdder::CallbackAdder(function_t _function)
+    :   function(_function),
+        delayTicks(0),
+        periodTicks(0),
+        posted(false)
+{}
+
+// the copy posts, not the original
+minar::Scheduler::CallbackAdder::CallbackAdder(const CallbackAdder& other)
+    :   function(other.function),
+        delayTicks(other.delayTicks),
+        periodTicks(other.periodTicks),
+        posted(other.posted)
+{
+    other.posted = true;
+}
+
+minar::Scheduler::CallbackAdder::~CallbackAdder()
+{
+    if (!posted)
+    {
+        post();
+    }
+}
+
+minar::Scheduler::CallbackAdder& minar::Scheduler::CallbackAdder::delay(tick_t ticks)
+{
+    delayTicks = ticks;
+    return *this;
+}
+
+minar::Scheduler::CallbackAdder& minar::Scheduler::CallbackAdder::period(tick_t ticks)
+{
+    periodTicks = ticks;
+    return *this;
+}
+
+minar::Scheduler::CallbackAdder& minar::Scheduler::CallbackAdder::tolerance(tick_t)
+{
+    return *this;
+}
+
+minar::callback_handle_t minar::Scheduler::CallbackAdder::getHandle()
+{
+    return (posted) ? NULL : post();
+}
+
+minar::callback_handle_t minar::Scheduler::CallbackAdder::post()
+{
+    posted = true;
+
+    for (uint32_t idx = 0; idx < MINAR_HOST_CALLBACKS; idx++)
+    {
+        if (!entries[idx].used)
+        {
+            entries[idx].function = function;
+            entries[idx].due = now + delayTicks;
+            entries[idx].sequence = sequence++;
+            entries[idx].period = periodTicks;
+            entries[idx].used = true;
+
+            return &entries[idx];
+        }
+    }
+
+    // the firmware posts far fewer than this; more is a leak
+    fprintf(stderr, "minar: more than %u callbacks pending\n", MINAR_HOST_CALLBACKS);
+    abort();
+}
+
+/*****************************************************************************/
+
+minar::Scheduler::CallbackAdder minar::Scheduler::postCallback(function_t function)
+{
+    return CallbackAdder(function);
+}
+
+int minar::Scheduler::cancelCallback(callback_handle_t handle)
+{
+    entry_t* entry = (entry_t*) handle;
+
+    if ((entry == NULL) || !entry->used)
+    {
+        return -1;
+    }
+
+    entry->used = false;
+
+    return 0;
+}
+
+minar::tick_t minar::Scheduler::getTime()
+{
+    return (tick_t) now & platform::Time_Mask;
+}
+
+static entry_t* next()
+{
+    entry_t* first = NULL;
+
+    for (uint32_t idx = 0; idx < MINAR_HOST_CALLBACKS; idx++)
+    {
+        entry_t* entry = &entries[idx];
+
+        if (entry->used &&
+            ((first == NULL) ||
+             (entry->due < first->due) ||
+             ((entry->due == first->due) && (entry->sequence < first->sequence))))
+        {
+            first = entry;
+        }
+    }
+
+    return first;
+}
+
+uint32_t minar::Scheduler::hostRunUntil(uint64_t time)
+{
+    uint32_t count = 0;
+
+    for (entry_t* entry = next(); (entry != NULL) && (entry->due <= time); entry = next())
+    {
+        function_t function = entry->function;
+
+        now = (entry->due > now) ? entry->due : now;
+
+        if (entry->period > 0)
+        {
+            entry->due = now + entry->period;
+            entry->sequence = sequence++;
+        }
+        else
+        {
+            entry->used = false;
+        }
+
+        if (now != lastWakeup)
+        {
+            lastWakeup = now;
+            wakeups++;
+        }
+
+        dispatched++;
+        count++;
+
+        function();
+    }
+
+    now = (time > now) ? time : now;
+
+    return count;
+}
+
+uint64_t minar::Scheduler::hostNow()
+{
+    return now;
+}
+
+uint32_t minar::Scheduler::hostPending()
+{
+    uint32_t count = 0;
+
+    for (uint32_t idx = 0; idx < MINAR_HOST_CALLBACKS; idx++)
+    {
+        count += (entries[idx].used) ? 1 : 0;
+    }
+
+    return count;
+}
+
+bool minar::Scheduler::hostNextDue(uint64_t* time)
+{
+    entry_t* entry = next();
+
+    if (entry)
+    {
+        *time = entry->due;
+    }
+
+    return (entry != NULL);
+}
+
+uint32_t minar::Scheduler::hostDispatched()
+{
+    return dispatched;
+}
+
+uint32_t minar::Scheduler::hostWakeups()
+{
+    return wakeups;
+}
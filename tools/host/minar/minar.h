@@ -0,0 +1,111 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_MINAR_H__
+#define __HOST_MINAR_H__
+
+#include <stdint.h>
+
+/*
+    Host stand-in for the minar scheduler in virtual time. Ticks run at
+    32768 Hz and wrap at 24 bits, as on the nRF51 RTC, so wrap handling is
+    exercised within minutes of virtual time.
+
+    Callbacks wait in a fixed pool, never on the heap, so they do not show
+    up in the firmware's heap counters. Nothing runs until the host calls
+    Scheduler::hostRunUntil, which advances virtual time to each callback
+    in turn, oldest first among callbacks due at the same tick.
+*/
+namespace minar
+{
+    typedef uint32_t tick_t;
+    typedef void* callback_handle_t;
+
+    namespace platform
+    {
+        const tick_t Time_Base = 32768;
+        const tick_t Time_Mask = 0x00FFFFFF;
+    }
+
+    inline tick_t milliseconds(uint32_t ms)
+    {
+        return (tick_t) (((uint64_t) ms * platform::Time_Base + 999) / 1000);
+    }
+
+    class Scheduler
+    {
+    public:
+        typedef void (*function_t)(void);
+
+        /*
+            Posts the callback when it goes out of scope, or when
+            getHandle() is called, whichever comes first.
+        */
+        class CallbackAdder
+        {
+        public:
+            CallbackAdder(function_t _function);
+            CallbackAdder(const CallbackAdder& other);
+            ~CallbackAdder();
+
+            CallbackAdder& delay(tick_t ticks);
+            CallbackAdder& period(tick_t ticks);
+            CallbackAdder& tolerance(tick_t ticks);
+
+            callback_handle_t getHandle();
+
+        private:
+            CallbackAdder& operator=(const CallbackAdder&);
+
+            callback_handle_t post();
+
+            function_t function;
+            tick_t delayTicks;
+            tick_t periodTicks;
+            mutable bool posted;
+        };
+
+        static CallbackAdder postCallback(function_t function);
+        static int cancelCallback(callback_handle_t handle);
+
+        // masked like the RTC counter
+        static tick_t getTime();
+
+        /*
+            Host side. Run every callback due up to time, in ticks since
+            the start; time stops there. Returns the number run.
+        */
+        static uint32_t hostRunUntil(uint64_t time);
+
+        // ticks since the start, not masked
+        static uint64_t hostNow();
+
+        // callbacks waiting, and when the next one is due
+        static uint32_t hostPending();
+        static bool hostNextDue(uint64_t* time);
+
+        // callbacks run, and distinct ticks they ran at, since the start
+        static uint32_t hostDispatched();
+        static uint32_t hostWakeups();
+    };
+
+    inline uint64_t hostMilliseconds(uint64_t ticks)
+    {
+        return ticks * 1000 / platform::Time_Base;
+    }
+}
+
+#endif // __HOST_MINAR_H__
@@ -0,0 +1,61 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "watchdog/Watchdog.h"
+#include "minar/minar.h"
+
+static uint32_t timeout = 0;
+static uint32_t feeds = 0;
+static uint64_t lastFeed = 0;
+static uint32_t longestGap = 0;
+
+static uint32_t gapMs()
+{
+    return (uint32_t) minar::hostMilliseconds(minar::Scheduler::hostNow() - lastFeed);
+}
+
+void watchdog::enable(uint32_t timeoutMs)
+{
+    timeout = timeoutMs;
+    lastFeed = minar::Scheduler::hostNow();
+}
+
+void watchdog::feed()
+{
+    uint32_t gap = gapMs();
+
+    longestGap = (gap > longestGap) ? gap : longestGap;
+    lastFeed = minar::Scheduler::hostNow();
+    feeds++;
+}
+
+uint32_t watchdog::hostTimeoutMs()
+{
+    return timeout;
+}
+
+uint32_t watchdog::hostFeeds()
+{
+    return feeds;
+}
+
+uint32_t watchdog::hostLongestGapMs()
+{
+    uint32_t gap = (timeout > 0) ? gapMs() : 0;
+
+    return (gap > longestGap) ? gap : longestGap;
+}
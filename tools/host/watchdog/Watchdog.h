@@ -0,0 +1,41 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HOST_WATCHDOG_H__
+#define __HOST_WATCHDOG_H__
+
+#include <stdint.h>
+
+/*
+    Host stand-in for the watchdog. Nothing resets; instead the longest
+    time between feeds, in virtual milliseconds, is kept for the host to
+    compare against the timeout.
+*/
+namespace watchdog
+{
+    void enable(uint32_t timeoutMs);
+    void feed();
+
+    // host side
+    uint32_t hostTimeoutMs();
+    uint32_t hostFeeds();
+
+    // longest gap between feeds so far, up to now if the last is ongoing
+    uint32_t hostLongestGapMs();
+}
+
+#endif // __HOST_WATCHDOG_H__
@@ -0,0 +1,307 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host benchmark for TextCodec on a corpus of notifications.
+
+    Build and run from this directory:
+
+        g++ -O2 -I../source text_codec_benchmark.cpp ../source/cbor/TextCodec.cpp -o text_codec_benchmark
+        ./text_codec_benchmark notification_corpus.txt
+
+    Each corpus line is title, subtitle, message, and app separated by
+    tabs; lines starting with '#' are skipped. Every notification is
+    encoded as the default alert on AlertPort,
+
+        [1, "title subtitle", "message", uid, final, "app", count, categoryCount]
+
+    once with plain text and once with packed text, and decoded again to
+    check the round trip. Reports bytes on the SPI link and encode cost.
+    Cycle counts are taken on the host and only indicate relative cost.
+*/
+
+#include "cbor/CborWriter.h"
+#include "cbor/TextCodec.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+
+// same limits as the alert on the device
+#define ATTRIBUTE_MAX_LENGTH 110
+#define APP_NAME_MAX_LENGTH 24
+
+#define MAX_NOTIFICATIONS 1024
+#define LINE_LENGTH 1024
+#define ROUNDS 1000
+
+typedef struct {
+    char line[LINE_LENGTH];
+    const char* fields[4];
+    uint32_t lengths[4];
+} notification_t;
+
+static notification_t notifications[MAX_NOTIFICATIONS];
+
+/*****************************************************************************/
+
+static uint32_t clamp(uint32_t length, uint32_t max)
+{
+    return (length > max) ? max : length;
+}
+
+static void text(CborWriter& cbor, const TextCodec::piece_t* pieces, uint8_t count, bool packed)
+{
+    uint32_t length = 0;
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        length += pieces[idx].length;
+    }
+
+    if (packed)
+    {
+        uint32_t packedLength = TextCodec::encode(pieces, count, NULL);
+
+        if (packedLength < length)
+        {
+            cbor.header(CborWriter::TypeBytes, packedLength);
+            TextCodec::encode(pieces, count, cbor.reserve(packedLength));
+            return;
+        }
+    }
+
+    cbor.header(CborWriter::TypeText, length);
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        cbor.raw(pieces[idx].data, pieces[idx].length);
+    }
+}
+
+static uint32_t encodeAlert(const notification_t& notification, bool packed, uint8_t* buffer, uint32_t length)
+{
+    const uint8_t space = ' ';
+
+    TextCodec::piece_t title[3] = {
+        { (const uint8_t*) notification.fields[0], clamp(notification.lengths[0], ATTRIBUTE_MAX_LENGTH) },
+        { &space, 1 },
+        { (const uint8_t*) notification.fields[1], clamp(notification.lengths[1], ATTRIBUTE_MAX_LENGTH) }
+    };
+    TextCodec::piece_t message = { (const uint8_t*) notification.fields[2],
+                                   clamp(notification.lengths[2], ATTRIBUTE_MAX_LENGTH) };
+    TextCodec::piece_t app = { (const uint8_t*) notification.fields[3],
+                               clamp(notification.lengths[3], APP_NAME_MAX_LENGTH) };
+
+    CborWriter cbor(buffer, length);
+
+    cbor.array(8);
+    cbor.item(1);
+    text(cbor, title, 3, packed);
+    text(cbor, &message, 1, packed);
+    cbor.item(0x1234);
+    cbor.item(notification.lengths[2] < ATTRIBUTE_MAX_LENGTH);
+    text(cbor, &app, 1, packed);
+    cbor.item(1);
+    cbor.item(1);
+
+    return cbor.getLength();
+}
+
+/*
+    Decode every byte string in the packed alert and compare with the
+    text strings in the plain one.
+*/
+static bool roundTrip(const uint8_t* plain, const uint8_t* packed, uint32_t packedLength)
+{
+    uint32_t plainOffset = 1;
+    uint32_t packedOffset = 1;
+    uint8_t decoded[LINE_LENGTH];
+
+    while (packedOffset < packedLength)
+    {
+        uint8_t initial = packed[packedOffset];
+        uint8_t type = initial >> 5;
+        uint32_t value = initial & 0x1F;
+        uint32_t header = 1;
+
+        if (value == 24)
+        {
+            value = packed[packedOffset + 1];
+            header = 2;
+        }
+
+        uint32_t plainValue = plain[plainOffset] & 0x1F;
+        uint32_t plainHeader = (plainValue == 24) ? 2 : 1;
+        plainValue = (plainValue == 24) ? plain[plainOffset + 1] : plainValue;
+
+        if (type == CborWriter::TypeBytes)
+        {
+            uint32_t length = TextCodec::decode(&packed[packedOffset + header], value, decoded, sizeof(decoded));
+
+            if ((length != plainValue) || memcmp(decoded, &plain[plainOffset + plainHeader], length))
+            {
+                return false;
+            }
+
+            packedOffset += header + value;
+            plainOffset += plainHeader + plainValue;
+        }
+        else if (type == CborWriter::TypeText)
+        {
+            if (memcmp(&packed[packedOffset], &plain[plainOffset], header + value))
+            {
+                return false;
+            }
+
+            packedOffset += header + value;
+            plainOffset += header + value;
+        }
+        else
+        {
+            // small unsigned integers, identical in both
+            packedOffset += header;
+            plainOffset += header;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t load(FILE* file)
+{
+    uint32_t count = 0;
+
+    while ((count < MAX_NOTIFICATIONS) && fgets(notifications[count].line, LINE_LENGTH, file))
+    {
+        notification_t& notification = notifications[count];
+        char* cursor = notification.line;
+
+        if (*cursor == '#')
+        {
+            continue;
+        }
+
+        cursor[strcspn(cursor, "\r\n")] = '\0';
+
+        for (uint8_t field = 0; field < 4; field++)
+        {
+            uint32_t length = strcspn(cursor, "\t");
+
+            notification.fields[field] = cursor;
+            notification.lengths[field] = length;
+
+            cursor += (cursor[length] == '\t') ? length + 1 : length;
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+static double seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char** argv)
+{
+    FILE* file = (argc > 1) ? fopen(argv[1], "r") : stdin;
+
+    if (file == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint32_t count = load(file);
+
+    uint8_t plain[512];
+    uint8_t packed[512];
+    uint32_t plainTotal = 0;
+    uint32_t packedTotal = 0;
+    uint32_t textTotal = 0;
+    uint32_t failures = 0;
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        uint32_t plainLength = encodeAlert(notifications[idx], false, plain, sizeof(plain));
+        uint32_t packedLength = encodeAlert(notifications[idx], true, packed, sizeof(packed));
+
+        if (!roundTrip(plain, packed, packedLength))
+        {
+            printf("round trip failed: line %u\n", idx + 1);
+            failures++;
+        }
+
+        plainTotal += plainLength;
+        packedTotal += packedLength;
+        textTotal += clamp(notifications[idx].lengths[0], ATTRIBUTE_MAX_LENGTH) + 1
+                   + clamp(notifications[idx].lengths[1], ATTRIBUTE_MAX_LENGTH)
+                   + clamp(notifications[idx].lengths[2], ATTRIBUTE_MAX_LENGTH)
+                   + clamp(notifications[idx].lengths[3], APP_NAME_MAX_LENGTH);
+    }
+
+    double timing[2];
+    uint64_t cycles[2];
+
+    for (uint8_t mode = 0; mode < 2; mode++)
+    {
+        double start = seconds();
+        uint64_t startCycles = CYCLES();
+
+        for (uint32_t round = 0; round < ROUNDS; round++)
+        {
+            for (uint32_t idx = 0; idx < count; idx++)
+            {
+                encodeAlert(notifications[idx], mode, packed, sizeof(packed));
+            }
+        }
+
+        cycles[mode] = CYCLES() - startCycles;
+        timing[mode] = seconds() - start;
+    }
+
+    double bytes = (double) textTotal * ROUNDS;
+
+    printf("notifications        %u\n", count);
+    printf("text bytes           %u\n", textTotal);
+    printf("alert bytes plain    %u\n", plainTotal);
+    printf("alert bytes packed   %u\n", packedTotal);
+    printf("ratio                %.3f\n", (double) packedTotal / plainTotal);
+    printf("SPI bytes saved      %u (%.1f%%)\n", plainTotal - packedTotal,
+           100.0 * (plainTotal - packedTotal) / plainTotal);
+    printf("encode plain         %.2f cycles/byte, %.2f ns/byte\n",
+           cycles[0] / bytes, timing[0] * 1e9 / bytes);
+    printf("encode packed        %.2f cycles/byte, %.2f ns/byte\n",
+           cycles[1] / bytes, timing[1] * 1e9 / bytes);
+    printf("round trip failures  %u\n", failures);
+
+    return (failures) ? 1 : 0;
+}
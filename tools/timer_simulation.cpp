@@ -0,0 +1,358 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host simulation of the firmware's background timers on TimerQueue.
+
+    Build and run from this directory:
+
+        g++ -O2 -I../source timer_simulation.cpp ../source/timer/TimerQueue.cpp -o timer_simulation
+        ./timer_simulation [hours]
+
+    Each scenario runs three times:
+
+    - minar: one callback per timer, no slack, and the old 10 s watchdog
+      period.
+    - alone: the firmware's delays, slack and alignment, but every timer
+      in a queue of its own, so no two timers share a wakeup.
+    - coalesced: the firmware's settings on one queue.
+
+    minar to alone is the change in schedule, alone to coalesced is the
+    saving from sharing wakeups. Timer wakeups are reported per hour;
+    wakeups caused by the radio are not counted.
+
+    The queue reads its time through TickClock from a simulated minar
+    tick counter, as TimerService does. The wrap scenarios start the
+    counter shortly before it wraps. The longest gap between watchdog
+    feeds, in simulated time, must stay at or below three quarters of
+    the 20 s timeout; the program fails otherwise.
+*/
+
+#include "timer/TimerQueue.h"
+#include "timer/TickClock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HOUR_MS (60UL * 60 * 1000)
+#define TICKS_PER_SECOND 32768
+
+// firmware settings, see main.cpp, Scanner.cpp, ConnectionManager.cpp,
+// and AdvertisingManager.cpp
+#define WATCHDOG_TIMEOUT_MS 20000
+#define WATCHDOG_FEED_MS 2000
+#define WATCHDOG_FEED_SLACK_MS 13000
+#define WATCHDOG_PERIOD_MS 10000
+#define SCANNER_BATCH_MS 1000
+#define SCANNER_BATCH_SLACK_MS 1000
+#define CONNECTION_IDLE_TIMEOUT_MS 10000
+#define CONNECTION_IDLE_SLACK_MS 2000
+
+static const uint32_t stageDurations[] = { 30 * 1000, 5 * 60 * 1000 };
+
+typedef struct {
+    const char* name;
+    bool scanning;
+    uint32_t alertMinMs;                // 0 for no alerts
+    uint32_t alertMaxMs;
+    uint32_t reconnectMs;               // 0 for staying connected
+    uint32_t tickMask;
+    uint32_t ticksToWrap;               // counter starts this far from wrapping
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "connected, quiet",       false, 120000, 600000, 0,              0xFFFFFFFF, 0xFFFFFFFF },
+    { "connected, busy",        false, 5000,   60000,  0,              0xFFFFFFFF, 0xFFFFFFFF },
+    { "connected, scanning",    true,  120000, 600000, 0,              0xFFFFFFFF, 0xFFFFFFFF },
+    { "reconnecting",           false, 120000, 600000, 15 * 60 * 1000, 0xFFFFFFFF, 0xFFFFFFFF },
+    { "busy, 32 bit tick wrap", false, 5000,   60000,  0,              0xFFFFFFFF, 30 * 60 * TICKS_PER_SECOND },
+    { "busy, 24 bit tick wrap", true,  5000,   60000,  0,              0x00FFFFFF, 60 * TICKS_PER_SECOND }
+};
+
+typedef enum {
+    ModeMinar,
+    ModeAlone,
+    ModeCoalesced
+} run_t;
+
+// one queue per kind of timer when they may not share wakeups
+typedef enum {
+    TimerFeed,
+    TimerBatch,
+    TimerIdle,
+    TimerStage,
+    TimerKinds
+} kind_t;
+
+/*****************************************************************************/
+
+static TimerQueue* queues[TimerKinds];
+static run_t mode;
+
+// simulated time, and the queue's time as read through TickClock
+static uint32_t simulated;
+static uint32_t now;
+
+static TimerQueue::handle_t idleTimer;
+static TimerQueue::handle_t stageTimer;
+static uint8_t stage;
+
+static uint32_t lastFeed;
+static uint32_t maxFeedGap;
+
+static TimerQueue& queueFor(kind_t kind)
+{
+    return (mode == ModeAlone) ? *queues[kind] : *queues[0];
+}
+
+static TimerQueue::handle_t start(kind_t kind, void (*callback)(void), uint32_t delay, uint32_t slack, uint32_t period = 0)
+{
+    return queueFor(kind).add(callback, now, delay, (mode == ModeMinar) ? 0 : slack, period);
+}
+
+static void feed()
+{
+    if (simulated - lastFeed > maxFeedGap)
+    {
+        maxFeedGap = simulated - lastFeed;
+    }
+
+    lastFeed = simulated;
+}
+
+static void sendBatch()
+{
+}
+
+static void onIdle()
+{
+    idleTimer = TimerQueue::NoHandle;
+}
+
+static void nextStage()
+{
+    stageTimer = TimerQueue::NoHandle;
+    stage++;
+
+    if (stage < sizeof(stageDurations) / sizeof(uint32_t))
+    {
+        uint32_t duration = stageDurations[stage];
+        stageTimer = start(TimerStage, nextStage, duration, duration / 8);
+    }
+}
+
+// traffic keeps the connection fast; it falls back once idle
+static void alert()
+{
+    if (idleTimer != TimerQueue::NoHandle)
+    {
+        queueFor(TimerIdle).remove(idleTimer);
+    }
+
+    idleTimer = start(TimerIdle, onIdle, CONNECTION_IDLE_TIMEOUT_MS, CONNECTION_IDLE_SLACK_MS);
+}
+
+// disconnect and advertise through the stages until the phone is back
+static void reconnect()
+{
+    if (stageTimer != TimerQueue::NoHandle)
+    {
+        queueFor(TimerStage).remove(stageTimer);
+    }
+
+    stage = 0;
+    stageTimer = start(TimerStage, nextStage, stageDurations[0], stageDurations[0] / 8);
+}
+
+static uint32_t randomDelay(uint32_t minimum, uint32_t maximum)
+{
+    return minimum + (uint32_t) (rand() % (maximum - minimum + 1));
+}
+
+/*
+    The minar tick counter at a simulated time, rounded up like a minar
+    callback that never fires early.
+*/
+static uint32_t ticksAt(const scenario_t& scenario, uint32_t ms)
+{
+    uint64_t ticks = ((uint64_t) ms * TICKS_PER_SECOND + 999) / 1000;
+
+    return (uint32_t) (scenario.tickMask - scenario.ticksToWrap + ticks) & scenario.tickMask;
+}
+
+static uint32_t simulate(const scenario_t& scenario, run_t _mode, uint32_t hours)
+{
+    TimerQueue minar(1);
+    TimerQueue shared;
+    TimerQueue alone[TimerKinds];
+    TickClock clock(TICKS_PER_SECOND, scenario.tickMask);
+
+    for (uint8_t kind = 0; kind < TimerKinds; kind++)
+    {
+        queues[kind] = (_mode == ModeMinar) ? &minar : (_mode == ModeAlone) ? &alone[kind] : &shared;
+    }
+
+    mode = _mode;
+    simulated = 0;
+    now = clock.read(ticksAt(scenario, 0));
+    idleTimer = TimerQueue::NoHandle;
+    stageTimer = TimerQueue::NoHandle;
+    stage = 0;
+    lastFeed = 0;
+    maxFeedGap = 0;
+
+    // same radio traffic for every run
+    srand(1);
+
+    if (mode == ModeMinar)
+    {
+        start(TimerFeed, feed, WATCHDOG_PERIOD_MS, 0, WATCHDOG_PERIOD_MS);
+    }
+    else
+    {
+        start(TimerFeed, feed, WATCHDOG_FEED_MS, WATCHDOG_FEED_SLACK_MS, WATCHDOG_FEED_MS);
+    }
+
+    if (scenario.scanning)
+    {
+        start(TimerBatch, sendBatch, SCANNER_BATCH_MS, SCANNER_BATCH_SLACK_MS, SCANNER_BATCH_MS);
+    }
+
+    uint32_t nextAlert = (scenario.alertMinMs) ? randomDelay(scenario.alertMinMs, scenario.alertMaxMs) : 0;
+    uint32_t nextReconnect = scenario.reconnectMs;
+    uint32_t end = hours * HOUR_MS;
+
+    while (simulated < end)
+    {
+        // earliest wakeup over all queues, converted to simulated time
+        // the way TimerService posts its minar callback
+        uint32_t wakeup = end;
+
+        for (uint8_t kind = 0; kind < TimerKinds; kind++)
+        {
+            uint32_t queueWakeup;
+
+            if (queues[kind]->getWakeup(&queueWakeup))
+            {
+                int32_t delay = (int32_t) (queueWakeup - now);
+                uint32_t at = simulated + ((delay > 0) ? delay : 0);
+
+                if (at < wakeup)
+                {
+                    wakeup = at;
+                }
+            }
+        }
+
+        if (nextAlert && (nextAlert <= wakeup) && (nextAlert <= nextReconnect || !nextReconnect))
+        {
+            simulated = nextAlert;
+            now = clock.read(ticksAt(scenario, simulated));
+            nextAlert += randomDelay(scenario.alertMinMs, scenario.alertMaxMs);
+
+            alert();
+        }
+        else if (nextReconnect && (nextReconnect <= wakeup))
+        {
+            simulated = nextReconnect;
+            now = clock.read(ticksAt(scenario, simulated));
+            nextReconnect += scenario.reconnectMs;
+
+            reconnect();
+        }
+        else if (wakeup < end)
+        {
+            simulated = wakeup;
+            now = clock.read(ticksAt(scenario, simulated));
+
+            // queues of their own wake up separately, even at the same time
+            for (uint8_t kind = 0; kind < TimerKinds; kind++)
+            {
+                uint32_t queueWakeup;
+
+                if (((kind == 0) || (queues[kind] != queues[0])) &&
+                    queues[kind]->getWakeup(&queueWakeup) &&
+                    ((int32_t) (queueWakeup - now) <= 0))
+                {
+                    queues[kind]->expire(now);
+                }
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // a feed that stopped altogether never measures its own gap
+    if (end - lastFeed > maxFeedGap)
+    {
+        maxFeedGap = end - lastFeed;
+    }
+
+    uint32_t wakeups = 0;
+
+    for (uint8_t kind = 0; kind < TimerKinds; kind++)
+    {
+        if ((kind == 0) || (queues[kind] != queues[0]))
+        {
+            wakeups += queues[kind]->getStatistics().wakeups;
+        }
+    }
+
+    return wakeups;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char** argv)
+{
+    uint32_t hours = (argc > 1) ? atoi(argv[1]) : 24;
+    bool passed = true;
+
+    if (hours == 0)
+    {
+        hours = 1;
+    }
+
+    printf("%-24s %9s %9s %9s %9s %10s %10s\n",
+           "wakeups per hour", "minar", "alone", "coalesced", "schedule", "coalescing", "feed gap");
+
+    for (uint8_t idx = 0; idx < sizeof(scenarios) / sizeof(scenario_t); idx++)
+    {
+        double minarRate = (double) simulate(scenarios[idx], ModeMinar, hours) / hours;
+        double aloneRate = (double) simulate(scenarios[idx], ModeAlone, hours) / hours;
+        double coalescedRate = (double) simulate(scenarios[idx], ModeCoalesced, hours) / hours;
+        uint32_t feedGap = maxFeedGap;
+
+        printf("%-24s %9.1f %9.1f %9.1f %8.1f%% %9.1f%% %8.1f s\n",
+               scenarios[idx].name,
+               minarRate,
+               aloneRate,
+               coalescedRate,
+               100.0 * (minarRate - aloneRate) / minarRate,
+               100.0 * (aloneRate - coalescedRate) / aloneRate,
+               feedGap / 1000.0);
+
+        if (feedGap > WATCHDOG_TIMEOUT_MS * 3 / 4)
+        {
+            printf("  feed gap leaves less than a quarter of the watchdog timeout\n");
+            passed = false;
+        }
+    }
+
+    return (passed) ? 0 : 1;
+}
@@ -0,0 +1,843 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Deterministic replay of a trace capture on the host.
+
+    Build and run from this directory:
+
+        g++ -O2 -DTARGET_LIKE_WATCH -DADVERTISING_COMPANY_ID=0x0059 -DMEMORY_HEAP_TRAP=0 \
+            -Ihost -I../source trace_replay.cpp $(find ../source host -name '*.cpp') -o trace_replay
+        ./trace_replay [-v] [-e expected.txt] capture.bin
+
+    The sample capture is the lossy reconnect of ancs_pipeline_harness,
+    recorded with -c 6, where every alert depends on when the phone
+    answered. It is checked with:
+
+        ./trace_replay -e trace_replay_sample.txt trace_replay_sample.bin
+
+    The capture is the byte strings of the [16, offset, total, bytes]
+    replies joined in offset order, as for decode_trace_capture.py. The
+    firmware is compiled as it is, main.cpp and ANCSManager included,
+    against the stand-ins under host/, and booted with app_start. Each
+    input record is then played, at its captured time in minar's virtual
+    time, into the handler it was recorded in:
+
+        Connected, Disconnected     Gap connection callbacks
+        ServiceFound, Notification  ANCSClient callbacks
+        Characteristic              discovery, once the firmware starts it
+        DataSource                  GattClient HVX callbacks
+        AttributeData               ANCSClient data block
+        Written, Read               GattClient write and read callbacks
+        Received                    MessageCenter listener for the port
+
+    The phone's answers are replayed as they were received, whatever the
+    replayed firmware asks for. A capture without Written and Read
+    records, i.e., from firmware that did not record them, gets made-up
+    answers instead: Control Point writes are acknowledged one connection
+    event after they are made, and declaration reads of cached handles
+    are answered with the handles from Characteristic records. When the
+    phone acknowledges a write decides when a fetch it never answers is
+    abandoned, so with made-up answers such a capture can diverge.
+    Payloads the capture cut short cannot be replayed and are counted.
+    The capture should start before the connection, i.e., with Control
+    [15, 1] while advertising.
+
+    Reports the alerts the replayed firmware sent on AlertPort next to the
+    AlertQueued records of the device, alert latency from the
+    notification in both, queue statistics, and heap use after init in
+    both; -v lists every alert. Heap use is counted rather than trapped,
+    hence MEMORY_HEAP_TRAP=0. Everything reported is in virtual time, so
+    the output is the same on every run. With -e the output is compared
+    with expected.txt and the program fails if it differs. It also fails
+    if the capture cannot be read.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+#include "ble-ancs-client/ANCSClient.h"
+#include "message-center/MessageCenter.h"
+#include "minar/minar.h"
+
+#include "ancs/ANCSManager.h"
+#include "cbor/CborReader.h"
+#include "connection/ConnectionManager.h"
+#include "log/TraceCapture.h"
+#include "memory/MemoryMonitor.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_HEADER_LENGTH 7
+#define MAX_VALUES 8
+#define MAX_CAPTURE (1024 * 1024)
+#define MAX_RECORDS 65536
+#define MAX_ALERTS 4096
+#define MAX_ARRIVALS 1024
+#define MAX_OUTPUT (256 * 1024)
+
+// replay starts this long after boot, so init has settled
+#define START_US 1000000
+
+// and runs this long past the last record, so fetches and transfers finish
+#define SETTLE_US 30000000
+
+// firmware entry point, see main.cpp
+void app_start(int, char *[]);
+
+typedef struct {
+    uint64_t time;                      // us since the first record, wraps unfolded
+    uint64_t ticks;                     // minar ticks since the first record
+    uint8_t type;
+    uint8_t count;
+    uint8_t length;
+    uint32_t values[MAX_VALUES];
+    const uint8_t* data;
+} record_t;
+
+typedef struct {
+    uint32_t notificationUID;
+    uint32_t length;
+    uint32_t latency;                   // ms
+} alert_t;
+
+typedef struct {
+    uint32_t notificationUID;
+    uint64_t time;                      // us
+} arrival_t;
+
+static uint8_t capture[MAX_CAPTURE];
+static record_t records[MAX_RECORDS];
+static uint32_t recordCount = 0;
+static bool verbose = false;
+
+static const UUID controlPointUUID("69D1D8F3-45E1-49A8-9821-9BBDFDAAD9D9");
+static const UUID dataSourceUUID("22EAC6E9-24D6-4BB5-BE44-B36ACE7C7BFB");
+
+/*****************************************************************************/
+/* Capture                                                                   */
+/*****************************************************************************/
+
+static uint32_t readLittle32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+/*
+    Split the capture into records, as decode_trace_capture.py does.
+*/
+static bool parse(const uint8_t* data, uint32_t length)
+{
+    uint32_t offset = 0;
+    uint32_t previous = 0;
+    uint64_t wraps = 0;
+    uint64_t start = 0;
+    uint64_t startTicks = 0;
+
+    while (offset + RECORD_HEADER_LENGTH <= length)
+    {
+        const uint8_t* header = &data[offset];
+        uint32_t end = offset + RECORD_HEADER_LENGTH + 4 * header[1] + header[2];
+
+        if (end > length)
+        {
+            printf("truncated record at offset %u\n", offset);
+            break;
+        }
+
+        if (recordCount == MAX_RECORDS)
+        {
+            printf("more than %u records\n", MAX_RECORDS);
+            return false;
+        }
+
+        record_t& record = records[recordCount];
+        uint32_t stamp = readLittle32(&header[3]);
+
+        // us ticker wraps every 71 minutes; interrupts can reorder close stamps
+        if ((recordCount > 0) && (previous > stamp) && (previous - stamp > 0x80000000UL))
+        {
+            wraps++;
+        }
+
+        previous = stamp;
+
+        // the stamp is rounded down from a tick, so round up to get it back
+        uint64_t ticks = (((wraps << 32) + stamp) * minar::platform::Time_Base + 999999) / 1000000;
+
+        if (recordCount == 0)
+        {
+            start = stamp;
+            startTicks = ticks;
+        }
+
+        record.time = (wraps << 32) + stamp - start;
+        record.ticks = ticks - startTicks;
+        record.type = header[0];
+        record.count = (header[1] > MAX_VALUES) ? MAX_VALUES : header[1];
+        record.length = header[2];
+        record.data = &data[end - header[2]];
+
+        for (uint8_t idx = 0; idx < record.count; idx++)
+        {
+            record.values[idx] = readLittle32(&header[RECORD_HEADER_LENGTH + 4 * idx]);
+        }
+
+        recordCount++;
+        offset = end;
+    }
+
+    return true;
+}
+
+// a cut payload cannot be replayed; the original length is in the last value
+static bool isComplete(const record_t& record)
+{
+    return (record.count > 0) && (record.values[record.count - 1] == record.length);
+}
+
+/*****************************************************************************/
+/* Output                                                                    */
+/*****************************************************************************/
+
+static char output[MAX_OUTPUT];
+static uint32_t outputLength = 0;
+
+// printed and kept for the comparison with the expected output
+static void report(const char* format, ...)
+{
+    va_list arguments;
+
+    va_start(arguments, format);
+    int length = vsnprintf(&output[outputLength], MAX_OUTPUT - outputLength, format, arguments);
+    va_end(arguments);
+
+    if (length > 0)
+    {
+        fputs(&output[outputLength], stdout);
+
+        outputLength += ((uint32_t) length < MAX_OUTPUT - outputLength) ? length : MAX_OUTPUT - outputLength - 1;
+    }
+}
+
+static bool compareExpected(const char* path)
+{
+    static char expected[MAX_OUTPUT];
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    size_t length = fread(expected, 1, sizeof(expected), file);
+
+    fclose(file);
+
+    if ((length == outputLength) && (memcmp(expected, output, length) == 0))
+    {
+        printf("output matches %s\n", path);
+        return true;
+    }
+
+    // point at the first line that differs
+    uint32_t line = 1;
+
+    for (uint32_t idx = 0; (idx < length) && (idx < outputLength) && (expected[idx] == output[idx]); idx++)
+    {
+        line += (output[idx] == '\n') ? 1 : 0;
+    }
+
+    printf("output differs from %s at line %u\n", path, line);
+    return false;
+}
+
+/*****************************************************************************/
+/* Replay                                                                    */
+/*****************************************************************************/
+
+static alert_t deviceAlerts[MAX_ALERTS];
+static uint32_t deviceAlertCount = 0;
+static uint32_t deviceHeapCalls = 0;
+
+static alert_t replayAlerts[MAX_ALERTS];
+static uint32_t replayAlertCount = 0;
+
+static arrival_t arrivals[MAX_ARRIVALS];
+static uint32_t arrivalCount = 0;
+
+static GattAttribute::Handle_t capturedControlPoint = 0;
+static GattAttribute::Handle_t capturedDataSource = 0;
+static bool characteristicsPending = false;
+
+// the phone's answers are in the capture, otherwise they are made up
+static bool capturedWrites = false;
+static bool capturedReads = false;
+
+static Gap::Handle_t writeConnection;
+static GattAttribute::Handle_t writeHandle;
+static Gap::Handle_t readConnection;
+static GattAttribute::Handle_t readHandle;
+
+static bool connected = false;
+
+static uint32_t counts[256];
+static uint32_t cut = 0;
+
+// capture time that virtual time has reached
+static uint64_t captureNow()
+{
+    uint64_t now = minar::Scheduler::hostNow() * 1000000 / minar::platform::Time_Base;
+
+    return (now > START_US) ? now - START_US : 0;
+}
+
+static void runUntil(uint64_t ticks)
+{
+    minar::Scheduler::hostRunUntil(minar::milliseconds(START_US / 1000) + ticks);
+}
+
+static void arrive(uint32_t notificationUID, uint64_t time)
+{
+    for (uint32_t idx = 0; idx < arrivalCount; idx++)
+    {
+        if (arrivals[idx].notificationUID == notificationUID)
+        {
+            return;
+        }
+    }
+
+    if (arrivalCount < MAX_ARRIVALS)
+    {
+        arrivals[arrivalCount].notificationUID = notificationUID;
+        arrivals[arrivalCount].time = time;
+        arrivalCount++;
+    }
+}
+
+// ms from the first time the phone reported the notification
+static uint32_t latency(uint32_t notificationUID, uint64_t time)
+{
+    for (uint32_t idx = 0; idx < arrivalCount; idx++)
+    {
+        if (arrivals[idx].notificationUID == notificationUID)
+        {
+            return (time - arrivals[idx].time) / 1000;
+        }
+    }
+
+    return 0;
+}
+
+static void addAlert(alert_t* alerts, uint32_t* count, uint32_t notificationUID, uint32_t length, uint64_t time)
+{
+    if (*count < MAX_ALERTS)
+    {
+        alerts[*count].notificationUID = notificationUID;
+        alerts[*count].length = length;
+        alerts[*count].latency = latency(notificationUID, time);
+        (*count)++;
+    }
+}
+
+/*
+    [alert level, "title subtitle", "message", uid, ...]; fragments,
+    [uid, offset, final, bytes], and the other ports are not alerts.
+*/
+static void onHostMessage(uint16_t port, const uint8_t* data, uint32_t length)
+{
+    CborReader cbor(data, length);
+    uint32_t items;
+    uint32_t level;
+    const char* text;
+    uint32_t textLength;
+    uint32_t notificationUID;
+
+    if ((port == MessageCenter::AlertPort) &&
+        cbor.readArray(&items) && (items >= 5) &&
+        cbor.readUnsigned(&level) &&
+        cbor.readText(&text, &textLength) &&
+        cbor.readText(&text, &textLength) &&
+        cbor.readUnsigned(&notificationUID))
+    {
+        addAlert(replayAlerts, &replayAlertCount, notificationUID, length, captureNow());
+    }
+}
+
+static void deliverCharacteristics()
+{
+    GattClient& client = BLE::Instance().gattClient();
+
+    if (!characteristicsPending || !client.isServiceDiscoveryActive() ||
+        (capturedControlPoint == 0) || (capturedDataSource == 0))
+    {
+        return;
+    }
+
+    characteristicsPending = false;
+
+    client.hostCharacteristic(DiscoveredCharacteristic(controlPointUUID, capturedControlPoint - 1, capturedControlPoint));
+    client.hostCharacteristic(DiscoveredCharacteristic(dataSourceUUID, capturedDataSource - 1, capturedDataSource));
+    client.hostDiscoveryDone();
+}
+
+static uint32_t eventPeriodMs()
+{
+    uint32_t period = ConnectionManager::getEventPeriodMs();
+
+    return (period > 0) ? period : 30;
+}
+
+static void acknowledgeWrite()
+{
+    GattWriteCallbackParams params = { writeConnection, writeHandle, GattClient::GATT_OP_WRITE_REQ, 0, 0, NULL };
+
+    if (connected)
+    {
+        BLE::Instance().gattClient().hostDataWritten(params);
+    }
+}
+
+static void answerRead()
+{
+    GattAttribute::Handle_t value = readHandle + 1;
+    uint8_t declaration[3 + UUID::LENGTH_OF_LONG_UUID];
+
+    // without the handle in the capture the read goes unanswered
+    if (!connected || ((value != capturedControlPoint) && (value != capturedDataSource)))
+    {
+        return;
+    }
+
+    // properties, value handle, and the 128-bit UUID
+    declaration[0] = 0;
+    declaration[1] = value;
+    declaration[2] = value >> 8;
+    memcpy(&declaration[3],
+           ((value == capturedControlPoint) ? controlPointUUID : dataSourceUUID).getBaseUUID(),
+           UUID::LENGTH_OF_LONG_UUID);
+
+    GattReadCallbackParams params = { readConnection, readHandle, 0, sizeof(declaration), declaration };
+
+    BLE::Instance().gattClient().hostDataRead(params);
+}
+
+static ble_error_t onDiscovery(Gap::Handle_t, const UUID&)
+{
+    characteristicsPending = true;
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onRead(Gap::Handle_t connection, GattAttribute::Handle_t handle)
+{
+    readConnection = connection;
+    readHandle = handle;
+
+    if (!capturedReads)
+    {
+        minar::Scheduler::postCallback(answerRead)
+            .delay(minar::milliseconds(eventPeriodMs()));
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+static ble_error_t onWrite(Gap::Handle_t connection, GattAttribute::Handle_t handle, uint16_t, const uint8_t*)
+{
+    writeConnection = connection;
+    writeHandle = handle;
+
+    if (!capturedWrites)
+    {
+        minar::Scheduler::postCallback(acknowledgeWrite)
+            .delay(minar::milliseconds(eventPeriodMs()));
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+static void replayRecord(const record_t& record)
+{
+    counts[record.type]++;
+
+    switch (record.type)
+    {
+        case TraceCapture::RecordConnected:
+            if ((record.count >= 7) && (record.length >= Gap::ADDR_LEN))
+            {
+                Gap::ConnectionParams_t connectionParams = { (uint16_t) record.values[3],
+                                                             (uint16_t) record.values[4],
+                                                             (uint16_t) record.values[5],
+                                                             (uint16_t) record.values[6] };
+                Gap::ConnectionCallbackParams_t params;
+
+                memset(&params, 0, sizeof(params));
+                params.handle = record.values[0];
+                params.role = (Gap::Role_t) record.values[1];
+                params.peerAddrType = (Gap::AddressType_t) record.values[2];
+                params.connectionParams = &connectionParams;
+                memcpy(params.peerAddr, record.data, Gap::ADDR_LEN);
+
+                connected = connected || (params.role == Gap::PERIPHERAL);
+
+                BLE::Instance().gap().hostConnect(params);
+            }
+            break;
+
+        case TraceCapture::RecordDisconnected:
+            if (record.count >= 2)
+            {
+                connected = false;
+
+                BLE::Instance().gap().hostDisconnect(record.values[0], (Gap::DisconnectionReason_t) record.values[1]);
+            }
+            break;
+
+        case TraceCapture::RecordServiceFound:
+            ANCSClient::hostServiceFound();
+            break;
+
+        case TraceCapture::RecordNotification:
+            if (record.count >= 5)
+            {
+                ANCSClient::Notification_t event = { (uint8_t) record.values[0],
+                                                     (uint8_t) record.values[1],
+                                                     (uint8_t) record.values[2],
+                                                     (uint8_t) record.values[3],
+                                                     record.values[4] };
+
+                if (event.eventID != ANCSClient::EventIDNotificationRemoved)
+                {
+                    arrive(event.notificationUID, record.time);
+                }
+
+                ANCSClient::hostNotification(event);
+            }
+            break;
+
+        case TraceCapture::RecordCharacteristic:
+            if (record.count >= 2)
+            {
+                if (record.values[0] == 1)
+                {
+                    capturedControlPoint = record.values[1];
+                }
+                else
+                {
+                    capturedDataSource = record.values[1];
+                }
+
+                deliverCharacteristics();
+            }
+            break;
+
+        case TraceCapture::RecordDataSource:
+            if (!isComplete(record))
+            {
+                cut++;
+            }
+            else if (record.count >= 3)
+            {
+                GattHVXCallbackParams params = { (Gap::Handle_t) record.values[0],
+                                                 (GattAttribute::Handle_t) record.values[1],
+                                                 1,
+                                                 record.length,
+                                                 record.data };
+
+                BLE::Instance().gattClient().hostHVX(params);
+            }
+            break;
+
+        case TraceCapture::RecordAttributeData:
+            if (!isComplete(record))
+            {
+                cut++;
+            }
+            else
+            {
+                ANCSClient::hostAttribute(record.data, record.length);
+            }
+            break;
+
+        case TraceCapture::RecordWritten:
+            if (record.count >= 2)
+            {
+                GattWriteCallbackParams params = { (Gap::Handle_t) record.values[0],
+                                                   (GattAttribute::Handle_t) record.values[1],
+                                                   GattClient::GATT_OP_WRITE_REQ,
+                                                   0,
+                                                   0,
+                                                   NULL };
+
+                BLE::Instance().gattClient().hostDataWritten(params);
+            }
+            break;
+
+        case TraceCapture::RecordRead:
+            if (!isComplete(record))
+            {
+                cut++;
+            }
+            else if (record.count >= 4)
+            {
+                GattReadCallbackParams params = { (Gap::Handle_t) record.values[0],
+                                                  (GattAttribute::Handle_t) record.values[1],
+                                                  (uint16_t) record.values[2],
+                                                  record.length,
+                                                  record.data };
+
+                BLE::Instance().gattClient().hostDataRead(params);
+            }
+            break;
+
+        case TraceCapture::RecordReceived:
+            if (!isComplete(record))
+            {
+                cut++;
+            }
+            else if (record.count >= 2)
+            {
+                MessageCenter::hostReceive(record.values[0], record.data, record.length);
+            }
+            break;
+
+        // outputs of the device are compared, not replayed
+        case TraceCapture::RecordAlertQueued:
+            if (record.count >= 2)
+            {
+                addAlert(deviceAlerts, &deviceAlertCount, record.values[0], record.values[1], record.time);
+            }
+            break;
+
+        case TraceCapture::RecordHeapCall:
+            deviceHeapCalls++;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void replay()
+{
+    BLE::Instance().gattClient().hostSetHandlers(onDiscovery, onRead, onWrite);
+    MessageCenter::hostSetSink(onHostMessage);
+
+    for (uint32_t idx = 0; idx < recordCount; idx++)
+    {
+        capturedWrites = capturedWrites || (records[idx].type == TraceCapture::RecordWritten);
+        capturedReads = capturedReads || (records[idx].type == TraceCapture::RecordRead);
+    }
+
+    app_start(0, NULL);
+
+    /*
+        The records of one tick are played together, after the callbacks
+        due at that tick and before the ones they post, as the phone
+        delivers a connection event's worth at once.
+    */
+    for (uint32_t idx = 0; idx < recordCount; idx++)
+    {
+        if ((idx == 0) || (records[idx].ticks != records[idx - 1].ticks))
+        {
+            runUntil(records[idx].ticks);
+            deliverCharacteristics();
+        }
+
+        replayRecord(records[idx]);
+    }
+
+    runUntil(((recordCount > 0) ? records[recordCount - 1].ticks : 0) + minar::milliseconds(SETTLE_US / 1000));
+}
+
+/*****************************************************************************/
+/* Report                                                                    */
+/*****************************************************************************/
+
+static int compare(const void* a, const void* b)
+{
+    uint32_t first = *(const uint32_t*) a;
+    uint32_t second = *(const uint32_t*) b;
+
+    return (first > second) - (first < second);
+}
+
+static void reportLatency(const char* name, const alert_t* alerts, uint32_t count)
+{
+    static uint32_t values[MAX_ALERTS];
+    uint64_t sum = 0;
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        values[idx] = alerts[idx].latency;
+        sum += values[idx];
+    }
+
+    qsort(values, count, sizeof(uint32_t), compare);
+
+    report("%-8s %7u %8u %8u %8u\n",
+           name,
+           count,
+           (count) ? (uint32_t) (sum / count) : 0,
+           (count) ? values[count / 2] : 0,
+           (count) ? values[count - 1] : 0);
+}
+
+static void reportAll()
+{
+    uint64_t duration = (recordCount > 0) ? records[recordCount - 1].time : 0;
+
+    report("%u records over %llu.%03llu s, %u payloads cut short\n",
+           recordCount,
+           (unsigned long long) (duration / 1000000),
+           (unsigned long long) (duration / 1000 % 1000),
+           cut);
+
+    report("replayed: %u connected, %u disconnected, %u service found, %u notifications,\n"
+           "          %u characteristics, %u data source, %u attribute data, %u written,\n"
+           "          %u read, %u received\n",
+           counts[TraceCapture::RecordConnected],
+           counts[TraceCapture::RecordDisconnected],
+           counts[TraceCapture::RecordServiceFound],
+           counts[TraceCapture::RecordNotification],
+           counts[TraceCapture::RecordCharacteristic],
+           counts[TraceCapture::RecordDataSource],
+           counts[TraceCapture::RecordAttributeData],
+           counts[TraceCapture::RecordWritten],
+           counts[TraceCapture::RecordRead],
+           counts[TraceCapture::RecordReceived]);
+
+    // pairs in order; the first difference is where the replay went its own way
+    uint32_t matching = 0;
+    uint32_t common = (replayAlertCount < deviceAlertCount) ? replayAlertCount : deviceAlertCount;
+
+    while ((matching < common) &&
+           (replayAlerts[matching].notificationUID == deviceAlerts[matching].notificationUID) &&
+           (replayAlerts[matching].length == deviceAlerts[matching].length))
+    {
+        matching++;
+    }
+
+    if (verbose)
+    {
+        uint32_t rows = (replayAlertCount > deviceAlertCount) ? replayAlertCount : deviceAlertCount;
+
+        report("\n%5s %10s %7s %8s %10s %7s %8s\n", "alert", "replay uid", "length", "ms", "device uid", "length", "ms");
+
+        for (uint32_t idx = 0; idx < rows; idx++)
+        {
+            report("%5u", idx + 1);
+
+            if (idx < replayAlertCount)
+            {
+                report(" %10u %7u %8u", replayAlerts[idx].notificationUID, replayAlerts[idx].length, replayAlerts[idx].latency);
+            }
+            else
+            {
+                report(" %10s %7s %8s", "-", "-", "-");
+            }
+
+            if (idx < deviceAlertCount)
+            {
+                report(" %10u %7u %8u", deviceAlerts[idx].notificationUID, deviceAlerts[idx].length, deviceAlerts[idx].latency);
+            }
+
+            report("%s\n", (idx == matching) ? "  <- first difference" : "");
+        }
+    }
+
+    report("\nalerts: %u replayed, %u on the device, first %u identical\n",
+           replayAlertCount, deviceAlertCount, matching);
+
+    report("\n%-8s %7s %8s %8s %8s\n", "latency", "alerts", "avg ms", "p50 ms", "max ms");
+    reportLatency("replay", replayAlerts, replayAlertCount);
+    reportLatency("device", deviceAlerts, deviceAlertCount);
+
+    const NotificationScheduler::statistics_t& queue = ANCSManager::getQueueStatistics();
+    const AlertRateLimiter::statistics_t& rate = ANCSManager::getRateStatistics();
+    const HandleCache::statistics_t& handles = ANCSManager::getHandleCacheStatistics();
+
+    report("\nqueue: %u added, %u coalesced, %u superseded, %u cancelled, %u dropped, peak %u\n",
+           queue.added, queue.coalesced, queue.superseded, queue.cancelled, queue.dropped, queue.highWaterMark);
+    report("rate limit: %u admitted, %u suppressed, %u replayed\n",
+           rate.admitted, rate.suppressed, rate.replayed);
+    report("handle cache: %u hits, %u misses, %u stores, %u invalidations\n",
+           handles.hits, handles.misses, handles.stores, handles.invalidations);
+    report("heap calls after init: %u replayed, %u on the device\n",
+           MemoryMonitor::getStatistics().heapCalls, deviceHeapCalls);
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = NULL;
+    const char* expected = NULL;
+
+    for (int idx = 1; idx < argc; idx++)
+    {
+        if (strcmp(argv[idx], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if ((strcmp(argv[idx], "-e") == 0) && (idx + 1 < argc))
+        {
+            expected = argv[++idx];
+        }
+        else
+        {
+            path = argv[idx];
+        }
+    }
+
+    if (path == NULL)
+    {
+        printf("usage: trace_replay [-v] [-e expected.txt] capture.bin\n");
+        return 1;
+    }
+
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    size_t length = fread(capture, 1, sizeof(capture), file);
+    bool whole = feof(file);
+
+    fclose(file);
+
+    if (!whole)
+    {
+        printf("%s: larger than %u bytes\n", path, MAX_CAPTURE);
+        return 1;
+    }
+
+    if (!parse(capture, length))
+    {
+        return 1;
+    }
+
+    replay();
+
+    reportAll();
+
+    return ((expected == NULL) || compareExpected(expected)) ? 0 : 1;
+}
@@ -0,0 +1,376 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Host benchmark of UUIDFilterSet against one lookup per UUID.
+
+    Build and run from this directory:
+
+        g++ -O2 -Ihost -I../source uuid_filter_benchmark.cpp -o uuid_filter_benchmark
+        ./uuid_filter_benchmark
+
+    Sets of 1, 8, and 64 filters, alternating 16-bit and 128-bit UUIDs, are
+    matched against generated scan reports whose service lists hold a mix
+    of filtered and unrelated UUIDs.
+
+    per UUID is the old advertisementContainsUUID called once per filter: a
+    pass over the payload for every filter and a UUID constructed for every
+    list entry. index builds one AdvertisementIndex per report and asks it
+    once per filter. filter set is a single UUIDFilterSet::match per
+    report. All three must produce the same match masks; the program fails
+    if they do not. Cycle counts are taken on the host and only indicate
+    relative cost.
+*/
+
+#include "ble/BLE.h"
+#include "AdvertisingParsing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+
+#define REPORTS 1024
+#define PAYLOAD_LENGTH 31
+#define MAX_FILTERS 64
+#define ROUNDS 50
+
+typedef UUIDFilterSet<MAX_FILTERS>::mask_t mask_t;
+
+typedef struct {
+    uint8_t data[PAYLOAD_LENGTH];
+    uint8_t length;
+} report_t;
+
+static report_t reports[REPORTS];
+
+// filter UUIDs, 16-bit at even positions and 128-bit at odd ones
+static uint16_t shortValues[MAX_FILTERS];
+static uint8_t longValues[MAX_FILTERS][UUID::LENGTH_OF_LONG_UUID];
+static UUID* filters[MAX_FILTERS];
+
+/*****************************************************************************/
+/* Generator                                                                 */
+/*****************************************************************************/
+
+static uint32_t randomState = 2463534242UL;
+
+static uint32_t random32()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+static void createFilters()
+{
+    static const uint8_t vendorBase[UUID::LENGTH_OF_LONG_UUID] = {
+        0xD0, 0x00, 0x2D, 0x12, 0x1E, 0x4B, 0x0F, 0xA4,
+        0x99, 0x4E, 0xCE, 0xB5, 0x00, 0x00, 0x05, 0x79
+    };
+
+    for (uint8_t idx = 0; idx < MAX_FILTERS; idx++)
+    {
+        if (idx % 2 == 0)
+        {
+            shortValues[idx] = 0xFE00 + idx;
+            filters[idx] = new UUID((UUID::ShortUUIDBytes_t) shortValues[idx]);
+        }
+        else
+        {
+            // one vendor base, services differ in bytes 12 and 13
+            memcpy(longValues[idx], vendorBase, UUID::LENGTH_OF_LONG_UUID);
+            longValues[idx][12] = idx;
+            longValues[idx][13] = idx >> 8;
+            filters[idx] = new UUID(longValues[idx], UUID::LSB);
+        }
+    }
+}
+
+static void generate(report_t& report)
+{
+    report.length = 0;
+
+    // flags
+    report.data[report.length++] = 2;
+    report.data[report.length++] = GapAdvertisingData::FLAGS;
+    report.data[report.length++] = 0x06;
+
+    if (random32() % 2)
+    {
+        // 16-bit list, a quarter of the entries from the filters
+        uint8_t count = 1 + random32() % 4;
+
+        report.data[report.length++] = 1 + 2 * count;
+        report.data[report.length++] = GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS;
+
+        for (uint8_t idx = 0; idx < count; idx++)
+        {
+            uint16_t value = (random32() % 4) ? 0x1800 + random32() % 64 : shortValues[2 * (random32() % (MAX_FILTERS / 2))];
+
+            report.data[report.length++] = value;
+            report.data[report.length++] = value >> 8;
+        }
+    }
+
+    if (report.length + 2 + UUID::LENGTH_OF_LONG_UUID <= PAYLOAD_LENGTH)
+    {
+        // one 128-bit service, from the filters half the time
+        report.data[report.length++] = 1 + UUID::LENGTH_OF_LONG_UUID;
+        report.data[report.length++] = GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS;
+
+        memcpy(&report.data[report.length], longValues[1 + 2 * (random32() % (MAX_FILTERS / 2))], UUID::LENGTH_OF_LONG_UUID);
+
+        if (random32() % 2)
+        {
+            report.data[report.length] ^= 0x80;
+        }
+
+        report.length += UUID::LENGTH_OF_LONG_UUID;
+    }
+
+    // fill the rest with manufacturer data
+    if (report.length + 3 <= PAYLOAD_LENGTH)
+    {
+        uint8_t valueLength = PAYLOAD_LENGTH - report.length - 2;
+
+        report.data[report.length++] = 1 + valueLength;
+        report.data[report.length++] = GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA;
+
+        for (uint8_t idx = 0; idx < valueLength; idx++)
+        {
+            report.data[report.length++] = random32();
+        }
+    }
+}
+
+/*****************************************************************************/
+/* Matchers                                                                  */
+/*****************************************************************************/
+
+/*
+    advertisementContainsUUID before the index, byte order made explicit
+    so it compares like with like.
+*/
+static bool containsUUIDBefore(const Gap::AdvertisementCallbackParams_t* params, const UUID& uuid)
+{
+    // scan through advertisement data
+    for (uint8_t idx = 0; idx < params->advertisingDataLen; )
+    {
+        uint8_t fieldLength = params->advertisingData[idx];
+        uint8_t fieldType = params->advertisingData[idx + 1];
+        const uint8_t* fieldValue = &(params->advertisingData[idx + 2]);
+
+        // find 16-bit service IDs
+        if ((fieldType == GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS) ||
+            (fieldType == GapAdvertisingData::INCOMPLETE_LIST_16BIT_SERVICE_IDS))
+        {
+            uint8_t units = (fieldLength - 1) / 2;
+
+            for (uint8_t unit = 0; unit < units; unit++)
+            {
+                // compare short UUID
+                UUID beaconUUID((UUID::ShortUUIDBytes_t) ((fieldValue[unit * 2 + 1] << 8) | fieldValue[unit * 2]));
+
+                if (beaconUUID == uuid)
+                {
+                    return true;
+                }
+            }
+        }
+        // find 128-bit service IDs
+        else if ((fieldType == GapAdvertisingData::COMPLETE_LIST_128BIT_SERVICE_IDS) ||
+                 (fieldType == GapAdvertisingData::INCOMPLETE_LIST_128BIT_SERVICE_IDS))
+        {
+            uint8_t units = (fieldLength - 1) / 16;
+
+            for (uint8_t unit = 0; unit < units; unit++)
+            {
+                // compare long UUID
+                UUID beaconUUID(&fieldValue[unit * 16], UUID::LSB);
+
+                if (beaconUUID == uuid)
+                {
+                    return true;
+                }
+            }
+        }
+
+        // move to next field
+        idx += fieldLength + 1;
+    }
+
+    return false;
+}
+
+static mask_t matchPerUUID(const Gap::AdvertisementCallbackParams_t* params,
+                           const UUIDFilterSet<MAX_FILTERS>&,
+                           uint8_t count)
+{
+    mask_t mask = 0;
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if (containsUUIDBefore(params, *filters[idx]))
+        {
+            mask |= (mask_t) 1 << idx;
+        }
+    }
+
+    return mask;
+}
+
+static mask_t matchIndex(const Gap::AdvertisementCallbackParams_t* params,
+                         const UUIDFilterSet<MAX_FILTERS>&,
+                         uint8_t count)
+{
+    AdvertisementIndex index(params);
+    mask_t mask = 0;
+
+    for (uint8_t idx = 0; idx < count; idx++)
+    {
+        if (index.containsUUID(*filters[idx]))
+        {
+            mask |= (mask_t) 1 << idx;
+        }
+    }
+
+    return mask;
+}
+
+static mask_t matchSet(const Gap::AdvertisementCallbackParams_t* params,
+                       const UUIDFilterSet<MAX_FILTERS>& set,
+                       uint8_t)
+{
+    return set.match(params);
+}
+
+typedef mask_t (*matcher_t)(const Gap::AdvertisementCallbackParams_t* params,
+                            const UUIDFilterSet<MAX_FILTERS>& set,
+                            uint8_t count);
+
+static const matcher_t matchers[] = { matchPerUUID, matchIndex, matchSet };
+static const char* const names[] = { "per UUID", "index", "filter set" };
+
+#define MODES (sizeof(matchers) / sizeof(matcher_t))
+
+/*****************************************************************************/
+
+int main()
+{
+    createFilters();
+
+    for (uint32_t idx = 0; idx < REPORTS; idx++)
+    {
+        generate(reports[idx]);
+    }
+
+    static const uint8_t sizes[] = { 1, 8, 64 };
+
+    Gap::AdvertisementCallbackParams_t params;
+    memset(&params, 0, sizeof(params));
+
+    bool passed = true;
+
+    printf("%u reports, cycles per report:\n", REPORTS);
+    printf("%-8s %12s %12s %12s %10s\n", "filters", names[0], names[1], names[2], "matches");
+
+    for (uint8_t size = 0; size < sizeof(sizes); size++)
+    {
+        uint8_t count = sizes[size];
+
+        UUIDFilterSet<MAX_FILTERS> set;
+
+        for (uint8_t idx = 0; idx < count; idx++)
+        {
+            set.add(*filters[idx]);
+        }
+
+        mask_t masks[MODES][REPORTS];
+        uint64_t cycles[MODES];
+
+        for (uint8_t mode = 0; mode < MODES; mode++)
+        {
+            for (uint32_t idx = 0; idx < REPORTS; idx++)
+            {
+                params.advertisingData = reports[idx].data;
+                params.advertisingDataLen = reports[idx].length;
+
+                masks[mode][idx] = matchers[mode](&params, set, count);
+            }
+
+            mask_t ignored = 0;
+            uint64_t start = CYCLES();
+
+            for (uint32_t round = 0; round < ROUNDS; round++)
+            {
+                for (uint32_t idx = 0; idx < REPORTS; idx++)
+                {
+                    params.advertisingData = reports[idx].data;
+                    params.advertisingDataLen = reports[idx].length;
+
+                    ignored ^= matchers[mode](&params, set, count);
+                }
+            }
+
+            cycles[mode] = CYCLES() - start;
+
+            // keep the matches from being optimised away
+            if (ignored == (mask_t) -1)
+            {
+                printf("\n");
+            }
+        }
+
+        uint32_t matches = 0;
+
+        for (uint32_t idx = 0; idx < REPORTS; idx++)
+        {
+            matches += (masks[0][idx] != 0);
+
+            for (uint8_t mode = 1; mode < MODES; mode++)
+            {
+                if (masks[mode][idx] != masks[0][idx])
+                {
+                    printf("report %u: %s mask differs\n", idx, names[mode]);
+                    passed = false;
+                }
+            }
+        }
+
+        printf("%-8u %12.1f %12.1f %12.1f %10u\n",
+               count,
+               (double) cycles[0] / ((uint64_t) REPORTS * ROUNDS),
+               (double) cycles[1] / ((uint64_t) REPORTS * ROUNDS),
+               (double) cycles[2] / ((uint64_t) REPORTS * ROUNDS),
+               matches);
+    }
+
+    for (uint8_t idx = 0; idx < MAX_FILTERS; idx++)
+    {
+        delete filters[idx];
+    }
+
+    return (passed) ? 0 : 1;
+}